@@ -5,8 +5,11 @@
 
 #include "base64.h"
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
@@ -29,20 +32,35 @@ static uchar s_digits[256] = "\
 \x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\
 \x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58\x58";
 
+// Each 12 bits of input map to a pair of digits so a group of 3 bytes is
+// written with two lookups and two copies. Filled on first use.
+static char digit_pairs[4096][2];
+static bool digit_pairs_ready = false;
+
+static void fill_digit_pairs(void) {
+    int i;
+
+    for (i = 0; i < 4096; i++) {
+        digit_pairs[i][0] = digits[i >> 6];
+        digit_pairs[i][1] = digits[i & 0x3F];
+    }
+    digit_pairs_ready = true;
+}
+
 void to_base64(const uchar *src, int len, char *b64) {
     const uchar *end3;
     int          len3 = len % 3;
-    uchar        b1, b2, b3;
+    uchar        b1, b2;
+    uint32_t     v;
 
+    if (!digit_pairs_ready) {
+        fill_digit_pairs();
+    }
     end3 = src + (len - len3);
-    while (src < end3) {
-        b1     = *src++;
-        b2     = *src++;
-        b3     = *src++;
-        *b64++ = digits[(uchar)(b1 >> 2)];
-        *b64++ = digits[(uchar)(((b1 & 0x03) << 4) | (b2 >> 4))];
-        *b64++ = digits[(uchar)(((b2 & 0x0F) << 2) | (b3 >> 6))];
-        *b64++ = digits[(uchar)(b3 & 0x3F)];
+    for (; src < end3; src += 3, b64 += 4) {
+        v = ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | (uint32_t)src[2];
+        memcpy(b64, digit_pairs[v >> 12], 2);
+        memcpy(b64 + 2, digit_pairs[v & 0x0FFF], 2);
     }
     if (1 == len3) {
         b1     = *src++;
@@ -81,9 +99,32 @@ unsigned long b64_orig_size(const char *text) {
     return size;
 }
 
+// Valid digits are all below 0x40 and invalid or terminating characters are
+// 0x58 so one test of the OR of a group of 4 finds any that are not digits.
+static inline bool decode4(const uchar *s, uchar *str) {
+    uint32_t b0 = s_digits[s[0]];
+    uint32_t b1 = s_digits[s[1]];
+    uint32_t b2 = s_digits[s[2]];
+    uint32_t b3 = s_digits[s[3]];
+    uint32_t v;
+
+    if (0x40 & (b0 | b1 | b2 | b3)) {
+        return false;
+    }
+    v      = (b0 << 18) | (b1 << 12) | (b2 << 6) | b3;
+    str[0] = (uchar)(v >> 16);
+    str[1] = (uchar)(v >> 8);
+    str[2] = (uchar)v;
+
+    return true;
+}
+
 void from_base64(const char *b64, uchar *str) {
-    uchar b0, b1, b2, b3;
+    const char *end = b64 + strlen(b64);
+    uchar       b0, b1, b2, b3;
 
+    for (; 4 <= end - b64 && decode4((const uchar *)b64, str); b64 += 4, str += 3) {
+    }
     while (1) {
         if ('X' == (b0 = s_digits[(uchar)*b64++])) {
             break;
@@ -103,3 +144,59 @@ void from_base64(const char *b64, uchar *str) {
     }
     *str = '\0';
 }
+
+size_t b64_decode(B64Dec dec, const char *b64, size_t len, uchar *str, long *badp) {
+    const uchar *s     = (const uchar *)b64;
+    const uchar *end   = s + len;
+    uchar       *start = str;
+    uchar        b;
+
+    while (s < end) {
+        if (0 == dec->cnt) {
+            for (; 4 <= end - s && decode4(s, str); s += 4, str += 3) {
+            }
+            if (end <= s) {
+                break;
+            }
+        }
+        // A line break, padding, or a bad character. Go one at a time until
+        // the next group starts.
+        if ('X' != (b = s_digits[*s])) {
+            dec->bits = (dec->bits << 6) | b;
+            if (4 == ++dec->cnt) {
+                *str++    = (uchar)(dec->bits >> 16);
+                *str++    = (uchar)(dec->bits >> 8);
+                *str++    = (uchar)dec->bits;
+                dec->bits = 0;
+                dec->cnt  = 0;
+            }
+        } else if ('=' == *s) {
+            str += b64_decode_finish(dec, str);
+        } else if (' ' != *s && '\n' != *s && '\r' != *s && '\t' != *s) {
+            (*badp)++;
+        }
+        s++;
+    }
+    return (size_t)(str - start);
+}
+
+size_t b64_decode_finish(B64Dec dec, uchar *str) {
+    size_t cnt = 0;
+
+    switch (dec->cnt) {
+    case 2:
+        str[0] = (uchar)(dec->bits >> 4);
+        cnt    = 1;
+        break;
+    case 3:
+        str[0] = (uchar)(dec->bits >> 10);
+        str[1] = (uchar)(dec->bits >> 2);
+        cnt    = 2;
+        break;
+    default: break;
+    }
+    dec->bits = 0;
+    dec->cnt  = 0;
+
+    return cnt;
+}
@@ -6,13 +6,27 @@
 #ifndef BASE64_H
 #define BASE64_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef unsigned char uchar;
 
+// State carried between calls to b64_decode() when the encoded text arrives
+// in pieces. Up to 3 digits of an incomplete group are held in bits.
+typedef struct _b64Dec {
+    uint32_t bits;
+    int      cnt;
+} *B64Dec;
+
 #define b64_size(len) ((len + 2) / 3 * 4)
+#define b64_decode_size(len) ((len) / 4 * 3 + 6)
 
 extern unsigned long b64_orig_size(const char *text);
 
 extern void to_base64(const uchar *src, int len, char *b64);
 extern void from_base64(const char *b64, uchar *str);
 
+extern size_t b64_decode(B64Dec dec, const char *b64, size_t len, uchar *str, long *badp);
+extern size_t b64_decode_finish(B64Dec dec, uchar *str);
+
 #endif /* BASE64_H */
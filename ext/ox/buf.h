@@ -31,20 +31,43 @@
 #ifndef OX_BUF_H
 #define OX_BUF_H
 
+#include <errno.h>
 #include <ruby.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#define BUF_IOV_MAX 64
+#define BUF_SCATTER_MIN 4096
+
+// When writing to memory and the buffer outgrows base the content is moved
+// into a Ruby String (str) so the finished document can be handed off without
+// a copy. The owner of the Buf must mark str.
+//
+// When writing to a file descriptor in scatter mode large String payloads are
+// not copied. They are queued as iovecs that point into frozen Strings held
+// in refs and written along with the framing bytes in base by a single
+// writev() when base fills up or the Buf is finished. Framing bytes from mark
+// to tail have not been queued yet. The owner must also mark refs.
 typedef struct _buf {
-    char *head;
-    char *end;
-    char *tail;
-    int   fd;
-    bool  err;
-    char  base[16384];
+    char         *head;
+    char         *end;
+    char         *tail;
+    VALUE         str;
+    int           fd;
+    bool          err;
+    struct iovec *iov;  // NULL unless in scatter mode
+    int           iov_cnt;
+    char         *mark;
+    VALUE         refs;
+    char          base[16384];
 } *Buf;
 
 inline static void buf_init(Buf buf, int fd, long initial_size) {
+    buf->str     = Qnil;
+    buf->iov     = NULL;
+    buf->iov_cnt = 0;
+    buf->refs    = Qnil;
     if (sizeof(buf->base) < (size_t)initial_size) {
         buf->head = ALLOC_N(char, initial_size);
         buf->end  = buf->head + initial_size - 1;
@@ -53,23 +76,123 @@ inline static void buf_init(Buf buf, int fd, long initial_size) {
         buf->end  = buf->base + sizeof(buf->base) - 1;
     }
     buf->tail = buf->head;
+    buf->mark = buf->head;
     buf->fd   = fd;
     buf->err  = false;
 }
 
+// Switches a file descriptor Buf to scatter mode.
+inline static void buf_scatter(Buf buf) {
+    if (0 != buf->fd && NULL == buf->iov) {
+        buf->iov  = ALLOC_N(struct iovec, BUF_IOV_MAX);
+        buf->refs = rb_ary_new();
+    }
+}
+
+// Empties the buffer but keeps any memory already allocated for reuse.
 inline static void buf_reset(Buf buf) {
-    buf->head = buf->base;
     buf->tail = buf->head;
+    buf->err  = false;
+}
+
+inline static size_t buf_len(Buf buf) {
+    return buf->tail - buf->head;
 }
 
 inline static void buf_cleanup(Buf buf) {
-    if (buf->base != buf->head) {
-        free(buf->head);
+    if (buf->base != buf->head && Qnil == buf->str) {
+        xfree(buf->head);
     }
+    xfree(buf->iov);
 }
 
-inline static size_t buf_len(Buf buf) {
-    return buf->tail - buf->head;
+inline static void buf_grow(Buf buf, size_t slen) {
+    size_t len     = buf->end - buf->head;
+    size_t toff    = buf->tail - buf->head;
+    size_t new_len = len + slen + len / 2;
+
+    if (Qnil == buf->str) {
+        buf->str = rb_str_new(NULL, (long)new_len);
+        memcpy(RSTRING_PTR(buf->str), buf->head, toff);
+        if (buf->base != buf->head) {
+            xfree(buf->head);
+        }
+    } else {
+        rb_str_resize(buf->str, (long)new_len);
+    }
+    buf->head = RSTRING_PTR(buf->str);
+    buf->tail = buf->head + toff;
+    buf->end  = buf->head + new_len - 2;
+}
+
+// Returns the content as a String, giving up the heap String if there is one
+// rather than copying it. The Buf is left empty and using base.
+inline static VALUE buf_take_str(Buf buf) {
+    VALUE rstr;
+
+    if (Qnil == buf->str) {
+        rstr = rb_str_new(buf->head, buf_len(buf));
+        if (buf->base != buf->head) {
+            xfree(buf->head);
+        }
+    } else {
+        rstr = buf->str;
+        rb_str_set_len(rstr, (long)buf_len(buf));
+        buf->str = Qnil;
+    }
+    buf->head = buf->base;
+    buf->end  = buf->base + sizeof(buf->base) - 1;
+    buf->tail = buf->head;
+
+    return rstr;
+}
+
+inline static void buf_push_iov(Buf buf, const char *s, size_t len) {
+    buf->iov[buf->iov_cnt].iov_base = (void *)s;
+    buf->iov[buf->iov_cnt].iov_len  = len;
+    buf->iov_cnt++;
+}
+
+// Writes all queued iovecs, continuing after partial writes.
+inline static void buf_writev(Buf buf) {
+    struct iovec *v   = buf->iov;
+    int           cnt = buf->iov_cnt;
+    ssize_t       n;
+
+    while (0 < cnt) {
+        if (0 > (n = writev(buf->fd, v, cnt))) {
+            if (EINTR == errno) {
+                continue;
+            }
+            buf->err = true;
+            break;
+        }
+        for (; 0 < cnt && (size_t)n >= v->iov_len; cnt--, v++) {
+            n -= (ssize_t)v->iov_len;
+        }
+        if (0 < cnt) {
+            v->iov_base = (char *)v->iov_base + n;
+            v->iov_len -= (size_t)n;
+        }
+    }
+    buf->iov_cnt = 0;
+    rb_ary_clear(buf->refs);
+}
+
+// Writes everything pending to the file descriptor and empties base.
+inline static void buf_flush(Buf buf) {
+    size_t len = buf->tail - buf->head;
+
+    if (0 < buf->iov_cnt) {
+        if (buf->mark < buf->tail) {
+            buf_push_iov(buf, buf->mark, buf->tail - buf->mark);
+        }
+        buf_writev(buf);
+    } else if (0 < len && len != (size_t)write(buf->fd, buf->head, len)) {
+        buf->err = true;
+    }
+    buf->tail = buf->head;
+    buf->mark = buf->head;
 }
 
 inline static void buf_append_string(Buf buf, const char *s, size_t slen) {
@@ -78,13 +201,10 @@ inline static void buf_append_string(Buf buf, const char *s, size_t slen) {
     }
     if (buf->end <= buf->tail + slen) {
         if (0 != buf->fd) {
-            size_t len = buf->tail - buf->head;
-
-            if (len != (size_t)write(buf->fd, buf->head, len)) {
-                buf->err = true;
+            buf_flush(buf);
+            if (buf->err) {
                 return;
             }
-            buf->tail = buf->head;
             if (sizeof(buf->base) <= slen) {
                 if (slen != (size_t)write(buf->fd, s, slen)) {
                     buf->err = true;
@@ -93,18 +213,7 @@ inline static void buf_append_string(Buf buf, const char *s, size_t slen) {
                 return;
             }
         } else {
-            size_t len     = buf->end - buf->head;
-            size_t toff    = buf->tail - buf->head;
-            size_t new_len = len + slen + len / 2;
-
-            if (buf->base == buf->head) {
-                buf->head = ALLOC_N(char, new_len);
-                memcpy(buf->head, buf->base, len);
-            } else {
-                REALLOC_N(buf->head, char, new_len);
-            }
-            buf->tail = buf->head + toff;
-            buf->end  = buf->head + new_len - 2;
+            buf_grow(buf, slen);
         }
     }
     if (0 < slen) {
@@ -119,25 +228,9 @@ inline static void buf_append(Buf buf, char c) {
     }
     if (buf->end <= buf->tail) {
         if (0 != buf->fd) {
-            size_t len = buf->tail - buf->head;
-
-            if (len != (size_t)write(buf->fd, buf->head, len)) {
-                buf->err = true;
-            }
-            buf->tail = buf->head;
+            buf_flush(buf);
         } else {
-            size_t len     = buf->end - buf->head;
-            size_t toff    = buf->tail - buf->head;
-            size_t new_len = len + len / 2;
-
-            if (buf->base == buf->head) {
-                buf->head = ALLOC_N(char, new_len);
-                memcpy(buf->head, buf->base, len);
-            } else {
-                REALLOC_N(buf->head, char, new_len);
-            }
-            buf->tail = buf->head + toff;
-            buf->end  = buf->head + new_len - 2;
+            buf_grow(buf, 0);
         }
     }
     *buf->tail++ = c;
@@ -149,14 +242,34 @@ inline static void buf_finish(Buf buf) {
         return;
     }
     if (0 != buf->fd) {
-        size_t len = buf->tail - buf->head;
-
-        if (0 < len && len != (size_t)write(buf->fd, buf->head, len)) {
-            buf->err = true;
-        }
+        buf_flush(buf);
         fsync(buf->fd);
-        buf->tail = buf->head;
     }
 }
 
+// Appends the content of a String. In scatter mode a large String is queued
+// by reference instead of being copied. A frozen copy, which shares the
+// bytes, is held so later changes to the String do not change the output.
+inline static void buf_append_value(Buf buf, VALUE rstr) {
+    size_t len = (size_t)RSTRING_LEN(rstr);
+
+    if (NULL == buf->iov || len < BUF_SCATTER_MIN) {
+        buf_append_string(buf, RSTRING_PTR(rstr), len);
+        return;
+    }
+    if (buf->err) {
+        return;
+    }
+    if (BUF_IOV_MAX - 2 <= buf->iov_cnt) {
+        buf_flush(buf);
+    }
+    rstr = rb_str_new_frozen(rstr);
+    rb_ary_push(buf->refs, rstr);
+    if (buf->mark < buf->tail) {
+        buf_push_iov(buf, buf->mark, buf->tail - buf->mark);
+    }
+    buf_push_iov(buf, RSTRING_PTR(rstr), len);
+    buf->mark = buf->tail;
+}
+
 #endif /* OX_BUF_H */
@@ -16,13 +16,15 @@
 #include "ruby/version.h"
 
 #define MAX_DEPTH 128
+#define POOL_MAX 8
 
+static void builder_mark(void *ptr);
 static void builder_free(void *ptr);
 
 static const rb_data_type_t ox_builder_type = {
     "Ox/builder",
     {
-        NULL,
+        builder_mark,
         builder_free,
         NULL,
     },
@@ -51,6 +53,11 @@ typedef struct _builder {
 } *Builder;
 
 static VALUE      builder_class   = Qundef;
+static VALUE      template_class  = Qundef;
+static ID         pool_id;
+static VALUE      attrs_sym   = Qundef;
+static VALUE      root_sym    = Qundef;
+static VALUE      scatter_sym = Qundef;
 static const char indent_spaces[] = "\n                                                                                "
                                     "                                                ";  // 128 spaces
 
@@ -81,6 +88,17 @@ static const char xml_attr_chars[257] = "\
 11111111111111111111111111111111\
 11111111111111111111111111111111";
 
+// Same as xml_attr_chars but for template attribute values in single quotes.
+static const char xml_apos_attr_chars[257] = "\
+:::::::::11::1::::::::::::::::::\
+11611156111111111111111111114141\
+11111111111111111111111111111111\
+11111111111111111111111111111111\
+11111111111111111111111111111111\
+11111111111111111111111111111111\
+11111111111111111111111111111111\
+11111111111111111111111111111111";
+
 // From 3.1 of the XML 1.1 spec. All over 0x20 except <&, > also.
 static const char xml_element_chars[257] = "\
 :::::::::11::1::::::::::::::::::\
@@ -96,9 +114,9 @@ inline static size_t xml_str_len(const unsigned char *str, size_t len, const cha
     size_t size = 0;
 
     for (; 0 < len; str++, len--) {
-        size += table[*str];
+        size += table[*str] - '0';
     }
-    return size - len * (size_t)'0';
+    return size;
 }
 
 static void append_indent(Builder b) {
@@ -118,14 +136,21 @@ static void append_indent(Builder b) {
     }
 }
 
-static void append_string(Builder b, const char *str, size_t size, const char *table, bool strip_invalid_chars) {
+// If rstr is not Qnil it is the String that str and size came from and it is
+// handed to the buffer as is when nothing needs to be escaped.
+static void
+append_chars(Builder b, VALUE rstr, const char *str, size_t size, const char *table, bool strip_invalid_chars) {
     size_t xsize = xml_str_len((const unsigned char *)str, size, table);
 
     if (size == xsize) {
         const char *s   = str;
         const char *end = str + size;
 
-        buf_append_string(&b->buf, str, size);
+        if (Qnil == rstr) {
+            buf_append_string(&b->buf, str, size);
+        } else {
+            buf_append_value(&b->buf, rstr);
+        }
         b->col += size;
         s = strchr(s, '\n');
         while (NULL != s) {
@@ -184,6 +209,14 @@ static void append_string(Builder b, const char *str, size_t size, const char *t
     }
 }
 
+static void append_string(Builder b, const char *str, size_t size, const char *table, bool strip_invalid_chars) {
+    append_chars(b, Qnil, str, size, table, strip_invalid_chars);
+}
+
+static void append_value(Builder b, VALUE v, bool strip_invalid_chars) {
+    append_chars(b, v, StringValuePtr(v), RSTRING_LEN(v), xml_element_chars, strip_invalid_chars);
+}
+
 static void append_sym_str(Builder b, VALUE v) {
     const char *s;
     long        len;
@@ -237,6 +270,52 @@ static int append_attr(VALUE key, VALUE value, VALUE bv) {
     return ST_CONTINUE;
 }
 
+static void push_element(Builder b, VALUE rname, VALUE attrs) {
+    Element     e;
+    const char *name;
+    long        len;
+
+    // Checked before anything changes so a raise leaves the stack with only
+    // fully pushed elements for pop() and reset().
+    if (MAX_DEPTH <= b->depth + 1) {
+        rb_raise(ox_arg_error_class, "XML too deeply nested");
+    }
+    switch (rb_type(rname)) {
+    case T_STRING:
+        name = StringValuePtr(rname);
+        len  = RSTRING_LEN(rname);
+        break;
+    case T_SYMBOL:
+        name = rb_id2name(SYM2ID(rname));
+        len  = strlen(name);
+        break;
+    default: rb_raise(ox_arg_error_class, "expected a Symbol or String for an element name"); break;
+    }
+    i_am_a_child(b, false);
+    append_indent(b);
+    b->depth++;
+    e = &b->stack[b->depth];
+    if (sizeof(e->buf) <= (size_t)len) {
+        e->name = strdup(name);
+        *e->buf = '\0';
+    } else {
+        strcpy(e->buf, name);
+        e->name = e->buf;
+    }
+    e->len            = len;
+    e->has_child      = false;
+    e->non_text_child = false;
+
+    buf_append(&b->buf, '<');
+    b->col++;
+    b->pos++;
+    append_string(b, e->name, len, xml_element_chars, false);
+    if (T_HASH == rb_type(attrs)) {
+        rb_hash_foreach(attrs, append_attr, (VALUE)b);
+    }
+    // Do not close with > or /> yet. That is done with i_am_a_child() or pop().
+}
+
 static void init(Builder b, int fd, int indent, long initial_size) {
     buf_init(&b->buf, fd, initial_size);
     b->indent    = indent;
@@ -247,6 +326,13 @@ static void init(Builder b, int fd, int indent, long initial_size) {
     b->pos       = 0;
 }
 
+static void builder_mark(void *ptr) {
+    if (NULL != ptr) {
+        rb_gc_mark(((Builder)ptr)->buf.str);
+        rb_gc_mark(((Builder)ptr)->buf.refs);
+    }
+}
+
 static void builder_free(void *ptr) {
     Builder b;
     Element e;
@@ -257,7 +343,7 @@ static void builder_free(void *ptr) {
     }
     b = (Builder)ptr;
     buf_cleanup(&b->buf);
-    for (e = b->stack, d = b->depth; 0 < d; d--, e++) {
+    for (e = b->stack, d = b->depth; 0 <= d; d--, e++) {
         if (e->name != e->buf) {
             free(e->name);
         }
@@ -282,15 +368,15 @@ static void pop(Builder b) {
         buf_append(&b->buf, '>');
         b->col += e->len + 3;
         b->pos += e->len + 3;
-        if (e->buf != e->name) {
-            free(e->name);
-            e->name = 0;
-        }
     } else {
         buf_append_string(&b->buf, "/>", 2);
         b->col += 2;
         b->pos += 2;
     }
+    if (e->buf != e->name) {
+        free(e->name);
+        e->name = e->buf;
+    }
 }
 
 static void bclose(Builder b) {
@@ -309,9 +395,7 @@ static void bclose(Builder b) {
     }
 }
 
-static VALUE to_s(Builder b) {
-    volatile VALUE rstr;
-
+static void to_s_finish(Builder b) {
     if (0 != b->buf.fd) {
         rb_raise(ox_arg_error_class, "can not create a String with a stream or file builder.");
     }
@@ -322,14 +406,72 @@ static VALUE to_s(Builder b) {
         b->pos++;
     }
     *b->buf.tail = '\0';  // for debugging
-    rstr         = rb_str_new(b->buf.head, buf_len(&b->buf));
+}
+
+static VALUE to_s(Builder b) {
+    volatile VALUE rstr;
+
+    to_s_finish(b);
+    rstr = rb_str_new(b->buf.head, buf_len(&b->buf));
+
+    if ('\0' != *b->encoding) {
+        rb_enc_associate(rstr, rb_enc_find(b->encoding));
+    }
+    return rstr;
+}
+
+static void reset(Builder b) {
+    Element e;
+
+    if (0 != b->buf.fd) {
+        rb_raise(ox_arg_error_class, "can not reset a stream or file builder.");
+    }
+    for (; 0 <= b->depth; b->depth--) {
+        e = &b->stack[b->depth];
+        if (e->buf != e->name) {
+            free(e->name);
+        }
+    }
+    buf_reset(&b->buf);
+    *b->encoding = '\0';
+    b->line      = 1;
+    b->col       = 1;
+    b->pos       = 0;
+}
+
+// Like to_s() but hands the buffer over to the returned String when possible
+// and then resets the builder.
+static VALUE take_s(Builder b) {
+    volatile VALUE rstr;
 
+    to_s_finish(b);
+    rstr = buf_take_str(&b->buf);
     if ('\0' != *b->encoding) {
         rb_enc_associate(rstr, rb_enc_find(b->encoding));
     }
+    reset(b);
+
     return rstr;
 }
 
+static void parse_options(VALUE opts, int *indent, long *buf_size) {
+    volatile VALUE v;
+
+    rb_check_type(opts, T_HASH);
+    if (Qnil != (v = rb_hash_lookup(opts, ox_indent_sym))) {
+        if (rb_cInteger != rb_obj_class(v)) {
+            rb_raise(ox_parse_error_class, ":indent must be a fixnum.\n");
+        }
+        *indent = NUM2INT(v);
+    }
+    if (Qnil != (v = rb_hash_lookup(opts, ox_size_sym))) {
+        if (rb_cInteger != rb_obj_class(v)) {
+            rb_raise(ox_parse_error_class, ":size must be a fixnum.\n");
+        }
+        *buf_size = NUM2LONG(v);
+    }
+}
+
 /* call-seq: new(options)
  *
  * Creates a new Builder that will write to a string that can be retrieved with
@@ -346,21 +488,7 @@ static VALUE builder_new(int argc, VALUE *argv, VALUE self) {
     long    buf_size = 0;
 
     if (1 == argc) {
-        volatile VALUE v;
-
-        rb_check_type(*argv, T_HASH);
-        if (Qnil != (v = rb_hash_lookup(*argv, ox_indent_sym))) {
-            if (rb_cInteger != rb_obj_class(v)) {
-                rb_raise(ox_parse_error_class, ":indent must be a fixnum.\n");
-            }
-            indent = NUM2INT(v);
-        }
-        if (Qnil != (v = rb_hash_lookup(*argv, ox_size_sym))) {
-            if (rb_cInteger != rb_obj_class(v)) {
-                rb_raise(ox_parse_error_class, ":size must be a fixnum.\n");
-            }
-            buf_size = NUM2LONG(v);
-        }
+        parse_options(*argv, &indent, &buf_size);
     }
     b->file = NULL;
     init(b, 0, indent, buf_size);
@@ -385,11 +513,14 @@ static VALUE builder_new(int argc, VALUE *argv, VALUE self) {
  * - +options+ - (Hash) formating options
  *   - +:indent+ (Fixnum) indentaion level, negative values excludes terminating newline
  *   - +:size+ (Fixnum) the initial size of the string buffer
+ *   - +:scatter+ (true|false) if true large text, cdata, and raw Strings are written with writev() instead of being
+ *     copied into the buffer, the Strings are held until written
  */
 static VALUE builder_file(int argc, VALUE *argv, VALUE self) {
     Builder b        = ALLOC(struct _builder);
     int     indent   = ox_default_options.indent;
     long    buf_size = 0;
+    bool    scatter  = false;
     FILE   *f;
 
     if (1 > argc) {
@@ -401,24 +532,14 @@ static VALUE builder_file(int argc, VALUE *argv, VALUE self) {
         rb_raise(rb_eIOError, "%s\n", strerror(errno));
     }
     if (2 == argc) {
-        volatile VALUE v;
-
-        rb_check_type(argv[1], T_HASH);
-        if (Qnil != (v = rb_hash_lookup(argv[1], ox_indent_sym))) {
-            if (rb_cInteger != rb_obj_class(v)) {
-                rb_raise(ox_parse_error_class, ":indent must be a fixnum.\n");
-            }
-            indent = NUM2INT(v);
-        }
-        if (Qnil != (v = rb_hash_lookup(argv[1], ox_size_sym))) {
-            if (rb_cInteger != rb_obj_class(v)) {
-                rb_raise(ox_parse_error_class, ":size must be a fixnum.\n");
-            }
-            buf_size = NUM2LONG(v);
-        }
+        parse_options(argv[1], &indent, &buf_size);
+        scatter = (Qtrue == rb_hash_lookup(argv[1], scatter_sym));
     }
     b->file = f;
     init(b, fileno(f), indent, buf_size);
+    if (scatter) {
+        buf_scatter(&b->buf);
+    }
 
     if (rb_block_given_p()) {
         volatile VALUE rb = TypedData_Wrap_Struct(builder_class, &ox_builder_type, b);
@@ -438,11 +559,14 @@ static VALUE builder_file(int argc, VALUE *argv, VALUE self) {
  * - +options+ - (Hash) formating options
  *   - +:indent+ (Fixnum) indentaion level, negative values excludes terminating newline
  *   - +:size+ (Fixnum) the initial size of the string buffer
+ *   - +:scatter+ (true|false) if true large text, cdata, and raw Strings are written with writev() instead of being
+ *     copied into the buffer, the Strings are held until written
  */
 static VALUE builder_io(int argc, VALUE *argv, VALUE self) {
     Builder        b        = ALLOC(struct _builder);
     int            indent   = ox_default_options.indent;
     long           buf_size = 0;
+    bool           scatter  = false;
     int            fd;
     volatile VALUE v;
 
@@ -454,24 +578,14 @@ static VALUE builder_io(int argc, VALUE *argv, VALUE self) {
         rb_raise(rb_eIOError, "expected an IO that has a fileno.");
     }
     if (2 == argc) {
-        volatile VALUE v;
-
-        rb_check_type(argv[1], T_HASH);
-        if (Qnil != (v = rb_hash_lookup(argv[1], ox_indent_sym))) {
-            if (rb_cInteger != rb_obj_class(v)) {
-                rb_raise(ox_parse_error_class, ":indent must be a fixnum.\n");
-            }
-            indent = NUM2INT(v);
-        }
-        if (Qnil != (v = rb_hash_lookup(argv[1], ox_size_sym))) {
-            if (rb_cInteger != rb_obj_class(v)) {
-                rb_raise(ox_parse_error_class, ":size must be a fixnum.\n");
-            }
-            buf_size = NUM2LONG(v);
-        }
+        parse_options(argv[1], &indent, &buf_size);
+        scatter = (Qtrue == rb_hash_lookup(argv[1], scatter_sym));
     }
     b->file = NULL;
     init(b, fd, indent, buf_size);
+    if (scatter) {
+        buf_scatter(&b->buf);
+    }
 
     if (rb_block_given_p()) {
         volatile VALUE rb = TypedData_Wrap_Struct(builder_class, &ox_builder_type, b);
@@ -483,6 +597,598 @@ static VALUE builder_io(int argc, VALUE *argv, VALUE self) {
     }
 }
 
+static VALUE pooled_yield(VALUE rb) {
+    Builder b = (Builder)DATA_PTR(rb);
+
+    rb_yield(rb);
+    bclose(b);
+
+    return take_s(b);
+}
+
+static VALUE pooled_release(VALUE rb) {
+    volatile VALUE pool = rb_thread_local_aref(rb_thread_current(), pool_id);
+    Builder        b    = (Builder)DATA_PTR(rb);
+
+    // Only needed if the block raised but always safe.
+    reset(b);
+    if (Qnil != pool && RARRAY_LEN(pool) < POOL_MAX) {
+        rb_ary_push(pool, rb);
+    }
+    return Qnil;
+}
+
+static VALUE pool_take(int indent, long buf_size) {
+    volatile VALUE pool = rb_thread_local_aref(rb_thread_current(), pool_id);
+    volatile VALUE rb;
+    Builder        b;
+
+    if (Qnil == pool) {
+        pool = rb_ary_new();
+        rb_thread_local_aset(rb_thread_current(), pool_id, pool);
+    }
+    if (Qnil == (rb = rb_ary_pop(pool))) {
+        b       = ALLOC(struct _builder);
+        b->file = NULL;
+        init(b, 0, indent, buf_size);
+        rb = TypedData_Wrap_Struct(builder_class, &ox_builder_type, b);
+    } else {
+        TypedData_Get_Struct(rb, struct _builder, &ox_builder_type, b);
+        b->indent = indent;
+    }
+    return rb;
+}
+
+/* call-seq: pooled(options) { |builder| } => String
+ *
+ * Yields a Builder that writes to a String and returns the generated
+ * string. Builders are kept in a small fiber local pool and reset after each
+ * use so repeated calls reuse the same builder and buffer instead of
+ * allocating new ones. The builder must not be used after the block returns.
+ *
+ * - +options+ - (Hash) formating options
+ *   - +:indent+ (Fixnum) indentaion level, negative values excludes terminating newline
+ *   - +:size+ (Fixnum) the initial size of the string buffer, only used when a new builder is created
+ */
+static VALUE builder_pooled(int argc, VALUE *argv, VALUE self) {
+    volatile VALUE rb;
+    int            indent   = ox_default_options.indent;
+    long           buf_size = 0;
+
+    if (!rb_block_given_p()) {
+        rb_raise(ox_arg_error_class, "a block is required");
+    }
+    if (1 == argc) {
+        parse_options(*argv, &indent, &buf_size);
+    }
+    rb = pool_take(indent, buf_size);
+
+    return rb_ensure(pooled_yield, rb, pooled_release, rb);
+}
+
+typedef struct _emit {
+    Builder b;
+    bool    attrs;
+} *Emit;
+
+static void emit_element(Emit e, VALUE name, VALUE value);
+static void emit_content(Emit e, VALUE value);
+
+static int emit_pair(VALUE key, VALUE value, VALUE x) {
+    emit_element((Emit)x, key, value);
+
+    return ST_CONTINUE;
+}
+
+static void emit_content(Emit e, VALUE value) {
+    volatile VALUE v;
+    long           i;
+
+    switch (rb_type(value)) {
+    case T_NIL: break;
+    case T_HASH: rb_hash_foreach(value, emit_pair, (VALUE)e); break;
+    case T_ARRAY:
+        for (i = 0; i < RARRAY_LEN(value); i++) {
+            emit_content(e, RARRAY_AREF(value, i));
+        }
+        break;
+    default:
+        v = rb_String(value);
+        i_am_a_child(e->b, true);
+        append_value(e->b, v, false);
+        break;
+    }
+}
+
+// The reverse of the :hash load mode. An Array value is repeated elements of
+// the same name unless attributes are enabled and the Array starts with a
+// Hash, in which case the Hash holds the attributes and the rest is content.
+static void emit_element(Emit e, VALUE name, VALUE value) {
+    if (T_ARRAY == rb_type(value)) {
+        long cnt = RARRAY_LEN(value);
+        long i;
+
+        if (e->attrs && 0 < cnt && T_HASH == rb_type(RARRAY_AREF(value, 0))) {
+            push_element(e->b, name, RARRAY_AREF(value, 0));
+            for (i = 1; i < RARRAY_LEN(value); i++) {
+                emit_content(e, RARRAY_AREF(value, i));
+            }
+            pop(e->b);
+        } else {
+            for (i = 0; i < RARRAY_LEN(value); i++) {
+                emit_element(e, name, RARRAY_AREF(value, i));
+            }
+        }
+        return;
+    }
+    push_element(e->b, name, Qnil);
+    emit_content(e, value);
+    pop(e->b);
+}
+
+static void emit_hash(Builder b, VALUE hash, VALUE opts) {
+    struct _emit   e;
+    volatile VALUE root = Qnil;
+
+    e.b     = b;
+    e.attrs = false;
+    if (Qnil != opts) {
+        rb_check_type(opts, T_HASH);
+        root    = rb_hash_lookup(opts, root_sym);
+        e.attrs = RTEST(rb_hash_lookup(opts, attrs_sym));
+    }
+    if (Qnil == root) {
+        Check_Type(hash, T_HASH);
+        emit_content(&e, hash);
+    } else {
+        emit_element(&e, root, hash);
+    }
+}
+
+/* call-seq: emit_hash(hash, options)
+ *
+ * Adds elements for the contents of a Hash. Each key becomes an element and
+ * the value its content. A nil value is an empty element, a Hash value holds
+ * child elements, an Array value is repeated elements of the same name, and
+ * anything else is text. The output of the :hash load mode round trips.
+ *
+ * - +hash+ - (Hash) contents to add
+ * - +options+ - (Hash) emit options
+ *   - +:root+ (String|Symbol) name of an element to wrap the contents in
+ *   - +:attrs+ (true|false) if true an Array value that starts with a Hash is an element whose attributes are the Hash
+ */
+static VALUE builder_emit_hash(int argc, VALUE *argv, VALUE self) {
+    Builder b;
+
+    TypedData_Get_Struct(self, struct _builder, &ox_builder_type, b);
+
+    if (1 > argc) {
+        rb_raise(ox_arg_error_class, "missing hash");
+    }
+    emit_hash(b, *argv, (1 < argc) ? argv[1] : Qnil);
+
+    return Qnil;
+}
+
+typedef struct _dumpHash {
+    VALUE rb;
+    VALUE hash;
+    VALUE opts;
+} *DumpHash;
+
+static VALUE dump_hash_body(VALUE x) {
+    DumpHash d = (DumpHash)x;
+    Builder  b = (Builder)DATA_PTR(d->rb);
+
+    emit_hash(b, d->hash, d->opts);
+    bclose(b);
+    strcpy(b->encoding, ox_default_options.encoding);
+
+    return take_s(b);
+}
+
+/* call-seq: dump_hash(hash, options) => String
+ *
+ * Returns an XML String for a Hash such as one returned by a :hash mode load
+ * without building an Ox::Element tree. A pooled Builder is used so repeated
+ * calls reuse the same buffer. See Ox::Builder#emit_hash for how values are
+ * written.
+ *
+ * - +hash+ - (Hash) contents to dump
+ * - +options+ - (Hash) dump options
+ *   - +:root+ (String|Symbol) name of an element to wrap the contents in
+ *   - +:attrs+ (true|false) if true an Array value that starts with a Hash is an element whose attributes are the Hash
+ *   - +:indent+ (Fixnum) indentaion level, negative values excludes terminating newline
+ *
+ * _raise_ [Ox::ArgError] if a key is not a String or Symbol. The pooled
+ * Builder is reset and can be used again.
+ */
+static VALUE dump_hash(int argc, VALUE *argv, VALUE self) {
+    struct _dumpHash d;
+    int              indent   = ox_default_options.indent;
+    long             buf_size = 0;
+
+    if (1 > argc) {
+        rb_raise(ox_arg_error_class, "missing hash");
+    }
+    d.hash = *argv;
+    d.opts = Qnil;
+    if (1 < argc) {
+        d.opts = argv[1];
+        parse_options(d.opts, &indent, &buf_size);
+    }
+    d.rb = pool_take(indent, buf_size);
+
+    return rb_ensure(dump_hash_body, (VALUE)&d, pooled_release, d.rb);
+}
+
+// A template is XML with {{name}} slots. The static parts are stored back to
+// back in bytes and each slot records the run of static bytes before it, the
+// escaping table for its position, and the index of its name. The last slot
+// only holds the trailing run.
+typedef struct _slot {
+    const char *table;  // NULL for CDATA which is not escaped
+    long        off;
+    long        len;
+    long        nl;    // newlines in the run
+    long        tail;  // bytes after the last newline in the run
+    long        name;  // index in names or -1 for the trailing run
+} *Slot;
+
+typedef struct _template {
+    char *bytes;
+    Slot  slots;
+    long  scnt;
+    VALUE names;  // Array of the slot name Symbols
+    char  encoding[64];
+} *Template;
+
+static void template_mark(void *ptr) {
+    if (NULL != ptr) {
+        rb_gc_mark(((Template)ptr)->names);
+    }
+}
+
+static void template_free(void *ptr) {
+    Template t = (Template)ptr;
+
+    if (NULL != t) {
+        xfree(t->bytes);
+        xfree(t->slots);
+        xfree(t);
+    }
+}
+
+static const rb_data_type_t ox_template_type = {
+    "Ox/template",
+    {
+        template_mark,
+        template_free,
+        NULL,
+    },
+    0,
+    0,
+};
+
+typedef enum {
+    InText  = 't',
+    InTag   = 'g',
+    InCdata = 'c',
+    InOther = 'o',  // comment or processing instruction
+} TmplState;
+
+static void close_run(Template t, long cap, long off, long end, long name) {
+    Slot        slot;
+    const char *b;
+
+    if (cap <= t->scnt) {
+        rb_raise(ox_arg_error_class, "too many template slots.\n");
+    }
+    slot       = t->slots + t->scnt;
+    slot->off  = off;
+    slot->len  = end - off;
+    slot->nl   = 0;
+    slot->tail = slot->len;
+    slot->name = name;
+    for (b = t->bytes + off; b < t->bytes + end; b++) {
+        if ('\n' == *b) {
+            slot->nl++;
+            slot->tail = t->bytes + end - b - 1;
+        }
+    }
+    if (0 <= name) {
+        t->scnt++;
+    }
+}
+
+static long slot_name(Template t, const char *name, long len) {
+    VALUE sym = ID2SYM(rb_intern2(name, len));
+    long  i;
+
+    for (i = RARRAY_LEN(t->names) - 1; 0 <= i; i--) {
+        if (sym == RARRAY_AREF(t->names, i)) {
+            return i;
+        }
+    }
+    rb_ary_push(t->names, sym);
+
+    return RARRAY_LEN(t->names) - 1;
+}
+
+static void compile(Template t, const char *src, long len) {
+    const char *end   = src + len;
+    const char *s     = src;
+    const char *term  = NULL;
+    const char *table = NULL;
+    TmplState   state = InText;
+    char        q     = '\0';
+    long        cap   = 1;
+    long        blen  = 0;
+    long        off   = 0;
+    const char *e;
+    const char *n;
+
+    for (e = src; e + 1 < end; e++) {
+        if ('{' == *e && '{' == e[1]) {
+            cap++;
+        }
+    }
+    t->bytes = ALLOC_N(char, len + 1);
+    t->slots = ALLOC_N(struct _slot, cap);
+    while (s < end) {
+        if ('{' == *s && s + 1 < end && '{' == s[1]) {
+            switch (state) {
+            case InText: table = xml_element_chars; break;
+            case InTag: table = ('"' == q) ? xml_attr_chars : xml_apos_attr_chars; break;
+            default: table = NULL; break;
+            }
+            if (InOther == state || (InTag == state && '\0' == q)) {
+                rb_raise(ox_arg_error_class,
+                         "template slot at byte %ld is not in element text, an attribute value, or CDATA.\n",
+                         (long)(s - src));
+            }
+            for (n = s + 2; n + 1 < end && !('}' == *n && '}' == n[1]); n++) {
+            }
+            if (end <= n + 1) {
+                rb_raise(ox_arg_error_class, "unterminated template slot at byte %ld.\n", (long)(s - src));
+            }
+            for (e = n, s += 2; s < e && ' ' == *s; s++) {
+            }
+            for (; s < e && ' ' == e[-1]; e--) {
+            }
+            if (s == e) {
+                rb_raise(ox_arg_error_class, "empty template slot at byte %ld.\n", (long)(n - src));
+            }
+            close_run(t, cap, off, blen, slot_name(t, s, e - s));
+            t->slots[t->scnt - 1].table = table;
+            off                         = blen;
+            s                           = n + 2;
+            continue;
+        }
+        switch (state) {
+        case InText:
+            if ('<' == *s) {
+                if (0 == strncmp(s, "<!--", 4)) {
+                    state = InOther;
+                    term  = "-->";
+                } else if (0 == strncmp(s, "<![CDATA[", 9)) {
+                    memcpy(t->bytes + blen, s, 9);
+                    blen += 9;
+                    s += 9;
+                    state = InCdata;
+                    continue;
+                } else if ('?' == s[1]) {
+                    state = InOther;
+                    term  = "?>";
+                } else {
+                    state = InTag;
+                    q     = '\0';
+                }
+            }
+            break;
+        case InTag:
+            if ('\0' != q) {
+                if (q == *s) {
+                    q = '\0';
+                }
+            } else if ('"' == *s || '\'' == *s) {
+                q = *s;
+            } else if ('>' == *s) {
+                state = InText;
+            }
+            break;
+        case InCdata:
+            if (0 == strncmp(s, "]]>", 3)) {
+                memcpy(t->bytes + blen, s, 3);
+                blen += 3;
+                s += 3;
+                state = InText;
+                continue;
+            }
+            break;
+        default:
+            if (0 == strncmp(s, term, strlen(term))) {
+                memcpy(t->bytes + blen, s, strlen(term));
+                blen += strlen(term);
+                s += strlen(term);
+                state = InText;
+                continue;
+            }
+            break;
+        }
+        t->bytes[blen++] = *s++;
+    }
+    close_run(t, cap, off, blen, -1);
+}
+
+static VALUE slot_value(Template t, VALUE values, long name) {
+    VALUE sym = RARRAY_AREF(t->names, name);
+    VALUE v;
+
+    switch (rb_type(values)) {
+    case T_HASH:
+        if (Qundef == (v = rb_hash_lookup2(values, sym, Qundef)) &&
+            Qundef == (v = rb_hash_lookup2(values, rb_sym2str(sym), Qundef))) {
+            rb_raise(ox_arg_error_class, "missing template value for %s.\n", rb_id2name(SYM2ID(sym)));
+        }
+        return v;
+    case T_ARRAY:
+        if (RARRAY_LEN(values) <= name) {
+            rb_raise(ox_arg_error_class, "missing template value for %s.\n", rb_id2name(SYM2ID(sym)));
+        }
+        return RARRAY_AREF(values, name);
+    default: rb_raise(ox_arg_error_class, "template values must be a Hash or an Array.\n"); break;
+    }
+    return Qnil;
+}
+
+// Appends a CDATA slot value. A "]]>" in the value would end the section
+// early so the value is split between the "]]" and the ">" into two
+// consecutive CDATA sections.
+static void append_cdata(Builder b, VALUE v, const char *str, long len) {
+    const char *end    = str + len;
+    const char *start  = str;
+    const char *nl     = NULL;
+    long        splits = 0;  // since the last newline
+    const char *s;
+
+    for (s = str; s < end; s++) {
+        if ('\n' == *s) {
+            splits = 0;
+        } else if (']' == *s && s + 2 < end && ']' == s[1] && '>' == s[2]) {
+            buf_append_string(&b->buf, start, s + 2 - start);
+            buf_append_string(&b->buf, "]]><![CDATA[", 12);
+            b->pos += 12;
+            start = s + 2;
+            splits++;
+        }
+    }
+    if (start == str) {
+        buf_append_value(&b->buf, v);
+    } else {
+        buf_append_string(&b->buf, start, end - start);
+    }
+    b->pos += len;
+    for (s = str; NULL != (s = memchr(s, '\n', end - s)); s++) {
+        b->line++;
+        nl = s;
+    }
+    if (NULL == nl) {
+        b->col += len + splits * 12;
+    } else {
+        b->col = end - nl + splits * 12;
+    }
+}
+
+// Writes the static runs with a single copy each and escapes only the slot
+// values. Line, column, and position are kept as if each part had been added
+// with the builder methods.
+static void template_write(Template t, Builder b, VALUE values) {
+    volatile VALUE v;
+    Slot           slot;
+    const char    *str;
+    long           len;
+    long           i;
+
+    for (i = 0, slot = t->slots; i <= t->scnt; i++, slot++) {
+        buf_append_string(&b->buf, t->bytes + slot->off, slot->len);
+        b->pos += slot->len;
+        if (0 < slot->nl) {
+            b->line += slot->nl;
+            b->col = slot->tail + 1;
+        } else {
+            b->col += slot->len;
+        }
+        if (t->scnt == i || Qnil == (v = slot_value(t, values, slot->name))) {
+            continue;
+        }
+        if (T_STRING != rb_type(v)) {
+            v = rb_String(v);
+        }
+        str = RSTRING_PTR(v);
+        len = RSTRING_LEN(v);
+        if (NULL != slot->table) {
+            append_chars(b, v, str, len, slot->table, false);
+            continue;
+        }
+        append_cdata(b, v, str, len);
+    }
+}
+
+/* call-seq: compile(xml) => Ox::Template
+ *
+ * Compiles XML with {{name}} slots into a template. A slot may be in element
+ * text, a quoted attribute value, or CDATA and its value is escaped for that
+ * position when rendered. A "]]>" in a CDATA value is split across two CDATA
+ * sections. The same name may be used for more than one slot. The XML is not
+ * otherwise checked.
+ *
+ * - +xml+ - (String) XML with slots
+ */
+static VALUE template_compile(VALUE self, VALUE xml) {
+    volatile VALUE rt;
+    Template       t;
+    rb_encoding   *enc;
+
+    Check_Type(xml, T_STRING);
+    rt       = TypedData_Make_Struct(template_class, struct _template, &ox_template_type, t);
+    t->names = rb_ary_new();
+    if (NULL != (enc = rb_enc_get(xml))) {
+        strncpy(t->encoding, rb_enc_name(enc), sizeof(t->encoding) - 1);
+    }
+    compile(t, RSTRING_PTR(xml), RSTRING_LEN(xml));
+    RB_GC_GUARD(xml);
+
+    return rt;
+}
+
+typedef struct _render {
+    VALUE    rb;
+    Template t;
+    VALUE    values;
+} *Render;
+
+static VALUE render_body(VALUE x) {
+    Render  r = (Render)x;
+    Builder b = (Builder)DATA_PTR(r->rb);
+
+    template_write(r->t, b, r->values);
+    strcpy(b->encoding, r->t->encoding);
+
+    return take_s(b);
+}
+
+/* call-seq: render(values) => String
+ *
+ * Returns the template XML with each slot replaced by its value. Values are
+ * looked up by slot name, as a Symbol and then as a String, in a Hash or in
+ * the order the names first appear in the template if an Array. A nil value
+ * leaves the slot empty and other values are converted with to_s.
+ *
+ * - +values+ - (Hash|Array) slot values
+ */
+static VALUE template_render(VALUE self, VALUE values) {
+    struct _render r;
+
+    TypedData_Get_Struct(self, struct _template, &ox_template_type, r.t);
+    r.values = values;
+    r.rb     = pool_take(-1, 0);
+
+    return rb_ensure(render_body, (VALUE)&r, pooled_release, r.rb);
+}
+
+/* call-seq: slots() => Array
+ *
+ * Returns the slot names as Symbols in the order they first appear.
+ */
+static VALUE template_slots(VALUE self) {
+    Template t;
+
+    TypedData_Get_Struct(self, struct _template, &ox_template_type, t);
+
+    return rb_ary_dup(t->names);
+}
+
 /* call-seq: instruct(decl,options)
  *
  * Adds the top level <?xml?> element.
@@ -562,53 +1268,14 @@ static VALUE builder_instruct(int argc, VALUE *argv, VALUE self) {
  * - +attributes+ - (Hash) of the element
  */
 static VALUE builder_element(int argc, VALUE *argv, VALUE self) {
-    Builder     b;
-    Element     e;
-    const char *name;
-    long        len;
+    Builder b;
 
     TypedData_Get_Struct(self, struct _builder, &ox_builder_type, b);
 
     if (1 > argc) {
         rb_raise(ox_arg_error_class, "missing element name");
     }
-    i_am_a_child(b, false);
-    append_indent(b);
-    b->depth++;
-    if (MAX_DEPTH <= b->depth) {
-        rb_raise(ox_arg_error_class, "XML too deeply nested");
-    }
-    switch (rb_type(*argv)) {
-    case T_STRING:
-        name = StringValuePtr(*argv);
-        len  = RSTRING_LEN(*argv);
-        break;
-    case T_SYMBOL:
-        name = rb_id2name(SYM2ID(*argv));
-        len  = strlen(name);
-        break;
-    default: rb_raise(ox_arg_error_class, "expected a Symbol or String for an element name"); break;
-    }
-    e = &b->stack[b->depth];
-    if (sizeof(e->buf) <= (size_t)len) {
-        e->name = strdup(name);
-        *e->buf = '\0';
-    } else {
-        strcpy(e->buf, name);
-        e->name = e->buf;
-    }
-    e->len            = len;
-    e->has_child      = false;
-    e->non_text_child = false;
-
-    buf_append(&b->buf, '<');
-    b->col++;
-    b->pos++;
-    append_string(b, e->name, len, xml_element_chars, false);
-    if (1 < argc && T_HASH == rb_type(argv[1])) {
-        rb_hash_foreach(argv[1], append_attr, (VALUE)b);
-    }
-    // Do not close with > or /> yet. That is done with i_am_a_child() or pop().
+    push_element(b, *argv, (1 < argc) ? argv[1] : Qnil);
     if (rb_block_given_p()) {
         rb_yield(self);
         pop(b);
@@ -732,7 +1399,7 @@ static VALUE builder_text(int argc, VALUE *argv, VALUE self) {
 
     v = rb_String(v);
     i_am_a_child(b, true);
-    append_string(b, StringValuePtr(v), RSTRING_LEN(v), xml_element_chars, RTEST(strip_invalid_chars));
+    append_value(b, v, RTEST(strip_invalid_chars));
 
     return Qnil;
 }
@@ -762,7 +1429,7 @@ static VALUE builder_cdata(VALUE self, VALUE data) {
     buf_append_string(&b->buf, "<![CDATA[", 9);
     b->col += 9;
     b->pos += 9;
-    buf_append_string(&b->buf, str, len);
+    buf_append_value(&b->buf, v);
     b->col += len;
     s = strchr(s, '\n');
     while (NULL != s) {
@@ -799,7 +1466,7 @@ static VALUE builder_raw(VALUE self, VALUE text) {
     s   = str;
     end = str + len;
     i_am_a_child(b, true);
-    buf_append_string(&b->buf, str, len);
+    buf_append_value(&b->buf, v);
     b->col += len;
     s = strchr(s, '\n');
     while (NULL != s) {
@@ -812,6 +1479,27 @@ static VALUE builder_raw(VALUE self, VALUE text) {
     return Qnil;
 }
 
+/* call-seq: template(template, values)
+ *
+ * Adds a rendered Ox::Template. See Ox::Template#render for how values are
+ * used.
+ *
+ * - +template+ - (Ox::Template) template to render
+ * - +values+ - (Hash|Array) slot values
+ */
+static VALUE builder_template(VALUE self, VALUE tmpl, VALUE values) {
+    Builder  b;
+    Template t;
+
+    TypedData_Get_Struct(self, struct _builder, &ox_builder_type, b);
+    TypedData_Get_Struct(tmpl, struct _template, &ox_template_type, t);
+    i_am_a_child(b, false);
+    append_indent(b);
+    template_write(t, b, values);
+
+    return Qnil;
+}
+
 /* call-seq: to_s()
  *
  * Returns the JSON document string in what ever state the construction is at.
@@ -823,6 +1511,33 @@ static VALUE builder_to_s(VALUE self) {
     return to_s(b);
 }
 
+/* call-seq: to_s!()
+ *
+ * Returns the XML document string and resets the builder. Unlike to_s() a
+ * document that has outgrown the builder's inline buffer is handed to the
+ * returned String without being copied.
+ */
+static VALUE builder_take_s(VALUE self) {
+    Builder b;
+
+    TypedData_Get_Struct(self, struct _builder, &ox_builder_type, b);
+    return take_s(b);
+}
+
+/* call-seq: reset()
+ *
+ * Discards the document built so far so the builder can be used for a new
+ * document. Buffer memory already allocated is kept for reuse.
+ */
+static VALUE builder_reset(VALUE self) {
+    Builder b;
+
+    TypedData_Get_Struct(self, struct _builder, &ox_builder_type, b);
+    reset(b);
+
+    return self;
+}
+
 /* call-seq: line()
  *
  * Returns the current line in the output. The first line is line 1.
@@ -922,6 +1637,16 @@ void ox_init_builder(VALUE ox) {
     // Just for rdoc.
     ox = rb_define_module("Ox");
 #endif
+    pool_id   = rb_intern("ox_builder_pool");
+    attrs_sym = ID2SYM(rb_intern("attrs"));
+    rb_gc_register_address(&attrs_sym);
+    root_sym = ID2SYM(rb_intern("root"));
+    rb_gc_register_address(&root_sym);
+    scatter_sym = ID2SYM(rb_intern("scatter"));
+    rb_gc_register_address(&scatter_sym);
+
+    rb_define_module_function(ox, "dump_hash", dump_hash, -1);
+
     builder_class = rb_define_class_under(ox, "Builder", rb_cObject);
 #if RUBY_API_VERSION_CODE >= 30200
     rb_undef_alloc_func(builder_class);
@@ -929,6 +1654,7 @@ void ox_init_builder(VALUE ox) {
     rb_define_module_function(builder_class, "new", builder_new, -1);
     rb_define_module_function(builder_class, "file", builder_file, -1);
     rb_define_module_function(builder_class, "io", builder_io, -1);
+    rb_define_module_function(builder_class, "pooled", builder_pooled, -1);
     rb_define_method(builder_class, "instruct", builder_instruct, -1);
     rb_define_method(builder_class, "comment", builder_comment, 1);
     rb_define_method(builder_class, "doctype", builder_doctype, 1);
@@ -937,12 +1663,27 @@ void ox_init_builder(VALUE ox) {
     rb_define_method(builder_class, "text", builder_text, -1);
     rb_define_method(builder_class, "cdata", builder_cdata, 1);
     rb_define_method(builder_class, "raw", builder_raw, 1);
+    rb_define_method(builder_class, "emit_hash", builder_emit_hash, -1);
     rb_define_method(builder_class, "pop", builder_pop, 0);
     rb_define_method(builder_class, "close", builder_close, 0);
     rb_define_method(builder_class, "to_s", builder_to_s, 0);
+    rb_define_method(builder_class, "to_s!", builder_take_s, 0);
+    rb_define_method(builder_class, "reset", builder_reset, 0);
     rb_define_method(builder_class, "line", builder_line, 0);
     rb_define_method(builder_class, "column", builder_column, 0);
     rb_define_method(builder_class, "pos", builder_pos, 0);
     rb_define_method(builder_class, "indent", builder_get_indent, 0);
     rb_define_method(builder_class, "indent=", builder_set_indent, 1);
+    rb_define_method(builder_class, "template", builder_template, 2);
+
+    /*
+     * Document-class: Ox::Template
+     *
+     * XML with value slots that is compiled once and rendered many times.
+     */
+    template_class = rb_define_class_under(ox, "Template", rb_cObject);
+    rb_undef_alloc_func(template_class);
+    rb_define_module_function(template_class, "compile", template_compile, 1);
+    rb_define_method(template_class, "render", template_render, 1);
+    rb_define_method(template_class, "slots", template_slots, 0);
 }
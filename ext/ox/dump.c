@@ -4,6 +4,8 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,10 +13,17 @@
 
 #include "base64.h"
 #include "cache8.h"
+#include "lazy.h"
 #include "ox.h"
+#include "ruby/thread.h"
+#include "xsd_time.h"
 
 #define USE_B64 0
 #define MAX_DEPTH 1000
+#define MEMO_MIN 128
+#define PAR_MIN 2048   // fewest items for a parallel dump
+#define PAR_SLICE 1024 // fewest items per thread
+#define PAR_MAX 64
 
 typedef unsigned long ulong;
 
@@ -32,6 +41,28 @@ typedef struct _element {
     char          type;
 } *Element;
 
+// Object mode metadata for a named class. It is stored on the class itself
+// in a hidden instance variable by class_meta() so it lives and dies with the
+// class and nothing is pinned. Frozen and anonymous classes get no metadata.
+// Instance variable names are kept in the order they were last seen. Objects
+// of the same class nearly always define their ivars in the same order so a
+// mismatch only happens when the shape of the class changes and just that
+// slot is replaced.
+typedef struct _ivarMeta {
+    ID          id;
+    const char *name;
+    size_t      len;
+} *IvarMeta;
+
+typedef struct _classMeta {
+    char    *name;
+    size_t   len;
+    char     type;  // ObjectCode or ExceptionCode
+    int      icnt;
+    int      icap;
+    IvarMeta ivars;
+} *ClassMeta;
+
 typedef struct _out {
     void (*w_start)(struct _out *out, Element e);
     void (*w_end)(struct _out *out, Element e);
@@ -45,17 +76,26 @@ typedef struct _out {
     int           depth; /* used by dumpHash */
     Options       opts;
     VALUE         obj;
+    ClassMeta     meta;   /* class of obj when dumping ivars */
+    int           ivar_i; /* index of the next ivar of obj */
+    uint64_t      memo_sig;
+    VALUE         memo_parent; /* memo cell of the element whose nodes are being dumped */
+    bool          memo_below;  /* an element below kept its XML */
+    bool          memo_lazy;   /* nodes were dumped from a lazy parse tape */
+    VALUE         str;         /* String that holds buf or Qnil if buf was allocated */
 } *Out;
 
 static void dump_obj_to_xml(VALUE obj, Options copts, Out out);
 
 static void dump_first_obj(VALUE obj, Out out);
 static void dump_obj(ID aid, VALUE obj, int depth, Out out);
+static void dump_obj_named(const char *attr, size_t alen, VALUE obj, int depth, Out out);
 static void dump_gen_doc(VALUE obj, int depth, Out out);
 static void dump_gen_element(VALUE obj, int depth, Out out);
 static void dump_gen_instruct(VALUE obj, int depth, Out out);
 static int  dump_gen_attr(VALUE key, VALUE value, VALUE ov);
 static int  dump_gen_nodes(VALUE obj, int depth, Out out);
+static int  dump_tape_nodes(Tape t, long first, int depth, Out out);
 static void
 dump_gen_val_node(VALUE obj, int depth, const char *pre, size_t plen, const char *suf, size_t slen, Out out);
 
@@ -67,28 +107,27 @@ static void grow(Out out, size_t len);
 static void dump_value(Out out, const char *value, size_t size);
 static void dump_str_value(Out out, const char *value, size_t size, const char *table);
 static int  dump_var(ID key, VALUE value, VALUE ov);
+static int  dump_meta_var(ID key, VALUE value, VALUE ov);
 static void dump_num(Out out, VALUE obj);
 static void dump_date(Out out, VALUE obj);
 static void dump_time_thin(Out out, VALUE obj);
 static void dump_time_xsd(Out out, VALUE obj);
 static int  dump_hash(VALUE key, VALUE value, VALUE ov);
 
-static int is_xml_friendly(const uchar *str, int len, const char *table);
+static int  is_xml_friendly(const uchar *str, int len, const char *table);
+static bool dump_par(VALUE items, int depth, bool gen, Out out, int *indent_needed);
 
-static const char hex_chars[17] = "0123456789abcdef";
+static ID class_meta_id = 0;
 
-// The : character is equivalent to 10. Used for replacement characters up to 10
-// characters long such as '&#x10FFFF;'.
-static const char xml_friendly_chars[257] = "\
-:::::::::11::1::::::::::::::::::\
-11611156111111111111111111114141\
-11111111111111111111111111111111\
-11111111111111111111111111111111\
-11111111111111111111111111111111\
-11111111111111111111111111111111\
-11111111111111111111111111111111\
-11111111111111111111111111111111";
+// Bumped when a node with more than one parent changes so that every
+// memoized dump is stale since not all of its ancestors are known.
+static uint64_t memo_gen = 0;
+
+static const char hex_chars[17] = "0123456789abcdef";
 
+// The digit is the escaped width of the character. The : character is
+// equivalent to 10. Used for replacement characters up to 10 characters long
+// such as '&#x10FFFF;'.
 static const char xml_quote_chars[257] = "\
 :::::::::11::1::::::::::::::::::\
 11611151111111111111111111114141\
@@ -122,9 +161,9 @@ inline static size_t xml_str_len(const uchar *str, size_t len, const char *table
     size_t size = 0;
 
     for (; 0 < len; str++, len--) {
-        size += xml_friendly_chars[*str];
+        size += table[*str] - '0';
     }
-    return size - len * (size_t)'0';
+    return size;
 }
 
 inline static void dump_hex(uchar c, Out out) {
@@ -156,7 +195,9 @@ static Type obj_class_code(VALUE obj) {
     }
     case T_DATA: return (rb_cTime == clas) ? TimeCode : ((ox_date_class == clas) ? DateCode : 0);
     case T_STRUCT: return (rb_cRange == clas) ? RangeCode : StructCode;
-    case T_OBJECT: return (ox_document_clas == clas || ox_element_clas == clas) ? RawCode : ObjectCode;
+    case T_OBJECT:
+        return (ox_document_clas == clas || ox_element_clas == clas || ox_lazy_element_clas == clas) ? RawCode
+                                                                                                     : ObjectCode;
     case T_REGEXP: return RegexpCode;
     case T_BIGNUM: return BignumCode;
     case T_COMPLEX: return ComplexCode;
@@ -166,6 +207,88 @@ static Type obj_class_code(VALUE obj) {
     }
 }
 
+static void class_meta_free(void *ptr) {
+    ClassMeta meta = (ClassMeta)ptr;
+
+    if (NULL != meta) {
+        xfree(meta->name);
+        xfree(meta->ivars);
+        xfree(meta);
+    }
+}
+
+static const rb_data_type_t ox_class_meta_type = {
+    "Ox/class_meta",
+    {
+        NULL,
+        class_meta_free,
+        NULL,
+    },
+    0,
+    0,
+};
+
+// Returns the cached metadata for a T_OBJECT or T_STRUCT class or NULL if
+// the class is anonymous or frozen. The metadata is held by the class in a
+// hidden variable so it is freed along with the class and does not keep a
+// class alive. Anonymous classes are not cached since the name is not known
+// until the class is assigned to a constant.
+static ClassMeta class_meta(VALUE clas) {
+    ClassMeta      meta;
+    volatile VALUE path;
+    volatile VALUE holder;
+
+    if (0 == class_meta_id) {
+        class_meta_id = rb_intern("ox_class_meta");
+    }
+    if (T_DATA == rb_type(holder = rb_attr_get(clas, class_meta_id))) {
+        return (ClassMeta)DATA_PTR(holder);
+    }
+    if (OBJ_FROZEN(clas) || Qnil == (path = rb_class_path_cached(clas))) {
+        return NULL;
+    }
+    meta       = ALLOC(struct _classMeta);
+    meta->len  = (size_t)RSTRING_LEN(path);
+    meta->name = ALLOC_N(char, meta->len + 1);
+    memcpy(meta->name, RSTRING_PTR(path), meta->len);
+    meta->name[meta->len] = '\0';
+    meta->type            = (Qtrue == rb_class_inherited_p(clas, rb_eException)) ? ExceptionCode : ObjectCode;
+    meta->icnt            = 0;
+    meta->icap            = 0;
+    meta->ivars           = NULL;
+    holder                = TypedData_Wrap_Struct(0, &ox_class_meta_type, meta);
+    rb_ivar_set(clas, class_meta_id, holder);
+
+    return meta;
+}
+
+// Returns the name of the i-th ivar of an object. The cached name is used if
+// the same ivar was at that position before and otherwise the slot is
+// replaced.
+static IvarMeta ivar_meta(ClassMeta meta, int i, ID id) {
+    IvarMeta im;
+
+    if (i < meta->icnt && id == meta->ivars[i].id) {
+        return meta->ivars + i;
+    }
+    if (meta->icap <= i) {
+        meta->icap = (0 == meta->icap) ? 8 : meta->icap * 2;
+        REALLOC_N(meta->ivars, struct _ivarMeta, meta->icap);
+    }
+    if (meta->icnt <= i) {
+        meta->icnt = i + 1;
+    }
+    im     = meta->ivars + i;
+    im->id = id;
+    // Ruby 2.3 started to return NULL for some IDs so check for NULL.
+    if (NULL == (im->name = rb_id2name(id))) {
+        im->len = 0;
+    } else {
+        im->len = strlen(im->name);
+    }
+    return im;
+}
+
 inline static void fill_indent(Out out, int cnt) {
     if (0 <= cnt) {
         *out->cur++ = '\n';
@@ -249,7 +372,13 @@ static void grow(Out out, size_t len) {
     if (size <= len * 2 + pos) {
         size += len;
     }
-    REALLOC_N(out->buf, char, size + 10); /* 10 extra for terminator character plus extra (paranoid) */
+    if (Qnil == out->str) {
+        REALLOC_N(out->buf, char, size + 10); /* 10 extra for terminator character plus extra (paranoid) */
+    } else {
+        rb_str_set_len(out->str, pos);
+        rb_str_modify_expand(out->str, size + 10 - pos);
+        out->buf = RSTRING_PTR(out->str);
+    }
     out->end = out->buf + size;
     out->cur = out->buf + pos;
 }
@@ -331,12 +460,10 @@ inline static void dump_value(Out out, const char *value, size_t size) {
     *out->cur = '\0';
 }
 
-inline static void dump_str_value(Out out, const char *value, size_t size, const char *table) {
-    size_t xsize = xml_str_len((const uchar *)value, size, table);
-
-    if (out->end - out->cur <= (long)xsize) {
-        grow(out, xsize);
-    }
+// Writes value escaped for the table. Room must already be reserved. With
+// the strict effort the first invalid character is returned and nothing more
+// is written, otherwise NULL is returned.
+inline static const char *fill_str_value(Out out, const char *value, size_t size, const char *table) {
     for (; 0 < size; size--, value++) {
         if ('1' == table[(uchar)*value]) {
             *out->cur++ = *value;
@@ -380,7 +507,7 @@ inline static void dump_str_value(Out out, const char *value, size_t size, const
             default:
                 // Must be one of the invalid characters.
                 if (StrictEffort == out->opts->effort) {
-                    rb_raise(ox_syntax_error_class, "'\\#x%02x' is not a valid XML character.", *value);
+                    return value;
                 }
                 if (Yes == out->opts->allow_invalid) {
                     *out->cur++ = '&';
@@ -400,13 +527,27 @@ inline static void dump_str_value(Out out, const char *value, size_t size, const
             }
         }
     }
+    return NULL;
+}
+
+inline static void dump_str_value(Out out, const char *value, size_t size, const char *table) {
+    size_t      xsize = xml_str_len((const uchar *)value, size, table);
+    const char *bad;
+
+    if (out->end - out->cur <= (long)xsize) {
+        grow(out, xsize);
+    }
+    if (NULL != (bad = fill_str_value(out, value, size, table))) {
+        *out->cur = '\0';
+        rb_raise(ox_syntax_error_class, "'\\#x%02x' is not a valid XML character.", *bad);
+    }
     *out->cur = '\0';
 }
 
-inline static void dump_num(Out out, VALUE obj) {
+// Writes a long. Room for 21 characters must already be reserved.
+inline static void fill_num(Out out, long num) {
     char  buf[32];
     char *b   = buf + sizeof(buf) - 1;
-    long  num = NUM2LONG(obj);
     int   neg = 0;
 
     if (0 > num) {
@@ -426,12 +567,18 @@ inline static void dump_num(Out out, VALUE obj) {
     } else {
         *b = '0';
     }
-    if (out->end - out->cur <= (long)(sizeof(buf) - (b - buf))) {
-        grow(out, sizeof(buf) - (b - buf));
-    }
     for (; '\0' != *b; b++) {
         *out->cur++ = *b;
     }
+}
+
+inline static void dump_num(Out out, VALUE obj) {
+    long num = NUM2LONG(obj);
+
+    if (out->end - out->cur <= 24) {
+        grow(out, 24);
+    }
+    fill_num(out, num);
     *out->cur = '\0';
 }
 
@@ -484,45 +631,18 @@ static void dump_date(Out out, VALUE obj) {
     out->cur += size;
 }
 
+// The offset is the one the Time carries so a Time in UTC or with a fixed
+// offset is written as it would print. Ruby keeps that on the Time so no
+// localtime() call is needed.
 static void dump_time_xsd(Out out, VALUE obj) {
-    struct tm      *tm;
-    struct timespec ts   = rb_time_timespec(obj);
-    time_t          sec  = ts.tv_sec;
-    long            nsec = ts.tv_nsec;
-    int             tzhour, tzmin;
-    char            tzsign = '+';
+    struct timespec ts     = rb_time_timespec(obj);
+    long            offset = NUM2LONG(rb_time_utc_offset(obj));
 
-    if (out->end - out->cur <= 33) {
-        grow(out, 33);
+    if (out->end - out->cur <= XSD_TIME_MAX) {
+        grow(out, XSD_TIME_MAX);
     }
     /* 2010-07-09T10:47:45.895826+09:00 */
-    tm = localtime(&sec);
-#if HAVE_ST_TM_GMTOFF
-    if (0 > tm->tm_gmtoff) {
-        tzsign = '-';
-        tzhour = (int)(tm->tm_gmtoff / -3600);
-        tzmin  = (int)(tm->tm_gmtoff / -60) - (tzhour * 60);
-    } else {
-        tzhour = (int)(tm->tm_gmtoff / 3600);
-        tzmin  = (int)(tm->tm_gmtoff / 60) - (tzhour * 60);
-    }
-#else
-    tzhour = 0;
-    tzmin  = 0;
-#endif
-    /* TBD replace with more efficient printer */
-    out->cur += sprintf(out->cur,
-                        "%04d-%02d-%02dT%02d:%02d:%02d.%06ld%c%02d:%02d",
-                        tm->tm_year + 1900,
-                        tm->tm_mon + 1,
-                        tm->tm_mday,
-                        tm->tm_hour,
-                        tm->tm_min,
-                        tm->tm_sec,
-                        nsec / 1000,
-                        tzsign,
-                        tzhour,
-                        tzmin);
+    out->cur += ox_xsd_time_format(out->cur, (int64_t)ts.tv_sec, ts.tv_nsec, offset);
 }
 
 static void dump_first_obj(VALUE obj, Out out) {
@@ -574,6 +694,21 @@ static void dump_first_obj(VALUE obj, Out out) {
 }
 
 static void dump_obj(ID aid, VALUE obj, int depth, Out out) {
+    const char *attr = NULL;
+    size_t      alen = 0;
+
+    if (0 != aid) {
+        // Ruby 2.3 started to return NULL for some IDs so check for
+        // NULL. Ignore if NULL aid.
+        if (NULL == (attr = rb_id2name(aid))) {
+            return;
+        }
+        alen = strlen(attr);
+    }
+    dump_obj_named(attr, alen, obj, depth, out);
+}
+
+static void dump_obj_named(const char *attr, size_t alen, VALUE obj, int depth, Out out) {
     struct _element e;
     VALUE           prev_obj = out->obj;
     char            value_buf[64];
@@ -582,20 +717,10 @@ static void dump_obj(ID aid, VALUE obj, int depth, Out out) {
     if (MAX_DEPTH < depth) {
         rb_raise(rb_eSysStackError, "maximum depth exceeded");
     }
-    out->obj = obj;
-    if (0 == aid) {
-        e.attr.str = 0;
-        e.attr.len = 0;
-    } else {
-        e.attr.str = rb_id2name(aid);
-        // Ruby 2.3 started to return NULL for some IDs so check for
-        // NULL. Ignore if NULL aid.
-        if (NULL == e.attr.str) {
-            return;
-        }
-        e.attr.len = strlen(e.attr.str);
-    }
-    e.closed = 0;
+    out->obj   = obj;
+    e.attr.str = attr;
+    e.attr.len = alen;
+    e.closed   = 0;
     if (0 == depth) {
         e.indent = (0 <= out->indent) ? 0 : -1;
     } else if (0 > out->indent) {
@@ -627,8 +752,11 @@ static void dump_obj(ID aid, VALUE obj, int depth, Out out) {
             int          i;
             int          d2 = depth + 1;
 
-            for (i = cnt; 0 < i; i--, np++) {
-                dump_obj(0, *np, d2, out);
+            if (2 > out->opts->parallel || cnt < PAR_MIN || 0 != out->circ_cache ||
+                !dump_par(obj, depth, false, out, NULL)) {
+                for (i = cnt; 0 < i; i--, np++) {
+                    dump_obj(0, *np, d2, out);
+                }
             }
             out->w_end(out, &e);
         }
@@ -803,18 +931,28 @@ static void dump_obj(ID aid, VALUE obj, int depth, Out out) {
             dump_obj(ox_excl_id, excl, d2, out);
             out->w_end(out, &e);
         } else {
-            char num_buf[16];
-            int  d2 = depth + 1;
-            long i;
-            long cnt   = NUM2LONG(rb_struct_size(obj));
-            e.type     = StructCode;
-            e.clas.str = rb_class2name(clas);
-            e.clas.len = strlen(e.clas.str);
+            char      num_buf[16];
+            char     *num_end = num_buf + sizeof(num_buf) - 1;
+            int       d2      = depth + 1;
+            long      i;
+            long      cnt  = NUM2LONG(rb_struct_size(obj));
+            ClassMeta meta = class_meta(clas);
+
+            e.type = StructCode;
+            if (NULL == meta) {
+                e.clas.str = rb_class2name(clas);
+                e.clas.len = strlen(e.clas.str);
+            } else {
+                e.clas.str = meta->name;
+                e.clas.len = meta->len;
+            }
             out->w_start(out, &e);
 
             for (i = 0; i < cnt; i++) {
-                VALUE v = RSTRUCT_GET(obj, (int)(i));
-                dump_obj(rb_intern(ulong2str(i, num_buf + sizeof(num_buf) - 1)), v, d2, out);
+                VALUE       v = RSTRUCT_GET(obj, (int)(i));
+                const char *s = ulong2str(i, num_end);
+
+                dump_obj_named(s, num_end - s, v, d2, out);
             }
             out->w_end(out, &e);
         }
@@ -826,28 +964,50 @@ static void dump_obj(ID aid, VALUE obj, int depth, Out out) {
         break;
     }
     case T_OBJECT: {
-        VALUE clas;
+        VALUE     clas;
+        ClassMeta meta;
 
         if (0 != out->circ_cache && check_circular(out, obj, &e)) {
             break;
         }
-        clas       = rb_obj_class(obj);
-        e.clas.str = rb_class2name(clas);
-        e.clas.len = strlen(e.clas.str);
+        clas = rb_obj_class(obj);
         if (ox_document_clas == clas) {
             e.type = RawCode;
             out->w_start(out, &e);
             dump_gen_doc(obj, depth + 1, out);
             out->w_end(out, &e);
-        } else if (ox_element_clas == clas) {
+        } else if (ox_element_clas == clas || ox_lazy_element_clas == clas) {
             e.type = RawCode;
             out->w_start(out, &e);
             dump_gen_element(obj, depth + 1, out);
             out->w_end(out, &e);
-        } else { /* Object */
-            e.type   = (Qtrue == rb_obj_is_kind_of(obj, rb_eException)) ? ExceptionCode : ObjectCode;
-            cnt      = (int)rb_ivar_count(obj);
-            e.closed = (0 >= cnt);
+        } else if (NULL != (meta = class_meta(clas))) {
+            e.type     = meta->type;
+            e.clas.str = meta->name;
+            e.clas.len = meta->len;
+            cnt        = (int)rb_ivar_count(obj);
+            e.closed   = (0 >= cnt);
+            out->w_start(out, &e);
+            if (0 < cnt) {
+                unsigned int od = out->depth;
+                ClassMeta    om = out->meta;
+                int          oi = out->ivar_i;
+
+                out->depth  = depth + 1;
+                out->meta   = meta;
+                out->ivar_i = 0;
+                rb_ivar_foreach(obj, dump_meta_var, (VALUE)out);
+                out->depth  = od;
+                out->meta   = om;
+                out->ivar_i = oi;
+                out->w_end(out, &e);
+            }
+        } else { /* Object of an anonymous class */
+            e.type     = (Qtrue == rb_obj_is_kind_of(obj, rb_eException)) ? ExceptionCode : ObjectCode;
+            e.clas.str = rb_class2name(clas);
+            e.clas.len = strlen(e.clas.str);
+            cnt        = (int)rb_ivar_count(obj);
+            e.closed   = (0 >= cnt);
             out->w_start(out, &e);
             if (0 < cnt) {
                 unsigned int od = out->depth;
@@ -936,6 +1096,21 @@ static void dump_obj(ID aid, VALUE obj, int depth, Out out) {
     out->obj = prev_obj;
 }
 
+static int dump_meta_var(ID key, VALUE value, VALUE ov) {
+    Out      out = (Out)ov;
+    IvarMeta im  = ivar_meta(out->meta, out->ivar_i++, key);
+
+    if (NULL == im->name) {
+        return ST_CONTINUE;
+    }
+    if (T_DATA == rb_type(value) && key == ox_mesg_id) {
+        value = rb_funcall(out->obj, ox_message_id, 0);
+    }
+    dump_obj_named(im->name, im->len, value, out->depth, out);
+
+    return ST_CONTINUE;
+}
+
 static int dump_var(ID key, VALUE value, VALUE ov) {
     Out out = (Out)ov;
 
@@ -1000,15 +1175,209 @@ static void dump_gen_doc(VALUE obj, int depth, Out out) {
     }
 }
 
+// The memoized bytes of an element depend on its depth and on the dump
+// options that change the output so those are part of the key.
+static uint64_t memo_sig(Options opts) {
+    const unsigned char *b;
+    const unsigned char *end;
+    uint64_t             h = 14695981039346656037ULL;
+    unsigned char        parts[6];
+
+    parts[0] = (unsigned char)opts->indent;
+    parts[1] = (unsigned char)(opts->indent >> 8);
+    parts[2] = (unsigned char)opts->no_empty;
+    parts[3] = (unsigned char)opts->effort;
+    parts[4] = (unsigned char)opts->allow_invalid;
+    parts[5] = (unsigned char)opts->margin_len;
+    for (b = parts, end = parts + sizeof(parts); b < end; b++) {
+        h = (h ^ *b) * 1099511628211ULL;
+    }
+    for (b = (const unsigned char *)opts->margin, end = b + opts->margin_len; b < end; b++) {
+        h = (h ^ *b) * 1099511628211ULL;
+    }
+    for (b = (const unsigned char *)opts->inv_repl, end = b + sizeof(opts->inv_repl); b < end; b++) {
+        h = (h ^ *b) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// A memo cell is a two item Array of a change count and the cell of the
+// parent. Each node dumped with the :memoize option gets one in a hidden
+// variable. A cell holds no node so a subtree that is removed keeps only the
+// cells of its old ancestors and not the old tree or its XML. The parent is
+// true if the node was found under more than one parent or under one that
+// can not have a cell.
+static VALUE memo_cell(VALUE node, VALUE parent) {
+    VALUE cell = rb_attr_get(node, ox_memo_cell_id);
+
+    if (T_ARRAY != rb_type(cell)) {
+        if (OBJ_FROZEN(node)) {
+            return Qtrue;
+        }
+        cell = rb_ary_new_capa(2);
+        rb_ary_push(cell, INT2FIX(0));
+        rb_ary_push(cell, parent);
+        rb_ivar_set(node, ox_memo_cell_id, cell);
+    }
+    return cell;
+}
+
+// Links node to the cell of the element being dumped.
+static void memo_link(VALUE node, Out out) {
+    VALUE cell = memo_cell(node, out->memo_parent);
+    VALUE prev;
+
+    if (Qtrue == cell || out->memo_parent == (prev = RARRAY_AREF(cell, 1)) || Qtrue == prev) {
+        return;
+    }
+    rb_ary_store(cell, 1, (Qnil == prev) ? out->memo_parent : Qtrue);
+}
+
+static VALUE memo_key(Out out, int depth, VALUE cell) {
+    uint64_t k = out->memo_sig ^ ((uint64_t)(depth + 1) * 0x9E3779B97F4A7C15ULL) ^ (memo_gen * 0xC2B2AE3D27D4EB4FULL) ^
+                 ((uint64_t)FIX2LONG(RARRAY_AREF(cell, 0)) * 0x165667B19E3779F9ULL);
+
+    return LONG2FIX((long)(k >> 2));
+}
+
+/* call-seq: clear_memo() => self
+ *
+ * Drops the XML kept by a dump with the :memoize option for this node and
+ * each of its ancestors. Other elements keep theirs. The Ox::Element and
+ * Ox::HasAttrs methods that change a node call this. It must be called
+ * after changing the nodes Array, the attributes Hash, or a text String
+ * directly.
+ */
+VALUE ox_clear_memo(VALUE self) {
+    VALUE cell = rb_attr_get(self, ox_memo_cell_id);
+    int   cnt;
+
+    if (Qnil != rb_attr_get(self, ox_memo_id) && !OBJ_FROZEN(self)) {
+        rb_ivar_set(self, ox_memo_id, Qnil);
+    }
+    for (cnt = MAX_DEPTH; T_ARRAY == rb_type(cell) && 0 < cnt; cnt--) {
+        rb_ary_store(cell, 0, LONG2FIX(FIX2LONG(RARRAY_AREF(cell, 0)) + 1));
+        cell = RARRAY_AREF(cell, 1);
+    }
+    if (Qnil != cell) {
+        memo_gen++;
+    }
+    return self;
+}
+
+static void dump_gen_element_xml(VALUE obj, int depth, Out out);
+
+// With the :memoize option an element keeps its XML if it is at least
+// MEMO_MIN bytes and no element below it kept its own. The element or
+// document passed to the dump always keeps its XML. That holds the kept
+// bytes to about twice the size of the XML while a change only renders the
+// smallest kept element it is in again. Nothing above a lazy element dumped
+// from its parse tape is kept since changes to nodes built later from the
+// tape could not be seen.
+static void dump_gen_memo(VALUE obj, int depth, Out out, bool root) {
+    volatile VALUE memo;
+    volatile VALUE key    = Qnil;
+    VALUE          cell   = memo_cell(obj, out->memo_parent);
+    VALUE          parent = out->memo_parent;
+    bool           below  = out->memo_below;
+    bool           lazy   = out->memo_lazy;
+    long           start;
+    long           len;
+
+    if (Qtrue != cell) {
+        key = memo_key(out, depth, cell);
+        if (key == rb_attr_get(obj, ox_memo_key_id) && T_STRING == rb_type(memo = rb_attr_get(obj, ox_memo_id))) {
+            dump_value(out, RSTRING_PTR(memo), RSTRING_LEN(memo));
+            out->memo_below = true;
+            return;
+        }
+    }
+    start            = out->cur - out->buf;
+    out->memo_parent = cell;
+    out->memo_below  = false;
+    out->memo_lazy   = false;
+    if (ox_document_clas == rb_obj_class(obj)) {
+        dump_gen_doc(obj, depth, out);
+    } else {
+        dump_gen_element_xml(obj, depth, out);
+    }
+    len = out->cur - out->buf - start;
+    if (Qtrue != cell && !OBJ_FROZEN(obj)) {
+        if (MEMO_MIN <= len && (root || !out->memo_below) && !out->memo_lazy) {
+            rb_ivar_set(obj, ox_memo_id, rb_obj_freeze(rb_str_new(out->buf + start, len)));
+            rb_ivar_set(obj, ox_memo_key_id, key);
+            out->memo_below = true;
+        } else if (Qnil != rb_attr_get(obj, ox_memo_id)) {
+            rb_ivar_set(obj, ox_memo_id, Qnil);
+        }
+    }
+    out->memo_parent = parent;
+    out->memo_below  = below || out->memo_below;
+    out->memo_lazy   = lazy || out->memo_lazy;
+}
+
 static void dump_gen_element(VALUE obj, int depth, Out out) {
-    volatile VALUE rname = rb_attr_get(obj, ox_at_value_id);
-    volatile VALUE attrs = rb_attr_get(obj, ox_attributes_id);
-    volatile VALUE nodes = rb_attr_get(obj, ox_nodes_id);
-    const char    *name  = StringValuePtr(rname);
-    long           nlen  = RSTRING_LEN(rname);
-    size_t         size;
-    int            indent;
+    if (out->opts->memoize) {
+        dump_gen_memo(obj, depth, out, false);
+    } else {
+        dump_gen_element_xml(obj, depth, out);
+    }
+}
+
+static void dump_attr(Out out, const char *key, size_t klen, const char *value, size_t vlen) {
+    size_t size = 4 + klen + vlen;
+
+    if (out->end - out->cur <= (long)size) {
+        grow(out, size);
+    }
+    *out->cur++ = ' ';
+    fill_value(out, key, klen);
+    *out->cur++ = '=';
+    *out->cur++ = '"';
+    dump_str_value(out, value, vlen, xml_quote_chars);
+    *out->cur++ = '"';
+}
+
+// Attributes are read from node index of tape t when attrs is Qundef.
+static void dump_attrs(Out out, VALUE attrs, Tape t, long index) {
+    if (Qundef == attrs) {
+        TapeNode n = t->nodes + index;
+        TapeAttr a = t->attrs + n->attr;
+        long     i;
+
+        for (i = n->attr_cnt; 0 < i; i--, a++) {
+            const char *key   = t->str + a->name;
+            const char *value = t->str + a->value;
 
+            dump_attr(out, key, strlen(key), value, strlen(value));
+        }
+    } else if (T_ARRAY == rb_type(attrs)) {  // flat name/value pairs from a :compact mode load
+        long cnt = RARRAY_LEN(attrs) - 1;
+        long i;
+
+        for (i = 0; i < cnt; i += 2) {
+            dump_gen_attr(RARRAY_AREF(attrs, i), RARRAY_AREF(attrs, i + 1), (VALUE)out);
+        }
+    } else if (Qnil != attrs) {
+        rb_hash_foreach(attrs, dump_gen_attr, (VALUE)out);
+    }
+}
+
+/* Writes an element with the nodes Array or, when t is not NULL, with the
+ * child nodes of node index on a lazy parse tape. An attrs of Qundef takes
+ * the attributes from the tape as well.
+ */
+static void
+dump_element(Out out, const char *name, long nlen, int depth, VALUE attrs, Tape t, long index, VALUE nodes) {
+    size_t size;
+    int    indent;
+    bool   has_nodes;
+
+    if (NULL != t) {
+        has_nodes = (0 != t->nodes[index].first);
+    } else {
+        has_nodes = (T_STRING == rb_type(nodes) || (Qnil != nodes && 0 < RARRAY_LEN(nodes)));
+    }
     if (0 > out->indent) {
         indent = -1;
     } else if (0 == out->indent) {
@@ -1027,14 +1396,19 @@ static void dump_gen_element(VALUE obj, int depth, Out out) {
     fill_indent(out, indent);
     *out->cur++ = '<';
     fill_value(out, name, nlen);
-    if (Qnil != attrs) {
-        rb_hash_foreach(attrs, dump_gen_attr, (VALUE)out);
-    }
-    if (Qnil != nodes && 0 < RARRAY_LEN(nodes)) {
+    dump_attrs(out, attrs, t, index);
+    if (has_nodes) {
         int do_indent;
 
         *out->cur++ = '>';
-        do_indent   = dump_gen_nodes(nodes, depth, out);
+        if (NULL != t) {
+            do_indent = dump_tape_nodes(t, t->nodes[index].first, depth, out);
+        } else if (T_STRING == rb_type(nodes)) {  // lone text from a :compact mode load
+            dump_str_value(out, RSTRING_PTR(nodes), RSTRING_LEN(nodes), xml_element_chars);
+            do_indent = 0;
+        } else {
+            do_indent = dump_gen_nodes(nodes, depth, out);
+        }
         if (out->end - out->cur <= (long)size) {
             grow(out, size);
         }
@@ -1056,23 +1430,33 @@ static void dump_gen_element(VALUE obj, int depth, Out out) {
     *out->cur   = '\0';
 }
 
-static void dump_gen_instruct(VALUE obj, int depth, Out out) {
-    volatile VALUE rname    = rb_attr_get(obj, ox_at_value_id);
-    volatile VALUE attrs    = rb_attr_get(obj, ox_attributes_id);
-    volatile VALUE rcontent = rb_attr_get(obj, ox_at_content_id);
-    const char    *name     = StringValuePtr(rname);
-    const char    *content  = 0;
-    long           nlen     = RSTRING_LEN(rname);
-    long           clen     = 0;
-    size_t         size;
-
-    if (T_STRING == rb_type(rcontent)) {
-        content = StringValuePtr(rcontent);
-        clen    = RSTRING_LEN(rcontent);
-        size    = 4 + nlen + clen;
-    } else {
-        size = 4 + nlen;
+static void dump_gen_element_xml(VALUE obj, int depth, Out out) {
+    volatile VALUE rname = rb_attr_get(obj, ox_at_value_id);
+    volatile VALUE attrs = rb_attr_get(obj, ox_attributes_id);
+    volatile VALUE nodes = Qnil;
+    const char    *name  = StringValuePtr(rname);
+    long           index = 0;
+    Tape           t;
+
+    // The nodes of a lazy element that have not been built yet are dumped
+    // straight from the parse tape.
+    if (NULL == (t = ox_lazy_tape(obj, &index))) {
+        if (ox_lazy_element_clas == rb_obj_class(obj)) {
+            nodes = ox_lazy_nodes(obj);
+        } else {
+            nodes = rb_attr_get(obj, ox_nodes_id);
+        }
+    }
+    if (NULL != t) {
+        out->memo_lazy = true;
     }
+    dump_element(out, name, RSTRING_LEN(rname), depth, attrs, t, index, nodes);
+}
+
+static void
+dump_instruct(Out out, const char *name, long nlen, const char *content, long clen, VALUE attrs, Tape t, long index) {
+    size_t size = 4 + nlen + clen;
+
     if (out->end - out->cur <= (long)size) {
         grow(out, size);
     }
@@ -1084,14 +1468,27 @@ static void dump_gen_instruct(VALUE obj, int depth, Out out) {
             dump_value(out, " ", 1);
         }
         fill_value(out, content, clen);
-    } else if (Qnil != attrs) {
-        rb_hash_foreach(attrs, dump_gen_attr, (VALUE)out);
+    } else {
+        dump_attrs(out, attrs, t, index);
     }
     *out->cur++ = '?';
     *out->cur++ = '>';
     *out->cur   = '\0';
 }
 
+static void dump_gen_instruct(VALUE obj, int depth, Out out) {
+    volatile VALUE rname    = rb_attr_get(obj, ox_at_value_id);
+    volatile VALUE attrs    = rb_attr_get(obj, ox_attributes_id);
+    volatile VALUE rcontent = rb_attr_get(obj, ox_at_content_id);
+    const char    *name     = StringValuePtr(rname);
+
+    if (T_STRING == rb_type(rcontent)) {
+        dump_instruct(out, name, RSTRING_LEN(rname), StringValuePtr(rcontent), RSTRING_LEN(rcontent), Qnil, NULL, 0);
+    } else {
+        dump_instruct(out, name, RSTRING_LEN(rname), NULL, 0, attrs, NULL, 0);
+    }
+}
+
 static int dump_gen_nodes(VALUE obj, int depth, Out out) {
     long cnt           = RARRAY_LEN(obj);
     int  indent_needed = 1;
@@ -1104,9 +1501,16 @@ static int dump_gen_nodes(VALUE obj, int depth, Out out) {
         if (MAX_DEPTH < depth) {
             rb_raise(rb_eSysStackError, "maximum depth exceeded");
         }
+        if (1 < out->opts->parallel && PAR_MIN <= cnt && !out->opts->memoize &&
+            dump_par(obj, depth, true, out, &indent_needed)) {
+            return indent_needed;
+        }
         for (; 0 < cnt; cnt--, np++) {
             clas = rb_obj_class(*np);
-            if (ox_element_clas == clas) {
+            if (out->opts->memoize && rb_cString != clas) {
+                memo_link(*np, out);
+            }
+            if (ox_element_clas == clas || ox_lazy_element_clas == clas) {
                 dump_gen_element(*np, d2, out);
             } else if (ox_instruct_clas == clas) {
                 dump_gen_instruct(*np, d2, out);
@@ -1131,11 +1535,7 @@ static int dump_gen_nodes(VALUE obj, int depth, Out out) {
 }
 
 static int dump_gen_attr(VALUE key, VALUE value, VALUE ov) {
-    Out out = (Out)ov;
-
     const char *ks;
-    size_t      klen;
-    size_t      size;
 
     switch (rb_type(key)) {
     case T_SYMBOL: ks = rb_id2name(SYM2ID(key)); break;
@@ -1145,35 +1545,17 @@ static int dump_gen_attr(VALUE key, VALUE value, VALUE ov) {
         ks  = StringValuePtr(key);
         break;
     }
-    klen  = strlen(ks);
     value = rb_String(value);
-    size  = 4 + klen + RSTRING_LEN(value);
-    if (out->end - out->cur <= (long)size) {
-        grow(out, size);
-    }
-    *out->cur++ = ' ';
-    fill_value(out, ks, klen);
-    *out->cur++ = '=';
-    *out->cur++ = '"';
-    dump_str_value(out, StringValuePtr(value), RSTRING_LEN(value), xml_quote_chars);
-    *out->cur++ = '"';
+    dump_attr((Out)ov, ks, strlen(ks), StringValuePtr(value), RSTRING_LEN(value));
 
     return ST_CONTINUE;
 }
 
 static void
-dump_gen_val_node(VALUE obj, int depth, const char *pre, size_t plen, const char *suf, size_t slen, Out out) {
-    volatile VALUE v = rb_attr_get(obj, ox_at_value_id);
-    const char    *val;
-    size_t         vlen;
-    size_t         size;
-    int            indent;
+dump_val(Out out, const char *val, size_t vlen, int depth, const char *pre, size_t plen, const char *suf, size_t slen) {
+    size_t size;
+    int    indent;
 
-    if (T_STRING != rb_type(v)) {
-        return;
-    }
-    val  = StringValuePtr(v);
-    vlen = RSTRING_LEN(v);
     if (0 > out->indent) {
         indent = -1;
     } else if (0 == out->indent) {
@@ -1192,26 +1574,984 @@ dump_gen_val_node(VALUE obj, int depth, const char *pre, size_t plen, const char
     *out->cur = '\0';
 }
 
+static void
+dump_gen_val_node(VALUE obj, int depth, const char *pre, size_t plen, const char *suf, size_t slen, Out out) {
+    volatile VALUE v = rb_attr_get(obj, ox_at_value_id);
+
+    if (T_STRING != rb_type(v)) {
+        return;
+    }
+    dump_val(out, StringValuePtr(v), RSTRING_LEN(v), depth, pre, plen, suf, slen);
+}
+
+// Same as dump_gen_nodes() but for the nodes on a lazy parse tape starting
+// with first.
+static int dump_tape_nodes(Tape t, long first, int depth, Out out) {
+    int      indent_needed = 1;
+    int      d2            = depth + 1;
+    TapeNode n;
+    long     i;
+
+    if (MAX_DEPTH < depth) {
+        rb_raise(rb_eSysStackError, "maximum depth exceeded");
+    }
+    for (i = first; 0 < i; i = n->next) {
+        const char *str;
+
+        n   = t->nodes + i;
+        str = t->str + n->str;
+        switch (n->type) {
+        case ElementNode: dump_element(out, str, strlen(str), d2, Qundef, t, i, Qnil); break;
+        case InstructNode:
+            if (0 <= n->content) {
+                const char *content = t->str + n->content;
+
+                dump_instruct(out, str, strlen(str), content, strlen(content), Qnil, NULL, 0);
+            } else {
+                dump_instruct(out, str, strlen(str), NULL, 0, Qundef, t, i);
+            }
+            indent_needed = (0 == n->next) ? 0 : 1;
+            break;
+        case TextNode:
+            dump_str_value(out, str, strlen(str), xml_element_chars);
+            indent_needed = (0 == n->next) ? 0 : 1;
+            break;
+        case CommentNode: dump_val(out, str, strlen(str), d2, "<!--", 4, "-->", 3); break;
+        case CDataNode: dump_val(out, str, strlen(str), d2, "<![CDATA[", 9, "]]>", 3); break;
+        case DocTypeNode: dump_val(out, str, strlen(str), d2, "<!DOCTYPE ", 10, ">", 1); break;
+        default: break;
+        }
+    }
+    return indent_needed;
+}
+
+// Parallel dump of a long object mode Array or generic nodes Array. The
+// items are first captured under the GVL as a flat list of ops that hold
+// numbers as native values and point at the bytes of the Strings. Those
+// bytes are then copied into one block owned by the dump. The ops are split
+// into slices and each slice is escaped and formatted into its own buffer on
+// a separate native thread. The buffers are appended to the output in order.
+//
+// The GVL is released while the workers run. Since the ops only point at the
+// copied bytes other Ruby threads may change or collect the dumped objects
+// without affecting the workers, and the workers never use the Ruby API. A
+// capture that would need to call Ruby, such as an attribute value that is
+// not a String, is abandoned and the serial dump is used instead.
+typedef enum {
+    ParOpen  = 'o',  // start of a generic element
+    ParAttr  = 'a',
+    ParGt    = '>',
+    ParEmpty = 'e',
+    ParClose = 'c',
+    ParText  = 't',
+    ParVal   = 'v',  // comment, raw, cdata, or doctype
+    ParNum   = 'i',
+    ParFloat = 'f',
+    ParStr   = 's',  // String or Symbol object
+    ParNone  = 'n',  // nil, true, or false object
+} ParKind;
+
+typedef struct _parOp {
+    const char *str;  // name, text, or attribute name
+    long        len;
+    const char *val;  // attribute value
+    long        vlen;
+    union {
+        long   i;
+        double d;
+    } num;
+    int  indent;
+    char kind;
+    char code;  // object type code, value node kind, or 1 if a close is indented
+    bool top;   // first op of a top level item
+} *ParOp;
+
+typedef struct _parSlice {
+    struct _out out;  // copy of the output with a buffer of its own
+    ParOp       head;
+    ParOp       tail;
+    const char *bad;  // invalid character found with the strict effort
+    bool        nomem;
+    bool        started;
+    pthread_t   thread;
+} *ParSlice;
+
+typedef struct _par {
+    Out              out;
+    ParOp            ops;
+    char            *text;  // copy of the bytes the ops point at
+    long             ocnt;
+    long             ocap;
+    long             tcnt;  // top level items captured
+    int              scnt;
+    bool             failed;  // an attribute could not be captured
+    struct _parSlice slices[PAR_MAX];
+} *Par;
+
+// Plain malloc is used for the ops so the capture can not start a GC.
+static ParOp par_op(Par p, char kind, int indent) {
+    ParOp op;
+
+    if (p->ocap <= p->ocnt) {
+        long cap = (0 == p->ocap) ? 4096 : p->ocap * 2;
+
+        if (NULL == (op = (ParOp)realloc(p->ops, sizeof(struct _parOp) * cap))) {
+            return NULL;
+        }
+        p->ops  = op;
+        p->ocap = cap;
+    }
+    op = p->ops + p->ocnt++;
+    memset(op, 0, sizeof(struct _parOp));
+    op->kind   = kind;
+    op->indent = indent;
+
+    return op;
+}
+
+static int par_indent(Out out, int depth) {
+    if (0 > out->indent) {
+        return -1;
+    } else if (0 == out->indent) {
+        return 0;
+    }
+    return depth * out->indent;
+}
+
+static bool par_attr(Par p, VALUE key, VALUE value) {
+    ParOp op;
+
+    if (T_STRING != rb_type(value) || NULL == (op = par_op(p, ParAttr, -1))) {
+        return false;
+    }
+    switch (rb_type(key)) {
+    case T_SYMBOL: op->str = rb_id2name(SYM2ID(key)); break;
+    case T_STRING: op->str = StringValuePtr(key); break;
+    default: return false;
+    }
+    op->len  = (long)strlen(op->str);
+    op->val  = RSTRING_PTR(value);
+    op->vlen = RSTRING_LEN(value);
+
+    return true;
+}
+
+static int par_attr_cb(VALUE key, VALUE value, VALUE x) {
+    Par p = (Par)x;
+
+    if (par_attr(p, key, value)) {
+        return ST_CONTINUE;
+    }
+    p->failed = true;
+
+    return ST_STOP;
+}
+
+static int par_gen_nodes(Par p, VALUE nodes, int depth, bool top);
+
+static bool par_gen_element(Par p, VALUE obj, int depth) {
+    VALUE rname  = rb_attr_get(obj, ox_at_value_id);
+    VALUE attrs  = rb_attr_get(obj, ox_attributes_id);
+    VALUE nodes  = rb_attr_get(obj, ox_nodes_id);
+    int   indent = par_indent(p->out, depth);
+    int   indent_needed;
+    ParOp op;
+
+    if (T_STRING != rb_type(rname) || (Qnil != nodes && T_ARRAY != rb_type(nodes) && T_STRING != rb_type(nodes)) ||
+        NULL == (op = par_op(p, ParOpen, indent))) {
+        return false;
+    }
+    op->str = RSTRING_PTR(rname);
+    op->len = RSTRING_LEN(rname);
+    if (T_ARRAY == rb_type(attrs)) {
+        long cnt = RARRAY_LEN(attrs) - 1;
+        long i;
+
+        for (i = 0; i < cnt; i += 2) {
+            if (!par_attr(p, RARRAY_AREF(attrs, i), RARRAY_AREF(attrs, i + 1))) {
+                return false;
+            }
+        }
+    } else if (T_HASH == rb_type(attrs)) {
+        rb_hash_foreach(attrs, par_attr_cb, (VALUE)p);
+        if (p->failed) {
+            return false;
+        }
+    } else if (Qnil != attrs) {
+        return false;
+    }
+    if (T_STRING == rb_type(nodes)) {
+        if (NULL == par_op(p, ParGt, -1) || NULL == (op = par_op(p, ParText, -1))) {
+            return false;
+        }
+        op->str = RSTRING_PTR(nodes);
+        op->len = RSTRING_LEN(nodes);
+        if (NULL == (op = par_op(p, ParClose, indent))) {
+            return false;
+        }
+    } else if (Qnil != nodes && 0 < RARRAY_LEN(nodes)) {
+        if (NULL == par_op(p, ParGt, -1) || 0 > (indent_needed = par_gen_nodes(p, nodes, depth, false)) ||
+            NULL == (op = par_op(p, ParClose, indent))) {
+            return false;
+        }
+        op->code = (char)indent_needed;
+    } else if (NULL == (op = par_op(p, ParEmpty, -1))) {
+        return false;
+    }
+    op->str = RSTRING_PTR(rname);
+    op->len = RSTRING_LEN(rname);
+
+    return true;
+}
+
+static bool par_val(Par p, VALUE obj, int depth, char code) {
+    VALUE v = rb_attr_get(obj, ox_at_value_id);
+    ParOp op;
+
+    if (T_STRING == rb_type(v)) {
+        if (NULL == (op = par_op(p, ParVal, par_indent(p->out, depth)))) {
+            return false;
+        }
+        op->code = code;
+        op->str  = RSTRING_PTR(v);
+        op->len  = RSTRING_LEN(v);
+    }
+    return true;
+}
+
+// Captures nodes as dump_gen_nodes() would write them and returns the same
+// indent flag or -1 if a node can not be captured.
+static int par_gen_nodes(Par p, VALUE nodes, int depth, bool top) {
+    const VALUE *np            = RARRAY_CONST_PTR(nodes);
+    long         cnt           = RARRAY_LEN(nodes);
+    int          indent_needed = 1;
+    int          d2            = depth + 1;
+    long         start;
+    VALUE        clas;
+    ParOp        op;
+    bool         ok;
+
+    if (MAX_DEPTH < depth) {
+        return -1;
+    }
+    for (; 0 < cnt; cnt--, np++) {
+        clas  = rb_obj_class(*np);
+        start = p->ocnt;
+        if (ox_element_clas == clas) {
+            ok = par_gen_element(p, *np, d2);
+        } else if (rb_cString == clas) {
+            if ((ok = (NULL != (op = par_op(p, ParText, -1))))) {
+                op->str = RSTRING_PTR(*np);
+                op->len = RSTRING_LEN(*np);
+            }
+            indent_needed = (1 == cnt) ? 0 : 1;
+        } else if (ox_comment_clas == clas) {
+            ok = par_val(p, *np, d2, 'c');
+        } else if (ox_raw_clas == clas) {
+            ok = par_val(p, *np, d2, 'r');
+        } else if (ox_cdata_clas == clas) {
+            ok = par_val(p, *np, d2, 'd');
+        } else if (ox_doctype_clas == clas) {
+            ok = par_val(p, *np, d2, 't');
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return -1;
+        }
+        if (top && start < p->ocnt) {
+            p->ops[start].top = true;
+            p->tcnt++;
+        }
+    }
+    return indent_needed;
+}
+
+// Captures the items of an object mode Array. Only values with a fixed
+// format are captured.
+static bool par_obj_items(Par p, VALUE ary, int depth) {
+    const VALUE *np     = RARRAY_CONST_PTR(ary);
+    long         cnt    = RARRAY_LEN(ary);
+    int          indent = par_indent(p->out, depth);
+    ParOp        op;
+
+    for (; 0 < cnt; cnt--, np++) {
+        switch (rb_type(*np)) {
+        case T_NIL:
+        case T_TRUE:
+        case T_FALSE: op = par_op(p, ParNone, indent); break;
+        case T_FIXNUM: op = par_op(p, ParNum, indent); break;
+        case T_FLOAT: op = par_op(p, ParFloat, indent); break;
+        case T_STRING:
+        case T_SYMBOL: op = par_op(p, ParStr, indent); break;
+        default: return false;
+        }
+        if (NULL == op) {
+            return false;
+        }
+        switch (rb_type(*np)) {
+        case T_NIL: op->code = NilClassCode; break;
+        case T_TRUE: op->code = TrueClassCode; break;
+        case T_FALSE: op->code = FalseClassCode; break;
+        case T_FIXNUM:
+            op->code  = FixnumCode;
+            op->num.i = FIX2LONG(*np);
+            break;
+        case T_FLOAT:
+            op->code  = FloatCode;
+            op->num.d = RFLOAT_VALUE(*np);
+            break;
+        case T_STRING:
+            op->code = StringCode;
+            op->str  = RSTRING_PTR(*np);
+            op->len  = RSTRING_LEN(*np);
+            break;
+        default:  // T_SYMBOL
+            op->code = SymbolCode;
+            op->str  = rb_id2name(SYM2ID(*np));
+            op->len  = (long)strlen(op->str);
+            break;
+        }
+        op->top = true;
+        p->tcnt++;
+    }
+    return true;
+}
+
+// Copies the bytes the ops point at so they no longer depend on the Ruby
+// objects once the GVL is released.
+static bool par_copy(Par p) {
+    ParOp  end  = p->ops + p->ocnt;
+    size_t size = 1;
+    char  *t;
+    ParOp  op;
+
+    for (op = p->ops; op < end; op++) {
+        size += op->len + op->vlen;
+    }
+    if (NULL == (t = p->text = (char *)malloc(size))) {
+        return false;
+    }
+    for (op = p->ops; op < end; op++) {
+        if (0 < op->len) {
+            memcpy(t, op->str, op->len);
+            op->str = t;
+            t += op->len;
+        }
+        if (0 < op->vlen) {
+            memcpy(t, op->val, op->vlen);
+            op->val = t;
+            t += op->vlen;
+        }
+    }
+    return true;
+}
+
+// The worker functions below run on native threads and must not call Ruby.
+
+static size_t par_size(ParSlice s) {
+    Options opts = s->out.opts;
+    size_t  size = 1;
+    ParOp   op;
+
+    for (op = s->head; op < s->tail; op++) {
+        size += 40 + ((0 <= op->indent) ? op->indent + 1 + opts->margin_len : 0);
+        switch (op->kind) {
+        case ParAttr: size += op->len + xml_str_len((const uchar *)op->val, op->vlen, xml_quote_chars); break;
+        case ParText:
+        case ParStr: size += xml_str_len((const uchar *)op->str, op->len, xml_element_chars); break;
+        default: size += op->len; break;
+        }
+    }
+    return size;
+}
+
+static void par_fill_val(Out out, ParOp op) {
+    const char *pre;
+    const char *suf;
+
+    switch (op->code) {
+    case 'c':
+        pre = "<!--";
+        suf = "-->";
+        break;
+    case 'd':
+        pre = "<![CDATA[";
+        suf = "]]>";
+        break;
+    case 't':
+        pre = "<!DOCTYPE ";
+        suf = ">";
+        break;
+    default:
+        pre = "";
+        suf = "";
+        break;
+    }
+    fill_indent(out, op->indent);
+    fill_value(out, pre, strlen(pre));
+    fill_value(out, op->str, op->len);
+    fill_value(out, suf, strlen(suf));
+}
+
+static void *par_write(void *x) {
+    ParSlice s    = (ParSlice)x;
+    Out      out  = &s->out;
+    size_t   size = par_size(s);
+    char     num[32];
+    ParOp    op;
+
+    if (NULL == (out->buf = malloc(size))) {
+        s->nomem = true;
+        return NULL;
+    }
+    out->cur = out->buf;
+    out->end = out->buf + size;
+    for (op = s->head; op < s->tail && NULL == s->bad; op++) {
+        switch (op->kind) {
+        case ParOpen:
+            fill_indent(out, op->indent);
+            *out->cur++ = '<';
+            fill_value(out, op->str, op->len);
+            break;
+        case ParAttr:
+            *out->cur++ = ' ';
+            fill_value(out, op->str, op->len);
+            *out->cur++ = '=';
+            *out->cur++ = '"';
+            s->bad      = fill_str_value(out, op->val, op->vlen, xml_quote_chars);
+            *out->cur++ = '"';
+            break;
+        case ParGt: *out->cur++ = '>'; break;
+        case ParEmpty:
+            if (out->opts->no_empty) {
+                *out->cur++ = '>';
+                *out->cur++ = '<';
+                *out->cur++ = '/';
+                fill_value(out, op->str, op->len);
+            } else {
+                *out->cur++ = '/';
+            }
+            *out->cur++ = '>';
+            break;
+        case ParClose:
+            if (op->code) {
+                fill_indent(out, op->indent);
+            }
+            *out->cur++ = '<';
+            *out->cur++ = '/';
+            fill_value(out, op->str, op->len);
+            *out->cur++ = '>';
+            break;
+        case ParText: s->bad = fill_str_value(out, op->str, op->len, xml_element_chars); break;
+        case ParVal: par_fill_val(out, op); break;
+        case ParNone:
+            fill_indent(out, op->indent);
+            *out->cur++ = '<';
+            *out->cur++ = op->code;
+            if (out->opts->no_empty) {
+                *out->cur++ = '>';
+                *out->cur++ = '<';
+                *out->cur++ = '/';
+                *out->cur++ = op->code;
+            } else {
+                *out->cur++ = '/';
+            }
+            *out->cur++ = '>';
+            break;
+        default:  // ParNum, ParFloat, and ParStr
+            fill_indent(out, op->indent);
+            *out->cur++ = '<';
+            *out->cur++ = op->code;
+            *out->cur++ = '>';
+            if (ParNum == op->kind) {
+                fill_num(out, op->num.i);
+            } else if (ParFloat == op->kind) {
+                fill_value(out, num, snprintf(num, sizeof(num), "%0.16g", op->num.d));
+            } else {
+                s->bad = fill_str_value(out, op->str, op->len, xml_element_chars);
+            }
+            *out->cur++ = '<';
+            *out->cur++ = '/';
+            *out->cur++ = op->code;
+            *out->cur++ = '>';
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void par_cleanup(Par p) {
+    ParSlice s;
+
+    for (s = p->slices; s < p->slices + p->scnt; s++) {
+        free(s->out.buf);
+    }
+    free(p->ops);
+    free(p->text);
+}
+
+// Runs the slice workers without the GVL. The calling thread writes the
+// first slice and any slice a thread could not be started for.
+static void *par_run(void *x) {
+    Par      p = (Par)x;
+    ParSlice s;
+
+    for (s = p->slices + 1; s < p->slices + p->scnt; s++) {
+        s->started = (0 == pthread_create(&s->thread, NULL, par_write, s));
+    }
+    par_write(p->slices);
+    for (s = p->slices; s < p->slices + p->scnt; s++) {
+        if (s->started) {
+            pthread_join(s->thread, NULL);
+        } else if (s != p->slices) {
+            par_write(s);
+        }
+    }
+    return NULL;
+}
+
+// Dumps the items of an object mode Array or of a generic nodes Array on
+// several threads. False is returned, with nothing written, if an item can
+// not be captured. For nodes the indent flag of dump_gen_nodes() is set.
+static bool dump_par(VALUE items, int depth, bool gen, Out out, int *indent_needed) {
+    struct _par p;
+    ParSlice    s;
+    long        start;
+    size_t      size  = 0;
+    const char *bad   = NULL;
+    char        c     = '\0';
+    bool        nomem = false;
+    int         i;
+
+    memset(&p, 0, sizeof(p));
+    p.out = out;
+    if (gen) {
+        if (0 > (*indent_needed = par_gen_nodes(&p, items, depth, true))) {
+            par_cleanup(&p);
+            return false;
+        }
+    } else if (!par_obj_items(&p, items, depth + 1)) {
+        par_cleanup(&p);
+        return false;
+    }
+    if (!par_copy(&p)) {
+        par_cleanup(&p);
+        return false;
+    }
+    p.scnt = (int)(p.tcnt / PAR_SLICE);
+    if (out->opts->parallel < p.scnt) {
+        p.scnt = out->opts->parallel;
+    }
+    if (PAR_MAX < p.scnt) {
+        p.scnt = PAR_MAX;
+    }
+    if (1 > p.scnt) {
+        p.scnt = 1;
+    }
+    // Slices split evenly by op count and then move forward to the start of
+    // the next top level item.
+    for (i = 0, s = p.slices; i < p.scnt; i++, s++) {
+        for (start = p.ocnt * i / p.scnt; start < p.ocnt && !p.ops[start].top; start++) {
+        }
+        s->out     = *out;
+        s->out.buf = NULL;
+        s->head    = p.ops + start;
+        if (0 < i) {
+            s[-1].tail = s->head;
+        }
+    }
+    p.slices[p.scnt - 1].tail = p.ops + p.ocnt;
+    rb_thread_call_without_gvl(par_run, &p, NULL, NULL);
+    for (s = p.slices; s < p.slices + p.scnt; s++) {
+        nomem = nomem || s->nomem;
+        if (NULL == bad) {
+            bad = s->bad;
+        }
+        size += s->out.cur - s->out.buf;
+    }
+    if (!nomem && NULL == bad) {
+        if (out->end - out->cur <= (long)size) {
+            grow(out, size);
+        }
+        for (s = p.slices; s < p.slices + p.scnt; s++) {
+            memcpy(out->cur, s->out.buf, s->out.cur - s->out.buf);
+            out->cur += s->out.cur - s->out.buf;
+        }
+        *out->cur = '\0';
+    } else if (NULL != bad) {
+        c = *bad;
+    }
+    par_cleanup(&p);
+    if (nomem) {
+        rb_memerror();
+    }
+    if (NULL != bad) {
+        rb_raise(ox_syntax_error_class, "'\\#x%02x' is not a valid XML character.", c);
+    }
+    return true;
+}
+
+// The measure functions compute the exact length of a generic dump so the
+// output can be allocated once. They follow the dump_gen functions and must
+// be kept in step with them. Anything that would raise while dumping is
+// counted as nothing since the dump raises anyway.
+
+inline static size_t measure_indent(Out out, int indent) {
+    return (0 <= indent) ? 1 + out->opts->margin_len + indent : 0;
+}
+
+static size_t measure_str(Out out, const char *str, size_t len, const char *table) {
+    const uchar *s    = (const uchar *)str;
+    const uchar *end  = s + len;
+    size_t       size = 0;
+    size_t       inv  = (Yes == out->opts->allow_invalid) ? 8 : (size_t)*out->opts->inv_repl;
+
+    for (; s < end; s++) {
+        switch (table[*s]) {
+        case '1': size++; break;
+        case ':': size += inv; break;
+        default: size += table[*s] - '0'; break;
+        }
+    }
+    return size;
+}
+
+static int measure_gen_attr(VALUE key, VALUE value, VALUE x) {
+    Out         out = (Out)((VALUE *)x)[0];
+    size_t     *sp  = (size_t *)((VALUE *)x)[1];
+    const char *ks;
+
+    switch (rb_type(key)) {
+    case T_SYMBOL: ks = rb_id2name(SYM2ID(key)); break;
+    case T_STRING: ks = StringValuePtr(key); break;
+    default:
+        key = rb_String(key);
+        ks  = StringValuePtr(key);
+        break;
+    }
+    value = rb_String(value);
+    *sp += 4 + strlen(ks) + measure_str(out, RSTRING_PTR(value), RSTRING_LEN(value), xml_quote_chars);
+
+    return ST_CONTINUE;
+}
+
+static size_t measure_gen_attrs(Out out, VALUE attrs) {
+    size_t size   = 0;
+    VALUE  args[2] = {(VALUE)out, (VALUE)&size};
+
+    if (T_ARRAY == rb_type(attrs)) {
+        long cnt = RARRAY_LEN(attrs) - 1;
+        long i;
+
+        for (i = 0; i < cnt; i += 2) {
+            measure_gen_attr(RARRAY_AREF(attrs, i), RARRAY_AREF(attrs, i + 1), (VALUE)args);
+        }
+    } else if (T_HASH == rb_type(attrs)) {
+        rb_hash_foreach(attrs, measure_gen_attr, (VALUE)args);
+    }
+    return size;
+}
+
+static size_t measure_tape_attrs(Out out, Tape t, long index) {
+    TapeNode n    = t->nodes + index;
+    TapeAttr a    = t->attrs + n->attr;
+    size_t   size = 0;
+    long     i;
+
+    for (i = n->attr_cnt; 0 < i; i--, a++) {
+        const char *value = t->str + a->value;
+
+        size += 4 + strlen(t->str + a->name) + measure_str(out, value, strlen(value), xml_quote_chars);
+    }
+    return size;
+}
+
+static size_t measure_gen_nodes(Out out, VALUE nodes, int depth, int *indent_needed);
+static size_t measure_tape_nodes(Out out, Tape t, long first, int depth, int *indent_needed);
+
+// Measures an element with attributes that measure asize and either the
+// nodes Array or, when t is not NULL, the child nodes of node index on a
+// lazy parse tape.
+static size_t measure_element(Out out, size_t nlen, size_t asize, int depth, Tape t, long index, VALUE nodes) {
+    size_t size;
+    int    indent = -1;
+    int    indent_needed;
+    bool   has_nodes;
+
+    if (NULL != t) {
+        has_nodes = (0 != t->nodes[index].first);
+    } else {
+        has_nodes = (T_STRING == rb_type(nodes) || (T_ARRAY == rb_type(nodes) && 0 < RARRAY_LEN(nodes)));
+    }
+    if (0 == out->indent) {
+        indent = 0;
+    } else if (0 < out->indent) {
+        indent = depth * out->indent;
+    }
+    size = measure_indent(out, indent) + 1 + nlen + asize;
+    if (0 == depth && 0 < out->opts->margin_len && 0 < out->indent) {
+        size += out->opts->margin_len;
+    }
+    if (has_nodes) {
+        if (NULL != t) {
+            size += measure_tape_nodes(out, t, t->nodes[index].first, depth, &indent_needed);
+        } else if (T_STRING == rb_type(nodes)) {
+            size += measure_str(out, RSTRING_PTR(nodes), RSTRING_LEN(nodes), xml_element_chars);
+            indent_needed = 0;
+        } else {
+            size += measure_gen_nodes(out, nodes, depth, &indent_needed);
+        }
+        size += 4 + nlen;
+        if (indent_needed) {
+            size += measure_indent(out, indent);
+        }
+    } else if (out->opts->no_empty) {
+        size += 4 + nlen;
+    } else {
+        size += 2;
+    }
+    return size;
+}
+
+static size_t measure_gen_element(Out out, VALUE obj, int depth) {
+    volatile VALUE rname = rb_attr_get(obj, ox_at_value_id);
+    volatile VALUE nodes = Qnil;
+    long           index = 0;
+    Tape           t;
+
+    if (T_STRING != rb_type(rname)) {
+        return 0;
+    }
+    if (NULL == (t = ox_lazy_tape(obj, &index))) {
+        if (ox_lazy_element_clas == rb_obj_class(obj)) {
+            nodes = ox_lazy_nodes(obj);
+        } else {
+            nodes = rb_attr_get(obj, ox_nodes_id);
+        }
+    }
+    return measure_element(out,
+                           RSTRING_LEN(rname),
+                           measure_gen_attrs(out, rb_attr_get(obj, ox_attributes_id)),
+                           depth,
+                           t,
+                           index,
+                           nodes);
+}
+
+static size_t measure_gen_instruct(Out out, VALUE obj) {
+    volatile VALUE rname    = rb_attr_get(obj, ox_at_value_id);
+    volatile VALUE rcontent = rb_attr_get(obj, ox_at_content_id);
+    size_t         size;
+
+    if (T_STRING != rb_type(rname)) {
+        return 0;
+    }
+    size = 4 + RSTRING_LEN(rname);
+    if (T_STRING == rb_type(rcontent)) {
+        size += RSTRING_LEN(rcontent);
+        if (' ' != *RSTRING_PTR(rcontent)) {
+            size++;
+        }
+    } else {
+        volatile VALUE attrs = rb_attr_get(obj, ox_attributes_id);
+
+        if (T_HASH == rb_type(attrs)) {
+            size += measure_gen_attrs(out, attrs);
+        }
+    }
+    return size;
+}
+
+static size_t measure_val(Out out, size_t vlen, int depth, size_t fix) {
+    int indent = -1;
+
+    if (0 == out->indent) {
+        indent = 0;
+    } else if (0 < out->indent) {
+        indent = depth * out->indent;
+    }
+    return measure_indent(out, indent) + fix + vlen;
+}
+
+static size_t measure_gen_val_node(Out out, VALUE obj, int depth, size_t fix) {
+    volatile VALUE v = rb_attr_get(obj, ox_at_value_id);
+
+    if (T_STRING != rb_type(v)) {
+        return 0;
+    }
+    return measure_val(out, RSTRING_LEN(v), depth, fix);
+}
+
+static size_t measure_gen_nodes(Out out, VALUE nodes, int depth, int *indent_needed) {
+    long   cnt  = RARRAY_LEN(nodes);
+    long   i;
+    int    d2   = depth + 1;
+    size_t size = 0;
+    VALUE  node;
+    VALUE  clas;
+
+    *indent_needed = 1;
+    if (MAX_DEPTH < depth) {
+        return 0;
+    }
+    for (i = 0; i < cnt; i++) {
+        node = RARRAY_AREF(nodes, i);
+        clas = rb_obj_class(node);
+        if (ox_element_clas == clas || ox_lazy_element_clas == clas) {
+            size += measure_gen_element(out, node, d2);
+        } else if (ox_instruct_clas == clas) {
+            size += measure_gen_instruct(out, node);
+            *indent_needed = (i == cnt - 1) ? 0 : 1;
+        } else if (rb_cString == clas) {
+            size += measure_str(out, RSTRING_PTR(node), RSTRING_LEN(node), xml_element_chars);
+            *indent_needed = (i == cnt - 1) ? 0 : 1;
+        } else if (ox_comment_clas == clas) {
+            size += measure_gen_val_node(out, node, d2, 7);
+        } else if (ox_raw_clas == clas) {
+            size += measure_gen_val_node(out, node, d2, 0);
+        } else if (ox_cdata_clas == clas) {
+            size += measure_gen_val_node(out, node, d2, 12);
+        } else if (ox_doctype_clas == clas) {
+            size += measure_gen_val_node(out, node, d2, 11);
+        }
+    }
+    return size;
+}
+
+static size_t measure_tape_nodes(Out out, Tape t, long first, int depth, int *indent_needed) {
+    int      d2   = depth + 1;
+    size_t   size = 0;
+    TapeNode n;
+    long     i;
+
+    *indent_needed = 1;
+    if (MAX_DEPTH < depth) {
+        return 0;
+    }
+    for (i = first; 0 < i; i = n->next) {
+        const char *str;
+        size_t      len;
+
+        n   = t->nodes + i;
+        str = t->str + n->str;
+        len = strlen(str);
+        switch (n->type) {
+        case ElementNode: size += measure_element(out, len, measure_tape_attrs(out, t, i), d2, t, i, Qnil); break;
+        case InstructNode:
+            size += 4 + len;
+            if (0 <= n->content) {
+                size += strlen(t->str + n->content);
+                if (' ' != t->str[n->content]) {
+                    size++;
+                }
+            } else {
+                size += measure_tape_attrs(out, t, i);
+            }
+            *indent_needed = (0 == n->next) ? 0 : 1;
+            break;
+        case TextNode:
+            size += measure_str(out, str, len, xml_element_chars);
+            *indent_needed = (0 == n->next) ? 0 : 1;
+            break;
+        case CommentNode: size += measure_val(out, len, d2, 7); break;
+        case CDataNode: size += measure_val(out, len, d2, 12); break;
+        case DocTypeNode: size += measure_val(out, len, d2, 11); break;
+        default: break;
+        }
+    }
+    return size;
+}
+
+static size_t measure_gen_doc(Out out, VALUE obj) {
+    volatile VALUE attrs = rb_attr_get(obj, ox_attributes_id);
+    volatile VALUE nodes = rb_attr_get(obj, ox_nodes_id);
+    size_t         size  = 0;
+    int            indent_needed;
+
+    if (Yes == out->opts->with_xml) {
+        size += out->opts->margin_len + 7 + measure_gen_attrs(out, attrs);
+    }
+    if (Yes == out->opts->with_instruct) {
+        if (0 < size) {
+            size++;
+        }
+        size += out->opts->margin_len + 35;
+    }
+    if (T_ARRAY == rb_type(nodes)) {
+        size += measure_gen_nodes(out, nodes, -1, &indent_needed);
+    }
+    return size;
+}
+
+// Returns the exact length of the dump of a generic node or 0 if it is not
+// measured. Memoized dumps are not measured since the kept bytes are used
+// instead of the nodes.
+static size_t measure_gen(Out out, VALUE obj) {
+    VALUE  clas = rb_obj_class(obj);
+    size_t size;
+
+    if (out->opts->memoize) {
+        return 0;
+    }
+    if (ox_document_clas == clas) {
+        size = measure_gen_doc(out, obj);
+    } else if (ox_element_clas == clas || ox_lazy_element_clas == clas) {
+        size = measure_gen_element(out, obj, 0);
+    } else if (ox_cdata_clas == clas) {
+        size = measure_gen_val_node(out, obj, 0, 12);
+    } else if (ox_instruct_clas == clas) {
+        size = measure_gen_instruct(out, obj);
+    } else if (ox_comment_clas == clas) {
+        size = measure_gen_val_node(out, obj, 0, 7);
+    } else if (ox_doctype_clas == clas) {
+        size = measure_gen_val_node(out, obj, 0, 11);
+    } else {
+        return 0;
+    }
+    if (0 <= out->indent) {
+        size++;
+    }
+    return size;
+}
+
 static void dump_obj_to_xml(VALUE obj, Options copts, Out out) {
     VALUE clas = rb_obj_class(obj);
 
-    out->w_time     = (Yes == copts->xsd_date) ? dump_time_xsd : dump_time_thin;
-    out->buf        = ALLOC_N(char, 65336);
-    out->end        = out->buf + 65325; /* 10 less than end plus extra for possible errors */
-    out->cur        = out->buf;
-    out->circ_cache = 0;
-    out->circ_cnt   = 0;
-    out->opts       = copts;
-    out->obj        = obj;
-    *out->cur       = '\0';
+    if (Qnil == out->str) {
+        out->buf = ALLOC_N(char, 65336);
+        out->end = out->buf + 65325; /* 10 less than end plus extra for possible errors */
+    } else {
+        out->buf = RSTRING_PTR(out->str);
+        out->end = out->buf + rb_str_capacity(out->str) - 10;
+    }
+    out->w_time      = (Yes == copts->xsd_date) ? dump_time_xsd : dump_time_thin;
+    out->cur         = out->buf;
+    out->circ_cache  = 0;
+    out->circ_cnt    = 0;
+    out->opts        = copts;
+    out->obj         = obj;
+    out->meta        = NULL;
+    out->ivar_i      = 0;
+    out->memo_sig    = (copts->memoize) ? memo_sig(copts) : 0;
+    out->memo_parent = Qnil;
+    out->memo_below  = false;
+    out->memo_lazy   = false;
+    *out->cur        = '\0';
     if (Yes == copts->circular) {
         ox_cache8_new(&out->circ_cache);
     }
     out->indent = copts->indent;
 
     if (ox_document_clas == clas) {
-        dump_gen_doc(obj, -1, out);
-    } else if (ox_element_clas == clas) {
+        if (copts->memoize) {
+            dump_gen_memo(obj, -1, out, true);
+        } else {
+            dump_gen_doc(obj, -1, out);
+        }
+    } else if ((ox_element_clas == clas || ox_lazy_element_clas == clas) && copts->memoize) {
+        dump_gen_memo(obj, 0, out, true);
+    } else if (ox_element_clas == clas || ox_lazy_element_clas == clas) {
         dump_gen_element(obj, 0, out);
     } else if (ox_cdata_clas == clas) {
         dump_gen_val_node(obj, 0, "<![CDATA[", 9, "]]>", 3, out);
@@ -1234,11 +2574,29 @@ static void dump_obj_to_xml(VALUE obj, Options copts, Out out) {
     }
 }
 
-char *ox_write_obj_to_str(VALUE obj, Options copts) {
-    struct _out out;
-
+/* Dumps obj into a String that is returned. The dump is written directly
+ * into the String. With the measure option a generic dump is measured first
+ * so the String is allocated once at the final size.
+ */
+VALUE ox_write_obj_to_rstr(VALUE obj, Options copts) {
+    struct _out    out;
+    volatile VALUE rstr;
+    size_t         size = 0;
+
+    if (copts->measure) {
+        out.opts   = copts;
+        out.indent = copts->indent;
+        size       = measure_gen(&out, obj);
+    }
+    // The reservations made while writing can exceed what is left to write
+    // by a few bytes so some extra is allocated for a measured dump.
+    rstr    = rb_str_buf_new((0 < size) ? (long)size + 64 : 65336);
+    out.str = rstr;
     dump_obj_to_xml(obj, copts, &out);
-    return out.buf;
+    rb_str_set_len(rstr, out.cur - out.buf);
+    rb_str_resize(rstr, out.cur - out.buf);  // releases unused capacity
+
+    return rstr;
 }
 
 void ox_write_obj_to_file(VALUE obj, const char *path, Options copts) {
@@ -1246,6 +2604,7 @@ void ox_write_obj_to_file(VALUE obj, const char *path, Options copts) {
     size_t      size;
     FILE       *f;
 
+    out.str = Qnil;
     dump_obj_to_xml(obj, copts, &out);
     size = out.cur - out.buf;
     if (0 == (f = fopen(path, "w"))) {
@@ -46,9 +46,12 @@ have_func('rb_ext_ractor_safe', 'ruby.h')
 have_func('pthread_mutex_init')
 have_func('rb_enc_interned_str')
 have_func('index')
+have_func('rb_io_wait', 'ruby/io.h')
+have_func('rb_fiber_scheduler_current', 'ruby/fiber/scheduler.h')
 
 have_header('ruby/st.h')
 have_header('sys/uio.h')
+have_header('zlib.h') if have_library('z', 'inflate', 'zlib.h')
 
 have_struct_member('struct tm', 'tm_gmtoff')
 
@@ -23,6 +23,7 @@ static void add_comment(PInfo pi, const char *comment);
 static void add_cdata(PInfo pi, const char *cdata, size_t len);
 static void add_text(PInfo pi, char *text, int closed);
 static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren);
+static void add_element_compact(PInfo pi, const char *ename, Attr attrs, int hasChildren);
 static void end_element(PInfo pi, const char *ename);
 static void add_instruct(PInfo pi, const char *name, Attr attrs, const char *content);
 
@@ -67,6 +68,46 @@ struct _parseCallbacks _ox_nomode_callbacks = {
 
 ParseCallbacks ox_nomode_callbacks = &_ox_nomode_callbacks;
 
+struct _parseCallbacks _ox_compact_callbacks = {
+    instruct, /* instruct, */
+    add_doctype,
+    add_comment,
+    add_cdata,
+    add_text,
+    add_element_compact,
+    end_element,
+    NULL,
+};
+
+ParseCallbacks ox_compact_callbacks = &_ox_compact_callbacks;
+
+// Appends a node to the element or document on top of the helper stack. The
+// helper of an element from a :compact mode load holds the element itself,
+// with a var of ox_nodes_id, until the element has more than one node. A
+// lone text String is set as the nodes as is and Element#nodes wraps it in an
+// Array when first called.
+static void add_node(PInfo pi, VALUE n) {
+    Helper h = helper_stack_peek(&pi->helpers);
+
+    if (ox_nodes_id == h->var) {
+        volatile VALUE prev = rb_attr_get(h->obj, ox_nodes_id);
+        volatile VALUE nodes;
+
+        if (Qnil == prev && T_STRING == rb_type(n)) {
+            rb_ivar_set(h->obj, ox_nodes_id, n);
+            return;
+        }
+        nodes = rb_ary_new();
+        if (Qnil != prev) {
+            rb_ary_push(nodes, prev);
+        }
+        rb_ivar_set(h->obj, ox_nodes_id, nodes);
+        h->var = 0;
+        h->obj = nodes;
+    }
+    rb_ary_push(h->obj, n);
+}
+
 static void create_doc(PInfo pi) {
     VALUE doc;
     VALUE nodes;
@@ -199,7 +240,7 @@ static void add_doctype(PInfo pi, const char *docType) {
     if (helper_stack_empty(&pi->helpers)) { /* top level object */
         create_doc(pi);
     }
-    rb_ary_push(helper_stack_peek(&pi->helpers)->obj, n);
+    add_node(pi, n);
 }
 
 static void add_comment(PInfo pi, const char *comment) {
@@ -213,7 +254,7 @@ static void add_comment(PInfo pi, const char *comment) {
     if (helper_stack_empty(&pi->helpers)) { /* top level object */
         create_doc(pi);
     }
-    rb_ary_push(helper_stack_peek(&pi->helpers)->obj, n);
+    add_node(pi, n);
 }
 
 static void add_cdata(PInfo pi, const char *cdata, size_t len) {
@@ -227,7 +268,7 @@ static void add_cdata(PInfo pi, const char *cdata, size_t len) {
     if (helper_stack_empty(&pi->helpers)) { /* top level object */
         create_doc(pi);
     }
-    rb_ary_push(helper_stack_peek(&pi->helpers)->obj, n);
+    add_node(pi, n);
 }
 
 static void add_text(PInfo pi, char *text, int closed) {
@@ -239,10 +280,14 @@ static void add_text(PInfo pi, char *text, int closed) {
     if (helper_stack_empty(&pi->helpers)) { /* top level object */
         create_doc(pi);
     }
-    rb_ary_push(helper_stack_peek(&pi->helpers)->obj, s);
+    add_node(pi, s);
 }
 
-static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren) {
+// When compact is true the attributes are stored as a flat Array of name and
+// value pairs instead of a Hash. The Ruby HasAttrs module converts that Array
+// into a Hash only if the attributes are asked for as a Hash. The nodes Array
+// is only made once there is more than a lone text node, see add_node().
+static void element(PInfo pi, const char *ename, Attr attrs, int hasChildren, bool compact) {
     VALUE e;
     VALUE s = rb_str_new2(ename);
 
@@ -255,8 +300,19 @@ static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren
     e = rb_obj_alloc(ox_element_clas);
     rb_ivar_set(e, ox_at_value_id, s);
     if (0 != attrs->name) {
-        volatile VALUE ah = rb_hash_new();
+        volatile VALUE ah;
+
+        if (compact) {
+            Attr a;
+            long cnt = 0;
 
+            for (a = attrs; 0 != a->name; a++) {
+                cnt++;
+            }
+            ah = rb_ary_new_capa(cnt * 2);
+        } else {
+            ah = rb_hash_new();
+        }
         for (; 0 != attrs->name; attrs++) {
             volatile VALUE sym;
 
@@ -271,16 +327,23 @@ static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren
             if (0 != pi->options->rb_enc) {
                 rb_enc_associate(s, pi->options->rb_enc);
             }
-            rb_hash_aset(ah, sym, s);
+            if (compact) {
+                rb_ary_push(ah, sym);
+                rb_ary_push(ah, s);
+            } else {
+                rb_hash_aset(ah, sym, s);
+            }
         }
         rb_ivar_set(e, ox_attributes_id, ah);
     }
     if (helper_stack_empty(&pi->helpers)) { /* top level object */
         pi->obj = e;
     } else {
-        rb_ary_push(helper_stack_peek(&pi->helpers)->obj, e);
+        add_node(pi, e);
     }
-    if (hasChildren) {
+    if (hasChildren && compact) {
+        helper_stack_push(&pi->helpers, ox_nodes_id, e, NoCode);
+    } else if (hasChildren) {
         VALUE nodes = rb_ary_new();
 
         rb_ivar_set(e, ox_nodes_id, nodes);
@@ -290,6 +353,14 @@ static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren
     }
 }
 
+static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren) {
+    element(pi, ename, attrs, hasChildren, false);
+}
+
+static void add_element_compact(PInfo pi, const char *ename, Attr attrs, int hasChildren) {
+    element(pi, ename, attrs, hasChildren, true);
+}
+
 static void end_element(PInfo pi, const char *ename) {
     if (!helper_stack_empty(&pi->helpers)) {
         helper_stack_pop(&pi->helpers);
@@ -338,5 +409,5 @@ static void add_instruct(PInfo pi, const char *name, Attr attrs, const char *con
     if (helper_stack_empty(&pi->helpers)) { /* top level object */
         create_doc(pi);
     }
-    rb_ary_push(helper_stack_peek(&pi->helpers)->obj, inst);
+    add_node(pi, inst);
 }
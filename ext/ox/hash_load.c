@@ -69,7 +69,7 @@ static void unmark(PInfo pi, VALUE val) {
     }
 }
 
-static void add_str(PInfo pi, VALUE s) {
+void ox_hash_add_str(PInfo pi, VALUE s) {
     Helper         parent = helper_stack_peek(&pi->helpers);
     volatile VALUE a;
 
@@ -97,7 +97,7 @@ static void add_text(PInfo pi, char *text, int closed) {
     if (0 != pi->options->rb_enc) {
         rb_enc_associate(s, pi->options->rb_enc);
     }
-    add_str(pi, s);
+    ox_hash_add_str(pi, s);
 }
 
 static void add_cdata(PInfo pi, const char *text, size_t len) {
@@ -105,7 +105,26 @@ static void add_cdata(PInfo pi, const char *text, size_t len) {
     if (0 != pi->options->rb_enc) {
         rb_enc_associate(s, pi->options->rb_enc);
     }
-    add_str(pi, s);
+    ox_hash_add_str(pi, s);
+}
+
+/* Pushes an element with the name +var+ and either a Hash of attributes or
+ * Qnil. Also used by Ox.sax_extract() to build the same shape from SAX
+ * events.
+ */
+void ox_hash_start_element(PInfo pi, ID var, VALUE attrs) {
+    if (helper_stack_empty(&pi->helpers)) {
+        create_top(pi);
+    }
+    if (Qnil != attrs) {
+        volatile VALUE a = rb_ary_new();
+
+        rb_ary_push(a, attrs);
+        mark_value(pi, a);
+        helper_stack_push(&pi->helpers, var, a, ArrayCode);
+    } else {
+        helper_stack_push(&pi->helpers, var, Qnil, NoCode);
+    }
 }
 
 static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren) {
@@ -113,14 +132,10 @@ static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren
     if (0 != pi->options->rb_enc) {
         rb_enc_associate(s, pi->options->rb_enc);
     }
-    if (helper_stack_empty(&pi->helpers)) {
-        create_top(pi);
-    }
     if (NULL != attrs && NULL != attrs->name) {
         volatile VALUE h = rb_hash_new();
         volatile VALUE key;
         volatile VALUE val;
-        volatile VALUE a;
 
         for (; 0 != attrs->name; attrs++) {
             key = rb_str_new2(attrs->name);
@@ -138,12 +153,9 @@ static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren
             }
             rb_hash_aset(h, key, val);
         }
-        a = rb_ary_new();
-        rb_ary_push(a, h);
-        mark_value(pi, a);
-        helper_stack_push(&pi->helpers, rb_intern_str(s), a, ArrayCode);
+        ox_hash_start_element(pi, rb_intern_str(s), h);
     } else {
-        helper_stack_push(&pi->helpers, rb_intern_str(s), Qnil, NoCode);
+        ox_hash_start_element(pi, rb_intern_str(s), Qnil);
     }
 }
 
@@ -152,10 +164,7 @@ static void add_element_no_attrs(PInfo pi, const char *ename, Attr attrs, int ha
     if (0 != pi->options->rb_enc) {
         rb_enc_associate(s, pi->options->rb_enc);
     }
-    if (helper_stack_empty(&pi->helpers)) {
-        create_top(pi);
-    }
-    helper_stack_push(&pi->helpers, rb_intern_str(s), Qnil, NoCode);
+    ox_hash_start_element(pi, rb_intern_str(s), Qnil);
 }
 
 static int umark_hash_cb(VALUE key, VALUE value, VALUE x) {
@@ -164,17 +173,21 @@ static int umark_hash_cb(VALUE key, VALUE value, VALUE x) {
     return ST_CONTINUE;
 }
 
-static void end_element_core(PInfo pi, const char *ename, bool check_marked) {
+void ox_hash_end_element(PInfo pi, bool check_marked) {
     Helper         e      = helper_stack_pop(&pi->helpers);
     Helper         parent = helper_stack_peek(&pi->helpers);
     volatile VALUE pobj   = parent->obj;
     volatile VALUE found  = Qundef;
+    volatile VALUE eobj;
     volatile VALUE key;
     volatile VALUE a;
 
     if (NoCode == e->type) {
         e->obj = Qnil;
     }
+    // Once popped the element is past the part of the helper stack that is
+    // marked so it is kept on the C stack until added to the parent.
+    eobj = e->obj;
     if (Qnil != pi->options->element_key_mod) {
         key = rb_funcall(pi->options->element_key_mod, ox_call_id, 1, rb_id2str(e->var));
     } else if (Yes == pi->options->sym_keys) {
@@ -228,18 +241,15 @@ static void end_element_core(PInfo pi, const char *ename, bool check_marked) {
     if (check_marked && NULL != pi->marked && RUBY_T_HASH == rb_type(e->obj)) {
         rb_hash_foreach(e->obj, umark_hash_cb, (VALUE)pi);
     }
+    RB_GC_GUARD(eobj);
 }
 
 static void end_element(PInfo pi, const char *ename) {
-    end_element_core(pi, ename, true);
+    ox_hash_end_element(pi, true);
 }
 
 static void end_element_no_attrs(PInfo pi, const char *ename) {
-    end_element_core(pi, ename, false);
-}
-
-static void finish(PInfo pi) {
-    xfree(pi->marked);
+    ox_hash_end_element(pi, false);
 }
 
 static void set_encoding_from_instruct(PInfo pi, Attr attrs) {
@@ -264,7 +274,7 @@ struct _parseCallbacks _ox_hash_callbacks = {
     add_text,
     add_element,
     end_element,
-    finish,
+    NULL,
 };
 
 ParseCallbacks ox_hash_callbacks = &_ox_hash_callbacks;
@@ -277,7 +287,7 @@ struct _parseCallbacks _ox_hash_cdata_callbacks = {
     add_text,
     add_element,
     end_element,
-    finish,
+    NULL,
 };
 
 ParseCallbacks ox_hash_cdata_callbacks = &_ox_hash_cdata_callbacks;
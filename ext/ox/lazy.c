@@ -0,0 +1,460 @@
+/* lazy.c
+ * Copyright (c) 2026, Peter Ohler
+ * All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "lazy.h"
+#include "ox.h"
+#include "ruby.h"
+#include "ruby/encoding.h"
+#include "ruby/version.h"
+
+// The lazy parse callbacks do not create any Ruby objects. Instead they record
+// each node in a flat array (the tape) with the strings for the node copied
+// into a single arena. Ox::LazyElement instances are then created from the
+// tape only when the parent element's nodes are asked for.
+
+#define TAPE_NODE_INC 256
+#define TAPE_ATTR_INC 64
+#define TAPE_STR_INC 4096
+#define TAPE_STACK_INC 32
+
+static void tape_mark(void *ptr);
+static void tape_free(void *ptr);
+
+static const rb_data_type_t ox_tape_type = {
+    "Ox/tape",
+    {
+        tape_mark,
+        tape_free,
+        NULL,
+    },
+    0,
+    0,
+};
+
+VALUE ox_lazy_element_clas = Qundef;
+
+static ID tape_id;
+static ID index_id;
+
+static void tape_mark(void *ptr) {
+    if (NULL != ptr) {
+        Tape t = (Tape)ptr;
+
+        rb_gc_mark(t->attr_key_mod);
+        rb_gc_mark(t->element_key_mod);
+    }
+}
+
+static void tape_free(void *ptr) {
+    if (NULL != ptr) {
+        Tape t = (Tape)ptr;
+
+        xfree(t->nodes);
+        xfree(t->attrs);
+        xfree(t->str);
+        xfree(t->stack);
+        xfree(ptr);
+    }
+}
+
+static long tape_str(Tape t, const char *s, size_t len) {
+    long off = t->slen;
+
+    if (t->ssize <= t->slen + (long)len + 1) {
+        t->ssize = t->ssize * 2 + (long)len + 1;
+        REALLOC_N(t->str, char, t->ssize);
+    }
+    memcpy(t->str + off, s, len);
+    t->str[off + len] = '\0';
+    t->slen += (long)len + 1;
+
+    return off;
+}
+
+static long tape_add_node(Tape t, NodeType type, long str) {
+    TapeOpen parent = t->stack + t->depth - 1;
+    TapeNode n;
+    long     index;
+
+    if (t->nsize <= t->ncnt) {
+        t->nsize += t->nsize / 2 + TAPE_NODE_INC;
+        REALLOC_N(t->nodes, struct _tapeNode, t->nsize);
+    }
+    index       = t->ncnt++;
+    n           = t->nodes + index;
+    n->type     = (char)type;
+    n->str      = str;
+    n->content  = -1;
+    n->attr     = 0;
+    n->attr_cnt = 0;
+    n->first    = 0;
+    n->next     = 0;
+    if (0 == parent->last) {
+        t->nodes[parent->node].first = index;
+    } else {
+        t->nodes[parent->last].next = index;
+    }
+    parent->last = index;
+
+    return index;
+}
+
+static void tape_add_attrs(Tape t, TapeNode n, Attr attrs) {
+    n->attr = t->acnt;
+    for (; 0 != attrs->name; attrs++) {
+        TapeAttr a;
+
+        if (t->asize <= t->acnt) {
+            t->asize += t->asize / 2 + TAPE_ATTR_INC;
+            REALLOC_N(t->attrs, struct _tapeAttr, t->asize);
+        }
+        a        = t->attrs + t->acnt++;
+        a->name  = tape_str(t, attrs->name, strlen(attrs->name));
+        a->value = tape_str(t, attrs->value, strlen(attrs->value));
+        n->attr_cnt++;
+    }
+}
+
+static Tape get_tape(PInfo pi) {
+    Tape t;
+
+    if (Qnil != pi->obj) {
+        return (Tape)DATA_PTR(pi->obj);
+    }
+    t             = ALLOC(struct _tape);
+    t->nsize      = TAPE_NODE_INC;
+    t->nodes      = ALLOC_N(struct _tapeNode, t->nsize);
+    t->ncnt       = 0;
+    t->asize      = TAPE_ATTR_INC;
+    t->attrs      = ALLOC_N(struct _tapeAttr, t->asize);
+    t->acnt       = 0;
+    t->ssize      = TAPE_STR_INC;
+    t->str        = ALLOC_N(char, t->ssize);
+    t->slen       = 0;
+    t->stack_size = TAPE_STACK_INC;
+    t->stack      = ALLOC_N(struct _tapeOpen, t->stack_size);
+    t->depth      = 0;
+
+    t->sym_keys        = pi->options->sym_keys;
+    t->rb_enc          = pi->options->rb_enc;
+    t->attr_key_mod    = pi->options->attr_key_mod;
+    t->element_key_mod = pi->options->element_key_mod;
+
+    // Node 0 is the document which holds the top level nodes.
+    t->nodes->type     = DocNode;
+    t->nodes->str      = tape_str(t, "", 0);
+    t->nodes->content  = -1;
+    t->nodes->attr     = 0;
+    t->nodes->attr_cnt = 0;
+    t->nodes->first    = 0;
+    t->nodes->next     = 0;
+    t->ncnt            = 1;
+    t->stack->node     = 0;
+    t->stack->last     = 0;
+    t->depth           = 1;
+
+    pi->obj = TypedData_Wrap_Struct(rb_cObject, &ox_tape_type, t);
+
+    return t;
+}
+
+static void instruct(PInfo pi, const char *target, Attr attrs, const char *content) {
+    Tape     t = get_tape(pi);
+    TapeNode n;
+
+    if (0 == strcmp("xml", target)) {
+        for (; 0 != attrs->name; attrs++) {
+            if (0 == strcmp("encoding", attrs->name)) {
+                pi->options->rb_enc = rb_enc_find(attrs->value);
+                t->rb_enc           = pi->options->rb_enc;
+            }
+        }
+        return;
+    }
+    if (0 == strcmp("ox", target)) {
+        return;
+    }
+    n = t->nodes + tape_add_node(t, InstructNode, tape_str(t, target, strlen(target)));
+    if (0 != content) {
+        n->content = tape_str(t, content, strlen(content));
+    } else {
+        tape_add_attrs(t, n, attrs);
+    }
+}
+
+static void add_value_node(PInfo pi, NodeType type, const char *value, size_t len) {
+    Tape t = get_tape(pi);
+
+    tape_add_node(t, type, tape_str(t, value, len));
+}
+
+static void add_doctype(PInfo pi, const char *docType) {
+    add_value_node(pi, DocTypeNode, docType, strlen(docType));
+}
+
+static void add_comment(PInfo pi, const char *comment) {
+    add_value_node(pi, CommentNode, comment, strlen(comment));
+}
+
+static void add_cdata(PInfo pi, const char *cdata, size_t len) {
+    add_value_node(pi, CDataNode, cdata, len);
+}
+
+static void add_text(PInfo pi, char *text, int closed) {
+    add_value_node(pi, TextNode, text, strlen(text));
+}
+
+static void add_element(PInfo pi, const char *ename, Attr attrs, int hasChildren) {
+    Tape     t     = get_tape(pi);
+    long     index = tape_add_node(t, ElementNode, tape_str(t, ename, strlen(ename)));
+    TapeOpen o;
+
+    tape_add_attrs(t, t->nodes + index, attrs);
+    if (t->stack_size <= t->depth) {
+        t->stack_size += TAPE_STACK_INC;
+        REALLOC_N(t->stack, struct _tapeOpen, t->stack_size);
+    }
+    o       = t->stack + t->depth++;
+    o->node = index;
+    o->last = 0;
+}
+
+static void end_element(PInfo pi, const char *ename) {
+    Tape t = get_tape(pi);
+
+    if (1 < t->depth) {
+        t->depth--;
+    }
+}
+
+static void finish(PInfo pi) {
+    if (Qnil != pi->obj) {
+        Tape t = (Tape)DATA_PTR(pi->obj);
+
+        t->rb_enc = pi->options->rb_enc;
+    }
+}
+
+struct _parseCallbacks _ox_lazy_callbacks = {
+    instruct,
+    add_doctype,
+    add_comment,
+    add_cdata,
+    add_text,
+    add_element,
+    end_element,
+    finish,
+};
+
+ParseCallbacks ox_lazy_callbacks = &_ox_lazy_callbacks;
+
+static VALUE tape_rstr(Tape t, long off) {
+    VALUE s = rb_str_new2(t->str + off);
+
+    if (0 != t->rb_enc) {
+        rb_enc_associate(s, t->rb_enc);
+    }
+    return s;
+}
+
+static VALUE tape_attr_key(Tape t, long off) {
+    const char *name = t->str + off;
+
+    if (Qnil != t->attr_key_mod) {
+        return rb_funcall(t->attr_key_mod, ox_call_id, 1, rb_str_new2(name));
+    } else if (Yes == t->sym_keys) {
+        return ox_sym_intern(name, strlen(name), NULL);
+    }
+    return ox_str_intern(name, strlen(name), NULL);
+}
+
+static VALUE make_node(VALUE tv, Tape t, long index) {
+    TapeNode       n = t->nodes + index;
+    volatile VALUE obj;
+    volatile VALUE v;
+
+    switch (n->type) {
+    case TextNode: return tape_rstr(t, n->str);
+    case CDataNode: obj = rb_obj_alloc(ox_cdata_clas); break;
+    case CommentNode: obj = rb_obj_alloc(ox_comment_clas); break;
+    case DocTypeNode: obj = rb_obj_alloc(ox_doctype_clas); break;
+    case InstructNode:
+        obj = rb_obj_alloc(ox_instruct_clas);
+        rb_ivar_set(obj, ox_at_value_id, tape_rstr(t, n->str));
+        if (0 <= n->content) {
+            rb_ivar_set(obj, ox_at_content_id, tape_rstr(t, n->content));
+        } else if (0 < n->attr_cnt) {
+            volatile VALUE ah = rb_hash_new();
+            TapeAttr       a  = t->attrs + n->attr;
+            long           i;
+
+            for (i = n->attr_cnt; 0 < i; i--, a++) {
+                rb_hash_aset(ah, tape_attr_key(t, a->name), tape_rstr(t, a->value));
+            }
+            rb_ivar_set(obj, ox_attributes_id, ah);
+        }
+        return obj;
+    case ElementNode:
+        obj = rb_obj_alloc(ox_lazy_element_clas);
+        v   = tape_rstr(t, n->str);
+        if (Qnil != t->element_key_mod) {
+            v = rb_funcall(t->element_key_mod, ox_call_id, 1, v);
+        }
+        rb_ivar_set(obj, ox_at_value_id, v);
+        if (0 < n->attr_cnt) {
+            // Same flat name/value Array used by the :compact load mode.
+            volatile VALUE pairs = rb_ary_new_capa(n->attr_cnt * 2);
+            TapeAttr       a     = t->attrs + n->attr;
+            long           i;
+
+            for (i = n->attr_cnt; 0 < i; i--, a++) {
+                rb_ary_push(pairs, tape_attr_key(t, a->name));
+                rb_ary_push(pairs, tape_rstr(t, a->value));
+            }
+            rb_ivar_set(obj, ox_attributes_id, pairs);
+        }
+        if (0 != n->first) {
+            rb_ivar_set(obj, tape_id, tv);
+            rb_ivar_set(obj, index_id, LONG2NUM(index));
+        }
+        return obj;
+    default: return Qnil;
+    }
+    rb_ivar_set(obj, ox_at_value_id, tape_rstr(t, n->str));
+
+    return obj;
+}
+
+VALUE
+ox_lazy_root(VALUE tv) {
+    Tape t;
+    long i;
+
+    if (Qnil == tv) {
+        return Qnil;
+    }
+    t = (Tape)DATA_PTR(tv);
+    for (i = t->nodes->first; 0 < i; i = t->nodes[i].next) {
+        if (ElementNode == t->nodes[i].type) {
+            return make_node(tv, t, i);
+        }
+    }
+    return Qnil;
+}
+
+VALUE
+ox_lazy_nodes(VALUE self) {
+    volatile VALUE tv = rb_attr_get(self, tape_id);
+    volatile VALUE nodes;
+    Tape           t;
+    long           i;
+
+    if (Qnil == tv) {
+        return rb_attr_get(self, ox_nodes_id);
+    }
+    t     = (Tape)DATA_PTR(tv);
+    nodes = rb_ary_new();
+    for (i = t->nodes[NUM2LONG(rb_attr_get(self, index_id))].first; 0 < i; i = t->nodes[i].next) {
+        rb_ary_push(nodes, make_node(tv, t, i));
+    }
+    rb_ivar_set(self, ox_nodes_id, nodes);
+    // Once the children are built the tape is no longer needed by this element.
+    rb_ivar_set(self, tape_id, Qnil);
+
+    return nodes;
+}
+
+/* Returns the tape and node index of an element whose child nodes have not
+ * been built yet so they can be dumped straight from the tape. NULL is
+ * returned if the nodes should be taken from the element instead, including
+ * when key modifiers were used since those can change the dumped names.
+ */
+Tape ox_lazy_tape(VALUE element, long *indexp) {
+    volatile VALUE tv;
+    Tape           t;
+
+    if (ox_lazy_element_clas != rb_obj_class(element) || Qnil == (tv = rb_attr_get(element, tape_id))) {
+        return NULL;
+    }
+    t = (Tape)DATA_PTR(tv);
+    if (Qnil != t->attr_key_mod || Qnil != t->element_key_mod) {
+        return NULL;
+    }
+    *indexp = NUM2LONG(rb_attr_get(element, index_id));
+
+    return t;
+}
+
+/* call-seq: nodes() => Array
+ *
+ * Returns the Element's nodes array, building the child nodes from the parsed
+ * document on the first call.
+ */
+static VALUE lazy_nodes(VALUE self) {
+    ox_lazy_nodes(self);
+
+    return rb_call_super(0, NULL);
+}
+
+/* call-seq: <<(node) => Ox::LazyElement
+ *
+ * Appends a Node to the Element's nodes array after building the existing
+ * nodes.
+ */
+static VALUE lazy_append(VALUE self, VALUE node) {
+    ox_lazy_nodes(self);
+
+    return rb_call_super(1, &node);
+}
+
+/* call-seq: prepend_child(node) => Ox::LazyElement
+ *
+ * Prepends a Node to the Element's nodes array after building the existing
+ * nodes.
+ */
+static VALUE lazy_prepend_child(VALUE self, VALUE node) {
+    ox_lazy_nodes(self);
+
+    return rb_call_super(1, &node);
+}
+
+/* call-seq: replace_text(txt)
+ *
+ * Replaces the nodes of the Element with a single text String.
+ */
+static VALUE lazy_replace_text(VALUE self, VALUE txt) {
+    ox_lazy_nodes(self);
+
+    return rb_call_super(1, &txt);
+}
+
+/*
+ * Document-class: Ox::LazyElement
+ *
+ * An Ox::Element returned by Ox.parse_lazy(). The child nodes are only created
+ * from the parsed document when the nodes of the element are first
+ * accessed. Attributes are kept as name and value pairs until asked for as a
+ * Hash.
+ */
+void ox_init_lazy(VALUE ox) {
+#if 0
+    // Just for rdoc.
+    ox = rb_define_module("Ox");
+#endif
+    tape_id  = rb_intern("tape");
+    index_id = rb_intern("index");
+
+    ox_lazy_element_clas = rb_define_class_under(ox, "LazyElement", ox_element_clas);
+    rb_gc_register_address(&ox_lazy_element_clas);
+    rb_define_method(ox_lazy_element_clas, "nodes", lazy_nodes, 0);
+    rb_define_method(ox_lazy_element_clas, "<<", lazy_append, 1);
+    rb_define_method(ox_lazy_element_clas, "prepend_child", lazy_prepend_child, 1);
+    rb_define_method(ox_lazy_element_clas, "replace_text", lazy_replace_text, 1);
+}
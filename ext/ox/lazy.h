@@ -0,0 +1,63 @@
+/* lazy.h
+ * Copyright (c) 2026, Peter Ohler
+ * All rights reserved.
+ */
+
+#ifndef OX_LAZY_H
+#define OX_LAZY_H
+
+#include "ruby.h"
+#include "ruby/encoding.h"
+
+typedef enum {
+    DocNode      = 'D',
+    ElementNode  = 'e',
+    TextNode     = 't',
+    CDataNode    = 'c',
+    CommentNode  = 'm',
+    DocTypeNode  = 'd',
+    InstructNode = 'i',
+} NodeType;
+
+typedef struct _tapeNode {
+    long str;       // arena offset of the name or value
+    long content;   // arena offset of the instruction content or -1
+    long attr;      // index of the first attribute
+    long attr_cnt;  // number of attributes
+    long first;     // index of the first child, 0 if none
+    long next;      // index of the next sibling, 0 if none
+    char type;
+} *TapeNode;
+
+typedef struct _tapeAttr {
+    long name;
+    long value;
+} *TapeAttr;
+
+typedef struct _tapeOpen {
+    long node;
+    long last;  // last child added, 0 if none
+} *TapeOpen;
+
+typedef struct _tape {
+    TapeNode     nodes;
+    long         ncnt;
+    long         nsize;
+    TapeAttr     attrs;
+    long         acnt;
+    long         asize;
+    char        *str;
+    long         slen;
+    long         ssize;
+    TapeOpen     stack;
+    int          depth;
+    int          stack_size;
+    char         sym_keys;
+    rb_encoding *rb_enc;
+    VALUE        attr_key_mod;
+    VALUE        element_key_mod;
+} *Tape;
+
+extern Tape ox_lazy_tape(VALUE element, long *indexp);
+
+#endif /* OX_LAZY_H */
@@ -15,6 +15,7 @@
 #include "ox.h"
 #include "ruby.h"
 #include "ruby/encoding.h"
+#include "xsd_time.h"
 
 static void instruct(PInfo pi, const char *target, Attr attrs, const char *content);
 static void add_text(PInfo pi, char *text, int closed);
@@ -381,11 +382,10 @@ static void add_text(PInfo pi, char *text, int closed) {
     case TimeCode: h->obj = parse_time(text, ox_time_class); break;
     case String64Code: {
         unsigned long str_size = b64_orig_size(text);
-        VALUE         v;
-        char         *str = ALLOCA_N(char, str_size + 1);
+        VALUE         v        = rb_str_new(NULL, str_size);
 
-        from_base64(text, (uchar *)str);
-        v = rb_str_new(str, str_size);
+        // Decoded in place as a String always has room for a terminator.
+        from_base64(text, (uchar *)RSTRING_PTR(v));
         if (0 != pi->options->rb_enc) {
             rb_enc_associate(v, pi->options->rb_enc);
         }
@@ -708,55 +708,13 @@ static VALUE parse_double_time(const char *text, VALUE clas) {
     return rb_time_nano_new(v, v2);
 }
 
-typedef struct _tp {
-    int  cnt;
-    char end;
-    char alt;
-} *Tp;
-
 static VALUE parse_xsd_time(const char *text, VALUE clas) {
-    long       cargs[10];
-    long      *cp = cargs;
-    long       v;
-    int        i;
-    char       c;
-    struct _tp tpa[10] = {{4, '-', '-'},
-                          {2, '-', '-'},
-                          {2, 'T', 'T'},
-                          {2, ':', ':'},
-                          {2, ':', ':'},
-                          {2, '.', '.'},
-                          {9, '+', '-'},
-                          {2, ':', ':'},
-                          {2, '\0', '\0'},
-                          {0, '\0', '\0'}};
-    Tp         tp      = tpa;
-    struct tm  tm;
-
-    for (; 0 != tp->cnt; tp++) {
-        for (i = tp->cnt, v = 0; 0 < i; text++, i--) {
-            c = *text;
-            if (c < '0' || '9' < c) {
-                if (tp->end == c || tp->alt == c) {
-                    break;
-                }
-                return Qnil;
-            }
-            v = 10 * v + (long)(c - '0');
-        }
-        c = *text++;
-        if (tp->end != c && tp->alt != c) {
-            return Qnil;
-        }
-        *cp++ = v;
+    struct _xsdTime xt;
+
+    if (!ox_xsd_time_parse(text, &xt)) {
+        return Qnil;
     }
-    tm.tm_year = (int)cargs[0] - 1900;
-    tm.tm_mon  = (int)cargs[1] - 1;
-    tm.tm_mday = (int)cargs[2];
-    tm.tm_hour = (int)cargs[3];
-    tm.tm_min  = (int)cargs[4];
-    tm.tm_sec  = (int)cargs[5];
-    return rb_time_nano_new(mktime(&tm), cargs[6]);
+    return ox_xsd_time_value(&xt);
 }
 
 // debug functions
@@ -6,11 +6,16 @@
 #include "ox.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#if HAVE_ZLIB_H
+#include <zlib.h>
+#endif
 
 #include "intern.h"
 #include "ruby.h"
@@ -43,7 +48,9 @@ ID ox_attrs_done_id;
 ID ox_beg_id;
 ID ox_bigdecimal_id;
 ID ox_call_id;
+ID ox_cdata_chunk_id;
 ID ox_cdata_id;
+ID ox_columns_id;
 ID ox_comment_id;
 ID ox_den_id;
 ID ox_doctype_id;
@@ -60,7 +67,11 @@ ID ox_instruct_id;
 ID ox_jd_id;
 ID ox_keys_id;
 ID ox_local_id;
+ID ox_location_id;
 ID ox_mesg_id;
+ID ox_memo_id;
+ID ox_memo_key_id;
+ID ox_memo_cell_id;
 ID ox_message_id;
 ID ox_new_id;
 ID ox_nodes_id;
@@ -71,6 +82,7 @@ ID ox_read_id;
 ID ox_readpartial_id;
 ID ox_start_element_id;
 ID ox_string_id;
+ID ox_text_chunk_id;
 ID ox_text_id;
 ID ox_to_c_id;
 ID ox_value_id;
@@ -108,25 +120,38 @@ static VALUE active_sym;
 static VALUE attr_key_mod_sym;
 static VALUE auto_define_sym;
 static VALUE auto_sym;
+static VALUE base64_sym;
 static VALUE block_sym;
+static VALUE chunk_size_sym;
 static VALUE circular_sym;
+static VALUE columns_sym;
+static VALUE compact_sym;
+static VALUE compressed_sym;
 static VALUE convert_special_sym;
 static VALUE effort_sym;
+static VALUE element_sym;
 static VALUE generic_sym;
 static VALUE hash_no_attrs_sym;
 static VALUE hash_sym;
 static VALUE inactive_sym;
+static VALUE index_sym;
 static VALUE invalid_replace_sym;
+static VALUE key_sym;
 static VALUE limited_sym;
+static VALUE location_sym;
 static VALUE margin_sym;
 static VALUE mode_sym;
 static VALUE nest_ok_sym;
+static VALUE measure_sym;
+static VALUE memoize_sym;
 static VALUE no_empty_sym;
 static VALUE object_sym;
 static VALUE off_sym;
+static VALUE parallel_sym;
 static VALUE opt_format_sym;
 static VALUE optimized_sym;
 static VALUE overlay_sym;
+static VALUE resume_sym;
 static VALUE skip_none_sym;
 static VALUE skip_off_sym;
 static VALUE skip_return_sym;
@@ -170,6 +195,9 @@ struct _options ox_default_options = {
     true,          // convert_special
     No,            // allow_invalid
     false,         // no_empty
+    false,         // memoize
+    0,             // parallel
+    false,         // measure
     false,         // with_cdata
     {'\0'},        // inv_repl
     {'\0'},        // strip_ns
@@ -181,6 +209,8 @@ struct _options ox_default_options = {
 
 extern ParseCallbacks ox_obj_callbacks;
 extern ParseCallbacks ox_gen_callbacks;
+extern ParseCallbacks ox_compact_callbacks;
+extern ParseCallbacks ox_lazy_callbacks;
 extern ParseCallbacks ox_limited_callbacks;
 extern ParseCallbacks ox_nomode_callbacks;
 extern ParseCallbacks ox_hash_callbacks;
@@ -190,7 +220,7 @@ extern ParseCallbacks ox_hash_no_attrs_cdata_callbacks;
 
 static void parse_dump_options(VALUE ropts, Options copts);
 
-static char *defuse_bom(char *xml, Options options) {
+char *ox_defuse_bom(char *xml, Options options) {
     switch ((uint8_t)*xml) {
     case 0xEF:  // UTF-8
         if (0xBB == (uint8_t)xml[1] && 0xBF == (uint8_t)xml[2]) {
@@ -246,7 +276,7 @@ static VALUE hints_to_overlay(Hints hints) {
     VALUE          ov;
 
     for (i = hints->size, h = hints->hints; 0 < i; i--, h++) {
-        switch (h->overlay) {
+        switch (hint_overlay(hints, h)) {
         case InactiveOverlay: ov = inactive_sym; break;
         case BlockOverlay: ov = block_sym; break;
         case OffOverlay: ov = off_sym; break;
@@ -272,7 +302,7 @@ static VALUE hints_to_overlay(Hints hints) {
  * - _:with_xml_ [true|false|nil] include XML prolog in the dump
  * - _:circular_ [true|false|nil] support circular references while dumping
  * - _:xsd_date_ [true|false|nil] use XSD date format instead of decimal format
- * - _:mode_ [:object|:generic|:limited|:hash|:hash_no_attrs|nil] load method to use for XML
+ * - _:mode_ [:object|:generic|:compact|:limited|:hash|:hash_no_attrs|nil] load method to use for XML
  * - _:effort_ [:strict|:tolerant|:auto_define] set the tolerance level for loading
  * - _:symbolize_keys_ [true|false|nil] symbolize element attribute keys or leave as Strings
  * - _:element_key_mod_ [Proc|nil] converts element keys on parse if not nil
@@ -283,6 +313,9 @@ static VALUE hints_to_overlay(Hints hints) {
  * - _:invalid_replace_ [nil|String] replacement string for invalid XML characters on dump. nil indicates include anyway
  * as hex. A string, limited to 10 characters will replace the invalid character with the replace.
  * - _:no_empty_ [true|false|nil] flag indicating there should be no empty elements in a dump
+ * - _:memoize_ [true|false|nil] flag indicating generic elements keep their dumped XML for the next dump
+ * - _:parallel_ [Fixnum|true|false] number of threads used to dump long arrays, 0 for none
+ * - _:measure_ [true|false|nil] flag indicating generic dumps are measured so the output is allocated once
  * - _:with_cdata_ [true|false] includes cdata in hash_load results
  * - _:strip_namespace_ [String|true|false] false or "" results in no namespace stripping. A string of "*" or true will
  * strip all namespaces. Any other non-empty string indicates that matching namespaces will be stripped.
@@ -299,6 +332,26 @@ static VALUE hints_to_overlay(Hints hints) {
  * Note that an indent of less than zero will result in a tight one line output
  * unless the text in the XML fields contain new line characters.
  */
+// Converts a :parallel option value to a thread count. True picks one thread
+// per online processor.
+static char parallel_threads(VALUE v) {
+    long cnt = 0;
+
+    if (Qtrue == v) {
+        cnt = sysconf(_SC_NPROCESSORS_ONLN);
+    } else if (T_FIXNUM == rb_type(v)) {
+        cnt = FIX2LONG(v);
+    } else if (Qfalse != v) {
+        rb_raise(ox_parse_error_class, ":parallel must be an Integer, true, or false.\n");
+    }
+    if (0 > cnt) {
+        cnt = 0;
+    } else if (CHAR_MAX < cnt) {
+        cnt = CHAR_MAX;
+    }
+    return (char)cnt;
+}
+
 static VALUE get_def_opts(VALUE self) {
     VALUE opts = rb_hash_new();
     int   elen = (int)strlen(ox_default_options.encoding);
@@ -333,10 +386,14 @@ static VALUE get_def_opts(VALUE self) {
                  (Yes == ox_default_options.smart) ? Qtrue : ((No == ox_default_options.smart) ? Qfalse : Qnil));
     rb_hash_aset(opts, convert_special_sym, (ox_default_options.convert_special) ? Qtrue : Qfalse);
     rb_hash_aset(opts, no_empty_sym, (ox_default_options.no_empty) ? Qtrue : Qfalse);
+    rb_hash_aset(opts, memoize_sym, (ox_default_options.memoize) ? Qtrue : Qfalse);
+    rb_hash_aset(opts, parallel_sym, INT2FIX(ox_default_options.parallel));
+    rb_hash_aset(opts, measure_sym, (ox_default_options.measure) ? Qtrue : Qfalse);
     rb_hash_aset(opts, with_cdata_sym, (ox_default_options.with_cdata) ? Qtrue : Qfalse);
     switch (ox_default_options.mode) {
     case ObjMode: rb_hash_aset(opts, mode_sym, object_sym); break;
     case GenMode: rb_hash_aset(opts, mode_sym, generic_sym); break;
+    case CompactMode: rb_hash_aset(opts, mode_sym, compact_sym); break;
     case LimMode: rb_hash_aset(opts, mode_sym, limited_sym); break;
     case HashMode: rb_hash_aset(opts, mode_sym, hash_sym); break;
     case HashNoAttrMode: rb_hash_aset(opts, mode_sym, hash_no_attrs_sym); break;
@@ -388,17 +445,17 @@ static int set_overlay(VALUE key, VALUE value, VALUE ctx) {
 
     if (NULL != (hint = ox_hint_find(hints, StringValuePtr(key)))) {
         if (active_sym == value) {
-            hint->overlay = ActiveOverlay;
+            hint_set_overlay(hints, hint, ActiveOverlay);
         } else if (inactive_sym == value) {
-            hint->overlay = InactiveOverlay;
+            hint_set_overlay(hints, hint, InactiveOverlay);
         } else if (block_sym == value) {
-            hint->overlay = BlockOverlay;
+            hint_set_overlay(hints, hint, BlockOverlay);
         } else if (nest_ok_sym == value) {
-            hint->overlay = NestOverlay;
+            hint_set_overlay(hints, hint, NestOverlay);
         } else if (off_sym == value) {
-            hint->overlay = OffOverlay;
+            hint_set_overlay(hints, hint, OffOverlay);
         } else if (abort_sym == value) {
-            hint->overlay = AbortOverlay;
+            hint_set_overlay(hints, hint, AbortOverlay);
         }
     }
     return ST_CONTINUE;
@@ -434,7 +491,7 @@ static VALUE sax_html_overlay(VALUE self) {
  *   - _:with_xml_ [true|false|nil] include XML prolog in the dump
  *   - _:circular_ [true|false|nil] support circular references while dumping
  *   - _:xsd_date_ [true|false|nil] use XSD date format instead of decimal format
- *   - _:mode_ [:object|:generic|:limited|:hash|:hash_no_attrs|nil] load method to use for XML
+ *   - _:mode_ [:object|:generic|:compact|:limited|:hash|:hash_no_attrs|nil] load method to use for XML
  *   - _:effort_ [:strict|:tolerant|:auto_define] set the tolerance level for loading
  *   - _:symbolize_keys_ [true|false|nil] symbolize element attribute keys or leave as Strings
  *   - _:element_key_mod_ [Proc|nil] converts element keys on parse if not nil
@@ -498,6 +555,8 @@ static VALUE set_def_opts(VALUE self, VALUE opts) {
         ox_default_options.mode = ObjMode;
     } else if (generic_sym == v) {
         ox_default_options.mode = GenMode;
+    } else if (compact_sym == v) {
+        ox_default_options.mode = CompactMode;
     } else if (limited_sym == v) {
         ox_default_options.mode = LimMode;
     } else if (hash_sym == v) {
@@ -505,7 +564,8 @@ static VALUE set_def_opts(VALUE self, VALUE opts) {
     } else if (hash_no_attrs_sym == v) {
         ox_default_options.mode = HashNoAttrMode;
     } else {
-        rb_raise(ox_parse_error_class, ":mode must be :object, :generic, :limited, :hash, :hash_no_attrs, or nil.\n");
+        rb_raise(ox_parse_error_class,
+                 ":mode must be :object, :generic, :compact, :limited, :hash, :hash_no_attrs, or nil.\n");
     }
 
     v = rb_hash_aref(opts, effort_sym);
@@ -558,6 +618,33 @@ static VALUE set_def_opts(VALUE self, VALUE opts) {
         rb_raise(ox_parse_error_class, ":no_empty must be true or false.\n");
     }
 
+    v = rb_hash_lookup(opts, memoize_sym);
+    if (Qnil == v) {
+        // no change
+    } else if (Qtrue == v) {
+        ox_default_options.memoize = 1;
+    } else if (Qfalse == v) {
+        ox_default_options.memoize = 0;
+    } else {
+        rb_raise(ox_parse_error_class, ":memoize must be true or false.\n");
+    }
+
+    v = rb_hash_lookup(opts, parallel_sym);
+    if (Qnil != v) {
+        ox_default_options.parallel = parallel_threads(v);
+    }
+
+    v = rb_hash_lookup(opts, measure_sym);
+    if (Qnil == v) {
+        // no change
+    } else if (Qtrue == v) {
+        ox_default_options.measure = 1;
+    } else if (Qfalse == v) {
+        ox_default_options.measure = 0;
+    } else {
+        rb_raise(ox_parse_error_class, ":measure must be true or false.\n");
+    }
+
     v = rb_hash_aref(opts, invalid_replace_sym);
     if (Qnil == v) {
         ox_default_options.allow_invalid = Yes;
@@ -674,7 +761,7 @@ static VALUE to_obj(VALUE self, VALUE ruby_xml) {
     Check_Type(ruby_xml, T_STRING);
     /* the xml string gets modified so make a copy of it */
     len = RSTRING_LEN(ruby_xml) + 1;
-    x   = defuse_bom(StringValuePtr(ruby_xml), &options);
+    x   = ox_defuse_bom(StringValuePtr(ruby_xml), &options);
     if (SMALL_XML < len) {
         xml = ALLOC_N(char, len);
     } else {
@@ -713,7 +800,7 @@ static VALUE to_gen(VALUE self, VALUE ruby_xml) {
     Check_Type(ruby_xml, T_STRING);
     /* the xml string gets modified so make a copy of it */
     len = RSTRING_LEN(ruby_xml) + 1;
-    x   = defuse_bom(StringValuePtr(ruby_xml), &options);
+    x   = ox_defuse_bom(StringValuePtr(ruby_xml), &options);
     if (SMALL_XML < len) {
         xml = ALLOC_N(char, len);
     } else {
@@ -730,6 +817,47 @@ static VALUE to_gen(VALUE self, VALUE ruby_xml) {
     return obj;
 }
 
+/* call-seq: parse_lazy(xml) => Ox::LazyElement
+ *
+ * Parses an XML document String into a compact native index of the document
+ * and returns the root element as an Ox::LazyElement. Child nodes are only
+ * created when the nodes of an element are accessed so reading a few values
+ * from a large document creates only the objects on the path to those values.
+ * Ox.dump() writes the untouched parts of the tree straight from the index
+ * without creating the child nodes.
+ * - +xml+ [String] xml XML String
+ * *return* [Ox::LazyElement] root element or nil if there is no element.
+ *
+ * _raise_ [Exception] if the XML is malformed.
+ */
+static VALUE to_lazy(VALUE self, VALUE ruby_xml) {
+    char           *xml, *x;
+    size_t          len;
+    volatile VALUE  tape;
+    struct _options options = ox_default_options;
+    struct _err     err;
+
+    err_init(&err);
+    Check_Type(ruby_xml, T_STRING);
+    /* the xml string gets modified so make a copy of it */
+    len = RSTRING_LEN(ruby_xml) + 1;
+    x   = ox_defuse_bom(StringValuePtr(ruby_xml), &options);
+    if (SMALL_XML < len) {
+        xml = ALLOC_N(char, len);
+    } else {
+        xml = ALLOCA_N(char, len);
+    }
+    memcpy(xml, x, len);
+    tape = ox_parse(xml, len - 1, ox_lazy_callbacks, 0, &options, &err);
+    if (SMALL_XML < len) {
+        xfree(xml);
+    }
+    if (err_has(&err)) {
+        ox_err_raise(&err);
+    }
+    return ox_lazy_root(tape);
+}
+
 static int load_options_cb(VALUE k, VALUE v, VALUE opts) {
     Options copts = (Options)opts;
 
@@ -740,6 +868,8 @@ static int load_options_cb(VALUE k, VALUE v, VALUE opts) {
             copts->mode = ObjMode;
         } else if (generic_sym == v) {
             copts->mode = GenMode;
+        } else if (compact_sym == v) {
+            copts->mode = CompactMode;
         } else if (limited_sym == v) {
             copts->mode = LimMode;
         } else if (hash_sym == v) {
@@ -747,7 +877,8 @@ static int load_options_cb(VALUE k, VALUE v, VALUE opts) {
         } else if (hash_no_attrs_sym == v) {
             copts->mode = HashNoAttrMode;
         } else {
-            rb_raise(ox_parse_error_class, ":mode must be :generic, :object, :limited, :hash, :hash_no_attrs.\n");
+            rb_raise(ox_parse_error_class,
+                     ":mode must be :generic, :compact, :object, :limited, :hash, :hash_no_attrs.\n");
         }
     } else if (effort_sym == k) {
         if (auto_define_sym == v) {
@@ -841,12 +972,30 @@ static int load_options_cb(VALUE k, VALUE v, VALUE opts) {
     return ST_CONTINUE;
 }
 
+void ox_parse_load_options(VALUE ropts, Options copts) {
+    rb_hash_foreach(ropts, load_options_cb, (VALUE)copts);
+}
+
+ParseCallbacks ox_load_callbacks(Options options) {
+    switch (options->mode) {
+    case ObjMode: return ox_obj_callbacks;
+    case GenMode: return ox_gen_callbacks;
+    case CompactMode: return ox_compact_callbacks;
+    case LimMode: return ox_limited_callbacks;
+    case HashMode: return options->with_cdata ? ox_hash_cdata_callbacks : ox_hash_callbacks;
+    case HashNoAttrMode: return options->with_cdata ? ox_hash_no_attrs_cdata_callbacks : ox_hash_no_attrs_callbacks;
+    case NoMode: return ox_nomode_callbacks;
+    default: break;
+    }
+    return ox_gen_callbacks;
+}
+
 static VALUE load(char *xml, size_t len, int argc, VALUE *argv, VALUE self, VALUE encoding, Err err) {
     VALUE           obj;
     struct _options options = ox_default_options;
 
     if (1 == argc && rb_cHash == rb_obj_class(*argv)) {
-        rb_hash_foreach(*argv, load_options_cb, (VALUE)&options);
+        ox_parse_load_options(*argv, &options);
     }
     if ('\0' == *options.encoding) {
         if (Qnil != encoding) {
@@ -857,32 +1006,14 @@ static VALUE load(char *xml, size_t len, int argc, VALUE *argv, VALUE self, VALU
     } else if (0 == options.rb_enc) {
         options.rb_enc = rb_enc_find(options.encoding);
     }
-    xml = defuse_bom(xml, &options);
-    switch (options.mode) {
-    case ObjMode:
+    xml = ox_defuse_bom(xml, &options);
+    if (ObjMode == options.mode) {
         rb_gc_disable();
         obj = ox_parse(xml, len, ox_obj_callbacks, 0, &options, err);
         RB_GC_GUARD(obj);
         rb_gc_enable();
-        break;
-    case GenMode: obj = ox_parse(xml, len, ox_gen_callbacks, 0, &options, err); break;
-    case LimMode: obj = ox_parse(xml, len, ox_limited_callbacks, 0, &options, err); break;
-    case HashMode:
-        if (options.with_cdata) {
-            obj = ox_parse(xml, len, ox_hash_cdata_callbacks, 0, &options, err);
-        } else {
-            obj = ox_parse(xml, len, ox_hash_callbacks, 0, &options, err);
-        }
-        break;
-    case HashNoAttrMode:
-        if (options.with_cdata) {
-            obj = ox_parse(xml, len, ox_hash_no_attrs_cdata_callbacks, 0, &options, err);
-        } else {
-            obj = ox_parse(xml, len, ox_hash_no_attrs_callbacks, 0, &options, err);
-        }
-        break;
-    case NoMode: obj = ox_parse(xml, len, ox_nomode_callbacks, 0, &options, err); break;
-    default: obj = ox_parse(xml, len, ox_gen_callbacks, 0, &options, err); break;
+    } else {
+        obj = ox_parse(xml, len, ox_load_callbacks(&options), 0, &options, err);
     }
     return obj;
 }
@@ -897,9 +1028,11 @@ static VALUE load(char *xml, size_t len, int argc, VALUE *argv, VALUE self, VALU
  *
  * - +xml+ [String] XML String
  * - +options+ [Hash] load options
- *   - *:mode* [:object|:generic|:limited] format expected
+ *   - *:mode* [:object|:generic|:compact|:limited] format expected
  *     - _:object_ - object format
  *     - _:generic_ - read as a generic XML file
+ *     - _:compact_ - same as generic but element attributes are kept as a flat Array until first asked for as a Hash
+ *       and a lone text node is kept as a String until the nodes Array is asked for
  *     - _:limited_ - read as a generic XML file but with callbacks on text and elements events only
  *     - _:hash_ - read and convert to a Hash and core class objects only
  *     - _:hash_no_attrs_ - read and convert to a Hash and core class objects only without capturing attributes
@@ -944,6 +1077,60 @@ static VALUE load_str(int argc, VALUE *argv, VALUE self) {
     return obj;
 }
 
+#if HAVE_ZLIB_H
+// Inflates gzip or zlib compressed data into a new buffer that the caller
+// frees. A gzip file may hold several members one after the other. The
+// avail_in and avail_out counts are only unsigned ints so more than 4GB is
+// handed to zlib in parts.
+static char *inflate_xml(const char *src, size_t slen, size_t *lenp, Err err) {
+    z_stream    zs;
+    const char *end  = src + slen;
+    size_t      size = slen * 4 + 4096;
+    size_t      len  = 0;
+    char       *xml  = ALLOC_N(char, size);
+    int         ret  = Z_OK;
+
+    memset(&zs, 0, sizeof(zs));
+    if (Z_OK != inflateInit2(&zs, 15 + 32)) {
+        xfree(xml);
+        ox_err_set(err, ox_parse_error_class, "failed to initialize zlib.\n");
+        return NULL;
+    }
+    zs.next_in = (Bytef *)src;
+    while (true) {
+        if (size - 1 <= len) {
+            size *= 2;
+            REALLOC_N(xml, char, size);
+        }
+        if (0 == zs.avail_in) {
+            zs.avail_in = (UINT_MAX < (size_t)(end - (char *)zs.next_in)) ? UINT_MAX : (uInt)(end - (char *)zs.next_in);
+        }
+        zs.next_out  = (Bytef *)(xml + len);
+        zs.avail_out = (UINT_MAX < size - 1 - len) ? UINT_MAX : (uInt)(size - 1 - len);
+        ret          = inflate(&zs, Z_NO_FLUSH);
+        len          = (char *)zs.next_out - xml;
+        if (Z_STREAM_END == ret) {
+            if (0 == zs.avail_in && end == (char *)zs.next_in) {
+                break;
+            }
+            inflateReset(&zs);
+        } else if (Z_OK != ret && !(Z_BUF_ERROR == ret && 0 == zs.avail_out)) {
+            break;
+        }
+    }
+    inflateEnd(&zs);
+    if (Z_STREAM_END != ret) {
+        xfree(xml);
+        ox_err_set(err, ox_parse_error_class, "Failed to inflate compressed input.\n");
+        return NULL;
+    }
+    xml[len] = '\0';
+    *lenp    = len;
+
+    return xml;
+}
+#endif
+
 /* call-seq: load_file(file_path, options) => Ox::Document or Ox::Element or Object
  *
  * Parses and XML document from a file into an Ox::Document, or Ox::Element,
@@ -951,9 +1138,11 @@ static VALUE load_str(int argc, VALUE *argv, VALUE self) {
  * malformed or the classes specified are not valid.
  * - +file_path+ [String] file path to read the XML document from
  * - +options+ [Hash] load options
- *   - *:mode* [:object|:generic|:limited] format expected
+ *   - *:mode* [:object|:generic|:compact|:limited] format expected
  *     - _:object_ - object format
  *     - _:generic_ - read as a generic XML file
+ *     - _:compact_ - same as generic but element attributes are kept as a flat Array until first asked for as a Hash
+ *       and a lone text node is kept as a String until the nodes Array is asked for
  *     - _:limited_ - read as a generic XML file but with callbacks on text and elements events only
  *     - _:hash_ - read and convert to a Hash and core class objects only
  *     - _:hash_no_attrs_ - read and convert to a Hash and core class objects only without capturing attributes
@@ -967,6 +1156,7 @@ static VALUE load_str(int argc, VALUE *argv, VALUE self) {
  * anyway as hex. A string, limited to 10 characters will replace the invalid character with the replace.
  *   - *:strip_namespace* [String|true|false] "" or false result in no namespace stripping. A string of "*" or true will
  * strip all namespaces. Any other non-empty string indicates that matching namespaces will be stripped.
+ *   - *:compressed* [true|false] if true the file is gzip or zlib compressed. The header type is detected.
  */
 static VALUE load_file(int argc, VALUE *argv, VALUE self) {
     char       *path;
@@ -975,9 +1165,18 @@ static VALUE load_file(int argc, VALUE *argv, VALUE self) {
     off_t       len;
     VALUE       obj;
     struct _err err;
+    bool        compressed = false;
 
     err_init(&err);
     Check_Type(*argv, T_STRING);
+    if (2 <= argc && rb_cHash == rb_obj_class(argv[1])) {
+        compressed = RTEST(rb_hash_lookup(argv[1], compressed_sym));
+    }
+#if !HAVE_ZLIB_H
+    if (compressed) {
+        rb_raise(rb_eNotImpError, "Ox was built without zlib so compressed input is not supported.\n");
+    }
+#endif
     path = StringValuePtr(*argv);
     if (0 == (f = fopen(path, "r"))) {
         rb_raise(rb_eIOError, "%s\n", strerror(errno));
@@ -993,6 +1192,18 @@ static VALUE load_file(int argc, VALUE *argv, VALUE self) {
     if ((size_t)len != fread(xml, 1, len, f)) {
         ox_err_set(&err, rb_eLoadError, "Failed to read %ld bytes from %s.\n", (long)len, path);
         obj = Qnil;
+#if HAVE_ZLIB_H
+    } else if (compressed) {
+        size_t xlen;
+        char  *x = inflate_xml(xml, len, &xlen, &err);
+
+        if (NULL == x) {
+            obj = Qnil;
+        } else {
+            obj = load(x, xlen, argc - 1, argv + 1, self, Qnil, &err);
+            xfree(x);
+        }
+#endif
     } else {
         xml[len] = '\0';
         obj      = load(xml, len, argc - 1, argv + 1, self, Qnil, &err);
@@ -1007,84 +1218,320 @@ static VALUE load_file(int argc, VALUE *argv, VALUE self) {
     return obj;
 }
 
-/* call-seq: sax_parse(handler, io, options)
+/* call-seq: load_at(file_path, offset, length, options) => Ox::Document or Ox::Element or Object
  *
- * Parses an IO stream or file containing an XML document. Raises an exception
- * if the XML is malformed or the classes specified are not valid.
- * - +handler+ [Ox::Sax] SAX (responds to OX::Sax methods) like handler
- * - +io+ [IO|String] IO Object to read from
- * - +options+ [Hash] options parse options
- *   - *:convert_special* [true|false] flag indicating special characters like &lt; are converted
- *   - *:symbolize* [true|false] flag indicating the parser symbolize element and attribute names
- *   - *:smart* [true|false] flag indicating the parser uses hints if available (use with html)
- *   - *:skip* [:skip_none|:skip_return|:skip_white|:skip_off] flag indicating the parser skips \\r or collpase white
- * space into a single space. Default (skip space)
- *   - *:strip_namespace* [nil|String|true|false] "" or false result in no namespace stripping. A string of "*" or true
- * will strip all namespaces. Any other non-empty string indicates that matching namespaces will be stripped.
+ * Parses the XML in the _length_ bytes starting at _offset_ in a file such as
+ * one of the records found by index_file(). Only that slice of the file is
+ * read.
+ * - +file_path+ [String] file path to read the XML from
+ * - +offset+ [Integer] byte offset of the start of the XML
+ * - +length+ [Integer] number of bytes to read
+ * - +options+ [Hash] load options as with load_file()
  */
-static VALUE sax_parse(int argc, VALUE *argv, VALUE self) {
-    struct _saxOptions options;
+static VALUE load_at(int argc, VALUE *argv, VALUE self) {
+    char       *path;
+    char       *xml;
+    FILE       *f;
+    off_t       off;
+    long        len;
+    VALUE       obj;
+    struct _err err;
 
-    options.symbolize       = (No != ox_default_options.sym_keys);
-    options.convert_special = ox_default_options.convert_special;
-    options.smart           = (Yes == ox_default_options.smart);
-    options.skip            = ox_default_options.skip;
-    options.hints           = NULL;
-    strcpy(options.strip_ns, ox_default_options.strip_ns);
+    if (argc < 3) {
+        rb_raise(ox_arg_error_class, "Wrong number of arguments to load_at.\n");
+    }
+    err_init(&err);
+    Check_Type(*argv, T_STRING);
+    off = NUM2OFFT(argv[1]);
+    len = NUM2LONG(argv[2]);
+    if (0 > off || 0 > len) {
+        rb_raise(ox_arg_error_class, "load_at offset and length must not be negative.\n");
+    }
+    path = StringValuePtr(*argv);
+    if (0 == (f = fopen(path, "r"))) {
+        rb_raise(rb_eIOError, "%s\n", strerror(errno));
+    }
+    if (SMALL_XML < len) {
+        xml = ALLOC_N(char, len + 1);
+    } else {
+        xml = ALLOCA_N(char, len + 1);
+    }
+    if (0 != fseeko(f, off, SEEK_SET) || (size_t)len != fread(xml, 1, len, f)) {
+        ox_err_set(&err, rb_eLoadError, "Failed to read %ld bytes at %ld from %s.\n", len, (long)off, path);
+        obj = Qnil;
+    } else {
+        xml[len] = '\0';
+        obj      = load(xml, len, argc - 3, argv + 3, self, Qnil, &err);
+    }
+    fclose(f);
+    if (SMALL_XML < len) {
+        xfree(xml);
+    }
+    if (err_has(&err)) {
+        ox_err_raise(&err);
+    }
+    return obj;
+}
 
-    if (argc < 2) {
-        rb_raise(ox_parse_error_class, "Wrong number of arguments to sax_parse.\n");
+static int check_column_cb(VALUE key, VALUE type, VALUE x) {
+    if (T_SYMBOL != rb_type(key) && T_STRING != rb_type(key)) {
+        rb_raise(ox_parse_error_class, ":columns keys must be element names as a Symbol or String.\n");
     }
-    if (3 <= argc && rb_cHash == rb_obj_class(argv[2])) {
-        VALUE h = argv[2];
+    ox_sax_column_type(type);
+
+    return ST_CONTINUE;
+}
+
+/* Fills in the SAX options from the defaults and then from the optional Hash
+ * +h+ as used by sax_parse() and Ox::Sax::Parser.new.
+ */
+void ox_sax_options_init(SaxOptions options, VALUE h) {
+    options->symbolize       = (No != ox_default_options.sym_keys);
+    options->convert_special = ox_default_options.convert_special;
+    options->smart           = (Yes == ox_default_options.smart);
+    options->skip            = ox_default_options.skip;
+    options->hints           = NULL;
+    options->columns         = Qnil;
+    options->sinks           = Qnil;
+    options->location        = true;
+    options->compressed      = false;
+    options->resume          = Qnil;
+    options->chunk_size      = SAX_CHUNK_SIZE;
+    strcpy(options->strip_ns, ox_default_options.strip_ns);
+
+    if (Qnil != h && rb_cHash == rb_obj_class(h)) {
         VALUE v;
 
         if (Qnil != (v = rb_hash_lookup(h, convert_special_sym))) {
-            options.convert_special = (Qtrue == v);
+            options->convert_special = (Qtrue == v);
         }
         if (Qnil != (v = rb_hash_lookup(h, smart_sym))) {
-            options.smart = (Qtrue == v);
+            options->smart = (Qtrue == v);
         }
         if (Qnil != (v = rb_hash_lookup(h, symbolize_sym))) {
-            options.symbolize = (Qtrue == v);
+            options->symbolize = (Qtrue == v);
         }
         if (Qnil != (v = rb_hash_lookup(h, skip_sym))) {
             if (skip_return_sym == v) {
-                options.skip = CrSkip;
+                options->skip = CrSkip;
             } else if (skip_white_sym == v) {
-                options.skip = SpcSkip;
+                options->skip = SpcSkip;
             } else if (skip_none_sym == v) {
-                options.skip = NoSkip;
+                options->skip = NoSkip;
             } else if (skip_off_sym == v) {
-                options.skip = OffSkip;
+                options->skip = OffSkip;
             }
         }
         if (Qnil != (v = rb_hash_lookup(h, strip_namespace_sym))) {
             if (Qfalse == v) {
-                *options.strip_ns = '\0';
+                *options->strip_ns = '\0';
             } else if (Qtrue == v) {
-                *options.strip_ns   = '*';
-                options.strip_ns[1] = '\0';
+                *options->strip_ns   = '*';
+                options->strip_ns[1] = '\0';
             } else {
                 long slen;
 
                 Check_Type(v, T_STRING);
                 slen = RSTRING_LEN(v);
-                if (sizeof(options.strip_ns) - 1 < (size_t)slen) {
+                if (sizeof(options->strip_ns) - 1 < (size_t)slen) {
                     rb_raise(ox_parse_error_class,
                              ":strip_namespace can be no longer than %d characters.",
-                             (int)sizeof(options.strip_ns) - 1);
+                             (int)sizeof(options->strip_ns) - 1);
                 }
-                strncpy(options.strip_ns, StringValuePtr(v), sizeof(options.strip_ns) - 1);
-                options.strip_ns[sizeof(options.strip_ns) - 1] = '\0';
+                strncpy(options->strip_ns, StringValuePtr(v), sizeof(options->strip_ns) - 1);
+                options->strip_ns[sizeof(options->strip_ns) - 1] = '\0';
             }
         }
+        if (Qnil != (v = rb_hash_lookup(h, columns_sym))) {
+            Check_Type(v, T_HASH);
+            rb_hash_foreach(v, check_column_cb, Qnil);
+            options->columns = v;
+        }
+        if (Qnil != (v = rb_hash_lookup(h, base64_sym))) {
+            ox_sax_sink_check(v);
+            options->sinks = v;
+        }
+        if (Qnil != (v = rb_hash_lookup(h, location_sym))) {
+            options->location = (Qfalse != v);
+        }
+        if (Qnil != (v = rb_hash_lookup(h, compressed_sym))) {
+            options->compressed = (Qfalse != v);
+        }
+        if (Qnil != (v = rb_hash_lookup(h, resume_sym))) {
+            Check_Type(v, T_STRING);
+            options->resume = v;
+        }
+        if (Qnil != (v = rb_hash_lookup(h, chunk_size_sym))) {
+            if (!RB_INTEGER_TYPE_P(v) || 0 >= NUM2LL(v)) {
+                rb_raise(ox_arg_error_class, ":chunk_size must be a positive Integer.\n");
+            }
+            options->chunk_size = (SAX_CHUNK_MIN < NUM2LL(v)) ? NUM2LONG(v) : SAX_CHUNK_MIN;
+        }
     }
+}
+
+/* call-seq: sax_parse(handler, io, options)
+ *
+ * Parses an IO stream or file containing an XML document. Raises an exception
+ * if the XML is malformed or the classes specified are not valid.
+ * - +handler+ [Ox::Sax|Hash] SAX (responds to OX::Sax methods) like handler or a Hash of callback names such as
+ * :start_element mapped to Procs that take the same arguments as the Ox::Sax methods
+ * - +io+ [IO|String] IO Object to read from
+ * - +options+ [Hash] options parse options
+ *   - *:convert_special* [true|false] flag indicating special characters like &lt; are converted
+ *   - *:symbolize* [true|false] flag indicating the parser symbolize element and attribute names
+ *   - *:smart* [true|false] flag indicating the parser uses hints if available (use with html)
+ *   - *:skip* [:skip_none|:skip_return|:skip_white|:skip_off] flag indicating the parser skips \\r or collpase white
+ * space into a single space. Default (skip space)
+ *   - *:strip_namespace* [nil|String|true|false] "" or false result in no namespace stripping. A string of "*" or true
+ * will strip all namespaces. Any other non-empty string indicates that matching namespaces will be stripped.
+ *   - *:columns* [Hash] element names mapped to :int, :float, or :time. The text of those elements is collected into
+ * packed native columns instead of being passed to the text() or value() callbacks. When the parse completes the
+ * handler's columns() method is called with a Hash of the same keys and binary Strings that unpack with 'q*' for
+ * :int, 'd*' for :float, and 'q*' for :time as nanoseconds since the epoch. Times without a zone are taken as UTC.
+ * CDATA is read as the element text. An element with no text is recorded as NaN in a :float column and as the smallest
+ * 64 bit integer in the others so each column keeps one entry per element.
+ *   - *:location* [true|false] if false line and column tracking is turned off for a faster parse. Positions are
+ * still tracked. Defaults to true.
+ *   - *:compressed* [true|false] if true the input is gzip or zlib compressed and is inflated as it is read. The
+ * header type is detected.
+ *   - *:resume* [String] state returned by Ox::Sax#checkpoint in an earlier parse of the same document. The _io_ is
+ * moved to the checkpoint with seek() and parsing continues from there with the same open elements. Callbacks for
+ * the part already parsed are not repeated.
+ *   - *:chunk_size* [Integer] size in bytes of the pieces a long text or CDATA node is delivered in when the handler
+ * has a text_chunk() or cdata_chunk() method. Smaller values are raised to 64. Defaults to 65536.
+ *   - *:base64* [Hash] element names or '/' separated paths of names mapped to an IO with a file descriptor or an
+ * Integer descriptor. The text of a matching element is base64 decoded and written directly to the descriptor
+ * instead of being passed to the handler. A path matches the innermost open elements.
+ */
+static VALUE sax_parse(int argc, VALUE *argv, VALUE self) {
+    struct _saxOptions options;
+
+    if (argc < 2) {
+        rb_raise(ox_parse_error_class, "Wrong number of arguments to sax_parse.\n");
+    }
+    ox_sax_options_init(&options, (3 <= argc) ? argv[2] : Qnil);
     ox_sax_parse(argv[0], argv[1], &options);
 
     return Qnil;
 }
 
+/* call-seq: sax_extract(io, options) { |hash| ... }
+ *
+ * Streams an IO or String containing an XML document through the SAX parser
+ * and yields a Hash for each element with a matching name. The Hash has the
+ * same shape as Ox.load() returns for that element alone in :hash or
+ * :hash_no_attrs mode. The Hash is built in C without any Ruby calls per SAX
+ * event and only one record is held at a time so memory stays bounded even
+ * for very large documents. Matching elements nested inside a match are part
+ * of the outer record.
+ * - +io+ [IO|String] IO Object or String to read from
+ * - +options+ [Hash] SAX options as with sax_parse() and
+ *   - *:element* [String|Symbol] name of the elements to extract, required
+ *   - *:mode* [:hash|:hash_no_attrs] shape of the yielded Hash, default :hash
+ *   - *:symbolize_keys* [true|false] element and attribute names as Symbols
+ *   - *:element_key_mod* [Proc] converts element keys
+ *   - *:attr_key_mod* [Proc] converts attribute keys
+ *   - *:with_cdata* [true|false] include CDATA as text
+ *
+ *   Ox.sax_extract(File.open('big.xml'), element: 'item') { |h| p h[:item] }
+ */
+static VALUE sax_extract(int argc, VALUE *argv, VALUE self) {
+    struct _saxOptions options;
+    struct _options    hopts   = ox_default_options;
+    volatile VALUE     element = Qnil;
+    volatile VALUE     h       = (2 <= argc) ? argv[1] : Qnil;
+
+    rb_need_block();
+    if (argc < 1 || 2 < argc) {
+        rb_raise(ox_arg_error_class, "Wrong number of arguments to sax_extract.\n");
+    }
+    hopts.mode = HashMode;
+    if (Qnil != h) {
+        Check_Type(h, T_HASH);
+        rb_hash_foreach(h, load_options_cb, (VALUE)&hopts);
+        element = rb_hash_lookup(h, element_sym);
+    }
+    if (HashMode != hopts.mode && HashNoAttrMode != hopts.mode) {
+        rb_raise(ox_arg_error_class, ":mode must be :hash or :hash_no_attrs for sax_extract.\n");
+    }
+    if (SYMBOL_P(element)) {
+        element = rb_sym2str(element);
+    }
+    if (T_STRING != rb_type(element)) {
+        rb_raise(ox_arg_error_class, "sax_extract requires an :element String or Symbol.\n");
+    }
+    ox_sax_options_init(&options, h);
+    options.symbolize = (Yes == hopts.sym_keys);
+    ox_sax_extract(argv[0], &options, &hopts, element, HashMode == hopts.mode);
+
+    return Qnil;
+}
+
+/* call-seq: index_file(file_path, options) => Hash
+ *
+ * Scans a file once and returns a Hash of key to [offset, length] for each
+ * element with a matching name. The offset and length cover the element from
+ * its start tag through its end tag so load_at() can parse just that record
+ * later without rescanning the file. No Ruby calls are made during the scan.
+ * Matching elements nested inside a match are part of the outer record and
+ * records without a key are skipped. If a key repeats the last record wins.
+ * Entities and character references in keys are decoded and CDATA in a key
+ * element is taken as is.
+ * - +file_path+ [String] file path to read the XML document from
+ * - +options+ [Hash] index options
+ *   - *:element* [String|Symbol] name of the record elements, required
+ *   - *:key* [String] "@name" for an attribute of the record element or the name of a child element whose text is
+ * the key, required
+ *   - *:index* [String] if set the index is also written to this file in a compact binary form for load_index()
+ *
+ *   index = Ox.index_file('big.xml', element: 'record', key: '@id')
+ *   offset, length = index['1234']
+ *   Ox.load_at('big.xml', offset, length, mode: :hash)
+ */
+static VALUE index_file(int argc, VALUE *argv, VALUE self) {
+    volatile VALUE element = Qnil;
+    volatile VALUE key     = Qnil;
+    volatile VALUE out     = Qnil;
+
+    if (2 != argc) {
+        rb_raise(ox_arg_error_class, "Wrong number of arguments to index_file.\n");
+    }
+    Check_Type(argv[0], T_STRING);
+    Check_Type(argv[1], T_HASH);
+    element = rb_hash_lookup(argv[1], element_sym);
+    key     = rb_hash_lookup(argv[1], key_sym);
+    out     = rb_hash_lookup(argv[1], index_sym);
+    if (SYMBOL_P(element)) {
+        element = rb_sym2str(element);
+    }
+    if (SYMBOL_P(key)) {
+        key = rb_sym2str(key);
+    }
+    if (T_STRING != rb_type(element) || 0 == RSTRING_LEN(element)) {
+        rb_raise(ox_arg_error_class, "index_file requires an :element String or Symbol.\n");
+    }
+    if (T_STRING != rb_type(key) || 0 == RSTRING_LEN(key) || (1 == RSTRING_LEN(key) && '@' == *RSTRING_PTR(key))) {
+        rb_raise(ox_arg_error_class, "index_file requires a :key String.\n");
+    }
+    if (Qnil != out) {
+        Check_Type(out, T_STRING);
+    }
+    return ox_index_file(argv[0], element, key, (Qnil == out) ? NULL : StringValueCStr(out));
+}
+
+/* call-seq: load_index(index_path) => Hash
+ *
+ * Reads an index written by index_file() with the :index option and returns
+ * the same Hash of key to [offset, length] that index_file() returned.
+ * - +index_path+ [String] path of the index file
+ */
+static VALUE load_index(VALUE self, VALUE path) {
+    Check_Type(path, T_STRING);
+
+    return ox_load_index(StringValueCStr(path));
+}
+
 /* call-seq: sax_html(handler, io, options)
  *
  * Parses an IO stream or file containing an XML document. Raises an exception
@@ -1106,7 +1553,7 @@ static VALUE sax_parse(int argc, VALUE *argv, VALUE self) {
  */
 static VALUE sax_html(int argc, VALUE *argv, VALUE self) {
     struct _saxOptions options;
-    bool               free_hints = false;
+    struct _hints      hints;
 
     options.symbolize       = (No != ox_default_options.sym_keys);
     options.convert_special = ox_default_options.convert_special;
@@ -1116,7 +1563,13 @@ static VALUE sax_html(int argc, VALUE *argv, VALUE self) {
     if (NULL == options.hints) {
         options.hints = ox_hints_html();
     }
-    *options.strip_ns = '\0';
+    options.columns    = Qnil;
+    options.sinks      = Qnil;
+    options.location   = true;
+    options.compressed = false;
+    options.resume     = Qnil;
+    options.chunk_size = SAX_CHUNK_SIZE;
+    *options.strip_ns  = '\0';
 
     if (argc < 2) {
         rb_raise(ox_parse_error_class, "Wrong number of arguments to sax_html.\n");
@@ -1150,16 +1603,16 @@ static VALUE sax_html(int argc, VALUE *argv, VALUE self) {
             if (0 == cnt) {
                 options.hints = ox_hints_html();
             } else {
-                options.hints = ox_hints_dup(options.hints);
-                free_hints    = true;
+                // The overlay is only for this parse so it goes in a byte
+                // array on the stack instead of a copy of the hints.
+                ox_hints_overlay(&hints, options.hints, ALLOCA_N(char, options.hints->size));
+                options.hints = &hints;
                 rb_hash_foreach(v, set_overlay, (VALUE)options.hints);
             }
         }
     }
     ox_sax_parse(argv[0], argv[1], &options);
-    if (free_hints) {
-        ox_hints_destroy(options.hints);
-    }
+
     return Qnil;
 }
 
@@ -1196,6 +1649,15 @@ static void parse_dump_options(VALUE ropts, Options copts) {
         if (Qnil != (v = rb_hash_lookup(ropts, no_empty_sym))) {
             copts->no_empty = (v == Qtrue);
         }
+        if (Qnil != (v = rb_hash_lookup(ropts, memoize_sym))) {
+            copts->memoize = (v == Qtrue);
+        }
+        if (Qnil != (v = rb_hash_lookup(ropts, parallel_sym))) {
+            copts->parallel = parallel_threads(v);
+        }
+        if (Qnil != (v = rb_hash_lookup(ropts, measure_sym))) {
+            copts->measure = (v == Qtrue);
+        }
         if (Qnil != (v = rb_hash_lookup(ropts, effort_sym))) {
             if (auto_define_sym == v) {
                 copts->effort = AutoEffort;
@@ -1266,6 +1728,13 @@ static void parse_dump_options(VALUE ropts, Options copts) {
  * - +options+ [Hash] formating options
  *   - *:indent* [Fixnum] format expected
  *   - *:no_empty* [true|false] if true don't output empty elements
+ *   - *:memoize* [true|false] if true the dumped node and the smallest elements of at least 128 bytes keep their XML
+ *     and later dumps reuse it until they or a descendant are changed with an Ox::Element or Ox::HasAttrs method,
+ *     see Ox::Node#clear_memo
+ *   - *:parallel* [Fixnum|true|false] threads used to escape and format an Array of at least 2048 nodes, or of
+ *     nil, true, false, Integer, Float, String, and Symbol values, true for one per processor, default: 0
+ *   - *:measure* [true|false] if true a generic document or element is measured first and the String is allocated
+ *     once at the exact size, default: false
  *   - *:xsd_date* [true|false] use XSD date format if true, default: false
  *   - *:circular* [true|false] allow circular references, default: false
  *   - *:strict|:tolerant]* [ :effort effort to use when an undumpable object (e.g., IO) is encountered, default:
@@ -1280,22 +1749,16 @@ static void parse_dump_options(VALUE ropts, Options copts) {
  * unless the text in the XML fields contain new line characters.
  */
 static VALUE dump(int argc, VALUE *argv, VALUE self) {
-    char           *xml;
     struct _options copts = ox_default_options;
-    VALUE           rstr;
+    volatile VALUE  rstr;
 
     if (2 == argc) {
         parse_dump_options(argv[1], &copts);
     }
-    if (0 == (xml = ox_write_obj_to_str(*argv, &copts))) {
-        rb_raise(rb_eNoMemError, "Not enough memory.\n");
-    }
-    rstr = rb_str_new2(xml);
+    rstr = ox_write_obj_to_rstr(*argv, &copts);
     if ('\0' != *copts.encoding) {
         rb_enc_associate(rstr, rb_enc_find(copts.encoding));
     }
-    xfree(xml);
-
     return rstr;
 }
 
@@ -1306,6 +1769,11 @@ static VALUE dump(int argc, VALUE *argv, VALUE self) {
  * - +options+ [Hash] formating options
  *   - *:indent* [Fixnum] format expected
  *   - *:no_empty* [true|false] if true don't output empty elements
+ *   - *:memoize* [true|false] if true the dumped node and the smallest elements of at least 128 bytes keep their XML
+ *     and later dumps reuse it until they or a descendant are changed with an Ox::Element or Ox::HasAttrs method,
+ *     see Ox::Node#clear_memo
+ *   - *:parallel* [Fixnum|true|false] threads used to escape and format an Array of at least 2048 nodes, or of
+ *     nil, true, false, Integer, Float, String, and Symbol values, true for one per processor, default: 0
  *   - *:xsd_date* [true|false] use XSD date format if true, default: false
  *   - *:circular* [true|false] allow circular references, default: false
  *   - *:strict|:tolerant]* [ :effort effort to use when an undumpable object (e.g., IO) is encountered, default:
@@ -1382,14 +1850,19 @@ void Init_ox(void) {
 
     rb_define_module_function(Ox, "parse_obj", to_obj, 1);
     rb_define_module_function(Ox, "parse", to_gen, 1);
+    rb_define_module_function(Ox, "parse_lazy", to_lazy, 1);
     rb_define_module_function(Ox, "load", load_str, -1);
     rb_define_module_function(Ox, "sax_parse", sax_parse, -1);
     rb_define_module_function(Ox, "sax_html", sax_html, -1);
+    rb_define_module_function(Ox, "sax_extract", sax_extract, -1);
+    rb_define_module_function(Ox, "index_file", index_file, -1);
+    rb_define_module_function(Ox, "load_index", load_index, 1);
 
     rb_define_module_function(Ox, "to_xml", to_xml, -1);
     rb_define_module_function(Ox, "dump", dump, -1);
 
     rb_define_module_function(Ox, "load_file", load_file, -1);
+    rb_define_module_function(Ox, "load_at", load_at, -1);
     rb_define_module_function(Ox, "to_file", to_file, -1);
 
     rb_define_module_function(Ox, "sax_html_overlay", sax_html_overlay, 0);
@@ -1415,7 +1888,9 @@ void Init_ox(void) {
     ox_beg_id               = rb_intern("@beg");
     ox_bigdecimal_id        = rb_intern("BigDecimal");
     ox_call_id              = rb_intern("call");
+    ox_cdata_chunk_id       = rb_intern("cdata_chunk");
     ox_cdata_id             = rb_intern("cdata");
+    ox_columns_id           = rb_intern("columns");
     ox_comment_id           = rb_intern("comment");
     ox_den_id               = rb_intern("@den");
     ox_doctype_id           = rb_intern("doctype");
@@ -1432,7 +1907,11 @@ void Init_ox(void) {
     ox_jd_id                = rb_intern("jd");
     ox_keys_id              = rb_intern("keys");
     ox_local_id             = rb_intern("local");
+    ox_location_id          = rb_intern("location");
     ox_mesg_id              = rb_intern("mesg");
+    ox_memo_id              = rb_intern("ox_memo");  // not an ivar name so it is hidden
+    ox_memo_key_id          = rb_intern("ox_memo_key");
+    ox_memo_cell_id         = rb_intern("ox_memo_cell");
     ox_message_id           = rb_intern("message");
     ox_nodes_id             = rb_intern("@nodes");
     ox_new_id               = rb_intern("new");
@@ -1443,6 +1922,7 @@ void Init_ox(void) {
     ox_readpartial_id       = rb_intern("readpartial");
     ox_start_element_id     = rb_intern("start_element");
     ox_string_id            = rb_intern("string");
+    ox_text_chunk_id        = rb_intern("text_chunk");
     ox_text_id              = rb_intern("text");
     ox_to_c_id              = rb_intern("to_c");
     ox_value_id             = rb_intern("value");
@@ -1481,14 +1961,26 @@ void Init_ox(void) {
     rb_gc_register_address(&auto_define_sym);
     auto_sym = ID2SYM(rb_intern("auto"));
     rb_gc_register_address(&auto_sym);
+    base64_sym = ID2SYM(rb_intern("base64"));
+    rb_gc_register_address(&base64_sym);
     block_sym = ID2SYM(rb_intern("block"));
     rb_gc_register_address(&block_sym);
+    chunk_size_sym = ID2SYM(rb_intern("chunk_size"));
+    rb_gc_register_address(&chunk_size_sym);
     circular_sym = ID2SYM(rb_intern("circular"));
     rb_gc_register_address(&circular_sym);
+    columns_sym = ID2SYM(rb_intern("columns"));
+    rb_gc_register_address(&columns_sym);
+    compact_sym = ID2SYM(rb_intern("compact"));
+    rb_gc_register_address(&compact_sym);
+    compressed_sym = ID2SYM(rb_intern("compressed"));
+    rb_gc_register_address(&compressed_sym);
     convert_special_sym = ID2SYM(rb_intern("convert_special"));
     rb_gc_register_address(&convert_special_sym);
     effort_sym = ID2SYM(rb_intern("effort"));
     rb_gc_register_address(&effort_sym);
+    element_sym = ID2SYM(rb_intern("element"));
+    rb_gc_register_address(&element_sym);
     element_key_mod_sym = ID2SYM(rb_intern("element_key_mod"));
     rb_gc_register_address(&element_key_mod_sym);
     generic_sym = ID2SYM(rb_intern("generic"));
@@ -1499,28 +1991,42 @@ void Init_ox(void) {
     rb_gc_register_address(&hash_sym);
     inactive_sym = ID2SYM(rb_intern("inactive"));
     rb_gc_register_address(&inactive_sym);
+    index_sym = ID2SYM(rb_intern("index"));
+    rb_gc_register_address(&index_sym);
     invalid_replace_sym = ID2SYM(rb_intern("invalid_replace"));
     rb_gc_register_address(&invalid_replace_sym);
+    key_sym = ID2SYM(rb_intern("key"));
+    rb_gc_register_address(&key_sym);
     limited_sym = ID2SYM(rb_intern("limited"));
     rb_gc_register_address(&limited_sym);
+    location_sym = ID2SYM(rb_intern("location"));
+    rb_gc_register_address(&location_sym);
     margin_sym = ID2SYM(rb_intern("margin"));
     rb_gc_register_address(&margin_sym);
     mode_sym = ID2SYM(rb_intern("mode"));
     rb_gc_register_address(&mode_sym);
     nest_ok_sym = ID2SYM(rb_intern("nest_ok"));
     rb_gc_register_address(&nest_ok_sym);
+    measure_sym = ID2SYM(rb_intern("measure"));
+    rb_gc_register_address(&measure_sym);
+    memoize_sym = ID2SYM(rb_intern("memoize"));
+    rb_gc_register_address(&memoize_sym);
     no_empty_sym = ID2SYM(rb_intern("no_empty"));
     rb_gc_register_address(&no_empty_sym);
     object_sym = ID2SYM(rb_intern("object"));
     rb_gc_register_address(&object_sym);
     off_sym = ID2SYM(rb_intern("off"));
     rb_gc_register_address(&off_sym);
+    parallel_sym = ID2SYM(rb_intern("parallel"));
+    rb_gc_register_address(&parallel_sym);
     opt_format_sym = ID2SYM(rb_intern("opt_format"));
     rb_gc_register_address(&opt_format_sym);
     optimized_sym = ID2SYM(rb_intern("optimized"));
     rb_gc_register_address(&optimized_sym);
     overlay_sym = ID2SYM(rb_intern("overlay"));
     rb_gc_register_address(&overlay_sym);
+    resume_sym = ID2SYM(rb_intern("resume"));
+    rb_gc_register_address(&resume_sym);
     ox_encoding_sym = ID2SYM(rb_intern("encoding"));
     rb_gc_register_address(&ox_encoding_sym);
     ox_indent_sym = ID2SYM(rb_intern("indent"));
@@ -1581,6 +2087,10 @@ void Init_ox(void) {
     ox_doctype_clas  = rb_const_get_at(Ox, rb_intern("DocType"));
     ox_cdata_clas    = rb_const_get_at(Ox, rb_intern("CData"));
     ox_bag_clas      = rb_const_get_at(Ox, rb_intern("Bag"));
+    rb_define_method(rb_const_get_at(Ox, rb_intern("Node")), "clear_memo", ox_clear_memo, 0);
+
+    ox_init_lazy(Ox);
+    ox_init_parser(Ox);
 
     // Classes can move in more recent versions so register them all.
     rb_gc_register_address(&Ox);
@@ -1616,6 +2126,7 @@ void Init_ox(void) {
     slot_cache_new(&ox_class_cache);
 
     ox_sax_define();
+    ox_hints_init();
     ox_hash_init();
 
 #if WITH_CACHE_TESTS
@@ -74,7 +74,15 @@ typedef enum {
 
 typedef enum { Yes = 'y', No = 'n', NotSet = 0 } YesNo;
 
-typedef enum { ObjMode = 'o', GenMode = 'g', LimMode = 'l', HashMode = 'h', HashNoAttrMode = 'n', NoMode = 0 } LoadMode;
+typedef enum {
+    ObjMode        = 'o',
+    GenMode        = 'g',
+    CompactMode    = 'c',
+    LimMode        = 'l',
+    HashMode       = 'h',
+    HashNoAttrMode = 'n',
+    NoMode         = 0
+} LoadMode;
 
 typedef enum {
     OffSkip = 'o',
@@ -122,6 +130,9 @@ typedef struct _options {
     char           convert_special;  // boolean true or false
     char           allow_invalid;    // YesNo
     char           no_empty;         // boolean - no empty elements when dumping
+    char           memoize;          // boolean - keep the dumped bytes of each element for reuse
+    char           parallel;         // threads for dumping long arrays, 0 or 1 for none
+    char           measure;          // boolean - measure a generic dump before writing it
     char           with_cdata;       // boolean - hash_load should include cdata
     char           inv_repl[12];     // max 10 valid characters, first character is the length
     char           strip_ns[64];     // namespace to strip, \0 is no-strip, \* is all, else only matches
@@ -150,12 +161,21 @@ struct _pInfo {
 };
 
 extern VALUE ox_parse(char *xml, size_t len, ParseCallbacks pcb, char **endp, Options options, Err err);
+extern VALUE ox_parse_with(PInfo pi, char *xml, size_t len, ParseCallbacks pcb, char **endp, Options options, Err err);
+extern void  ox_parse_load_options(VALUE ropts, Options copts);
+extern char *ox_defuse_bom(char *xml, Options options);
+extern void  ox_hash_start_element(PInfo pi, ID var, VALUE attrs);
+extern void  ox_hash_add_str(PInfo pi, VALUE s);
+extern void  ox_hash_end_element(PInfo pi, bool check_marked);
 extern void  _ox_raise_error(const char *msg, const char *xml, const char *current, const char *file, int line);
 
 extern void ox_sax_define(void);
 
-extern char *ox_write_obj_to_str(VALUE obj, Options copts);
+extern ParseCallbacks ox_load_callbacks(Options options);
+
+extern VALUE ox_write_obj_to_rstr(VALUE obj, Options copts);
 extern void  ox_write_obj_to_file(VALUE obj, const char *path, Options copts);
+extern VALUE ox_clear_memo(VALUE self);
 
 extern struct _options ox_default_options;
 
@@ -175,7 +195,9 @@ extern ID ox_attributes_id;
 extern ID ox_beg_id;
 extern ID ox_bigdecimal_id;
 extern ID ox_call_id;
+extern ID ox_cdata_chunk_id;
 extern ID ox_cdata_id;
+extern ID ox_columns_id;
 extern ID ox_comment_id;
 extern ID ox_den_id;
 extern ID ox_doctype_id;
@@ -192,7 +214,11 @@ extern ID ox_instruct_id;
 extern ID ox_jd_id;
 extern ID ox_keys_id;
 extern ID ox_local_id;
+extern ID ox_location_id;
 extern ID ox_mesg_id;
+extern ID ox_memo_id;
+extern ID ox_memo_key_id;
+extern ID ox_memo_cell_id;
 extern ID ox_message_id;
 extern ID ox_new_id;
 extern ID ox_nodes_id;
@@ -203,6 +229,7 @@ extern ID ox_read_id;
 extern ID ox_readpartial_id;
 extern ID ox_start_element_id;
 extern ID ox_string_id;
+extern ID ox_text_chunk_id;
 extern ID ox_text_id;
 extern ID ox_to_c_id;
 extern ID ox_value_id;
@@ -231,10 +258,15 @@ extern VALUE ox_comment_clas;
 extern VALUE ox_raw_clas;
 extern VALUE ox_doctype_clas;
 extern VALUE ox_cdata_clas;
+extern VALUE ox_lazy_element_clas;
 
 extern SlotCache ox_class_cache;
 
-extern void ox_init_builder(VALUE ox);
+extern void  ox_init_builder(VALUE ox);
+extern void  ox_init_lazy(VALUE ox);
+extern void  ox_init_parser(VALUE ox);
+extern VALUE ox_lazy_root(VALUE tape);
+extern VALUE ox_lazy_nodes(VALUE element);
 
 #if defined(__cplusplus)
 #if 0
@@ -138,10 +138,34 @@ static void mark_pi_cb(void *ptr) {
 VALUE
 ox_parse(char *xml, size_t len, ParseCallbacks pcb, char **endp, Options options, Err err) {
     struct _pInfo  pi;
-    int            body_read   = 0;
-    int            block_given = rb_block_given_p();
+    VALUE          obj;
     volatile VALUE wrap;
 
+    helper_stack_init(&pi.helpers);
+    pi.marked    = NULL;
+    pi.mark_size = 0;
+    // Protect against GC
+    wrap = TypedData_Wrap_Struct(rb_cObject, &ox_wrap_type, &pi);
+
+    obj = ox_parse_with(&pi, xml, len, pcb, endp, options, err);
+
+    DATA_PTR(wrap) = NULL;
+    helper_stack_cleanup(&pi.helpers);
+    xfree(pi.marked);
+
+    return obj;
+}
+
+/* Parses with parse info owned by the caller. The helper stack and marked
+ * array must already be initialized and are only reset here so whatever was
+ * allocated for them on an earlier parse is used again. Keeping the objects
+ * on the helper stack marked while parsing is also up to the caller.
+ */
+VALUE
+ox_parse_with(PInfo pi, char *xml, size_t len, ParseCallbacks pcb, char **endp, Options options, Err err) {
+    int body_read   = 0;
+    int block_given = rb_block_given_p();
+
     if (0 == xml) {
         set_error(err, "Invalid arg, xml string can not be null", xml, 0);
         return Qnil;
@@ -149,95 +173,81 @@ ox_parse(char *xml, size_t len, ParseCallbacks pcb, char **endp, Options options
     if (DEBUG <= options->trace) {
         printf("Parsing xml:\n%s\n", xml);
     }
-    // initialize parse info
-    helper_stack_init(&pi.helpers);
-    // Protect against GC
-    wrap = TypedData_Wrap_Struct(rb_cObject, &ox_wrap_type, &pi);
-
-    err_init(&pi.err);
-    pi.str        = xml;
-    pi.end        = pi.str + len;
-    pi.s          = xml;
-    pi.pcb        = pcb;
-    pi.obj        = Qnil;
-    pi.circ_array = 0;
-    pi.options    = options;
-    pi.marked     = NULL;
-    pi.mark_size  = 0;
-    pi.mark_cnt   = 0;
+    err_init(&pi->err);
+    pi->helpers.tail = pi->helpers.head;
+    pi->str          = xml;
+    pi->end          = pi->str + len;
+    pi->s            = xml;
+    pi->pcb          = pcb;
+    pi->obj          = Qnil;
+    pi->circ_array   = 0;
+    pi->options      = options;
+    pi->mark_cnt     = 0;
     while (1) {
-        next_non_white(&pi);  // skip white space
-        if ('\0' == *pi.s) {
+        next_non_white(pi);  // skip white space
+        if ('\0' == *pi->s) {
             break;
         }
         if (body_read && 0 != endp) {
-            *endp = pi.s;
+            *endp = pi->s;
             break;
         }
-        if ('<' != *pi.s) {  // all top level entities start with <
-            set_error(err, "invalid format, expected <", pi.str, pi.s);
-            helper_stack_cleanup(&pi.helpers);
+        if ('<' != *pi->s) {  // all top level entities start with <
+            set_error(err, "invalid format, expected <", pi->str, pi->s);
             return Qnil;
         }
-        pi.s++;  // past <
-        switch (*pi.s) {
+        pi->s++;  // past <
+        switch (*pi->s) {
         case '?':  // processing instruction
-            pi.s++;
-            read_instruction(&pi);
+            pi->s++;
+            read_instruction(pi);
             break;
         case '!':  // comment or doctype
-            pi.s++;
-            if ('\0' == *pi.s) {
-                set_error(err, "invalid format, DOCTYPE or comment not terminated", pi.str, pi.s);
-                helper_stack_cleanup(&pi.helpers);
+            pi->s++;
+            if ('\0' == *pi->s) {
+                set_error(err, "invalid format, DOCTYPE or comment not terminated", pi->str, pi->s);
                 return Qnil;
-            } else if ('-' == *pi.s) {
-                pi.s++;  // skip -
-                if ('-' != *pi.s) {
-                    set_error(err, "invalid format, bad comment format", pi.str, pi.s);
-                    helper_stack_cleanup(&pi.helpers);
+            } else if ('-' == *pi->s) {
+                pi->s++;  // skip -
+                if ('-' != *pi->s) {
+                    set_error(err, "invalid format, bad comment format", pi->str, pi->s);
                     return Qnil;
                 } else {
-                    pi.s++;  // skip second -
-                    read_comment(&pi);
+                    pi->s++;  // skip second -
+                    read_comment(pi);
                 }
-            } else if ((TolerantEffort == options->effort) ? 0 == strncasecmp("DOCTYPE", pi.s, 7)
-                                                           : 0 == strncmp("DOCTYPE", pi.s, 7)) {
-                pi.s += 7;
-                read_doctype(&pi);
+            } else if ((TolerantEffort == options->effort) ? 0 == strncasecmp("DOCTYPE", pi->s, 7)
+                                                           : 0 == strncmp("DOCTYPE", pi->s, 7)) {
+                pi->s += 7;
+                read_doctype(pi);
             } else {
-                set_error(err, "invalid format, DOCTYPE or comment expected", pi.str, pi.s);
-                helper_stack_cleanup(&pi.helpers);
+                set_error(err, "invalid format, DOCTYPE or comment expected", pi->str, pi->s);
                 return Qnil;
             }
             break;
         case '\0':
-            set_error(err, "invalid format, document not terminated", pi.str, pi.s);
-            helper_stack_cleanup(&pi.helpers);
+            set_error(err, "invalid format, document not terminated", pi->str, pi->s);
             return Qnil;
         default:
-            read_element(&pi);
+            read_element(pi);
             body_read = 1;
             break;
         }
-        if (err_has(&pi.err)) {
-            *err = pi.err;
-            helper_stack_cleanup(&pi.helpers);
+        if (err_has(&pi->err)) {
+            *err = pi->err;
             return Qnil;
         }
-        if (block_given && Qnil != pi.obj && Qundef != pi.obj) {
+        if (block_given && Qnil != pi->obj && Qundef != pi->obj) {
             if (NULL != pcb->finish) {
-                pcb->finish(&pi);
+                pcb->finish(pi);
             }
-            rb_yield(pi.obj);
+            rb_yield(pi->obj);
         }
     }
-    DATA_PTR(wrap) = NULL;
-    helper_stack_cleanup(&pi.helpers);
     if (NULL != pcb->finish) {
-        pcb->finish(&pi);
+        pcb->finish(pi);
     }
-    return pi.obj;
+    return pi->obj;
 }
 
 // Entered after the "<?" sequence. Ready to read the rest.
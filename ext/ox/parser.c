@@ -0,0 +1,235 @@
+/* parser.c
+ * Copyright (c) 2011, Peter Ohler
+ * All rights reserved.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err.h"
+#include "helper.h"
+#include "ox.h"
+#include "ruby.h"
+#include "ruby/encoding.h"
+
+// A document bigger than this is still copied into the parser buffer but the
+// buffer is released after the parse so one large document does not hold on
+// to the memory.
+#define PARSER_KEEP_MAX 0x00100000
+
+extern ParseCallbacks ox_obj_callbacks;
+extern ParseCallbacks ox_gen_callbacks;
+
+// A parser holds what Ox.load() sets up on every call. The options Hash is
+// walked once when the parser is created. The parse info, with its helper
+// stack and marked array, and the buffer the document is copied into are
+// kept from one parse to the next and only reset at the start of each.
+typedef struct _parser {
+    struct _options options;
+    struct _pInfo   pi;
+    rb_encoding    *rb_enc;  // from the :encoding option or NULL to use that of the document
+    char           *buf;
+    size_t          size;
+    bool            busy;
+} *Parser;
+
+typedef struct _parseArgs {
+    Parser         p;
+    VALUE          xml;
+    ParseCallbacks pcb;
+    Err            err;
+    bool           gc_off;  // GC was disabled for an object mode parse
+} *ParseArgs;
+
+static VALUE parser_class = Qundef;
+
+static void parser_mark(void *ptr) {
+    Parser p = (Parser)ptr;
+    Helper h;
+
+    if (NULL == p) {
+        return;
+    }
+    rb_gc_mark(p->options.attr_key_mod);
+    rb_gc_mark(p->options.element_key_mod);
+    rb_gc_mark(p->pi.obj);
+    // Unlike the parse info used by ox_parse() this one is not on the stack
+    // so every helper is marked and not only those with a type.
+    for (h = p->pi.helpers.head; h < p->pi.helpers.tail; h++) {
+        rb_gc_mark(h->obj);
+    }
+}
+
+static void parser_free(void *ptr) {
+    Parser p = (Parser)ptr;
+
+    if (NULL != p) {
+        helper_stack_cleanup(&p->pi.helpers);
+        xfree(p->pi.marked);
+        xfree(p->buf);
+        xfree(p);
+    }
+}
+
+static const rb_data_type_t ox_parser_type = {
+    "Ox/Parser",
+    {
+        parser_mark,
+        parser_free,
+        NULL,
+    },
+    0,
+    0,
+};
+
+static VALUE parse_body(VALUE x) {
+    ParseArgs pa  = (ParseArgs)x;
+    Parser    p   = pa->p;
+    size_t    len = (size_t)RSTRING_LEN(pa->xml);
+    char     *xml;
+    VALUE     obj;
+
+    // The parse is destructive so the document is copied.
+    if (p->size <= len) {
+        REALLOC_N(p->buf, char, len + 1);
+        p->size = len + 1;
+    }
+    memcpy(p->buf, RSTRING_PTR(pa->xml), len);
+    p->buf[len] = '\0';
+    // A BOM or an encoding in the prolog changes the encoding so it is set
+    // again for each document.
+    p->options.rb_enc = (NULL == p->rb_enc) ? rb_enc_get(pa->xml) : p->rb_enc;
+    xml               = ox_defuse_bom(p->buf, &p->options);
+    if (ox_obj_callbacks == pa->pcb) {
+        // Enabled again in parse_ensure() even if the parse raises.
+        rb_gc_disable();
+        pa->gc_off = true;
+    }
+    obj = ox_parse_with(&p->pi, xml, len - (xml - p->buf), pa->pcb, 0, &p->options, pa->err);
+
+    return obj;
+}
+
+static VALUE parse_ensure(VALUE x) {
+    ParseArgs pa = (ParseArgs)x;
+    Parser    p  = pa->p;
+
+    p->pi.helpers.tail = p->pi.helpers.head;
+    p->pi.obj          = Qnil;
+    if (PARSER_KEEP_MAX < p->size) {
+        xfree(p->buf);
+        p->buf  = NULL;
+        p->size = 0;
+    }
+    if (pa->gc_off) {
+        rb_gc_enable();
+    }
+    p->busy = false;
+
+    return Qnil;
+}
+
+static VALUE parse(VALUE self, VALUE xml, ParseCallbacks pcb) {
+    Parser            p = (Parser)DATA_PTR(self);
+    struct _parseArgs pa;
+    struct _err       err;
+    VALUE             obj;
+
+    Check_Type(xml, T_STRING);
+    if (p->busy) {
+        rb_raise(ox_arg_error_class, "Ox::Parser is already parsing a document.\n");
+    }
+    err_init(&err);
+    pa.p      = p;
+    pa.xml    = xml;
+    pa.pcb    = pcb;
+    pa.err    = &err;
+    pa.gc_off = false;
+    p->busy   = true;
+    obj       = rb_ensure(parse_body, (VALUE)&pa, parse_ensure, (VALUE)&pa);
+    if (err_has(&err)) {
+        ox_err_raise(&err);
+    }
+    return obj;
+}
+
+/* call-seq: new(options)
+ *
+ * Creates a parser that can be used over and over to parse documents with
+ * the same options. The options are read once when the parser is created
+ * and the stacks and buffers used while parsing are kept between documents
+ * so there is much less setup for each document than with Ox.load().
+ * - +options+ [Hash] the same options as Ox.load()
+ */
+static VALUE parser_new(int argc, VALUE *argv, VALUE self) {
+    Parser p;
+    VALUE  parser;
+
+    if (1 < argc) {
+        rb_raise(ox_arg_error_class, "Wrong number of arguments to Ox::Parser.new.\n");
+    }
+    parser                = TypedData_Make_Struct(parser_class, struct _parser, &ox_parser_type, p);
+    p->options            = ox_default_options;
+    p->options.html_hints = NULL;
+    p->pi.obj             = Qnil;
+    helper_stack_init(&p->pi.helpers);
+    if (1 == argc && Qnil != *argv) {
+        Check_Type(*argv, T_HASH);
+        ox_parse_load_options(*argv, &p->options);
+    }
+    if ('\0' != *p->options.encoding) {
+        if (NULL == p->options.rb_enc) {
+            p->options.rb_enc = rb_enc_find(p->options.encoding);
+        }
+        p->rb_enc = p->options.rb_enc;
+    }
+    return parser;
+}
+
+/* call-seq: parse(xml) => Ox::Document or Ox::Element
+ *
+ * Parses an XML document String into an Ox::Document or Ox::Element like
+ * Ox.parse() but with the options of the parser. The :mode option is
+ * ignored.
+ * - +xml+ [String] XML String
+ *
+ * _raise_ [Exception] if the XML is malformed.
+ */
+static VALUE parser_parse(VALUE self, VALUE xml) {
+    return parse(self, xml, ox_gen_callbacks);
+}
+
+/* call-seq: load(xml) => Ox::Document or Ox::Element or Object
+ *
+ * Parses an XML document String just as Ox.load() would with the options of
+ * the parser. If a block is given it is called with each top level entity.
+ * - +xml+ [String] XML String
+ */
+static VALUE parser_load(VALUE self, VALUE xml) {
+    Parser p = (Parser)DATA_PTR(self);
+
+    return parse(self, xml, ox_load_callbacks(&p->options));
+}
+
+/* Document-class: Ox::Parser
+ *
+ * A parser for loading many documents with the same options. A parser is
+ * not safe to share between threads.
+ *
+ *   parser = Ox::Parser.new(mode: :hash, symbolize_keys: false)
+ *   messages.each { |xml| handle(parser.load(xml)) }
+ */
+void ox_init_parser(VALUE ox) {
+#if 0
+    // Just for rdoc.
+    ox = rb_define_module("Ox");
+#endif
+    parser_class = rb_define_class_under(ox, "Parser", rb_cObject);
+    rb_gc_register_address(&parser_class);
+    rb_undef_alloc_func(parser_class);
+
+    rb_define_module_function(parser_class, "new", parser_new, -1);
+    rb_define_method(parser_class, "parse", parser_parse, 1);
+    rb_define_method(parser_class, "load", parser_load, 1);
+}
@@ -5,6 +5,8 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -42,7 +44,8 @@
 
 #define UTF8_STR "UTF-8"
 
-static void sax_drive_init(SaxDrive dr, VALUE handler, VALUE io, SaxOptions options);
+#define CHECKPOINT_MAGIC "OXC1"
+
 static void parse(SaxDrive dr);
 // All read functions should return the next character after the 'thing' that was read and leave dr->cur one after that.
 static char read_instruction(SaxDrive dr);
@@ -62,6 +65,9 @@ static Nv   hint_try_close(SaxDrive dr, const char *name);
 
 VALUE ox_sax_value_class = Qnil;
 
+static ID drives_id = 0;
+static ID seek_id  = 0;
+
 const rb_data_type_t ox_sax_value_type = {
     "Ox/Sax/Value",
     {
@@ -73,8 +79,17 @@ const rb_data_type_t ox_sax_value_type = {
     0,
 };
 
+void ox_sax_drive_parse(SaxDrive dr) {
+    parse(dr);
+    if (0 < dr->col_cnt && sax_has(dr, ColumnsCall)) {
+        VALUE arg = ox_sax_columns_value(dr);
+
+        sax_call(dr, ColumnsCall, 1, &arg);
+    }
+}
+
 static VALUE protect_parse(VALUE drp) {
-    parse((SaxDrive)drp);
+    ox_sax_drive_parse((SaxDrive)drp);
 
     return Qnil;
 }
@@ -98,8 +113,12 @@ void ox_sax_parse(VALUE handler, VALUE io, SaxOptions options) {
     struct _saxDrive dr;
     int              line = 0;
 
-    sax_drive_init(&dr, handler, io, options);
+    ox_sax_drive_init(&dr, handler, io, options);
+    rb_gc_register_address(&dr.value_obj);
+    ox_sax_drive_attach(dr.value_obj);
     rb_protect(protect_parse, (VALUE)&dr, &line);
+    ox_sax_drive_detach(dr.value_obj);
+    rb_gc_unregister_address(&dr.value_obj);
     ox_sax_drive_cleanup(&dr);
     if (0 != line) {
         rb_jump_tag(line);
@@ -121,6 +140,290 @@ static void set_col(VALUE handler, long col) {
     rb_ivar_set(handler, ox_at_column_id, LONG2NUM(col));
 }
 
+// The location is always kept on the drive for Ox::Sax#location. The
+// @pos, @line, and @column handler variables are only set if defined.
+static inline void set_loc(SaxDrive dr, long pos, long line, long col) {
+    dr->loc_pos  = pos;
+    dr->loc_line = line;
+    dr->loc_col  = col;
+    dr->set_pos(dr->handler, pos);
+    dr->set_line(dr->handler, line);
+    dr->set_col(dr->handler, col);
+}
+
+// Marks the end of the element about to be closed as a point the parse can
+// resume from. It is cleared once the end_element() callback returns.
+static inline void set_ckpt(SaxDrive dr, off_t pos, off_t line, off_t col) {
+    dr->ckpt_pos  = (long)pos;
+    dr->ckpt_line = (long)line;
+    dr->ckpt_col  = (long)col;
+}
+
+// Overlays live in a per-parse byte array indexed by hint id.
+static inline Overlay overlay_of(SaxDrive dr, Hint h) {
+    return hint_overlay(dr->options.hints, h);
+}
+
+// Element callbacks are made for elements without a hint or with an active
+// or nest-ok overlay.
+static inline bool hint_active(SaxDrive dr, Hint h) {
+    Overlay ov;
+
+    if (NULL == h) {
+        return true;
+    }
+    ov = overlay_of(dr, h);
+
+    return ActiveOverlay == ov || NestOverlay == ov;
+}
+
+/* The drives of the parses running on the current fiber are found through a
+ * fiber local Array of the objects that own them, the drive's value object
+ * for Ox.sax_parse() or the Ox::Sax::Parser. The handler itself is not
+ * changed so a parse nested in a callback on the same handler does not
+ * disturb the outer one.
+ */
+void ox_sax_drive_attach(VALUE owner) {
+    volatile VALUE drives;
+
+    if (0 == drives_id) {
+        drives_id = rb_intern("ox_sax_drives");
+    }
+    drives = rb_thread_local_aref(rb_thread_current(), drives_id);
+    if (Qnil == drives) {
+        drives = rb_ary_new();
+        rb_thread_local_aset(rb_thread_current(), drives_id, drives);
+    }
+    rb_ary_push(drives, owner);
+}
+
+void ox_sax_drive_detach(VALUE owner) {
+    volatile VALUE drives = rb_thread_local_aref(rb_thread_current(), drives_id);
+    long           i;
+
+    if (Qnil == drives) {
+        return;
+    }
+    for (i = RARRAY_LEN(drives) - 1; 0 <= i; i--) {
+        if (owner == RARRAY_AREF(drives, i)) {
+            rb_ary_delete_at(drives, i);
+            break;
+        }
+    }
+}
+
+// Returns the innermost drive parsing for the handler or NULL if not in a
+// parse.
+static SaxDrive attached_drive(VALUE self) {
+    volatile VALUE drives;
+    VALUE          owner;
+    SaxDrive       dr;
+    long           i;
+
+    if (0 == drives_id || Qnil == (drives = rb_thread_local_aref(rb_thread_current(), drives_id))) {
+        return NULL;
+    }
+    for (i = RARRAY_LEN(drives) - 1; 0 <= i; i--) {
+        owner = RARRAY_AREF(drives, i);
+        if (rb_typeddata_is_kind_of(owner, &ox_sax_value_type)) {
+            dr = (SaxDrive)DATA_PTR(owner);
+        } else {
+            dr = ox_sax_parser_drive(owner);
+        }
+        if (NULL != dr && self == dr->handler) {
+            return dr;
+        }
+    }
+    return NULL;
+}
+
+/* call-seq: location()
+ *
+ * Returns the location of the current callback as an Array of [pos, line,
+ * column] or nil if the handler is not being used in a parse. The line and
+ * column are zero if the parse was started with the :location option false.
+ * This avoids the cost of setting the @pos, @line, and @column variables on
+ * every callback when the location is only needed occasionally such as when
+ * reporting an error.
+ */
+VALUE
+ox_sax_location(VALUE self) {
+    SaxDrive dr = attached_drive(self);
+
+    if (NULL == dr) {
+        return Qnil;
+    }
+    return rb_ary_new3(3, LONG2NUM(dr->loc_pos), LONG2NUM(dr->loc_line), LONG2NUM(dr->loc_col));
+}
+
+static void cat_u64(VALUE str, uint64_t n) {
+    char b[8];
+    int  i;
+
+    for (i = 0; i < 8; i++) {
+        b[i] = (char)(n >> (i * 8));
+    }
+    rb_str_cat(str, b, sizeof(b));
+}
+
+/* call-seq: checkpoint()
+ *
+ * Returns the state needed to resume the parse just after the element being
+ * closed or nil if not called from end_element(). The state is a binary
+ * String that holds the byte offset, line, column, encoding, and the names
+ * of the open elements. Passing it as the :resume option to Ox.sax_parse()
+ * with the same document continues from that point.
+ */
+VALUE
+ox_sax_checkpoint(VALUE self) {
+    SaxDrive       dr = attached_drive(self);
+    volatile VALUE state;
+    const char    *enc;
+    const char    *name;
+    size_t         len;
+    Nv             nv;
+
+    if (NULL == dr || 0 > dr->ckpt_pos) {
+        return Qnil;
+    }
+    enc   = (NULL == dr->encoding) ? "" : rb_enc_name(dr->encoding);
+    state = rb_str_buf_new(64 + (dr->stack.tail - dr->stack.head) * 16);
+    rb_str_cat(state, CHECKPOINT_MAGIC, 4);
+    cat_u64(state, (uint64_t)dr->ckpt_pos);
+    cat_u64(state, (uint64_t)dr->ckpt_line);
+    cat_u64(state, (uint64_t)dr->ckpt_col);
+    len = strlen(enc);
+    cat_u64(state, (uint64_t)len);
+    rb_str_cat(state, enc, len);
+    cat_u64(state, (uint64_t)(dr->stack.tail - dr->stack.head));
+    for (nv = dr->stack.head; nv < dr->stack.tail; nv++) {
+        name = nv_name(nv);
+        len  = strlen(name);
+        cat_u64(state, (uint64_t)nv->childCnt);
+        cat_u64(state, (uint64_t)len);
+        rb_str_cat(state, name, len);
+    }
+    rb_enc_associate(state, rb_ascii8bit_encoding());
+
+    return state;
+}
+
+typedef struct _stateRd {
+    const char *s;
+    const char *end;
+} *StateRd;
+
+static const char *state_take(StateRd rd, uint64_t n) {
+    const char *s = rd->s;
+
+    if ((uint64_t)(rd->end - rd->s) < n) {
+        rb_raise(ox_arg_error_class, "Invalid :resume state.\n");
+    }
+    rd->s += n;
+
+    return s;
+}
+
+static uint64_t state_u64(StateRd rd) {
+    const unsigned char *b = (const unsigned char *)state_take(rd, 8);
+    uint64_t             n = 0;
+    int                  i;
+
+    for (i = 7; 0 <= i; i--) {
+        n = (n << 8) | b[i];
+    }
+    return n;
+}
+
+static off_t state_pos(VALUE state) {
+    struct _stateRd rd = {RSTRING_PTR(state), RSTRING_PTR(state) + RSTRING_LEN(state)};
+
+    if (0 != memcmp(state_take(&rd, 4), CHECKPOINT_MAGIC, 4)) {
+        rb_raise(ox_arg_error_class, "Invalid :resume state.\n");
+    }
+    return (off_t)state_u64(&rd);
+}
+
+// Restores the position, encoding, and open elements saved by checkpoint().
+// Hints and blocked overlays are looked up again from the element names.
+// With a NULL drive the state is only checked so nothing is left half set up
+// if it is not valid.
+static void resume_state(SaxDrive dr, VALUE io, VALUE state) {
+    struct _stateRd rd = {RSTRING_PTR(state) + 4, RSTRING_PTR(state) + RSTRING_LEN(state)};
+    const char     *name;
+    char            enc[64];
+    uint64_t        len;
+    uint64_t        cnt;
+    off_t           pos  = (off_t)state_u64(&rd);
+    off_t           line = (off_t)state_u64(&rd);
+    off_t           col  = (off_t)state_u64(&rd);
+    int             child_cnt;
+    Hint            h;
+
+    if (sizeof(enc) <= (len = state_u64(&rd))) {
+        rb_raise(ox_arg_error_class, "Invalid :resume state.\n");
+    }
+    memcpy(enc, state_take(&rd, len), len);
+    enc[len] = '\0';
+    if (NULL == dr) {
+        for (cnt = state_u64(&rd); 0 < cnt; cnt--) {
+            state_take(&rd, 8);
+            state_take(&rd, state_u64(&rd));
+        }
+        return;
+    }
+    dr->buf.pos  = pos;
+    dr->buf.line = line;
+    dr->buf.col  = col;
+    if (T_STRING == rb_type(io)) {
+        dr->buf.in.str += pos;
+    }
+    if ('\0' != *enc) {
+        dr->encoding = rb_enc_find(enc);
+    }
+    for (cnt = state_u64(&rd); 0 < cnt; cnt--) {
+        child_cnt = (int)state_u64(&rd);
+        len       = state_u64(&rd);
+        name      = state_take(&rd, len);
+        h         = NULL;
+        if (NULL != dr->options.hints) {
+            char *n = ox_strndup(name, len);
+
+            h = ox_hint_find(dr->options.hints, n);
+            xfree(n);
+            if (NULL != h && BlockOverlay == overlay_of(dr, h)) {
+                dr->blocked++;
+            }
+        }
+        stack_push(&dr->stack, name, len, str2sym(dr, name, len, NULL), h);
+        dr->stack.tail[-1].childCnt = child_cnt;
+    }
+}
+
+// Moves the input to the checkpoint before the read buffer is set up. A
+// String is advanced in resume_state() instead.
+static void resume_seek(VALUE io, SaxOptions options) {
+    off_t pos = state_pos(options->resume);
+
+    resume_state(NULL, io, options->resume);
+    if (options->compressed) {
+        rb_raise(ox_arg_error_class, ":resume can not be used with :compressed input.\n");
+    }
+    if (T_STRING == rb_type(io)) {
+        if (RSTRING_LEN(io) < pos) {
+            rb_raise(ox_arg_error_class, ":resume state is past the end of the String.\n");
+        }
+        return;
+    }
+    if (0 == seek_id) {
+        seek_id = rb_intern("seek");
+    }
+    if (!rb_respond_to(io, seek_id)) {
+        rb_raise(ox_arg_error_class, ":resume requires an IO that responds to seek().\n");
+    }
+    rb_funcall(io, seek_id, 1, OFFT2NUM(pos));
+}
+
 static void attr_noop(SaxDrive dr, VALUE name, char *value, long pos, long line, long col) {
 }
 
@@ -135,28 +438,24 @@ static void attr_text(SaxDrive dr, VALUE name, char *value, long pos, long line,
     if (0 != dr->encoding) {
         rb_enc_associate(args[1], dr->encoding);
     }
-    dr->set_pos(dr->handler, pos);
-    dr->set_line(dr->handler, line);
-    dr->set_col(dr->handler, col);
-    rb_funcall2(dr->handler, ox_attr_id, 2, args);
+    set_loc(dr, pos, line, col);
+    sax_call(dr, AttrCall, 2, args);
 }
 
 static void attr_value(SaxDrive dr, VALUE name, char *value, long pos, long line, long col) {
     VALUE args[2];
 
-    dr->set_pos(dr->handler, pos);
-    dr->set_line(dr->handler, line);
-    dr->set_col(dr->handler, col);
+    set_loc(dr, pos, line, col);
     args[0] = name;
     args[1] = dr->value_obj;
-    rb_funcall2(dr->handler, ox_attr_value_id, 2, args);
+    sax_call(dr, AttrValueCall, 2, args);
 }
 
-static void attrs_done_noop(VALUE handler) {
+static void attrs_done_noop(SaxDrive dr) {
 }
 
-static void attrs_done(VALUE handler) {
-    rb_funcall(handler, ox_attrs_done_id, 0);
+static void attrs_done(SaxDrive dr) {
+    sax_call(dr, AttrsDoneCall, 0, NULL);
 }
 
 static VALUE instruct_noop(SaxDrive dr, const char *target, long pos, long line, long col) {
@@ -166,10 +465,8 @@ static VALUE instruct_noop(SaxDrive dr, const char *target, long pos, long line,
 static VALUE instruct(SaxDrive dr, const char *target, long pos, long line, long col) {
     VALUE arg = rb_str_new2(target);
 
-    dr->set_pos(dr->handler, pos);
-    dr->set_line(dr->handler, line);
-    dr->set_col(dr->handler, col);
-    rb_funcall(dr->handler, ox_instruct_id, 1, arg);
+    set_loc(dr, pos, line, col);
+    sax_call(dr, InstructCall, 1, &arg);
 
     return arg;
 }
@@ -182,10 +479,8 @@ static void end_instruct_noop(SaxDrive dr, VALUE target, long pos, long line, lo
 }
 
 static void end_instruct(SaxDrive dr, VALUE target, long pos, long line, long col) {
-    dr->set_pos(dr->handler, pos);
-    dr->set_line(dr->handler, line);
-    dr->set_col(dr->handler, col);
-    rb_funcall(dr->handler, ox_end_instruct_id, 1, target);
+    set_loc(dr, pos, line, col);
+    sax_call(dr, EndInstructCall, 1, &target);
 }
 
 static void dr_loc_noop(SaxDrive dr, long pos, long line, long col) {
@@ -196,17 +491,15 @@ static void comment(SaxDrive dr, long pos, long line, long col) {
         Nv   parent = stack_peek(&dr->stack);
         Hint h      = ox_hint_find(dr->options.hints, "!--");
 
-        if (NULL == parent || NULL == parent->hint || OffOverlay != parent->hint->overlay ||
-            (NULL != h && (ActiveOverlay == h->overlay || ActiveOverlay == h->overlay))) {
+        if (NULL == parent || NULL == parent->hint || OffOverlay != overlay_of(dr, parent->hint) ||
+            (NULL != h && ActiveOverlay == overlay_of(dr, h))) {
             VALUE arg = rb_str_new2(dr->buf.str);
 
             if (0 != dr->encoding) {
                 rb_enc_associate(arg, dr->encoding);
             }
-            dr->set_pos(dr->handler, pos);
-            dr->set_line(dr->handler, line);
-            dr->set_col(dr->handler, col);
-            rb_funcall(dr->handler, ox_comment_id, 1, arg);
+            set_loc(dr, pos, line, col);
+            sax_call(dr, CommentCall, 1, &arg);
         }
     }
 }
@@ -214,24 +507,107 @@ static void comment(SaxDrive dr, long pos, long line, long col) {
 static void cdata(SaxDrive dr, long pos, long line, long col) {
     Nv parent = stack_peek(&dr->stack);
 
-    if (!dr->blocked && (NULL == parent || NULL == parent->hint || OffOverlay != parent->hint->overlay)) {
+    if (!dr->blocked && (NULL == parent || NULL == parent->hint || OffOverlay != overlay_of(dr, parent->hint))) {
         VALUE arg = rb_str_new2(dr->buf.str);
 
         if (0 != dr->encoding) {
             rb_enc_associate(arg, dr->encoding);
         }
-        dr->set_pos(dr->handler, pos);
-        dr->set_line(dr->handler, line);
-        dr->set_col(dr->handler, col);
-        rb_funcall(dr->handler, ox_cdata_id, 1, arg);
+        set_loc(dr, pos, line, col);
+        sax_call(dr, CdataCall, 1, &arg);
+    }
+}
+
+static inline bool node_wanted(SaxDrive dr, Nv parent) {
+    return !dr->blocked && (NULL == parent || NULL == parent->hint || OffOverlay != overlay_of(dr, parent->hint));
+}
+
+// Returns the point at or before end where a piece of a long node can stop
+// without splitting a character reference, a \r\n pair, or a UTF-8
+// character. Named references are no longer than the 16 characters
+// ox_sax_collapse_special() looks at.
+static char *chunk_cut(SaxDrive dr, char *str, char *end, bool refs) {
+    char   *cut = end;
+    char   *s;
+    uint8_t b;
+
+    if (refs) {
+        for (s = end - 1; str <= s && end - s <= 16 && ';' != *s; s--) {
+            if ('&' == *s) {
+                cut = s;
+                break;
+            }
+        }
+    }
+    if (str < cut && '\r' == cut[-1]) {
+        cut--;
+    }
+    if (dr->utf8) {
+        for (s = cut - 1; str <= s && cut - s < 4 && 0x80 == (0xC0 & (uint8_t)*s); s--) {
+        }
+        if (str <= s && 0xC0 <= (b = (uint8_t)*s) && cut - s < ((0xE0 > b) ? 2 : (0xF0 > b) ? 3 : 4)) {
+            cut = s;
+        }
+    }
+    return cut;
+}
+
+// Delivers the text from dr->buf.str to cut as one piece of a text node.
+// Character references and the skip mode are applied to each piece on its
+// own. When white space is collapsed a piece that starts with a space after
+// one that ended with a space drops it so a run across pieces is still a
+// single space.
+static void text_chunk(SaxDrive dr, char *cut, bool final, bool *spc, long pos, long line, long col) {
+    VALUE args[2];
+    char  save = *cut;
+    char *s    = dr->buf.str;
+
+    *cut = '\0';
+    if (dr->options.convert_special) {
+        ox_sax_collapse_special(dr, s, pos, line, col);
+    }
+    switch (dr->options.skip) {
+    case CrSkip: buf_collapse_return(s); break;
+    case SpcSkip:
+        buf_collapse_white(s);
+        if (*spc && ' ' == *s) {
+            s++;
+        }
+        if ('\0' != *s) {
+            *spc = (' ' == s[strlen(s) - 1]);
+        }
+        break;
+    default: break;
+    }
+    args[0] = rb_str_new2(s);
+    *cut    = save;
+    if (0 != dr->encoding) {
+        rb_enc_associate(args[0], dr->encoding);
+    }
+    args[1] = final ? Qtrue : Qfalse;
+    set_loc(dr, pos, line, col);
+    sax_call(dr, TextChunkCall, 2, args);
+}
+
+static void cdata_chunk(SaxDrive dr, char *cut, bool final, long pos, long line, long col) {
+    VALUE args[2];
+
+    if (node_wanted(dr, stack_peek(&dr->stack))) {
+        args[0] = rb_str_new(dr->buf.str, cut - dr->buf.str);
+        if (0 != dr->encoding) {
+            rb_enc_associate(args[0], dr->encoding);
+        }
+        args[1] = final ? Qtrue : Qfalse;
+        set_loc(dr, pos, line, col);
+        sax_call(dr, CdataChunkCall, 2, args);
     }
 }
 
 static void doctype(SaxDrive dr, long pos, long line, long col) {
-    dr->set_pos(dr->handler, pos);
-    dr->set_line(dr->handler, line);
-    dr->set_col(dr->handler, col);
-    rb_funcall(dr->handler, ox_doctype_id, 1, rb_str_new2(dr->buf.str));
+    VALUE arg = rb_str_new2(dr->buf.str);
+
+    set_loc(dr, pos, line, col);
+    sax_call(dr, DoctypeCall, 1, &arg);
 }
 
 static void error_noop(SaxDrive dr, const char *msg, long pos, long line, long col) {
@@ -243,65 +619,130 @@ static void error(SaxDrive dr, const char *msg, long pos, long line, long col) {
     args[0] = rb_str_new2(msg);
     args[1] = LONG2NUM(line);
     args[2] = LONG2NUM(col);
-    dr->set_pos(dr->handler, pos);
-    dr->set_line(dr->handler, line);
-    dr->set_col(dr->handler, col);
-    rb_funcall2(dr->handler, ox_error_id, 3, args);
+    set_loc(dr, pos, line, col);
+    sax_call(dr, ErrorCall, 3, args);
 }
 
 static void end_element_cb(SaxDrive dr, VALUE name, long pos, long line, long col, Hint h) {
-    if (dr->has_end_element && 0 >= dr->blocked &&
-        (NULL == h || ActiveOverlay == h->overlay || NestOverlay == h->overlay)) {
-        dr->set_pos(dr->handler, pos);
-        dr->set_line(dr->handler, line);
-        dr->set_col(dr->handler, col);
-        rb_funcall(dr->handler, ox_end_element_id, 1, name);
-    }
-    if (NULL != h && BlockOverlay == h->overlay && 0 < dr->blocked) {
+    if (dr->has_end_element && 0 >= dr->blocked && hint_active(dr, h)) {
+        set_loc(dr, pos, line, col);
+        sax_call(dr, EndElementCall, 1, &name);
+    }
+    dr->ckpt_pos = -1;
+    if (NULL != h && BlockOverlay == overlay_of(dr, h) && 0 < dr->blocked) {
         dr->blocked--;
     }
 }
 
-static void sax_drive_init(SaxDrive dr, VALUE handler, VALUE io, SaxOptions options) {
+static bool resolve_call(SaxDrive dr, SaxCallType type, ID id) {
+    SaxCall call = dr->calls + type;
+
+    call->recv  = Qundef;
+    call->id    = id;
+    call->proc  = false;
+    call->cfunc = NULL;
+    if (T_HASH == rb_type(dr->handler)) {
+        VALUE cb = rb_hash_lookup(dr->handler, ID2SYM(id));
+
+        if (Qnil == cb) {
+            return false;
+        }
+        if (rb_obj_is_proc(cb)) {
+            call->proc = true;
+        } else if (rb_respond_to(cb, ox_call_id)) {
+            call->id = ox_call_id;
+        } else {
+            rb_raise(ox_arg_error_class, "SAX handler Hash value for :%s must respond to call().\n", rb_id2name(id));
+        }
+        call->recv = cb;
+    } else if (rb_respond_to(dr->handler, id)) {
+        call->recv = dr->handler;
+    }
+    return (Qundef != call->recv);
+}
+
+// Each callback is resolved once here so the parse does not have to probe
+// the handler again. A Hash handler maps callback names to Procs.
+static void resolve_calls(SaxDrive dr) {
+    resolve_call(dr, InstructCall, ox_instruct_id);
+    resolve_call(dr, EndInstructCall, ox_end_instruct_id);
+    resolve_call(dr, AttrCall, ox_attr_id);
+    resolve_call(dr, AttrValueCall, ox_attr_value_id);
+    resolve_call(dr, AttrsDoneCall, ox_attrs_done_id);
+    resolve_call(dr, DoctypeCall, ox_doctype_id);
+    resolve_call(dr, CommentCall, ox_comment_id);
+    resolve_call(dr, CdataCall, ox_cdata_id);
+    resolve_call(dr, CdataChunkCall, ox_cdata_chunk_id);
+    resolve_call(dr, TextCall, ox_text_id);
+    resolve_call(dr, TextChunkCall, ox_text_chunk_id);
+    resolve_call(dr, ValueCall, ox_value_id);
+    resolve_call(dr, StartElementCall, ox_start_element_id);
+    resolve_call(dr, EndElementCall, ox_end_element_id);
+    resolve_call(dr, ErrorCall, ox_error_id);
+    resolve_call(dr, AbortCall, ox_abort_id);
+    resolve_call(dr, ColumnsCall, ox_columns_id);
+    ox_sax_extract_resolve(dr);
+}
+
+// The caller is responsible for keeping dr->value_obj alive.
+void ox_sax_drive_init(SaxDrive dr, VALUE handler, VALUE io, SaxOptions options) {
+    // Resolve first as a bad Hash handler raises.
+    dr->handler = handler;
+    resolve_calls(dr);
+    ox_sax_columns_init(dr, options->columns);
+    ox_sax_sinks_init(dr, options->sinks);
+    if (Qnil != options->resume) {
+        resume_seek(io, options);
+    }
     ox_sax_buf_init(&dr->buf, io);
     dr->buf.dr = dr;
+    if (options->compressed) {
+        ox_sax_buf_inflate(&dr->buf, io);
+    }
     stack_init(&dr->stack);
-    dr->handler   = handler;
     dr->value_obj = TypedData_Wrap_Struct(ox_sax_value_class, &ox_sax_value_type, dr);
-    rb_gc_register_address(&dr->value_obj);
-    dr->options = *options;
-    dr->err     = 0;
-    dr->blocked = 0;
-    dr->abort   = false;
+    dr->options   = *options;
+    dr->err       = 0;
+    dr->blocked   = 0;
+    dr->abort     = false;
+    dr->loc_pos   = 0;
+    dr->loc_line  = 0;
+    dr->loc_col   = 0;
+    dr->ckpt_pos  = -1;
+    if (!options->location) {
+        dr->buf.line   = 0;
+        dr->buf.locate = false;
+    }
 
     dr->set_pos  = (Qtrue == rb_ivar_defined(handler, ox_at_pos_id)) ? set_pos : set_long_noop;
     dr->set_line = (Qtrue == rb_ivar_defined(handler, ox_at_line_id)) ? set_line : set_long_noop;
     dr->set_col  = (Qtrue == rb_ivar_defined(handler, ox_at_column_id)) ? set_col : set_long_noop;
-    if (rb_respond_to(handler, ox_attr_value_id)) {
+    if (sax_has(dr, AttrValueCall)) {
         dr->attr_cb        = attr_value;
         dr->want_attr_name = true;
-    } else if (rb_respond_to(handler, ox_attr_id)) {
+    } else if (sax_has(dr, AttrCall)) {
         dr->attr_cb        = attr_text;
         dr->want_attr_name = true;
     } else {
         dr->attr_cb        = attr_noop;
         dr->want_attr_name = false;
     }
-    dr->attrs_done   = rb_respond_to(handler, ox_attrs_done_id) ? attrs_done : attrs_done_noop;
-    dr->instruct     = rb_respond_to(handler, ox_instruct_id) ? instruct : instruct_noop;
-    dr->end_instruct = rb_respond_to(handler, ox_end_instruct_id) ? end_instruct : end_instruct_noop;
-    if (rb_respond_to(handler, ox_end_instruct_id) && !rb_respond_to(handler, ox_instruct_id)) {
+    dr->attrs_done   = sax_has(dr, AttrsDoneCall) ? attrs_done : attrs_done_noop;
+    dr->instruct     = sax_has(dr, InstructCall) ? instruct : instruct_noop;
+    dr->end_instruct = sax_has(dr, EndInstructCall) ? end_instruct : end_instruct_noop;
+    if (sax_has(dr, EndInstructCall) && !sax_has(dr, InstructCall)) {
         dr->instruct = instruct_just_value;
     }
-    dr->doctype = rb_respond_to(handler, ox_doctype_id) ? doctype : dr_loc_noop;
-    dr->comment = rb_respond_to(handler, ox_comment_id) ? comment : dr_loc_noop;
-    dr->cdata   = rb_respond_to(handler, ox_cdata_id) ? cdata : dr_loc_noop;
-    dr->error   = rb_respond_to(handler, ox_error_id) ? error : error_noop;
+    dr->doctype = sax_has(dr, DoctypeCall) ? doctype : dr_loc_noop;
+    dr->comment = sax_has(dr, CommentCall) ? comment : dr_loc_noop;
+    dr->cdata   = sax_has(dr, CdataCall) ? cdata : dr_loc_noop;
+    dr->error   = sax_has(dr, ErrorCall) ? error : error_noop;
 
-    dr->has_text          = rb_respond_to(handler, ox_text_id);
-    dr->has_value         = rb_respond_to(handler, ox_value_id);
-    dr->has_start_element = rb_respond_to(handler, ox_start_element_id);
-    dr->has_end_element   = rb_respond_to(handler, ox_end_element_id);
+    dr->has_text          = sax_has(dr, TextCall);
+    dr->has_text_chunk    = sax_has(dr, TextChunkCall);
+    dr->has_value         = sax_has(dr, ValueCall);
+    dr->has_start_element = sax_has(dr, StartElementCall);
+    dr->has_end_element   = sax_has(dr, EndElementCall);
 
     if ('\0' == *ox_default_options.encoding) {
         VALUE encoding;
@@ -323,12 +764,16 @@ static void sax_drive_init(SaxDrive dr, VALUE handler, VALUE io, SaxOptions opti
     } else {
         dr->get_name = dr->options.symbolize ? ox_enc_sym : ox_enc_name;
     }
+    if (Qnil != options->resume) {
+        resume_state(dr, io, options->resume);
+    }
 }
 
 void ox_sax_drive_cleanup(SaxDrive dr) {
-    rb_gc_unregister_address(&dr->value_obj);
     buf_cleanup(&dr->buf);
     stack_cleanup(&dr->stack);
+    ox_sax_columns_cleanup(dr);
+    ox_sax_sinks_cleanup(dr);
 }
 
 static void ox_sax_drive_error_at(SaxDrive dr, const char *msg, off_t pos, off_t line, off_t col) {
@@ -355,10 +800,17 @@ static char skipBOM(SaxDrive dr) {
 }
 
 static void parse(SaxDrive dr) {
-    char c     = skipBOM(dr);
+    char c;
     int  state = START_STATE;
     Nv   parent;
 
+    if (Qnil == dr->options.resume) {
+        c = skipBOM(dr);
+    } else {
+        c     = buf_get(&dr->buf);
+        state = stack_empty(&dr->stack) ? AFTER_STATE : BODY_STATE;
+    }
+
     while ('\0' != c) {
         buf_protect(&dr->buf);
         if ('<' == c) {
@@ -437,16 +889,19 @@ static void parse(SaxDrive dr) {
                 break;
             case '/': /* element end */
                 parent = stack_peek(&dr->stack);
-                if (0 != parent && 0 == parent->childCnt && dr->has_text && !dr->blocked) {
-                    VALUE args[1];
+                if (0 != parent && 0 == parent->childCnt && (dr->has_text || dr->has_text_chunk) && !dr->blocked) {
+                    VALUE args[2];
                     args[0] = rb_str_new2("");
+                    args[1] = Qtrue;
                     if (0 != dr->encoding) {
                         rb_enc_associate(args[0], dr->encoding);
                     }
-                    dr->set_pos(dr->handler, dr->buf.pos);
-                    dr->set_line(dr->handler, dr->buf.line);
-                    dr->set_col(dr->handler, dr->buf.col);
-                    rb_funcall2(dr->handler, ox_text_id, 1, args);
+                    set_loc(dr, dr->buf.pos, dr->buf.line, dr->buf.col);
+                    if (dr->has_text_chunk) {
+                        sax_call(dr, TextChunkCall, 2, args);
+                    } else {
+                        sax_call(dr, TextCall, 1, args);
+                    }
                 }
                 c = read_element_end(dr);
                 if (0 == stack_peek(&dr->stack)) {
@@ -542,7 +997,7 @@ static char read_instruction(SaxDrive dr) {
     buf_reset(&dr->buf);
     dr->err = 0;
     c       = read_attrs(dr, c, '?', '?', is_xml, 1, NULL);
-    dr->attrs_done(dr->handler);
+    dr->attrs_done(dr);
     if (dr->err) {
         if (dr->has_text) {
             VALUE args[1];
@@ -554,10 +1009,8 @@ static char read_instruction(SaxDrive dr) {
             if (0 != dr->encoding) {
                 rb_enc_associate(args[0], dr->encoding);
             }
-            dr->set_pos(dr->handler, pos);
-            dr->set_line(dr->handler, line);
-            dr->set_col(dr->handler, col);
-            rb_funcall2(dr->handler, ox_text_id, 1, args);
+            set_loc(dr, pos, line, col);
+            sax_call(dr, TextCall, 1, args);
         }
         dr->buf.tail = dr->buf.head + coff;
         c            = buf_get(&dr->buf);
@@ -643,17 +1096,24 @@ static char read_doctype(SaxDrive dr) {
  */
 static char read_cdata(SaxDrive dr) {
     char            c;
-    char            zero   = '\0';
-    int             end    = 0;
-    long            pos    = (long)(dr->buf.pos - 9);
-    long            line   = (long)(dr->buf.line);
-    long            col    = (long)(dr->buf.col - 9);
-    struct _checkPt cp     = CHECK_PT_INIT;
-    Nv              parent = stack_peek(&dr->stack);
+    char            zero    = '\0';
+    int             end     = 0;
+    long            pos     = (long)(dr->buf.pos - 9);
+    long            line    = (long)(dr->buf.line);
+    long            col     = (long)(dr->buf.col - 9);
+    struct _checkPt cp      = CHECK_PT_INIT;
+    Nv              parent  = stack_peek(&dr->stack);
+    long            chunk   = sax_has(dr, CdataChunkCall) ? dr->options.chunk_size : LONG_MAX;
+    bool            chunked = false;
+    SaxColumn       column  = NULL;
+    char           *cut;
 
     // TBD check parent overlay
     if (0 != parent) {
         parent->childCnt++;
+        if (0 < dr->col_cnt && NULL != (column = ox_sax_column_find(dr, nv_name(parent)))) {
+            chunk = LONG_MAX;
+        }
     }
     buf_backup(&dr->buf); /* back up to the start in case the cdata is empty */
     buf_protect(&dr->buf);
@@ -687,6 +1147,9 @@ static char read_cdata(SaxDrive dr) {
                 goto CB;
             }
             ox_sax_drive_error(dr, NO_TERM "CDATA not terminated");
+            if (chunked) {
+                cdata_chunk(dr, dr->buf.tail, true, pos, line, col);
+            }
             return '\0';
         default:
             if (1 < end && !buf_checkset(&cp)) {
@@ -695,9 +1158,29 @@ static char read_cdata(SaxDrive dr) {
             end = 0;
             break;
         }
+        if (chunk <= dr->buf.tail - dr->buf.str) {
+            // Trailing ']' characters might be the start of the terminator.
+            cut = chunk_cut(dr, dr->buf.str, dr->buf.tail - ((2 < end) ? 2 : end), false);
+            cdata_chunk(dr, cut, false, pos, line, col);
+            if (buf_checkset(&cp)) {
+                // A checkpoint already delivered can not be backed up to.
+                cp.pro_dif -= cut - dr->buf.pro;
+                if (0 > cp.pro_dif) {
+                    cp.pro_dif = -1;
+                }
+            }
+            buf_release(&dr->buf, cut);
+            chunked = true;
+        }
     }
 CB:
-    dr->cdata(dr, pos, line, col);
+    if (NULL != column) {
+        ox_sax_column_add(dr, column, dr->buf.str);
+    } else if (LONG_MAX != chunk) {
+        cdata_chunk(dr, dr->buf.str + strlen(dr->buf.str), true, pos, line, col);
+    } else {
+        dr->cdata(dr, pos, line, col);
+    }
     if ('\0' != zero) {
         *(dr->buf.tail - 1) = zero;
     }
@@ -821,17 +1304,17 @@ static char read_element_start(SaxDrive dr) {
         } else {
             Nv top_nv = stack_peek(&dr->stack);
 
-            if (AbortOverlay == h->overlay) {
-                if (rb_respond_to(dr->handler, ox_abort_id)) {
+            if (AbortOverlay == overlay_of(dr, h)) {
+                if (sax_has(dr, AbortCall)) {
                     VALUE args[1];
 
                     args[0] = str2sym(dr, dr->buf.str, nlen, NULL);
-                    rb_funcall2(dr->handler, ox_abort_id, 1, args);
+                    sax_call(dr, AbortCall, 1, args);
                 }
                 dr->abort = true;
                 return '\0';
             }
-            if (BlockOverlay == h->overlay) {
+            if (BlockOverlay == overlay_of(dr, h)) {
                 dr->blocked++;
             }
             if (h->empty) {
@@ -840,7 +1323,7 @@ static char read_element_start(SaxDrive dr) {
             if (0 != top_nv) {
                 char msg[256];
 
-                if (!h->nest && NestOverlay != h->overlay && nv_same_name(top_nv, h->name, true)) {
+                if (!h->nest && NestOverlay != overlay_of(dr, h) && nv_same_name(top_nv, h->name, true)) {
                     snprintf(msg,
                              sizeof(msg) - 1,
                              "%s%s can not be nested in a %s document, closing previous.",
@@ -852,7 +1335,7 @@ static char read_element_start(SaxDrive dr) {
                     end_element_cb(dr, top_nv->val, pos, line, col, top_nv->hint);
                     top_nv = stack_peek(&dr->stack);
                 }
-                if (NULL != top_nv && 0 != h->parents && NestOverlay != h->overlay) {
+                if (NULL != top_nv && 0 != h->parents && NestOverlay != overlay_of(dr, h)) {
                     const char **p;
                     int          ok = 0;
 
@@ -876,26 +1359,23 @@ static char read_element_start(SaxDrive dr) {
             }
         }
     }
-    name = str2sym(dr, dr->buf.str, nlen, &ename);
-    if (NULL == ename) {
-        if (sizeof(ebuf) <= nlen) {
-            ename = ox_strndup(dr->buf.str, nlen);
-            efree = true;
-        } else {
-            memcpy(ebuf, dr->buf.str, nlen);
-            ebuf[nlen] = '\0';
-            ename      = ebuf;
-        }
+    // A cache key returned by str2sym() can be overwritten if a callback
+    // triggers a GC that evicts the slot so the name is always copied.
+    name = str2sym(dr, dr->buf.str, nlen, NULL);
+    if (sizeof(ebuf) <= nlen) {
+        ename = ox_strndup(dr->buf.str, nlen);
+        efree = true;
+    } else {
+        memcpy(ebuf, dr->buf.str, nlen);
+        ebuf[nlen] = '\0';
+        ename      = ebuf;
     }
-    if (dr->has_start_element && 0 >= dr->blocked &&
-        (NULL == h || ActiveOverlay == h->overlay || NestOverlay == h->overlay)) {
+    if (dr->has_start_element && 0 >= dr->blocked && hint_active(dr, h)) {
         VALUE args[1];
 
-        dr->set_pos(dr->handler, pos);
-        dr->set_line(dr->handler, line);
-        dr->set_col(dr->handler, col);
+        set_loc(dr, pos, line, col);
         args[0] = name;
-        rb_funcall2(dr->handler, ox_start_element_id, 1, args);
+        sax_call(dr, StartElementCall, 1, args);
     }
     if ('/' == c) {
         closed = true;
@@ -909,12 +1389,16 @@ static char read_element_start(SaxDrive dr) {
         }
         closed = ('/' == c);
     }
-    if (0 >= dr->blocked && (NULL == h || ActiveOverlay == h->overlay || NestOverlay == h->overlay)) {
-        dr->attrs_done(dr->handler);
+    if (0 >= dr->blocked && hint_active(dr, h)) {
+        dr->attrs_done(dr);
+    }
+    if ((closed || stackless) && 0 < dr->col_cnt) {
+        ox_sax_column_empty(dr, ename);
     }
     if (closed) {
         c = buf_next_non_white(&dr->buf);
 
+        set_ckpt(dr, dr->buf.pos, dr->buf.line, dr->buf.col);
         end_element_cb(dr, name, dr->buf.pos, dr->buf.line, dr->buf.col, h);
     } else if (stackless) {
         end_element_cb(dr, name, pos, line, col, h);
@@ -941,11 +1425,11 @@ static char read_element_start(SaxDrive dr) {
     return buf_get(&dr->buf);
 }
 
-static Nv stack_rev_find(SaxDrive dr, const char *name) {
+static Nv stack_rev_find(SaxDrive dr, const char *name, size_t len, uint32_t hash) {
     Nv nv;
 
     for (nv = dr->stack.tail - 1; dr->stack.head <= nv; nv--) {
-        if (nv_same_name(nv, name, dr->options.smart)) {
+        if (nv_same(nv, name, len, hash, dr->options.smart)) {
             return nv;
         }
     }
@@ -953,13 +1437,16 @@ static Nv stack_rev_find(SaxDrive dr, const char *name) {
 }
 
 static char read_element_end(SaxDrive dr) {
-    VALUE name = Qnil;
-    char  c;
-    long  pos  = (long)(dr->buf.pos - 1);
-    long  line = (long)(dr->buf.line);
-    long  col  = (long)(dr->buf.col - 1);
-    Nv    nv;
-    Hint  h = NULL;
+    VALUE           name = Qnil;
+    char            c;
+    long            pos  = (long)(dr->buf.pos - 1);
+    long            line = (long)(dr->buf.line);
+    long            col  = (long)(dr->buf.col - 1);
+    Nv              nv;
+    Hint            h   = NULL;
+    struct _checkPt end = CHECK_PT_INIT;
+    size_t          nlen;
+    uint32_t        hash;
 
     if ('\0' == (c = read_name_token(dr))) {
         return '\0';
@@ -967,17 +1454,28 @@ static char read_element_end(SaxDrive dr) {
     if (is_white(c)) {
         c = buf_next_non_white(&dr->buf);
     }
+    if ('>' == c) {
+        buf_checkpoint(&dr->buf, &end);
+    }
     // c should be > and current is one past so read another char
-    c  = buf_get(&dr->buf);
-    nv = stack_peek(&dr->stack);
-    if (0 != nv && nv_same_name(nv, dr->buf.str, dr->options.smart)) {
+    c    = buf_get(&dr->buf);
+    nv   = stack_peek(&dr->stack);
+    nlen = strlen(dr->buf.str);
+    hash = nv_hash(dr->buf.str, nlen);
+    if (0 != nv && nv_same(nv, dr->buf.str, nlen, hash, dr->options.smart)) {
         name = nv->val;
         h    = nv->hint;
+        if (0 < dr->col_cnt && 0 == nv->childCnt) {
+            ox_sax_column_empty(dr, nv_name(nv));
+        }
         stack_pop(&dr->stack);
+        if (buf_checkset(&end)) {
+            set_ckpt(dr, end.pos, end.line, end.col);
+        }
     } else {
         // Mismatched start and end
         char msg[256];
-        Nv   match = stack_rev_find(dr, dr->buf.str);
+        Nv   match = stack_rev_find(dr, dr->buf.str, nlen, hash);
 
         if (0 == match) {
             // Not found so open and close element.
@@ -1000,17 +1498,14 @@ static char read_element_end(SaxDrive dr) {
                 } else {
                     name = str2sym(dr, dr->buf.str, dr->buf.tail - dr->buf.str - 2, 0);
                 }
-                if (dr->has_start_element && 0 >= dr->blocked &&
-                    (NULL == h || ActiveOverlay == h->overlay || NestOverlay == h->overlay)) {
+                if (dr->has_start_element && 0 >= dr->blocked && hint_active(dr, h)) {
                     VALUE args[1];
 
-                    dr->set_pos(dr->handler, pos);
-                    dr->set_line(dr->handler, line);
-                    dr->set_col(dr->handler, col);
+                    set_loc(dr, pos, line, col);
                     args[0] = name;
-                    rb_funcall2(dr->handler, ox_start_element_id, 1, args);
+                    sax_call(dr, StartElementCall, 1, args);
                 }
-                if (NULL != h && BlockOverlay == h->overlay && 0 < dr->blocked) {
+                if (NULL != h && BlockOverlay == overlay_of(dr, h) && 0 < dr->blocked) {
                     dr->blocked--;
                 }
             }
@@ -1043,14 +1538,32 @@ static char read_element_end(SaxDrive dr) {
 }
 
 static char read_text(SaxDrive dr) {
-    VALUE args[1];
-    char  c;
-    long  pos      = (long)(dr->buf.pos);
-    long  line     = (long)(dr->buf.line);
-    long  col      = (long)(dr->buf.col - 1);
-    Nv    parent   = stack_peek(&dr->stack);
-    int   allWhite = 1;
-
+    VALUE     args[2];
+    char      c;
+    long      pos      = (long)(dr->buf.pos);
+    long      line     = (long)(dr->buf.line);
+    long      col      = (long)(dr->buf.col - 1);
+    Nv        parent   = stack_peek(&dr->stack);
+    int       allWhite = 1;
+    long      chunk    = LONG_MAX;
+    bool      wanted   = node_wanted(dr, parent);
+    bool      spc      = false;
+    SaxColumn column   = NULL;
+    SaxSink   sink;
+
+    if (0 < dr->sink_cnt && NULL != parent && NULL != (sink = ox_sax_sink_find(dr))) {
+        parent->childCnt++;
+        buf_backup(&dr->buf);
+        return ox_sax_sink_read(dr, sink);
+    }
+    if (0 < dr->col_cnt && NULL != parent) {
+        column = ox_sax_column_find(dr, nv_name(parent));
+    }
+    // Column values are short so a node is only split when it is going to
+    // text_chunk() or is dropped anyway.
+    if (dr->has_text_chunk && NULL == column) {
+        chunk = dr->options.chunk_size;
+    }
     buf_backup(&dr->buf);
     buf_protect(&dr->buf);
     while ('<' != (c = buf_get(&dr->buf))) {
@@ -1069,6 +1582,16 @@ static char read_text(SaxDrive dr) {
             break;
         default: allWhite = 0; break;
         }
+        // Leading white space is held until there is something else as only
+        // then is it certain the node will be delivered.
+        if (!allWhite && chunk <= dr->buf.tail - dr->buf.str) {
+            char *cut = chunk_cut(dr, dr->buf.str, dr->buf.tail, dr->options.convert_special);
+
+            if (wanted) {
+                text_chunk(dr, cut, false, &spc, pos, line, col);
+            }
+            buf_release(&dr->buf, cut);
+        }
     }
 END_OF_BUF:
     if ('\0' != c) {
@@ -1078,15 +1601,19 @@ END_OF_BUF:
         int isEnd = ('/' == buf_get(&dr->buf));
 
         buf_backup(&dr->buf);
-        if (dr->has_text && ((NoSkip == dr->options.skip && !isEnd) || (OffSkip == dr->options.skip))) {
+        if ((dr->has_text || dr->has_text_chunk) &&
+            ((NoSkip == dr->options.skip && !isEnd) || (OffSkip == dr->options.skip))) {
             args[0] = rb_str_new2(dr->buf.str);
+            args[1] = Qtrue;
             if (0 != dr->encoding) {
                 rb_enc_associate(args[0], dr->encoding);
             }
-            dr->set_pos(dr->handler, pos);
-            dr->set_line(dr->handler, line);
-            dr->set_col(dr->handler, col);
-            rb_funcall2(dr->handler, ox_text_id, 1, args);
+            set_loc(dr, pos, line, col);
+            if (dr->has_text_chunk) {
+                sax_call(dr, TextChunkCall, 2, args);
+            } else {
+                sax_call(dr, TextCall, 1, args);
+            }
         }
         if (!isEnd || 0 == parent || 0 < parent->childCnt) {
             return c;
@@ -1095,13 +1622,15 @@ END_OF_BUF:
     if (0 != parent) {
         parent->childCnt++;
     }
-    if (!dr->blocked && (NULL == parent || NULL == parent->hint || OffOverlay != parent->hint->overlay)) {
-        if (dr->has_value) {
-            dr->set_pos(dr->handler, pos);
-            dr->set_line(dr->handler, line);
-            dr->set_col(dr->handler, col);
+    if (NULL != column) {
+        ox_sax_column_add(dr, column, dr->buf.str);
+    } else if (wanted) {
+        if (dr->has_text_chunk) {
+            text_chunk(dr, dr->buf.str + strlen(dr->buf.str), true, &spc, pos, line, col);
+        } else if (dr->has_value) {
+            set_loc(dr, pos, line, col);
             *args = dr->value_obj;
-            rb_funcall2(dr->handler, ox_value_id, 1, args);
+            sax_call(dr, ValueCall, 1, args);
         } else if (dr->has_text) {
             if (dr->options.convert_special) {
                 ox_sax_collapse_special(dr, dr->buf.str, pos, line, col);
@@ -1115,10 +1644,8 @@ END_OF_BUF:
             if (0 != dr->encoding) {
                 rb_enc_associate(args[0], dr->encoding);
             }
-            dr->set_pos(dr->handler, pos);
-            dr->set_line(dr->handler, line);
-            dr->set_col(dr->handler, col);
-            rb_funcall2(dr->handler, ox_text_id, 1, args);
+            set_loc(dr, pos, line, col);
+            sax_call(dr, TextCall, 1, args);
         }
     }
     dr->buf.str = 0;
@@ -1186,10 +1713,8 @@ END_OF_BUF:
         if (0 != dr->encoding) {
             rb_enc_associate(args[0], dr->encoding);
         }
-        dr->set_pos(dr->handler, pos);
-        dr->set_line(dr->handler, line);
-        dr->set_col(dr->handler, col);
-        rb_funcall2(dr->handler, ox_text_id, 1, args);
+        set_loc(dr, pos, line, col);
+        sax_call(dr, TextCall, 1, args);
     }
     dr->buf.str = 0;
     if ('\0' != c) {
@@ -1254,7 +1779,7 @@ static char read_attrs(SaxDrive dr, char c, char termc, char term2, int is_xml,
                 is_encoding  = 0;
             }
         }
-        if (0 >= dr->blocked && (NULL == h || ActiveOverlay == h->overlay || NestOverlay == h->overlay)) {
+        if (0 >= dr->blocked && hint_active(dr, h)) {
             dr->attr_cb(dr, name, attr_value, pos, line, col);
         }
         if (is_white(c)) {
@@ -1565,7 +2090,7 @@ static Nv hint_try_close(SaxDrive dr, const char *name) {
         }
         if (nv->hint->empty) {
             end_element_cb(dr, nv->val, dr->buf.pos, dr->buf.line, dr->buf.col, nv->hint);
-            dr->stack.tail = nv;
+            stack_pop(&dr->stack);
         } else {
             break;
         }
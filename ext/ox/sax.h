@@ -12,6 +12,76 @@
 #include "sax_buf.h"
 #include "sax_hint.h"
 #include "sax_stack.h"
+#include "xsd_time.h"
+
+// Long text and CDATA nodes are delivered to text_chunk() and cdata_chunk()
+// in pieces of about this many bytes. The minimum leaves room to back up over
+// a partial entity or UTF-8 character at the end of a piece.
+#define SAX_CHUNK_SIZE 0x00010000
+#define SAX_CHUNK_MIN 64
+// Recorded in an :int or :time column for an element with no value. Float
+// columns record NaN.
+#define COLUMN_NULL_INT INT64_MIN
+
+typedef enum {
+    IntColumn   = 'i',
+    FloatColumn = 'f',
+    TimeColumn  = 't',
+} ColumnType;
+
+// Element text collected into a packed native column instead of being passed
+// to the handler. Integers and times (epoch nanoseconds) are stored as int64_t
+// and floats as double.
+typedef struct _saxColumn {
+    char *name;
+    VALUE key;
+    char  type;
+    char *data;
+    long  cnt;
+    long  size;
+} *SaxColumn;
+
+// Element text base64 decoded and written to a file descriptor instead of
+// being passed to the handler. The path is one or more element names
+// separated by '/' that must match the innermost open elements.
+typedef struct _saxSink {
+    char  *path;
+    size_t len;
+    int    fd;
+} *SaxSink;
+
+typedef enum {
+    InstructCall = 0,
+    EndInstructCall,
+    AttrCall,
+    AttrValueCall,
+    AttrsDoneCall,
+    DoctypeCall,
+    CommentCall,
+    CdataCall,
+    CdataChunkCall,
+    TextCall,
+    TextChunkCall,
+    ValueCall,
+    StartElementCall,
+    EndElementCall,
+    ErrorCall,
+    AbortCall,
+    ColumnsCall,
+    CALL_CNT,
+} SaxCallType;
+
+// A handler callback resolved once when the parse starts. The receiver is
+// the handler object itself or, for a Hash handler, the Proc or other
+// callable stored under the callback name. Qundef marks an absent callback.
+// Handlers implemented in C such as the one behind Ox.sax_extract() set
+// cfunc so no Ruby method is dispatched.
+typedef struct _saxCall {
+    VALUE recv;
+    ID    id;
+    bool  proc;
+    VALUE (*cfunc)(VALUE recv, int argc, const VALUE *argv);
+} *SaxCall;
 
 typedef struct _saxOptions {
     int      symbolize;
@@ -20,6 +90,12 @@ typedef struct _saxOptions {
     SkipMode skip;
     char     strip_ns[64];
     Hints    hints;
+    VALUE    columns;
+    VALUE    sinks;
+    bool     location;
+    bool     compressed;
+    VALUE    resume;  // state from Ox::Sax#checkpoint or Qnil
+    long     chunk_size;
 } *SaxOptions;
 
 typedef struct _saxDrive {
@@ -33,7 +109,7 @@ typedef struct _saxDrive {
     void (*set_line)(VALUE handler, long line);
     void (*set_col)(VALUE handler, long col);
     void (*attr_cb)(struct _saxDrive *dr, VALUE name, char *value, long pos, long line, long col);
-    void (*attrs_done)(VALUE handler);
+    void (*attrs_done)(struct _saxDrive *dr);
     VALUE (*instruct)(struct _saxDrive *dr, const char *target, long pos, long line, long col);
     void (*end_instruct)(struct _saxDrive *dr, VALUE target, long pos, long line, long col);
     void (*doctype)(struct _saxDrive *dr, long pos, long line, long col);
@@ -41,27 +117,85 @@ typedef struct _saxDrive {
     void (*cdata)(struct _saxDrive *dr, long pos, long line, long col);
     void (*error)(struct _saxDrive *dr, const char *msg, long pos, long line, long col);
 
-    rb_encoding *encoding;
-    int          err;
-    int          blocked;
-    bool         abort;
-    bool         utf8;
-    bool         want_attr_name;
-    bool         has_text;
-    bool         has_value;
-    bool         has_start_element;
-    bool         has_end_element;
+    struct _saxCall calls[CALL_CNT];
+    SaxColumn       columns;
+    int             col_cnt;
+    SaxSink         sinks;
+    int             sink_cnt;
+    long            loc_pos;
+    long            loc_line;
+    long            loc_col;
+    long            ckpt_pos;  // end of the element being closed or -1
+    long            ckpt_line;
+    long            ckpt_col;
+    rb_encoding    *encoding;
+    int             err;
+    int             blocked;
+    bool            abort;
+    bool            utf8;
+    bool            want_attr_name;
+    bool            has_text;
+    bool            has_text_chunk;
+    bool            has_value;
+    bool            has_start_element;
+    bool            has_end_element;
 
 } *SaxDrive;
 
 extern const rb_data_type_t ox_sax_value_type;
 
+static inline bool sax_has(SaxDrive dr, SaxCallType type) {
+    return (Qundef != dr->calls[type].recv);
+}
+
+static inline VALUE sax_call(SaxDrive dr, SaxCallType type, int argc, const VALUE *argv) {
+    SaxCall call = dr->calls + type;
+
+    if (NULL != call->cfunc) {
+        return call->cfunc(call->recv, argc, argv);
+    }
+    if (call->proc) {
+        return rb_proc_call_with_block(call->recv, argc, argv, Qnil);
+    }
+    return rb_funcallv(call->recv, call->id, argc, argv);
+}
+
 extern void ox_collapse_return(char *str);
 extern void ox_sax_parse(VALUE handler, VALUE io, SaxOptions options);
 extern void ox_sax_drive_cleanup(SaxDrive dr);
 extern void ox_sax_drive_error(SaxDrive dr, const char *msg);
 extern int  ox_sax_collapse_special(SaxDrive dr, char *str, long pos, long line, long col);
 
+extern void     ox_sax_options_init(SaxOptions options, VALUE h);
+extern void     ox_sax_drive_init(SaxDrive dr, VALUE handler, VALUE io, SaxOptions options);
+extern void     ox_sax_drive_parse(SaxDrive dr);
+extern void     ox_sax_drive_attach(VALUE owner);
+extern void     ox_sax_drive_detach(VALUE owner);
+extern void     ox_sax_parser_define(VALUE sax_module);
+extern SaxDrive ox_sax_parser_drive(VALUE parser);
+extern VALUE    ox_sax_location(VALUE self);
+extern VALUE    ox_sax_checkpoint(VALUE self);
+extern void     ox_sax_extract_resolve(SaxDrive dr);
+extern void     ox_sax_extract(VALUE io, SaxOptions options, Options hopts, VALUE element, bool attrs);
+extern VALUE    ox_index_file(VALUE path, VALUE element, VALUE key, const char *out_path);
+extern VALUE    ox_load_index(const char *path);
+
+extern char      ox_sax_column_type(VALUE type);
+extern void      ox_sax_columns_init(SaxDrive dr, VALUE columns);
+extern void      ox_sax_columns_cleanup(SaxDrive dr);
+extern SaxColumn ox_sax_column_find(SaxDrive dr, const char *name);
+extern void      ox_sax_column_add(SaxDrive dr, SaxColumn col, char *str);
+extern void      ox_sax_column_empty(SaxDrive dr, const char *name);
+extern VALUE     ox_sax_columns_value(SaxDrive dr);
+
+extern void    ox_sax_sink_check(VALUE sinks);
+extern void    ox_sax_sinks_init(SaxDrive dr, VALUE sinks);
+extern void    ox_sax_sinks_cleanup(SaxDrive dr);
+extern SaxSink ox_sax_sink_find(SaxDrive dr);
+extern char    ox_sax_sink_read(SaxDrive dr, SaxSink sink);
+
+extern double ox_sax_parse_float(const char *str, const char **endp);
+
 extern VALUE ox_sax_value_class;
 
 extern VALUE str2sym(SaxDrive dr, const char *str, size_t len, const char **strp);
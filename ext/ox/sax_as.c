@@ -4,8 +4,12 @@
  */
 
 #include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <sys/types.h>
 #if HAVE_SYS_UIO_H
@@ -46,59 +50,308 @@ static VALUE parse_double_time(const char *text) {
     return rb_time_nano_new(v, v2);
 }
 
-typedef struct _tp {
-    int  cnt;
-    char end;
-    char alt;
-} *Tp;
+static const double pow10_table[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
 
-static VALUE parse_xsd_time(const char *text) {
-    long       cargs[10];
-    long      *cp = cargs;
-    long       v;
-    int        i;
-    char       c       = '\0';
-    struct _tp tpa[10] = {{4, '-', '-'},
-                          {2, '-', '-'},
-                          {2, 'T', ' '},
-                          {2, ':', ':'},
-                          {2, ':', ':'},
-                          {2, '.', '.'},
-                          {9, '+', '-'},
-                          {2, ':', ':'},
-                          {2, '\0', '\0'},
-                          {0, '\0', '\0'}};
-    Tp         tp      = tpa;
-    struct tm  tm;
-
-    memset(cargs, 0, sizeof(cargs));
-    for (; 0 != tp->cnt; tp++) {
-        for (i = tp->cnt, v = 0; 0 < i; text++, i--) {
-            c = *text;
-            if (c < '0' || '9' < c) {
-                if ('\0' == c || tp->end == c || tp->alt == c) {
-                    break;
+// Parses a decimal float. When the mantissa fits in 53 bits and the power of
+// ten is exact as a double a single multiply or divide gives the correctly
+// rounded result. Anything else is left to strtod().
+double ox_sax_parse_float(const char *str, const char **endp) {
+    const char *s    = str;
+    uint64_t    m    = 0;
+    int         digs = 0;
+    int         exp  = 0;
+    bool        neg  = false;
+    bool        any  = false;
+    double      d;
+
+    if ('-' == *s) {
+        neg = true;
+        s++;
+    } else if ('+' == *s) {
+        s++;
+    }
+    for (; '0' <= *s && *s <= '9'; s++) {
+        if (19 <= digs) {
+            return strtod(str, (char **)endp);
+        }
+        m   = m * 10 + (uint64_t)(*s - '0');
+        any = true;
+        if (0 < m) {
+            digs++;
+        }
+    }
+    if ('.' == *s) {
+        for (s++; '0' <= *s && *s <= '9'; s++) {
+            if (19 <= digs) {
+                return strtod(str, (char **)endp);
+            }
+            m   = m * 10 + (uint64_t)(*s - '0');
+            any = true;
+            if (0 < m) {
+                digs++;
+            }
+            exp--;
+        }
+    }
+    if (!any) {
+        return strtod(str, (char **)endp);
+    }
+    if ('e' == *s || 'E' == *s) {
+        const char *e    = s + 1;
+        bool        eneg = false;
+        long        ev   = 0;
+
+        if ('-' == *e) {
+            eneg = true;
+            e++;
+        } else if ('+' == *e) {
+            e++;
+        }
+        if ('0' <= *e && *e <= '9') {
+            for (; '0' <= *e && *e <= '9'; e++) {
+                ev = ev * 10 + (long)(*e - '0');
+                if (1000 < ev) {
+                    return strtod(str, (char **)endp);
                 }
-                return Qnil;
             }
-            v = 10 * v + (long)(c - '0');
+            exp += eneg ? -(int)ev : (int)ev;
+            s = e;
         }
-        if ('\0' == c) {
-            break;
+    }
+    if ('\0' != *s && !is_white(*s)) {
+        return strtod(str, (char **)endp);
+    }
+    if (((uint64_t)1 << 53) < m || exp < -22 || 22 < exp) {
+        return strtod(str, (char **)endp);
+    }
+    d = (double)m;
+    if (exp < 0) {
+        d /= pow10_table[-exp];
+    } else {
+        d *= pow10_table[exp];
+    }
+    if (NULL != endp) {
+        *endp = s;
+    }
+    return neg ? -d : d;
+}
+
+static VALUE parse_xsd_time(const char *text) {
+    struct _xsdTime xt;
+
+    if (!ox_xsd_time_parse(text, &xt)) {
+        return Qnil;
+    }
+    return ox_xsd_time_value(&xt);
+}
+
+static VALUE int_sym   = Qundef;
+static VALUE float_sym = Qundef;
+static VALUE time_sym  = Qundef;
+
+char ox_sax_column_type(VALUE type) {
+    if (int_sym == type) {
+        return IntColumn;
+    } else if (float_sym == type) {
+        return FloatColumn;
+    } else if (time_sym == type) {
+        return TimeColumn;
+    }
+    rb_raise(ox_parse_error_class, ":columns values must be :int, :float, or :time.\n");
+
+    return '\0';
+}
+
+static int column_init_cb(VALUE key, VALUE type, VALUE x) {
+    SaxDrive  dr  = (SaxDrive)x;
+    SaxColumn col = dr->columns + dr->col_cnt++;
+    VALUE     name;
+
+    name      = (T_SYMBOL == rb_type(key)) ? rb_sym2str(key) : StringValue(key);
+    col->name = ox_strndup(RSTRING_PTR(name), RSTRING_LEN(name));
+    col->key  = key;
+    col->type = ox_sax_column_type(type);
+    col->cnt  = 0;
+    col->size = 1024;
+    col->data = ALLOC_N(char, col->size * sizeof(int64_t));
+
+    return ST_CONTINUE;
+}
+
+// The columns Hash is expected to have been checked with
+// ox_sax_column_type() already.
+void ox_sax_columns_init(SaxDrive dr, VALUE columns) {
+    dr->columns = NULL;
+    dr->col_cnt = 0;
+    if (Qnil == columns || 0 == RHASH_SIZE(columns)) {
+        return;
+    }
+    dr->columns = ALLOC_N(struct _saxColumn, RHASH_SIZE(columns));
+    rb_hash_foreach(columns, column_init_cb, (VALUE)dr);
+}
+
+void ox_sax_columns_cleanup(SaxDrive dr) {
+    SaxColumn col;
+    SaxColumn end = dr->columns + dr->col_cnt;
+
+    for (col = dr->columns; col < end; col++) {
+        xfree(col->name);
+        xfree(col->data);
+    }
+    xfree(dr->columns);
+    dr->columns = NULL;
+    dr->col_cnt = 0;
+}
+
+SaxColumn
+ox_sax_column_find(SaxDrive dr, const char *name) {
+    SaxColumn col;
+    SaxColumn end = dr->columns + dr->col_cnt;
+
+    for (col = dr->columns; col < end; col++) {
+        if (0 == strcmp(name, col->name)) {
+            return col;
         }
-        c = *text++;
-        if (tp->end != c && tp->alt != c) {
-            return Qnil;
+    }
+    return NULL;
+}
+
+static bool parse_int64(const char *s, int64_t *vp) {
+    uint64_t n   = 0;
+    bool     neg = false;
+
+    if ('-' == *s) {
+        neg = true;
+        s++;
+    } else if ('+' == *s) {
+        s++;
+    }
+    if ('\0' == *s) {
+        return false;
+    }
+    for (; '0' <= *s && *s <= '9'; s++) {
+        if ((uint64_t)INT64_MAX / 10 < n) {
+            return false;
+        }
+        n = n * 10 + (uint64_t)(*s - '0');
+        if ((uint64_t)INT64_MAX < n && !(neg && (uint64_t)INT64_MAX + 1 == n)) {
+            return false;
         }
-        *cp++ = v;
-    }
-    tm.tm_year = (int)cargs[0] - 1900;
-    tm.tm_mon  = (int)cargs[1] - 1;
-    tm.tm_mday = (int)cargs[2];
-    tm.tm_hour = (int)cargs[3];
-    tm.tm_min  = (int)cargs[4];
-    tm.tm_sec  = (int)cargs[5];
-    return rb_time_nano_new(mktime(&tm), cargs[6]);
+    }
+    if ('\0' != *s) {
+        return false;
+    }
+    *vp = neg ? (int64_t)(0 - n) : (int64_t)n;
+
+    return true;
+}
+
+static bool parse_time_nanos(const char *s, int64_t *vp) {
+    struct _xsdTime xt;
+    const char     *dot;
+
+    // Decimal epoch seconds as written by the Object mode dump.
+    for (dot = s; '0' <= *dot && *dot <= '9'; dot++) {
+    }
+    if ('.' == *dot && dot != s && dot - s < 12) {
+        int64_t sec  = 0;
+        int64_t nsec = 0;
+        long    scale;
+
+        for (; s < dot; s++) {
+            sec = sec * 10 + (*s - '0');
+        }
+        for (s++, scale = 100000000; '0' <= *s && *s <= '9'; s++, scale /= 10) {
+            nsec += scale * (*s - '0');
+        }
+        if ('\0' != *s) {
+            return false;
+        }
+        *vp = sec * 1000000000 + nsec;
+
+        return true;
+    }
+    if (!ox_xsd_time_parse(s, &xt)) {
+        return false;
+    }
+    // Times without a zone are taken to be UTC.
+    *vp = ox_xsd_time_utc_sec(&xt) * 1000000000 + xt.nsec;
+
+    return true;
+}
+
+static void column_push(SaxColumn col, int64_t i, double d) {
+    if (col->size <= col->cnt) {
+        col->size *= 2;
+        REALLOC_N(col->data, char, col->size * sizeof(int64_t));
+    }
+    if (FloatColumn == col->type) {
+        ((double *)col->data)[col->cnt++] = d;
+    } else {
+        ((int64_t *)col->data)[col->cnt++] = i;
+    }
+}
+
+// The value is trimmed and parsed where it is in the buffer. The character
+// after the value is replaced with a '\0' while parsing and then put back.
+void ox_sax_column_add(SaxDrive dr, SaxColumn col, char *str) {
+    char       *end;
+    const char *fend;
+    char        save;
+    int64_t     i = 0;
+    double      d = 0.0;
+    bool        ok;
+
+    for (; is_white(*str); str++) {
+    }
+    for (end = str + strlen(str); str < end && is_white(*(end - 1)); end--) {
+    }
+    if (str == end) {
+        column_push(col, COLUMN_NULL_INT, NAN);
+        return;
+    }
+    save = *end;
+    *end = '\0';
+    switch (col->type) {
+    case IntColumn: ok = parse_int64(str, &i); break;
+    case TimeColumn: ok = parse_time_nanos(str, &i); break;
+    case FloatColumn:
+    default:
+        d  = ox_sax_parse_float(str, &fend);
+        ok = ('\0' == *fend);
+        break;
+    }
+    if (!ok) {
+        char msg[128];
+
+        snprintf(msg, sizeof(msg), "Invalid Format: '%s' is not a valid %s value", str, col->name);
+        *end = save;
+        ox_sax_drive_error(dr, msg);
+    } else {
+        *end = save;
+    }
+    column_push(col, i, d);
+}
+
+void ox_sax_column_empty(SaxDrive dr, const char *name) {
+    SaxColumn col = ox_sax_column_find(dr, name);
+
+    if (NULL != col) {
+        column_push(col, COLUMN_NULL_INT, NAN);
+    }
+}
+
+VALUE
+ox_sax_columns_value(SaxDrive dr) {
+    volatile VALUE h = rb_hash_new();
+    SaxColumn      col;
+    SaxColumn      end = dr->columns + dr->col_cnt;
+
+    for (col = dr->columns; col < end; col++) {
+        rb_hash_aset(h, col->key, rb_str_new(col->data, col->cnt * sizeof(int64_t)));
+    }
+    return h;
 }
 
 /* call-seq: as_s()
@@ -156,7 +409,7 @@ static VALUE sax_value_as_f(VALUE self) {
     if ('\0' == *dr->buf.str) {
         return Qnil;
     }
-    return rb_float_new(strtod(dr->buf.str, 0));
+    return rb_float_new(ox_sax_parse_float(dr->buf.str, NULL));
 }
 
 /* call-seq: as_i()
@@ -196,7 +449,8 @@ static VALUE sax_value_as_i(VALUE self) {
 
 /* call-seq: as_time()
  *
- * *return* value as an Time.
+ * *return* value as an Time. An XSD time without a zone is UTC, the same as
+ * for a :time column.
  */
 static VALUE sax_value_as_time(VALUE self) {
     SaxDrive    dr;
@@ -255,6 +509,13 @@ void ox_sax_define(void) {
 #endif
     VALUE sax_module = rb_const_get_at(Ox, rb_intern("Sax"));
 
+    int_sym = ID2SYM(rb_intern("int"));
+    rb_gc_register_address(&int_sym);
+    float_sym = ID2SYM(rb_intern("float"));
+    rb_gc_register_address(&float_sym);
+    time_sym = ID2SYM(rb_intern("time"));
+    rb_gc_register_address(&time_sym);
+
     ox_sax_value_class = rb_define_class_under(sax_module, "Value", rb_cObject);
 #if RUBY_API_VERSION_CODE >= 30200
     rb_undef_alloc_func(ox_sax_value_class);
@@ -267,4 +528,9 @@ void ox_sax_define(void) {
     rb_define_method(ox_sax_value_class, "as_time", sax_value_as_time, 0);
     rb_define_method(ox_sax_value_class, "as_bool", sax_value_as_bool, 0);
     rb_define_method(ox_sax_value_class, "empty?", sax_value_empty, 0);
+
+    rb_define_method(sax_module, "location", ox_sax_location, 0);
+    rb_define_method(sax_module, "checkpoint", ox_sax_checkpoint, 0);
+
+    ox_sax_parser_define(sax_module);
 }
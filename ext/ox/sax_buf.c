@@ -4,6 +4,7 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -13,12 +14,20 @@
 #endif
 #include <time.h>
 #include <unistd.h>
+#if HAVE_ZLIB_H
+#include <zlib.h>
+#endif
 
 #include "ox.h"
 #include "ruby.h"
+#include "ruby/io.h"
+#if HAVE_RB_FIBER_SCHEDULER_CURRENT
+#include "ruby/fiber/scheduler.h"
+#endif
 #include "sax.h"
 
 #define BUF_PAD 4
+#define FD_BUF_SIZE 0x00010000
 
 static VALUE rescue_cb(VALUE rdr, VALUE err);
 static VALUE io_cb(VALUE rdr);
@@ -27,12 +36,40 @@ static int   read_from_io(Buf buf);
 static int   read_from_fd(Buf buf);
 static int   read_from_io_partial(Buf buf);
 static int   read_from_str(Buf buf);
+static int   read_from_push(Buf buf);
+
+// Under a fiber scheduler an IO such as a socket or pipe is read directly
+// from its descriptor so a slow peer waits through the scheduler instead of
+// blocking the reactor in readpartial(). Data already buffered by the IO
+// would be skipped so those stay on the readpartial() path.
+static bool scheduled_io(VALUE io) {
+#if HAVE_RB_FIBER_SCHEDULER_CURRENT && HAVE_RB_IO_WAIT
+    rb_io_t *fptr;
+
+    if (T_FILE != rb_type(io) || Qnil == rb_fiber_scheduler_current()) {
+        return false;
+    }
+    GetOpenFile(io, fptr);
+
+    return (0 == rb_io_read_pending(fptr));
+#else
+    return false;
+#endif
+}
 
 void ox_sax_buf_init(Buf buf, VALUE io) {
     volatile VALUE io_class = rb_obj_class(io);
     VALUE          rfd;
+    size_t         size = sizeof(buf->base);
 
-    if (rb_cString == io_class) {
+    buf->head    = buf->base;
+    buf->wait_io = Qnil;
+    buf->zin     = NULL;
+    if (Qnil == io) {
+        // Ox::Sax::Parser sets in.push after the drive is initialized.
+        buf->read_func = read_from_push;
+        buf->in.push   = NULL;
+    } else if (rb_cString == io_class) {
         buf->read_func = read_from_str;
         buf->in.str    = StringValuePtr(io);
     } else if (ox_stringio_class == io_class && 0 == FIX2INT(rb_funcall2(io, ox_pos_id, 0, 0))) {
@@ -40,9 +77,14 @@ void ox_sax_buf_init(Buf buf, VALUE io) {
 
         buf->read_func = read_from_str;
         buf->in.str    = StringValuePtr(s);
-    } else if (rb_cFile == io_class && Qnil != (rfd = rb_funcall(io, ox_fileno_id, 0))) {
+    } else if ((rb_cFile == io_class || scheduled_io(io)) && Qnil != (rfd = rb_funcall(io, ox_fileno_id, 0))) {
         buf->read_func = read_from_fd;
         buf->in.fd     = FIX2INT(rfd);
+        buf->wait_io   = io;
+        // Fewer, larger reads matter more than the allocation when each one
+        // is a system call and possibly a trip through the scheduler.
+        size      = FD_BUF_SIZE;
+        buf->head = ALLOC_N(char, size);
     } else if (rb_respond_to(io, ox_readpartial_id)) {
         buf->read_func = read_from_io_partial;
         buf->in.io     = io;
@@ -52,9 +94,8 @@ void ox_sax_buf_init(Buf buf, VALUE io) {
     } else {
         rb_raise(ox_arg_error_class, "sax_parser io argument must respond to readpartial() or read().\n");
     }
-    buf->head     = buf->base;
     *buf->head    = '\0';
-    buf->end      = buf->head + sizeof(buf->base) - BUF_PAD;
+    buf->end      = buf->head + size - BUF_PAD;
     buf->tail     = buf->head;
     buf->read_end = buf->head;
     buf->pro      = 0;
@@ -65,6 +106,7 @@ void ox_sax_buf_init(Buf buf, VALUE io) {
     buf->pro_pos  = 1;
     buf->pro_line = 1;
     buf->pro_col  = 0;
+    buf->locate   = true;
     buf->dr       = 0;
 }
 
@@ -172,11 +214,27 @@ static int read_from_io(Buf buf) {
     return (Qfalse == rb_rescue(io_cb, (VALUE)buf, rescue_cb, (VALUE)buf));
 }
 
-static int read_from_fd(Buf buf) {
+static ssize_t fd_read(Buf buf, char *dst, size_t max) {
     ssize_t cnt;
-    size_t  max = buf->end - buf->tail;
 
-    cnt = read(buf->in.fd, buf->tail, max);
+    while (0 > (cnt = read(buf->in.fd, dst, max))) {
+#if HAVE_RB_IO_WAIT
+        // Ruby makes pipes and sockets non-blocking. Waiting through the IO
+        // yields to the fiber scheduler if there is one and otherwise waits
+        // without holding the GVL.
+        if ((EAGAIN == errno || EWOULDBLOCK == errno) && Qnil != buf->wait_io) {
+            rb_io_wait(buf->wait_io, RB_INT2NUM(RUBY_IO_READABLE), Qnil);
+            continue;
+        }
+#endif
+        break;
+    }
+    return cnt;
+}
+
+static int read_from_fd(Buf buf) {
+    ssize_t cnt = fd_read(buf, buf->tail, buf->end - buf->tail);
+
     if (cnt < 0) {
         ox_sax_drive_error(buf->dr, "failed to read from file");
         return -1;
@@ -207,3 +265,190 @@ static int read_from_str(Buf buf) {
 
     return 0;
 }
+
+// Called on the parser fiber. When the pushed chunk has been consumed control
+// goes back to the caller of Ox::Sax::Parser#<< until more data arrives or
+// finish is called.
+static int read_from_push(Buf buf) {
+    PushIn in  = buf->in.push;
+    size_t max = buf->end - buf->tail - 1;
+    size_t cnt;
+
+    while (0 == in->len) {
+        if (in->done) {
+            return -1;
+        }
+        rb_fiber_yield(0, 0);
+    }
+    cnt = (max < in->len) ? max : in->len;
+    memcpy(buf->tail, in->str, cnt);
+    in->str += cnt;
+    in->len -= cnt;
+    buf->read_end = buf->tail + cnt;
+
+    return 0;
+}
+
+#if HAVE_ZLIB_H
+#define Z_SRC_SIZE 0x00010000
+
+// Compressed input is inflated straight into the parse buffer. The source
+// bytes are read with the same method the plain input would have used but
+// into a separate buffer, or for a String are taken in place.
+typedef struct _zIn {
+    z_stream zs;
+    int (*src_func)(Buf buf);  // read function for the uncompressed input
+    bool        src_done;
+    const char *rest;  // input not yet handed to zlib
+    size_t      rest_len;
+    char        src[Z_SRC_SIZE];
+} *ZIn;
+
+// Hands zlib the next part of rest. avail_in is only an unsigned int so
+// input over 4GB is given in parts. Returns false if rest is empty.
+static bool feed_src(ZIn zin) {
+    uInt cnt = (UINT_MAX < zin->rest_len) ? UINT_MAX : (uInt)zin->rest_len;
+
+    zin->zs.next_in  = (Bytef *)zin->rest;
+    zin->zs.avail_in = cnt;
+    zin->rest += cnt;
+    zin->rest_len -= cnt;
+
+    return 0 < cnt;
+}
+
+static VALUE src_io_cb(VALUE rbuf) {
+    Buf    buf = (Buf)rbuf;
+    ZIn    zin = buf->zin;
+    VALUE  args[1];
+    VALUE  rstr;
+    size_t cnt;
+
+    args[0] = ULONG2NUM(sizeof(zin->src));
+    rstr    = rb_funcall2(buf->in.io, (read_from_io == zin->src_func) ? ox_read_id : ox_readpartial_id, 1, args);
+    if (Qnil == rstr) {
+        return Qfalse;
+    }
+    cnt = RSTRING_LEN(rstr);
+    if (sizeof(zin->src) < cnt) {
+        cnt = sizeof(zin->src);
+    }
+    memcpy(zin->src, RSTRING_PTR(rstr), cnt);
+    zin->zs.next_in  = (Bytef *)zin->src;
+    zin->zs.avail_in = (uInt)cnt;
+
+    return Qtrue;
+}
+
+// Refills the compressed input. Returns false if there is no more.
+static bool fill_src(Buf buf) {
+    ZIn     zin = buf->zin;
+    ssize_t cnt = 0;
+
+    if (read_from_fd == zin->src_func) {
+        if (0 > (cnt = fd_read(buf, zin->src, sizeof(zin->src)))) {
+            ox_sax_drive_error(buf->dr, "failed to read from file");
+            cnt = 0;
+        }
+    } else if (read_from_push == zin->src_func) {
+        PushIn in = buf->in.push;
+
+        while (0 == in->len && !in->done) {
+            rb_fiber_yield(0, 0);
+        }
+        // The chunk stays alive until the parser is resumed and that only
+        // happens after all of it has been consumed.
+        zin->rest     = in->str;
+        zin->rest_len = in->len;
+        in->str += in->len;
+        in->len = 0;
+        return feed_src(zin);
+    } else if (read_from_io == zin->src_func || read_from_io_partial == zin->src_func) {
+        zin->zs.avail_in = 0;
+        rb_rescue(src_io_cb, (VALUE)buf, rescue_cb, (VALUE)buf);
+        return 0 < zin->zs.avail_in;
+    }
+    zin->zs.next_in  = (Bytef *)zin->src;
+    zin->zs.avail_in = (uInt)cnt;
+
+    return 0 < cnt;
+}
+
+static int read_from_inflate(Buf buf) {
+    ZIn    zin = buf->zin;
+    size_t max = buf->end - buf->tail - 1;
+    int    ret;
+
+    while (true) {
+        if (0 == zin->zs.avail_in && !feed_src(zin) && !zin->src_done && !fill_src(buf)) {
+            zin->src_done = true;
+        }
+        zin->zs.next_out  = (Bytef *)buf->tail;
+        zin->zs.avail_out = (uInt)max;
+        ret               = inflate(&zin->zs, Z_NO_FLUSH);
+        if (zin->zs.avail_out < max) {
+            buf->read_end = buf->tail + (max - zin->zs.avail_out);
+            return 0;
+        }
+        switch (ret) {
+        case Z_OK: break;
+        case Z_STREAM_END:
+            // A gzip file can be several members one after the other.
+            if (0 == zin->zs.avail_in && !feed_src(zin) && (zin->src_done || !fill_src(buf))) {
+                return -1;
+            }
+            inflateReset(&zin->zs);
+            break;
+        case Z_BUF_ERROR:
+            if (zin->src_done) {
+                ox_sax_drive_error(buf->dr, "compressed input is truncated");
+                return -1;
+            }
+            break;
+        default: ox_sax_drive_error(buf->dr, "failed to inflate compressed input"); return -1;
+        }
+    }
+}
+#endif
+
+/* Switches the input to be inflated as it is read. Both gzip and zlib
+ * headers are detected.
+ */
+void ox_sax_buf_inflate(Buf buf, VALUE io) {
+#if HAVE_ZLIB_H
+    ZIn zin = ZALLOC(struct _zIn);
+
+    zin->src_func = buf->read_func;
+    if (Z_OK != inflateInit2(&zin->zs, 15 + 32)) {
+        xfree(zin);
+        rb_raise(ox_parse_error_class, "failed to initialize zlib.\n");
+    }
+    if (read_from_str == buf->read_func) {
+        // A String is binary so the whole thing is the compressed input.
+        volatile VALUE s = (rb_cString == rb_obj_class(io)) ? io : rb_funcall2(io, ox_string_id, 0, 0);
+
+        zin->rest     = RSTRING_PTR(s);
+        zin->rest_len = (size_t)RSTRING_LEN(s);
+        zin->src_done = true;
+    }
+    buf->zin       = zin;
+    buf->read_func = read_from_inflate;
+    if (buf->base == buf->head) {
+        buf->head     = ALLOC_N(char, FD_BUF_SIZE);
+        *buf->head    = '\0';
+        buf->end      = buf->head + FD_BUF_SIZE - BUF_PAD;
+        buf->tail     = buf->head;
+        buf->read_end = buf->head;
+    }
+#else
+    rb_raise(rb_eNotImpError, "Ox was built without zlib so compressed input is not supported.\n");
+#endif
+}
+
+void ox_sax_buf_inflate_cleanup(Buf buf) {
+#if HAVE_ZLIB_H
+    inflateEnd(&buf->zin->zs);
+    xfree(buf->zin);
+    buf->zin = NULL;
+#endif
+}
@@ -6,8 +6,15 @@
 #ifndef OX_SAX_BUF_H
 #define OX_SAX_BUF_H
 
+#include <stdbool.h>
 #include <stdio.h>
 
+typedef struct _pushIn {
+    const char *str; /* unread part of the most recently pushed chunk */
+    size_t      len;
+    bool        done; /* set when no more chunks will be pushed */
+} *PushIn;
+
 typedef struct _buf {
     char  base[0x00001000];
     char *head;
@@ -27,7 +34,11 @@ typedef struct _buf {
         int         fd;
         VALUE       io;
         const char *str;
+        PushIn      push;
     } in;
+    VALUE             wait_io; /* IO to wait on when a non-blocking fd is not ready */
+    struct _zIn      *zin;     /* inflate state when the input is compressed */
+    bool              locate;  /* track line and column */
     struct _saxDrive *dr;
 } *Buf;
 
@@ -42,6 +53,8 @@ typedef struct _checkPt {
 #define CHECK_PT_INIT {-1, 0, 0, 0, '\0'}
 
 extern void ox_sax_buf_init(Buf buf, VALUE io);
+extern void ox_sax_buf_inflate(Buf buf, VALUE io);
+extern void ox_sax_buf_inflate_cleanup(Buf buf);
 extern int  ox_sax_buf_read(Buf buf);
 
 static inline char buf_get(Buf buf) {
@@ -52,11 +65,13 @@ static inline char buf_get(Buf buf) {
             return '\0';
         }
     }
-    if ('\n' == *buf->tail) {
-        buf->line++;
-        buf->col = 0;
-    } else {
-        buf->col++;
+    if (buf->locate) {
+        if ('\n' == *buf->tail) {
+            buf->line++;
+            buf->col = 0;
+        } else {
+            buf->col++;
+        }
     }
     buf->pos++;
 
@@ -65,11 +80,13 @@ static inline char buf_get(Buf buf) {
 
 static inline void buf_backup(Buf buf) {
     buf->tail--;
-    buf->col--;
     buf->pos--;
-    if (0 >= buf->col) {
-        buf->line--;
-        // allow col to be negative since we never backup twice in a row
+    if (buf->locate) {
+        buf->col--;
+        if (0 >= buf->col) {
+            buf->line--;
+            // allow col to be negative since we never backup twice in a row
+        }
     }
 }
 
@@ -88,6 +105,18 @@ static inline void buf_reset(Buf buf) {
     buf->col  = buf->pro_col;
 }
 
+/* Moves the protection forward to at, a point already read, so the part
+ * before it can slide out of the buffer. Only the position is kept exact so
+ * buf_reset() should not be used afterwards.
+ */
+static inline void buf_release(Buf buf, char *at) {
+    buf->pro_pos  = buf->pos - (buf->tail - at);
+    buf->pro_line = buf->line;
+    buf->pro_col  = buf->col;
+    buf->pro      = at;
+    buf->str      = at;
+}
+
 /* Starts by reading a character so it is safe to use with an empty or
  * compacted buffer.
  */
@@ -128,6 +157,9 @@ static inline char buf_next_white(Buf buf) {
 }
 
 static inline void buf_cleanup(Buf buf) {
+    if (NULL != buf->zin) {
+        ox_sax_buf_inflate_cleanup(buf);
+    }
     if (buf->base != buf->head && 0 != buf->head) {
         xfree(buf->head);
         buf->head = 0;
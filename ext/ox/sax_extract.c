@@ -0,0 +1,211 @@
+/* sax_extract.c
+ * Copyright (c) 2011, Peter Ohler
+ * All rights reserved.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ox.h"
+#include "ruby.h"
+#include "sax.h"
+
+// The extractor is a SAX handler implemented in C. Its callbacks are set
+// directly on the drive so no Ruby method is called per event. Outside of a
+// matching element events are ignored. Inside, they are fed to the same
+// builder used by hash_load.c so each yielded Hash has the shape Ox.load()
+// gives in :hash or :hash_no_attrs mode.
+typedef struct _saxExtract {
+    struct _pInfo   pi;
+    struct _options options;
+    VALUE           match;    // element name as a Symbol or String
+    VALUE           name;     // name of an element waiting for attributes
+    VALUE           attrs;    // attributes of the waiting element or Qnil
+    int             depth;    // 0 outside of a matching element
+    bool            pending;  // an element is waiting for attrs_done
+    bool            with_attrs;
+} *SaxExtract;
+
+static void extract_mark(void *ptr) {
+    SaxExtract ex = (SaxExtract)ptr;
+    Helper     h;
+
+    if (NULL == ex) {
+        return;
+    }
+    rb_gc_mark(ex->match);
+    rb_gc_mark(ex->name);
+    rb_gc_mark(ex->attrs);
+    rb_gc_mark(ex->pi.obj);
+    rb_gc_mark(ex->options.attr_key_mod);
+    rb_gc_mark(ex->options.element_key_mod);
+    if (NULL != ex->pi.helpers.head) {
+        for (h = ex->pi.helpers.head; h < ex->pi.helpers.tail; h++) {
+            rb_gc_mark(h->obj);
+        }
+    }
+}
+
+static void extract_free(void *ptr) {
+    SaxExtract ex = (SaxExtract)ptr;
+
+    if (NULL != ex) {
+        helper_stack_cleanup(&ex->pi.helpers);
+        xfree(ex->pi.marked);
+        xfree(ex);
+    }
+}
+
+static const rb_data_type_t ox_sax_extract_type = {
+    "Ox/Sax/Extract",
+    {
+        extract_mark,
+        extract_free,
+        NULL,
+    },
+    0,
+    0,
+};
+
+static void push_pending(SaxExtract ex) {
+    if (ex->pending) {
+        volatile VALUE name = ex->name;
+
+        ex->pending = false;
+        ox_hash_start_element(&ex->pi, SYMBOL_P(name) ? SYM2ID(name) : rb_intern_str(name), ex->attrs);
+        ex->name  = Qnil;
+        ex->attrs = Qnil;
+    }
+}
+
+static bool is_match(SaxExtract ex, VALUE name) {
+    if (SYMBOL_P(name)) {
+        return name == ex->match;
+    }
+    return T_STRING == rb_type(ex->match) && Qtrue == rb_str_equal(name, ex->match);
+}
+
+static VALUE start_element(VALUE self, int argc, const VALUE *argv) {
+    SaxExtract ex = (SaxExtract)DATA_PTR(self);
+
+    push_pending(ex);
+    if (0 < ex->depth || is_match(ex, *argv)) {
+        ex->depth++;
+        ex->name    = *argv;
+        ex->attrs   = Qnil;
+        ex->pending = true;
+    }
+    return Qnil;
+}
+
+static VALUE attr(VALUE self, int argc, const VALUE *argv) {
+    SaxExtract     ex = (SaxExtract)DATA_PTR(self);
+    volatile VALUE key;
+
+    if (!ex->pending) {
+        return Qnil;
+    }
+    key = argv[0];
+    if (Qnil != ex->options.attr_key_mod) {
+        key = rb_funcall(ex->options.attr_key_mod, ox_call_id, 1, SYMBOL_P(key) ? rb_sym2str(key) : key);
+    }
+    if (Qnil == ex->attrs) {
+        ex->attrs = rb_hash_new();
+    }
+    rb_hash_aset(ex->attrs, key, argv[1]);
+
+    return Qnil;
+}
+
+static VALUE attrs_done(VALUE self, int argc, const VALUE *argv) {
+    push_pending((SaxExtract)DATA_PTR(self));
+
+    return Qnil;
+}
+
+static VALUE text(VALUE self, int argc, const VALUE *argv) {
+    SaxExtract ex = (SaxExtract)DATA_PTR(self);
+
+    if (0 < ex->depth) {
+        push_pending(ex);
+        ox_hash_add_str(&ex->pi, *argv);
+    }
+    return Qnil;
+}
+
+static VALUE end_element(VALUE self, int argc, const VALUE *argv) {
+    SaxExtract     ex = (SaxExtract)DATA_PTR(self);
+    volatile VALUE obj;
+
+    if (0 == ex->depth) {
+        return Qnil;
+    }
+    push_pending(ex);
+    ox_hash_end_element(&ex->pi, ex->with_attrs);
+    if (0 == --ex->depth) {
+        // Drop all references to the record before yielding so memory is
+        // bounded by the record being built.
+        obj                 = ex->pi.obj;
+        ex->pi.obj          = Qnil;
+        ex->pi.helpers.tail = ex->pi.helpers.head;
+        ex->pi.mark_cnt     = 0;
+        rb_yield(obj);
+    }
+    return Qnil;
+}
+
+// Called for every drive after the normal callback resolution. Nothing is
+// changed unless the handler is an extractor.
+void ox_sax_extract_resolve(SaxDrive dr) {
+    SaxExtract ex;
+
+    if (!rb_typeddata_is_kind_of(dr->handler, &ox_sax_extract_type)) {
+        return;
+    }
+    ex = (SaxExtract)DATA_PTR(dr->handler);
+
+    dr->calls[StartElementCall].recv  = dr->handler;
+    dr->calls[StartElementCall].cfunc = start_element;
+    dr->calls[AttrsDoneCall].recv     = dr->handler;
+    dr->calls[AttrsDoneCall].cfunc    = attrs_done;
+    dr->calls[TextCall].recv          = dr->handler;
+    dr->calls[TextCall].cfunc         = text;
+    dr->calls[EndElementCall].recv    = dr->handler;
+    dr->calls[EndElementCall].cfunc   = end_element;
+    if (ex->with_attrs) {
+        dr->calls[AttrCall].recv  = dr->handler;
+        dr->calls[AttrCall].cfunc = attr;
+    }
+    if (ex->options.with_cdata) {
+        dr->calls[CdataCall].recv  = dr->handler;
+        dr->calls[CdataCall].cfunc = text;
+    }
+}
+
+/* Streams +io+ through the SAX drive and yields the Hash for each element
+ * named +element+. The +hopts+ are the load options that control the shape
+ * of the Hash as they would for Ox.load().
+ */
+void ox_sax_extract(VALUE io, SaxOptions options, Options hopts, VALUE element, bool attrs) {
+    volatile VALUE handler;
+    SaxExtract     ex;
+
+    handler            = TypedData_Make_Struct(rb_cObject, struct _saxExtract, &ox_sax_extract_type, ex);
+    ex->match          = Qnil;
+    ex->name           = Qnil;
+    ex->attrs          = Qnil;
+    ex->pi.obj         = Qnil;
+    ex->options        = *hopts;
+    ex->options.rb_enc = 0;  // the SAX drive sets the encoding of strings
+    ex->pi.options     = &ex->options;
+    ex->with_attrs     = attrs;
+    helper_stack_init(&ex->pi.helpers);
+    if (options->symbolize) {
+        ex->match = rb_str_intern(element);
+    } else {
+        ex->match = rb_str_new_frozen(element);
+    }
+    ox_sax_parse(handler, io, options);
+    RB_GC_GUARD(handler);
+}
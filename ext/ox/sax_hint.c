@@ -7,6 +7,7 @@
 
 #include <ruby.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -28,179 +29,249 @@ static const char *table_0[]                    = {"table", 0};
 static const char *tr_0[]                       = {"tr", 0};
 
 static struct _hint html_hint_array[] = {
-    {"!--", false, false, false, ActiveOverlay, NULL},  // comment
-    {"a", false, false, false, ActiveOverlay, NULL},
-    {"abbr", false, false, false, ActiveOverlay, NULL},
-    {"acronym", false, false, false, ActiveOverlay, NULL},
-    {"address", false, false, false, ActiveOverlay, NULL},
-    {"applet", false, false, false, ActiveOverlay, NULL},
-    {"area", true, false, false, ActiveOverlay, map_0},
-    {"article", false, false, false, ActiveOverlay, NULL},
-    {"aside", false, false, false, ActiveOverlay, NULL},
-    {"audio", false, false, false, ActiveOverlay, NULL},
-    {"b", false, false, false, ActiveOverlay, NULL},
-    {"base", true, false, false, ActiveOverlay, head_0},
-    {"basefont", true, false, false, ActiveOverlay, head_0},
-    {"bdi", false, false, false, ActiveOverlay, NULL},
-    {"bdo", false, true, false, ActiveOverlay, NULL},
-    {"big", false, false, false, ActiveOverlay, NULL},
-    {"blockquote", false, false, false, ActiveOverlay, NULL},
-    {"body", false, false, false, ActiveOverlay, html_0},
-    {"br", true, false, false, ActiveOverlay, NULL},
-    {"button", false, false, false, ActiveOverlay, NULL},
-    {"canvas", false, false, false, ActiveOverlay, NULL},
-    {"caption", false, false, false, ActiveOverlay, table_0},
-    {"center", false, false, false, ActiveOverlay, NULL},
-    {"cite", false, false, false, ActiveOverlay, NULL},
-    {"code", false, false, false, ActiveOverlay, NULL},
-    {"col", true, false, false, ActiveOverlay, colgroup_0},
-    {"colgroup", false, false, false, ActiveOverlay, NULL},
-    {"command", true, false, false, ActiveOverlay, NULL},
-    {"datalist", false, false, false, ActiveOverlay, NULL},
-    {"dd", false, false, false, ActiveOverlay, dl_0},
-    {"del", false, false, false, ActiveOverlay, NULL},
-    {"details", false, false, false, ActiveOverlay, NULL},
-    {"dfn", false, false, false, ActiveOverlay, NULL},
-    {"dialog", false, false, false, ActiveOverlay, dt_th_0},
-    {"dir", false, false, false, ActiveOverlay, NULL},
-    {"div", false, true, false, ActiveOverlay, NULL},
-    {"dl", false, false, false, ActiveOverlay, NULL},
-    {"dt", false, true, false, ActiveOverlay, dl_0},
-    {"em", false, false, false, ActiveOverlay, NULL},
-    {"embed", true, false, false, ActiveOverlay, NULL},
-    {"fieldset", false, false, false, ActiveOverlay, NULL},
-    {"figcaption", false, false, false, ActiveOverlay, figure_0},
-    {"figure", false, false, false, ActiveOverlay, NULL},
-    {"font", false, true, false, ActiveOverlay, NULL},
-    {"footer", false, false, false, ActiveOverlay, NULL},
-    {"form", false, false, false, ActiveOverlay, NULL},
-    {"frame", true, false, false, ActiveOverlay, frameset_0},
-    {"frameset", false, false, false, ActiveOverlay, NULL},
-    {"h1", false, false, false, ActiveOverlay, NULL},
-    {"h2", false, false, false, ActiveOverlay, NULL},
-    {"h3", false, false, false, ActiveOverlay, NULL},
-    {"h4", false, false, false, ActiveOverlay, NULL},
-    {"h5", false, false, false, ActiveOverlay, NULL},
-    {"h6", false, false, false, ActiveOverlay, NULL},
-    {"head", false, false, false, ActiveOverlay, html_0},
-    {"header", false, false, false, ActiveOverlay, NULL},
-    {"hgroup", false, false, false, ActiveOverlay, NULL},
-    {"hr", true, false, false, ActiveOverlay, NULL},
-    {"html", false, false, false, ActiveOverlay, NULL},
-    {"i", false, false, false, ActiveOverlay, NULL},
-    {"iframe", true, false, false, ActiveOverlay, NULL},
-    {"img", true, false, false, ActiveOverlay, NULL},
-    {"input", true, false, false, ActiveOverlay, NULL},  // somewhere under a form_0
-    {"ins", false, false, false, ActiveOverlay, NULL},
-    {"kbd", false, false, false, ActiveOverlay, NULL},
-    {"keygen", true, false, false, ActiveOverlay, NULL},
-    {"label", false, false, false, ActiveOverlay, NULL},  // somewhere under a form_0
-    {"legend", false, false, false, ActiveOverlay, fieldset_0},
-    {"li", false, false, false, ActiveOverlay, ol_ul_menu_0},
-    {"link", true, false, false, ActiveOverlay, head_0},
-    {"map", false, false, false, ActiveOverlay, NULL},
-    {"mark", false, false, false, ActiveOverlay, NULL},
-    {"menu", false, false, false, ActiveOverlay, NULL},
-    {"meta", true, false, false, ActiveOverlay, head_0},
-    {"meter", false, false, false, ActiveOverlay, NULL},
-    {"nav", false, false, false, ActiveOverlay, NULL},
-    {"noframes", false, false, false, ActiveOverlay, NULL},
-    {"noscript", false, false, false, ActiveOverlay, NULL},
-    {"object", false, false, false, ActiveOverlay, NULL},
-    {"ol", false, true, false, ActiveOverlay, NULL},
-    {"optgroup", false, false, false, ActiveOverlay, NULL},
-    {"option", false, false, false, ActiveOverlay, optgroup_select_datalist_0},
-    {"output", false, false, false, ActiveOverlay, NULL},
-    {"p", false, false, false, ActiveOverlay, NULL},
-    {"param", true, false, false, ActiveOverlay, NULL},
-    {"pre", false, false, false, ActiveOverlay, NULL},
-    {"progress", false, false, false, ActiveOverlay, NULL},
-    {"q", false, false, false, ActiveOverlay, NULL},
-    {"rp", false, false, false, ActiveOverlay, ruby_0},
-    {"rt", false, false, false, ActiveOverlay, ruby_0},
-    {"ruby", false, false, false, ActiveOverlay, NULL},
-    {"s", false, false, false, ActiveOverlay, NULL},
-    {"samp", false, false, false, ActiveOverlay, NULL},
-    {"script", false, false, true, ActiveOverlay, NULL},
-    {"section", false, true, false, ActiveOverlay, NULL},
-    {"select", false, false, false, ActiveOverlay, NULL},
-    {"small", false, false, false, ActiveOverlay, NULL},
-    {"source", false, false, false, ActiveOverlay, audio_video_0},
-    {"span", false, true, false, ActiveOverlay, NULL},
-    {"strike", false, false, false, ActiveOverlay, NULL},
-    {"strong", false, false, false, ActiveOverlay, NULL},
-    {"style", false, false, false, ActiveOverlay, NULL},
-    {"sub", false, false, false, ActiveOverlay, NULL},
-    {"summary", false, false, false, ActiveOverlay, details_0},
-    {"sup", false, false, false, ActiveOverlay, NULL},
-    {"table", false, false, false, ActiveOverlay, NULL},
-    {"tbody", false, false, false, ActiveOverlay, table_0},
-    {"td", false, false, false, ActiveOverlay, tr_0},
-    {"textarea", false, false, false, ActiveOverlay, NULL},
-    {"tfoot", false, false, false, ActiveOverlay, table_0},
-    {"th", false, false, false, ActiveOverlay, tr_0},
-    {"thead", false, false, false, ActiveOverlay, table_0},
-    {"time", false, false, false, ActiveOverlay, NULL},
-    {"title", false, false, false, ActiveOverlay, head_0},
-    {"tr", false, false, false, ActiveOverlay, table_0},
-    {"track", true, false, false, ActiveOverlay, audio_video_0},
-    {"tt", false, false, false, ActiveOverlay, NULL},
-    {"u", false, false, false, ActiveOverlay, NULL},
-    {"ul", false, false, false, ActiveOverlay, NULL},
-    {"var", false, false, false, ActiveOverlay, NULL},
-    {"video", false, false, false, ActiveOverlay, NULL},
-    {"wbr", true, false, false, ActiveOverlay, NULL},
+    {"!--", false, false, false, NULL},  // comment
+    {"a", false, false, false, NULL},
+    {"abbr", false, false, false, NULL},
+    {"acronym", false, false, false, NULL},
+    {"address", false, false, false, NULL},
+    {"applet", false, false, false, NULL},
+    {"area", true, false, false, map_0},
+    {"article", false, false, false, NULL},
+    {"aside", false, false, false, NULL},
+    {"audio", false, false, false, NULL},
+    {"b", false, false, false, NULL},
+    {"base", true, false, false, head_0},
+    {"basefont", true, false, false, head_0},
+    {"bdi", false, false, false, NULL},
+    {"bdo", false, true, false, NULL},
+    {"big", false, false, false, NULL},
+    {"blockquote", false, false, false, NULL},
+    {"body", false, false, false, html_0},
+    {"br", true, false, false, NULL},
+    {"button", false, false, false, NULL},
+    {"canvas", false, false, false, NULL},
+    {"caption", false, false, false, table_0},
+    {"center", false, false, false, NULL},
+    {"cite", false, false, false, NULL},
+    {"code", false, false, false, NULL},
+    {"col", true, false, false, colgroup_0},
+    {"colgroup", false, false, false, NULL},
+    {"command", true, false, false, NULL},
+    {"datalist", false, false, false, NULL},
+    {"dd", false, false, false, dl_0},
+    {"del", false, false, false, NULL},
+    {"details", false, false, false, NULL},
+    {"dfn", false, false, false, NULL},
+    {"dialog", false, false, false, dt_th_0},
+    {"dir", false, false, false, NULL},
+    {"div", false, true, false, NULL},
+    {"dl", false, false, false, NULL},
+    {"dt", false, true, false, dl_0},
+    {"em", false, false, false, NULL},
+    {"embed", true, false, false, NULL},
+    {"fieldset", false, false, false, NULL},
+    {"figcaption", false, false, false, figure_0},
+    {"figure", false, false, false, NULL},
+    {"font", false, true, false, NULL},
+    {"footer", false, false, false, NULL},
+    {"form", false, false, false, NULL},
+    {"frame", true, false, false, frameset_0},
+    {"frameset", false, false, false, NULL},
+    {"h1", false, false, false, NULL},
+    {"h2", false, false, false, NULL},
+    {"h3", false, false, false, NULL},
+    {"h4", false, false, false, NULL},
+    {"h5", false, false, false, NULL},
+    {"h6", false, false, false, NULL},
+    {"head", false, false, false, html_0},
+    {"header", false, false, false, NULL},
+    {"hgroup", false, false, false, NULL},
+    {"hr", true, false, false, NULL},
+    {"html", false, false, false, NULL},
+    {"i", false, false, false, NULL},
+    {"iframe", true, false, false, NULL},
+    {"img", true, false, false, NULL},
+    {"input", true, false, false, NULL},  // somewhere under a form_0
+    {"ins", false, false, false, NULL},
+    {"kbd", false, false, false, NULL},
+    {"keygen", true, false, false, NULL},
+    {"label", false, false, false, NULL},  // somewhere under a form_0
+    {"legend", false, false, false, fieldset_0},
+    {"li", false, false, false, ol_ul_menu_0},
+    {"link", true, false, false, head_0},
+    {"map", false, false, false, NULL},
+    {"mark", false, false, false, NULL},
+    {"menu", false, false, false, NULL},
+    {"meta", true, false, false, head_0},
+    {"meter", false, false, false, NULL},
+    {"nav", false, false, false, NULL},
+    {"noframes", false, false, false, NULL},
+    {"noscript", false, false, false, NULL},
+    {"object", false, false, false, NULL},
+    {"ol", false, true, false, NULL},
+    {"optgroup", false, false, false, NULL},
+    {"option", false, false, false, optgroup_select_datalist_0},
+    {"output", false, false, false, NULL},
+    {"p", false, false, false, NULL},
+    {"param", true, false, false, NULL},
+    {"pre", false, false, false, NULL},
+    {"progress", false, false, false, NULL},
+    {"q", false, false, false, NULL},
+    {"rp", false, false, false, ruby_0},
+    {"rt", false, false, false, ruby_0},
+    {"ruby", false, false, false, NULL},
+    {"s", false, false, false, NULL},
+    {"samp", false, false, false, NULL},
+    {"script", false, false, true, NULL},
+    {"section", false, true, false, NULL},
+    {"select", false, false, false, NULL},
+    {"small", false, false, false, NULL},
+    {"source", false, false, false, audio_video_0},
+    {"span", false, true, false, NULL},
+    {"strike", false, false, false, NULL},
+    {"strong", false, false, false, NULL},
+    {"style", false, false, false, NULL},
+    {"sub", false, false, false, NULL},
+    {"summary", false, false, false, details_0},
+    {"sup", false, false, false, NULL},
+    {"table", false, false, false, NULL},
+    {"tbody", false, false, false, table_0},
+    {"td", false, false, false, tr_0},
+    {"textarea", false, false, false, NULL},
+    {"tfoot", false, false, false, table_0},
+    {"th", false, false, false, tr_0},
+    {"thead", false, false, false, table_0},
+    {"time", false, false, false, NULL},
+    {"title", false, false, false, head_0},
+    {"tr", false, false, false, table_0},
+    {"track", true, false, false, audio_video_0},
+    {"tt", false, false, false, NULL},
+    {"u", false, false, false, NULL},
+    {"ul", false, false, false, NULL},
+    {"var", false, false, false, NULL},
+    {"video", false, false, false, NULL},
+    {"wbr", true, false, false, NULL},
 };
-static struct _hints html_hints = {"HTML", html_hint_array, sizeof(html_hint_array) / sizeof(*html_hint_array)};
+static char         html_overlays[sizeof(html_hint_array) / sizeof(*html_hint_array)];
+static struct _hints html_hints = {"HTML",
+                                   html_hint_array,
+                                   sizeof(html_hint_array) / sizeof(*html_hint_array),
+                                   html_overlays};
+
+// The names are looked up with a hash and displace perfect hash built once
+// at load time. A case folded FNV-1a hash of the name picks a bucket and the
+// displacement stored for that bucket is mixed into the same hash to pick a
+// slot. Displacements are chosen so that every name lands in its own slot so
+// a lookup is one pass over the name and a single strcasecmp() to confirm.
+#define HINT_BUCKETS 64
+#define HINT_SLOTS 256
+
+static uint16_t html_disp[HINT_BUCKETS];
+static uint8_t  html_slots[HINT_SLOTS];  // hint id + 1, zero if empty
+
+inline static uint32_t hint_hash(const char *name) {
+    uint32_t h = 2166136261U;
+
+    for (; '\0' != *name; name++) {
+        h = (h ^ (uint8_t)(*name | 0x20)) * 16777619U;
+    }
+    return h;
+}
+
+inline static int hint_slot(uint32_t h, uint16_t d) {
+    return (int)(((h ^ d) * 2654435761U) >> 24);
+}
+
+void ox_hints_init(void) {
+    uint32_t hashes[sizeof(html_hint_array) / sizeof(*html_hint_array)];
+    uint8_t  members[sizeof(html_hint_array) / sizeof(*html_hint_array)];
+    int      counts[HINT_BUCKETS];
+    int      order[HINT_BUCKETS];
+    int      i;
+    int      j;
+    int      k;
+    int      cnt;
+
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < html_hints.size; i++) {
+        hashes[i] = hint_hash(html_hint_array[i].name);
+        counts[hashes[i] % HINT_BUCKETS]++;
+    }
+    // Place the fullest buckets first while there is the most room.
+    for (i = 0; i < HINT_BUCKETS; i++) {
+        for (j = i; 0 < j && counts[order[j - 1]] < counts[i]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+    for (i = 0; i < HINT_BUCKETS && 0 < counts[order[i]]; i++) {
+        int      b = order[i];
+        uint16_t d;
+
+        for (cnt = 0, j = 0; j < html_hints.size; j++) {
+            if (b == (int)(hashes[j] % HINT_BUCKETS)) {
+                members[cnt++] = (uint8_t)j;
+            }
+        }
+        for (d = 1; 0 != d; d++) {
+            for (j = 0; j < cnt; j++) {
+                int s = hint_slot(hashes[members[j]], d);
+
+                if (0 != html_slots[s]) {
+                    break;
+                }
+                for (k = 0; k < j && s != hint_slot(hashes[members[k]], d); k++) {
+                }
+                if (k < j) {
+                    break;
+                }
+            }
+            if (j == cnt) {
+                break;
+            }
+        }
+        html_disp[b] = d;
+        for (j = 0; j < cnt; j++) {
+            html_slots[hint_slot(hashes[members[j]], d)] = members[j] + 1;
+        }
+    }
+}
 
 Hints ox_hints_html(void) {
     return &html_hints;
 }
 
 Hints ox_hints_dup(Hints h) {
-    Hints nh = ALLOC(struct _hints);
+    Hints nh = (Hints)ALLOC_N(char, sizeof(struct _hints) + h->size);
 
-    nh->hints = ALLOC_N(struct _hint, h->size);
-    memcpy(nh->hints, h->hints, sizeof(struct _hint) * h->size);
-    nh->size = h->size;
-    nh->name = h->name;
+    ox_hints_overlay(nh, h, (char *)(nh + 1));
 
     return nh;
 }
 
+void ox_hints_overlay(Hints dst, Hints src, char *overlays) {
+    *dst          = *src;
+    dst->overlays = overlays;
+    memcpy(overlays, src->overlays, src->size);
+}
+
 void ox_hints_destroy(Hints h) {
     if (NULL != h && &html_hints != h) {
-        xfree(h->hints);
         xfree(h);
     }
 }
 
 Hint ox_hint_find(Hints hints, const char *name) {
     if (0 != hints) {
-        Hint lo = hints->hints;
-        Hint hi = hints->hints + hints->size - 1;
-        Hint mid;
-        int  res;
-
-        if (0 == (res = strcasecmp(name, lo->name))) {
-            return lo;
-        } else if (0 > res) {
-            return 0;
-        }
-        if (0 == (res = strcasecmp(name, hi->name))) {
-            return hi;
-        } else if (0 < res) {
+        uint32_t h = hint_hash(name);
+        uint16_t d = html_disp[h % HINT_BUCKETS];
+        int      id;
+
+        if (0 == d || 0 == (id = html_slots[hint_slot(h, d)])) {
             return 0;
         }
-        while (1 < hi - lo) {
-            mid = lo + (hi - lo) / 2;
-            if (0 == (res = strcasecmp(name, mid->name))) {
-                return mid;
-            } else if (0 < res) {
-                lo = mid;
-            } else {
-                hi = mid;
-            }
+        if (0 == strcasecmp(name, hints->hints[id - 1].name)) {
+            return hints->hints + id - 1;
         }
     }
     return 0;
@@ -22,19 +22,29 @@ typedef struct _hint {
     char         empty;    // must be closed or close auto it, not error
     char         nest;     // nesting allowed
     char         jump;     // jump to end <script> ... </script>
-    char         overlay;  // Overlay
     const char **parents;
 } *Hint;
 
 typedef struct _hints {
     const char *name;
-    Hint        hints;  // array of hints
+    Hint        hints;     // array of hints, shared by all copies
     int         size;
+    char       *overlays;  // Overlay of each hint indexed by hint id
 } *Hints;
 
+extern void  ox_hints_init(void);
 extern Hints ox_hints_html(void);
 extern Hint  ox_hint_find(Hints hints, const char *name);
 extern Hints ox_hints_dup(Hints h);
+extern void  ox_hints_overlay(Hints dst, Hints src, char *overlays);
 extern void  ox_hints_destroy(Hints h);
 
+inline static Overlay hint_overlay(Hints hints, Hint h) {
+    return (Overlay)hints->overlays[h - hints->hints];
+}
+
+inline static void hint_set_overlay(Hints hints, Hint h, Overlay overlay) {
+    hints->overlays[h - hints->hints] = (char)overlay;
+}
+
 #endif /* OX_HINT_H */
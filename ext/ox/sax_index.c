@@ -0,0 +1,494 @@
+/* sax_index.c
+ * Copyright (c) 2011, Peter Ohler
+ * All rights reserved.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ox.h"
+#include "ruby.h"
+#include "sax.h"
+#include "sax_buf.h"
+#include "sax_stack.h"
+#include "special.h"
+
+#define INDEX_MAGIC "OXI1"
+#define NAME_MAX_LEN 256
+
+// The indexer scans a file with the SAX read buffer and element stack but
+// none of the drive's callbacks. Only tag boundaries are found, nothing is
+// converted or collapsed, so the byte offset of every '<' and '>' is exact.
+// A record spans from the '<' of a matching start tag to the '>' that closes
+// it. The key is either an attribute of the record element or the text of a
+// direct child element.
+typedef struct _indexer {
+    struct _saxDrive dr;  // only the buf and stack are used
+    const char      *element;
+    size_t           elen;
+    const char      *key;
+    size_t           klen;
+    bool             key_attr;
+    VALUE            file;
+    VALUE            index;  // Hash of key => [offset, length]
+    const char      *out_path;
+    FILE            *out;
+    off_t            start;  // offset of the current record or -1
+    long             depth;  // stack depth of the current record
+    char            *kbuf;
+    size_t           kcnt;
+    size_t           kcap;
+    bool             have_key;
+    bool             in_key;  // collecting the text of the key element
+} *Indexer;
+
+static void index_error(SaxDrive dr, const char *msg, off_t pos, off_t line, off_t col) {
+    rb_raise(ox_parse_error_class, "%s at byte %ld.\n", msg, (long)pos);
+}
+
+static void key_append(Indexer ix, char c) {
+    if (ix->kcap <= ix->kcnt) {
+        ix->kcap = (0 == ix->kcap) ? 64 : ix->kcap * 2;
+        REALLOC_N(ix->kbuf, char, ix->kcap);
+    }
+    ix->kbuf[ix->kcnt++] = c;
+}
+
+// Appends CDATA up to the "]]>" terminator to the key. An '&' is added as
+// "&amp;" so the CDATA comes through key_decode() unchanged.
+static void key_cdata(Indexer ix) {
+    Buf  buf = &ix->dr.buf;
+    int  end = 0;
+    char c;
+
+    while ('\0' != (c = buf_get(buf))) {
+        if (']' == c) {
+            end++;
+            continue;
+        }
+        if ('>' == c && 2 <= end) {
+            // Only the last two are part of the terminator.
+            for (end -= 2; 0 < end; end--) {
+                key_append(ix, ']');
+            }
+            return;
+        }
+        for (; 0 < end; end--) {
+            key_append(ix, ']');
+        }
+        key_append(ix, c);
+        if ('&' == c) {
+            key_append(ix, 'a');
+            key_append(ix, 'm');
+            key_append(ix, 'p');
+            key_append(ix, ';');
+        }
+    }
+}
+
+// Replaces character references and entities in the key with the characters
+// they stand for. A reference is never shorter than what it decodes to so
+// the key is decoded in place. Anything that is not a known reference is
+// left as is. Returns the new length.
+static size_t key_decode(char *str, size_t len) {
+    char       *s   = str;
+    char       *b   = str;
+    const char *end = str + len;
+    const char *semi;
+    char       *bn;
+    char        name[16];
+
+    while (s < end) {
+        if ('&' != *s || NULL == (semi = memchr(s, ';', end - s)) || (long)sizeof(name) <= semi - s) {
+            *b++ = *s++;
+            continue;
+        }
+        if ('#' == s[1]) {
+            uint64_t    u    = 0;
+            int         base = 10;
+            const char *d    = s + 2;
+            int         v;
+
+            if ('x' == *d || 'X' == *d) {
+                base = 16;
+                d++;
+            }
+            for (; d < semi; d++) {
+                if ('0' <= *d && *d <= '9') {
+                    v = *d - '0';
+                } else if (16 == base && 'a' <= (*d | 0x20) && (*d | 0x20) <= 'f') {
+                    v = (*d | 0x20) - 'a' + 10;
+                } else {
+                    break;
+                }
+                u = u * base + v;
+            }
+            if (d != semi || '#' == d[-1] || 'x' == (d[-1] | 0x20) || 0x10FFFF < u) {
+                *b++ = *s++;
+                continue;
+            }
+            b = ox_ucs_to_utf8_chars(b, u);
+        } else {
+            memcpy(name, s + 1, semi - s - 1);
+            name[semi - s - 1] = '\0';
+            if (NULL == (bn = ox_entity_lookup(b, name))) {
+                *b++ = *s++;
+                continue;
+            }
+            b = bn;
+        }
+        s = (char *)semi + 1;
+    }
+    return b - str;
+}
+
+static long stack_depth(Indexer ix) {
+    return (long)(ix->dr.stack.tail - ix->dr.stack.head);
+}
+
+static void write_u64(FILE *f, uint64_t n) {
+    unsigned char b[8];
+    int           i;
+
+    for (i = 0; i < 8; i++) {
+        b[i] = (unsigned char)(n >> (i * 8));
+    }
+    fwrite(b, 1, sizeof(b), f);
+}
+
+static uint64_t read_u64(const unsigned char *b) {
+    uint64_t n = 0;
+    int      i;
+
+    for (i = 7; 0 <= i; i--) {
+        n = (n << 8) | b[i];
+    }
+    return n;
+}
+
+static void add_record(Indexer ix, off_t end) {
+    const char    *k   = ix->kbuf;
+    size_t         len = ix->kcnt;
+    volatile VALUE key;
+
+    // Surrounding white space in element text is not part of the key.
+    for (; 0 < len && is_white(*k); k++, len--) {
+    }
+    for (; 0 < len && is_white(k[len - 1]); len--) {
+    }
+    if (!ix->have_key || 0 == len) {
+        return;
+    }
+    len = key_decode((char *)k, len);
+    key = rb_utf8_str_new(k, len);
+    rb_hash_aset(ix->index, key, rb_ary_new3(2, OFFT2NUM(ix->start), OFFT2NUM(end - ix->start)));
+    if (NULL != ix->out) {
+        write_u64(ix->out, (uint64_t)len);
+        fwrite(k, 1, len, ix->out);
+        write_u64(ix->out, (uint64_t)ix->start);
+        write_u64(ix->out, (uint64_t)(end - ix->start));
+    }
+}
+
+// Reads a name starting with c into name and returns the character that
+// ended it. Names longer than the buffer are truncated which only means they
+// can not match.
+static char read_name(Buf buf, char c, char *name, size_t *lenp) {
+    size_t len = 0;
+
+    while ('\0' != c && '>' != c && '/' != c && '=' != c && !is_white(c)) {
+        if (len < NAME_MAX_LEN) {
+            name[len] = c;
+        }
+        len++;
+        c = buf_get(buf);
+    }
+    *lenp = len;
+
+    return c;
+}
+
+// Skips past a terminator such as "-->". The terminators used all start
+// with a repeated character so a partial match only needs to stay put when
+// that character repeats.
+static void skip_past(Buf buf, const char *term) {
+    const char *t = term;
+    char        c;
+
+    while ('\0' != (c = buf_get(buf))) {
+        if (c == *t) {
+            if ('\0' == *++t) {
+                return;
+            }
+        } else if (t != term && !(c == *term && c == t[-1])) {
+            t = (c == *term) ? term + 1 : term;
+        }
+    }
+}
+
+static void skip_doctype(Buf buf) {
+    int  depth = 1;
+    char c;
+
+    while ('\0' != (c = buf_get(buf))) {
+        switch (c) {
+        case '<': depth++; break;
+        case '>':
+            if (0 == --depth) {
+                return;
+            }
+            break;
+        case '"':
+        case '\'':
+            for (char q = c; '\0' != (c = buf_get(buf)) && q != c;) {
+            }
+            break;
+        default: break;
+        }
+    }
+}
+
+// Reads the attributes of a start tag and returns '>', '/', or '\0'. The
+// value of the key attribute is captured only on a record's own start tag.
+static char read_attrs(Indexer ix, char c, bool capture) {
+    Buf    buf = &ix->dr.buf;
+    char   name[NAME_MAX_LEN];
+    size_t len;
+    bool   match;
+    char   q;
+
+    while (true) {
+        for (; is_white(c); c = buf_get(buf)) {
+        }
+        if ('>' == c || '/' == c || '\0' == c) {
+            return c;
+        }
+        c = read_name(buf, c, name, &len);
+        for (; is_white(c); c = buf_get(buf)) {
+        }
+        if ('=' != c) {
+            continue;
+        }
+        for (c = buf_get(buf); is_white(c); c = buf_get(buf)) {
+        }
+        match = capture && len == ix->klen && 0 == memcmp(name, ix->key, len);
+        if (match) {
+            ix->kcnt     = 0;
+            ix->have_key = true;
+        }
+        if ('"' == c || '\'' == c) {
+            for (q = c; '\0' != (c = buf_get(buf)) && q != c;) {
+                if (match) {
+                    key_append(ix, c);
+                }
+            }
+            c = buf_get(buf);
+        } else {
+            for (; '\0' != c && '>' != c && !is_white(c); c = buf_get(buf)) {
+                if (match) {
+                    key_append(ix, c);
+                }
+            }
+        }
+    }
+}
+
+static void start_element(Indexer ix, const char *name, size_t len, off_t start) {
+    long depth;
+
+    stack_push(&ix->dr.stack, name, (NAME_MAX_LEN < len) ? NAME_MAX_LEN : len, Qnil, NULL);
+    depth = stack_depth(ix);
+    if (0 > ix->start) {
+        if (len == ix->elen && 0 == memcmp(name, ix->element, len)) {
+            ix->start    = start;
+            ix->depth    = depth;
+            ix->have_key = false;
+            ix->kcnt     = 0;
+        }
+    } else if (!ix->key_attr && !ix->have_key && depth == ix->depth + 1 && len == ix->klen &&
+               0 == memcmp(name, ix->key, len)) {
+        ix->in_key   = true;
+        ix->have_key = true;
+        ix->kcnt     = 0;
+    }
+}
+
+static void end_element(Indexer ix, off_t end) {
+    long depth = stack_depth(ix);
+
+    if (0 <= ix->start) {
+        if (ix->in_key && depth == ix->depth + 1) {
+            ix->in_key = false;
+        } else if (depth == ix->depth) {
+            add_record(ix, end);
+            ix->start = -1;
+        }
+    }
+    stack_pop(&ix->dr.stack);
+}
+
+static VALUE index_scan(Indexer ix) {
+    Buf    buf = &ix->dr.buf;
+    char   name[NAME_MAX_LEN];
+    size_t len;
+    off_t  start;
+    char   c;
+
+    while ('\0' != (c = buf_get(buf))) {
+        if ('<' != c) {
+            if (ix->in_key) {
+                key_append(ix, c);
+            }
+            continue;
+        }
+        start = buf->pos - 1;
+        switch (c = buf_get(buf)) {
+        case '?': skip_past(buf, "?>"); break;
+        case '!':
+            switch (buf_get(buf)) {
+            case '-': skip_past(buf, "-->"); break;
+            case '[':
+                if (ix->in_key) {
+                    // Past the rest of "<![CDATA[".
+                    for (int i = 0; i < 6 && '\0' != buf_get(buf); i++) {
+                    }
+                    key_cdata(ix);
+                } else {
+                    skip_past(buf, "]]>");
+                }
+                break;
+            default: skip_doctype(buf); break;
+            }
+            break;
+        case '/':
+            for (c = buf_get(buf); '\0' != c && '>' != c; c = buf_get(buf)) {
+            }
+            if ('\0' == c) {
+                return Qnil;
+            }
+            end_element(ix, buf->pos);
+            break;
+        default:
+            c = read_name(buf, c, name, &len);
+            start_element(ix, name, len, start);
+            c = read_attrs(ix, c, 0 <= ix->start && ix->key_attr && stack_depth(ix) == ix->depth);
+            if ('/' == c) {
+                for (; '\0' != c && '>' != c; c = buf_get(buf)) {
+                }
+                if ('\0' == c) {
+                    return Qnil;
+                }
+                end_element(ix, buf->pos);
+            }
+            break;
+        }
+    }
+    return Qnil;
+}
+
+// Everything that can raise once the file is open is done here so
+// index_ensure() can close it.
+static VALUE index_body(VALUE x) {
+    Indexer ix = (Indexer)x;
+
+    if (NULL != ix->out_path) {
+        if (NULL == (ix->out = fopen(ix->out_path, "wb"))) {
+            rb_raise(rb_eIOError, "%s\n", strerror(errno));
+        }
+        fwrite(INDEX_MAGIC, 1, 4, ix->out);
+    }
+    ox_sax_buf_init(&ix->dr.buf, ix->file);
+    ix->dr.buf.dr     = &ix->dr;
+    ix->dr.buf.locate = false;
+
+    return index_scan(ix);
+}
+
+static VALUE index_ensure(VALUE x) {
+    Indexer ix = (Indexer)x;
+
+    buf_cleanup(&ix->dr.buf);
+    stack_cleanup(&ix->dr.stack);
+    xfree(ix->kbuf);
+    rb_io_close(ix->file);
+    if (NULL != ix->out) {
+        fclose(ix->out);
+    }
+    return Qnil;
+}
+
+/* Scans the file at +path+ and returns a Hash of key to [offset, length] for
+ * each +element+. The key is the +key+ attribute when it starts with '@' and
+ * otherwise the text of the +key+ child element. If +out_path+ is not NULL
+ * the same index is also written there.
+ */
+VALUE ox_index_file(VALUE path, VALUE element, VALUE key, const char *out_path) {
+    struct _indexer ix;
+    volatile VALUE  index = rb_hash_new();
+
+    memset(&ix, 0, sizeof(ix));
+    ix.element  = RSTRING_PTR(element);
+    ix.elen     = (size_t)RSTRING_LEN(element);
+    ix.key      = RSTRING_PTR(key);
+    ix.klen     = (size_t)RSTRING_LEN(key);
+    ix.key_attr = ('@' == *ix.key);
+    if (ix.key_attr) {
+        ix.key++;
+        ix.klen--;
+    }
+    if (NAME_MAX_LEN < ix.elen || NAME_MAX_LEN < ix.klen) {
+        rb_raise(ox_arg_error_class, "index element and key names are limited to %d characters.\n", NAME_MAX_LEN);
+    }
+    ix.start    = -1;
+    ix.index    = index;
+    ix.out_path = out_path;
+    ix.dr.error = index_error;
+    ix.file     = rb_file_open_str(path, "rb");
+    stack_init(&ix.dr.stack);
+    rb_ensure(index_body, (VALUE)&ix, index_ensure, (VALUE)&ix);
+    RB_GC_GUARD(element);
+    RB_GC_GUARD(key);
+
+    return index;
+}
+
+/* Reads an index written by ox_index_file() back into a Hash.
+ */
+VALUE ox_load_index(const char *path) {
+    volatile VALUE index = rb_hash_new();
+    unsigned char  b[16];
+    FILE          *f;
+    volatile VALUE key;
+    uint64_t       len;
+    const char    *err = NULL;
+
+    if (NULL == (f = fopen(path, "rb"))) {
+        rb_raise(rb_eIOError, "%s\n", strerror(errno));
+    }
+    if (4 != fread(b, 1, 4, f) || 0 != memcmp(b, INDEX_MAGIC, 4)) {
+        fclose(f);
+        rb_raise(ox_parse_error_class, "%s is not an Ox index file.\n", path);
+    }
+    while (8 == fread(b, 1, 8, f)) {
+        len = read_u64(b);
+        if (NAME_MAX_LEN * 64 < len) {
+            err = "corrupt key length";
+            break;
+        }
+        key = rb_utf8_str_new(NULL, (long)len);
+        if (len != fread(RSTRING_PTR(key), 1, len, f) || 16 != fread(b, 1, 16, f)) {
+            err = "truncated record";
+            break;
+        }
+        rb_hash_aset(index, key, rb_ary_new3(2, ULL2NUM(read_u64(b)), ULL2NUM(read_u64(b + 8))));
+    }
+    fclose(f);
+    if (NULL != err) {
+        rb_raise(ox_parse_error_class, "%s in index file %s.\n", err, path);
+    }
+    return index;
+}
@@ -0,0 +1,232 @@
+/* sax_parser.c
+ * Copyright (c) 2011, Peter Ohler
+ * All rights reserved.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ox.h"
+#include "ruby.h"
+#include "sax.h"
+#include "sax_buf.h"
+#include "sax_stack.h"
+
+// The parser drive is the same recursive descent drive used by sax_parse()
+// but it runs on a fiber. When the pushed bytes run out mid token the read
+// function yields back to the caller of <<() and all the drive state, the
+// element stack, protected buffer region, and position, is left in place
+// until the next chunk or finish() resumes it.
+typedef struct _saxParser {
+    struct _saxDrive dr;
+    struct _pushIn   in;
+    VALUE            fiber;
+    VALUE            chunk;
+    bool             active;  // drive initialized and not yet cleaned up
+    bool             done;    // parse completed, failed, or was aborted
+} *SaxParser;
+
+static VALUE parser_class = Qundef;
+
+static void parser_mark(void *ptr) {
+    SaxParser p = (SaxParser)ptr;
+    Nv        nv;
+    int       i;
+
+    if (NULL == p) {
+        return;
+    }
+    // The struct starts zeroed so this is safe even while the drive is being
+    // initialized.
+    rb_gc_mark(p->fiber);
+    rb_gc_mark(p->chunk);
+    rb_gc_mark(p->dr.handler);
+    rb_gc_mark(p->dr.value_obj);
+    rb_gc_mark(p->dr.options.columns);
+    rb_gc_mark(p->dr.options.sinks);
+    for (i = 0; i < CALL_CNT; i++) {
+        rb_gc_mark(p->dr.calls[i].recv);
+    }
+    if (p->active) {
+        for (nv = p->dr.stack.head; nv < p->dr.stack.tail; nv++) {
+            rb_gc_mark(nv->val);
+        }
+    }
+}
+
+static void parser_cleanup(SaxParser p) {
+    if (p->active) {
+        p->active = false;
+        ox_sax_drive_cleanup(&p->dr);
+    }
+}
+
+static void parser_free(void *ptr) {
+    if (NULL != ptr) {
+        parser_cleanup((SaxParser)ptr);
+        xfree(ptr);
+    }
+}
+
+static const rb_data_type_t ox_sax_parser_type = {
+    "Ox/Sax/Parser",
+    {
+        parser_mark,
+        parser_free,
+        NULL,
+    },
+    0,
+    0,
+};
+
+static VALUE parse_body(VALUE self) {
+    SaxParser p = (SaxParser)DATA_PTR(self);
+
+    // Attached on the parse fiber since that is where the callbacks run.
+    ox_sax_drive_attach(self);
+    ox_sax_drive_parse(&p->dr);
+
+    return Qnil;
+}
+
+static VALUE parse_ensure(VALUE self) {
+    SaxParser p = (SaxParser)DATA_PTR(self);
+
+    p->done = true;
+    ox_sax_drive_detach(self);
+    parser_cleanup(p);
+
+    return Qnil;
+}
+
+static VALUE fiber_body(RB_BLOCK_CALL_FUNC_ARGLIST(yielded, self)) {
+    return rb_ensure(parse_body, self, parse_ensure, self);
+}
+
+static void resume(VALUE self, SaxParser p) {
+    if (Qnil == p->fiber) {
+        p->fiber = rb_fiber_new(fiber_body, self);
+    }
+    rb_fiber_resume(p->fiber, 0, 0);
+}
+
+SaxDrive
+ox_sax_parser_drive(VALUE parser) {
+    SaxParser p;
+
+    if (!rb_typeddata_is_kind_of(parser, &ox_sax_parser_type)) {
+        return NULL;
+    }
+    p = (SaxParser)DATA_PTR(parser);
+
+    return p->active ? &p->dr : NULL;
+}
+
+/* call-seq: new(handler, options)
+ *
+ * Creates a push style SAX parser that makes callbacks on the _handler_ as
+ * chunks of XML are pushed with <<(). Parsing of a chunk stops at the last
+ * complete token and picks up where it left off when the next chunk arrives
+ * so no thread or IO is tied up waiting for the rest of a document.
+ * - +handler+ [Ox::Sax] SAX (responds to OX::Sax methods) like handler
+ * - +options+ [Hash] the same options as Ox.sax_parse()
+ */
+static VALUE parser_new(int argc, VALUE *argv, VALUE self) {
+    struct _saxOptions options;
+    SaxParser          p;
+    VALUE              parser;
+
+    if (argc < 1 || 2 < argc) {
+        rb_raise(ox_arg_error_class, "Wrong number of arguments to Ox::Sax::Parser.new.\n");
+    }
+    ox_sax_options_init(&options, (2 == argc) ? argv[1] : Qnil);
+    if (Qnil != options.resume) {
+        rb_raise(ox_arg_error_class, "Ox::Sax::Parser does not support the :resume option.\n");
+    }
+
+    parser   = TypedData_Make_Struct(parser_class, struct _saxParser, &ox_sax_parser_type, p);
+    p->fiber = Qnil;
+    p->chunk = Qnil;
+    ox_sax_drive_init(&p->dr, *argv, Qnil, &options);
+    p->dr.buf.in.push = &p->in;
+    p->active         = true;
+
+    return parser;
+}
+
+/* call-seq: <<(chunk)
+ *
+ * Pushes the next chunk of the document to the parser. Callbacks are made
+ * for every token completed by the chunk before this method returns.
+ * - +chunk+ [String] next bytes of the document
+ */
+static VALUE parser_push(VALUE self, VALUE chunk) {
+    SaxParser p = (SaxParser)DATA_PTR(self);
+
+    Check_Type(chunk, T_STRING);
+    if (p->in.done) {
+        rb_raise(ox_arg_error_class, "Ox::Sax::Parser already finished.\n");
+    }
+    if (p->done || 0 == RSTRING_LEN(chunk)) {
+        return self;
+    }
+    p->chunk  = rb_str_new_frozen(chunk);
+    p->in.str = RSTRING_PTR(p->chunk);
+    p->in.len = (size_t)RSTRING_LEN(p->chunk);
+    resume(self, p);
+    p->in.len = 0;
+    p->chunk  = Qnil;
+
+    return self;
+}
+
+/* call-seq: finish()
+ *
+ * Signals the end of the document. Any trailing text is delivered and errors
+ * for unclosed elements are reported just as they would be by Ox.sax_parse().
+ */
+static VALUE parser_finish(VALUE self) {
+    SaxParser p = (SaxParser)DATA_PTR(self);
+
+    if (p->in.done) {
+        return Qnil;
+    }
+    p->in.done = true;
+    if (!p->done) {
+        resume(self, p);
+    }
+    return Qnil;
+}
+
+/* call-seq: finished?()
+ *
+ * Returns true if finish() has been called or the parse was aborted or failed.
+ */
+static VALUE parser_finished(VALUE self) {
+    SaxParser p = (SaxParser)DATA_PTR(self);
+
+    return (p->in.done || p->done) ? Qtrue : Qfalse;
+}
+
+/* Document-class: Ox::Sax::Parser
+ *
+ * A push style SAX parser for documents that arrive in pieces such as over a
+ * socket. Chunks are pushed with <<() and finish() marks the end of the
+ * document.
+ *
+ *   parser = Ox::Sax::Parser.new(handler)
+ *   parser << '<top><chi'
+ *   parser << 'ld>text</child></top>'
+ *   parser.finish
+ */
+void ox_sax_parser_define(VALUE sax_module) {
+    parser_class = rb_define_class_under(sax_module, "Parser", rb_cObject);
+    rb_gc_register_address(&parser_class);
+    rb_undef_alloc_func(parser_class);
+
+    rb_define_module_function(parser_class, "new", parser_new, -1);
+    rb_define_method(parser_class, "<<", parser_push, 1);
+    rb_define_method(parser_class, "finish", parser_finish, 0);
+    rb_define_method(parser_class, "finished?", parser_finished, 0);
+}
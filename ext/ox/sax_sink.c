@@ -0,0 +1,230 @@
+/* sax_sink.c
+ * Copyright (c) 2011, Peter Ohler
+ * All rights reserved.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base64.h"
+#include "ox.h"
+#include "ruby.h"
+#include "ruby/io.h"
+#include "ruby/thread.h"
+#include "sax.h"
+#include "sax_buf.h"
+
+// Encoded text is taken from the read buffer in spans of at most this many
+// characters so the decoded bytes fit in an output buffer on the stack.
+#define SINK_SPAN 0x00004000
+
+static int sink_fd(VALUE v) {
+    volatile VALUE fd = v;
+
+    if (!RB_INTEGER_TYPE_P(v)) {
+        if (!rb_respond_to(v, ox_fileno_id) || Qnil == (fd = rb_funcall(v, ox_fileno_id, 0))) {
+            rb_raise(ox_arg_error_class, ":base64 values must be an IO with a file descriptor or an Integer.\n");
+        }
+    }
+    return NUM2INT(fd);
+}
+
+static int check_sink_cb(VALUE key, VALUE sink, VALUE x) {
+    if (T_SYMBOL != rb_type(key) && T_STRING != rb_type(key)) {
+        rb_raise(ox_arg_error_class, ":base64 keys must be element names or paths as a Symbol or String.\n");
+    }
+    sink_fd(sink);
+
+    return ST_CONTINUE;
+}
+
+void ox_sax_sink_check(VALUE sinks) {
+    Check_Type(sinks, T_HASH);
+    rb_hash_foreach(sinks, check_sink_cb, Qnil);
+}
+
+static int sink_init_cb(VALUE key, VALUE v, VALUE x) {
+    SaxDrive dr   = (SaxDrive)x;
+    SaxSink  sink = dr->sinks + dr->sink_cnt++;
+    VALUE    path = (T_SYMBOL == rb_type(key)) ? rb_sym2str(key) : StringValue(key);
+
+    // Anything already written through the IO goes ahead of the decoded
+    // bytes written directly to the descriptor.
+    if (T_FILE == rb_type(v)) {
+        rb_io_flush(v);
+    }
+    sink->path = ox_strndup(RSTRING_PTR(path), RSTRING_LEN(path));
+    sink->len  = (size_t)RSTRING_LEN(path);
+    sink->fd   = sink_fd(v);
+
+    return ST_CONTINUE;
+}
+
+// The sinks Hash is expected to have been checked with ox_sax_sink_check()
+// already.
+void ox_sax_sinks_init(SaxDrive dr, VALUE sinks) {
+    dr->sinks    = NULL;
+    dr->sink_cnt = 0;
+    if (Qnil == sinks || 0 == RHASH_SIZE(sinks)) {
+        return;
+    }
+    dr->sinks = ALLOC_N(struct _saxSink, RHASH_SIZE(sinks));
+    rb_hash_foreach(sinks, sink_init_cb, (VALUE)dr);
+}
+
+void ox_sax_sinks_cleanup(SaxDrive dr) {
+    SaxSink sink;
+    SaxSink end = dr->sinks + dr->sink_cnt;
+
+    for (sink = dr->sinks; sink < end; sink++) {
+        xfree(sink->path);
+    }
+    xfree(dr->sinks);
+    dr->sinks    = NULL;
+    dr->sink_cnt = 0;
+}
+
+// Matches the names in path from the last one back against the open
+// elements from the innermost out.
+static bool path_match(NStack stack, const char *path, size_t len) {
+    const char *end = path + len;
+    const char *s;
+    Nv          nv = stack->tail - 1;
+
+    while (path < end) {
+        if (nv < stack->head) {
+            return false;
+        }
+        for (s = end; path < s && '/' != s[-1]; s--) {
+        }
+        if ((size_t)(end - s) != nv->len || 0 != memcmp(s, nv->name, nv->len)) {
+            return false;
+        }
+        end = (path < s) ? s - 1 : s;
+        nv--;
+    }
+    return true;
+}
+
+SaxSink ox_sax_sink_find(SaxDrive dr) {
+    SaxSink sink;
+    SaxSink end = dr->sinks + dr->sink_cnt;
+
+    for (sink = dr->sinks; sink < end; sink++) {
+        if (path_match(&dr->stack, sink->path, sink->len)) {
+            return sink;
+        }
+    }
+    return NULL;
+}
+
+typedef struct _sinkWrite {
+    int          fd;
+    const uchar *data;
+    size_t       len;
+    ssize_t      cnt;
+    int          err;
+} *SinkWrite;
+
+static void *write_nogvl(void *x) {
+    SinkWrite sw = (SinkWrite)x;
+
+    sw->cnt = write(sw->fd, sw->data, sw->len);
+    sw->err = errno;
+
+    return NULL;
+}
+
+// The GVL is released for the write as the reader at the other end of a
+// pipe may be a Ruby thread.
+static void sink_write(SaxSink sink, const uchar *data, size_t len) {
+    struct _sinkWrite sw = {sink->fd, data, len, 0, 0};
+
+    while (0 < sw.len) {
+        rb_thread_call_without_gvl(write_nogvl, &sw, RUBY_UBF_IO, NULL);
+        if (0 > sw.cnt) {
+            if (EINTR == sw.err) {
+                rb_thread_check_ints();
+                continue;
+            }
+            if (EAGAIN == sw.err || EWOULDBLOCK == sw.err) {
+                rb_thread_fd_writable(sink->fd);
+                continue;
+            }
+            rb_raise(rb_eIOError, "base64 write to %s failed. %s\n", sink->path, strerror(sw.err));
+        }
+        sw.data += sw.cnt;
+        sw.len -= (size_t)sw.cnt;
+    }
+}
+
+static void advance(Buf buf, const char *stop) {
+    const char *s;
+
+    if (buf->locate) {
+        for (s = buf->tail; s < stop; s++) {
+            if ('\n' == *s) {
+                buf->line++;
+                buf->col = 0;
+            } else {
+                buf->col++;
+            }
+        }
+    }
+    buf->pos += stop - buf->tail;
+    buf->tail = (char *)stop;
+}
+
+/* Entered at the first character of element text that goes to sink. The
+ * text is decoded straight out of the read buffer a span at a time and the
+ * buffer is released behind it so it never holds more than one read. Like
+ * read_text() the '<' that ends the text is consumed and returned.
+ */
+char ox_sax_sink_read(SaxDrive dr, SaxSink sink) {
+    Buf            buf = &dr->buf;
+    struct _b64Dec dec = {0, 0};
+    uchar          out[b64_decode_size(SINK_SPAN)];
+    const char    *lt;
+    const char    *stop;
+    size_t         cnt;
+    long           bad = 0;
+    char           c   = '<';
+
+    while (true) {
+        if (buf->read_end <= buf->tail) {
+            buf_protect(buf);
+            if (0 != ox_sax_buf_read(buf) || buf->read_end <= buf->tail) {
+                ox_sax_drive_error(dr, "Not Terminated: text not terminated");
+                c = '\0';
+                break;
+            }
+        }
+        stop = buf->read_end;
+        if (SINK_SPAN < stop - buf->tail) {
+            stop = buf->tail + SINK_SPAN;
+        }
+        lt = memchr(buf->tail, '<', stop - buf->tail);
+        if (NULL != lt) {
+            stop = lt;
+        }
+        if (0 < (cnt = b64_decode(&dec, buf->tail, stop - buf->tail, out, &bad))) {
+            sink_write(sink, out, cnt);
+        }
+        advance(buf, stop);
+        if (NULL != lt) {
+            advance(buf, lt + 1);
+            break;
+        }
+    }
+    if (0 < (cnt = b64_decode_finish(&dec, out))) {
+        sink_write(sink, out, cnt);
+    }
+    if (0 < bad) {
+        ox_sax_drive_error(dr, "Invalid Format: invalid base64 character");
+    }
+    return c;
+}
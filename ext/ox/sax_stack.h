@@ -6,17 +6,25 @@
 #ifndef OX_SAX_STACK_H
 #define OX_SAX_STACK_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #include "intern.h"
 #include "sax_hint.h"
 
 #define STACK_INC 32
-#define NV_BUF_MAX 64
+#define NAMES_INC 1024
 
+// Element names are kept NUL terminated in one arena owned by the stack so a
+// push is a copy and a pop is a subtraction. Each entry also keeps the name
+// length and a case folded hash so most end tag checks are integer compares.
 typedef struct _nv {
-    char        name_buf[NV_BUF_MAX];
-    const char *name;
+    const char *name;  // in the stack's name arena
+    size_t      len;
+    uint32_t    hash;
     VALUE       val;
     int         childCnt;
     Hint        hint;
@@ -27,12 +35,36 @@ typedef struct _nStack {
     Nv         head; /* current stack */
     Nv         end;  /* stack end */
     Nv         tail; /* pointer to one past last element name on stack */
+    char       name_base[NAMES_INC];
+    char      *names;     /* name arena */
+    char      *names_end; /* end of the name arena */
+    char      *names_tail;
 } *NStack;
 
+// FNV-1a over the names with A-Z folded to a-z so the same hash works for
+// case sensitive and smart (case insensitive) matching. Only ASCII letters are
+// folded, the same as the strncasecmp() used for smart matches.
+inline static uint32_t nv_hash(const char *name, size_t len) {
+    uint32_t h = 2166136261U;
+
+    for (; 0 < len; len--, name++) {
+        uint8_t c = (uint8_t)*name;
+
+        if ('A' <= c && c <= 'Z') {
+            c |= 0x20;
+        }
+        h = (h ^ c) * 16777619U;
+    }
+    return h;
+}
+
 inline static void stack_init(NStack stack) {
-    stack->head = stack->base;
-    stack->end  = stack->base + sizeof(stack->base) / sizeof(struct _nv);
-    stack->tail = stack->head;
+    stack->head       = stack->base;
+    stack->end        = stack->base + sizeof(stack->base) / sizeof(struct _nv);
+    stack->tail       = stack->head;
+    stack->names      = stack->name_base;
+    stack->names_end  = stack->name_base + sizeof(stack->name_base);
+    stack->names_tail = stack->names;
 }
 
 inline static int stack_empty(NStack stack) {
@@ -43,9 +75,38 @@ inline static void stack_cleanup(NStack stack) {
     if (stack->base != stack->head) {
         xfree(stack->head);
     }
+    if (stack->name_base != stack->names) {
+        xfree(stack->names);
+    }
+}
+
+// Grows the name arena and moves the names of the entries on the stack with
+// it. Only happens when the total length of the open element names grows.
+inline static void stack_grow_names(NStack stack, size_t need) {
+    char  *old  = stack->names;
+    size_t size = stack->names_end - stack->names;
+    size_t used = stack->names_tail - stack->names;
+    Nv     nv;
+
+    while (size < used + need) {
+        size *= 2;
+    }
+    if (stack->name_base == old) {
+        stack->names = ALLOC_N(char, size);
+        memcpy(stack->names, old, used);
+    } else {
+        REALLOC_N(stack->names, char, size);
+    }
+    stack->names_end  = stack->names + size;
+    stack->names_tail = stack->names + used;
+    for (nv = stack->head; nv < stack->tail; nv++) {
+        nv->name = stack->names + (nv->name - old);
+    }
 }
 
 inline static void stack_push(NStack stack, const char *name, size_t nlen, VALUE val, Hint hint) {
+    Nv nv;
+
     if (stack->end <= stack->tail) {
         size_t len  = stack->end - stack->head;
         size_t toff = stack->tail - stack->head;
@@ -59,16 +120,19 @@ inline static void stack_push(NStack stack, const char *name, size_t nlen, VALUE
         stack->tail = stack->head + toff;
         stack->end  = stack->head + len + STACK_INC;
     }
-    if (NV_BUF_MAX <= nlen) {
-        stack->tail->name = ox_strndup(name, nlen);
-    } else {
-        strncpy(stack->tail->name_buf, name, nlen);
-        stack->tail->name_buf[nlen] = '\0';
-        stack->tail->name           = NULL;
+    if ((size_t)(stack->names_end - stack->names_tail) <= nlen) {
+        stack_grow_names(stack, nlen + 1);
     }
-    stack->tail->val      = val;
-    stack->tail->hint     = hint;
-    stack->tail->childCnt = 0;
+    nv = stack->tail;
+    memcpy(stack->names_tail, name, nlen);
+    stack->names_tail[nlen] = '\0';
+    nv->name                = stack->names_tail;
+    nv->len                 = nlen;
+    nv->hash                = nv_hash(name, nlen);
+    nv->val                 = val;
+    nv->hint                = hint;
+    nv->childCnt            = 0;
+    stack->names_tail += nlen + 1;
     stack->tail++;
 }
 
@@ -79,35 +143,35 @@ inline static Nv stack_peek(NStack stack) {
     return NULL;
 }
 
+// The popped entry and its name stay readable until the next push.
 inline static Nv stack_pop(NStack stack) {
     if (stack->head < stack->tail) {
         stack->tail--;
-        if (NULL != stack->tail->name) {
-            xfree((char *)(stack->tail->name));
-        }
+        stack->names_tail = (char *)stack->tail->name;
         return stack->tail;
     }
     return NULL;
 }
 
 inline static const char *nv_name(Nv nv) {
-    if (NULL == nv->name) {
-        return nv->name_buf;
-    }
     return nv->name;
 }
 
-inline static int nv_same_name(Nv nv, const char *name, bool smart) {
-    if (smart) {
-        if (NULL == nv->name) {
-            return (0 == strcasecmp(name, nv->name_buf));
-        }
-        return (0 == strcasecmp(name, nv->name));
+// Compares with a name whose length and nv_hash() are already known.
+inline static bool nv_same(Nv nv, const char *name, size_t len, uint32_t hash, bool smart) {
+    if (hash != nv->hash || len != nv->len) {
+        return false;
     }
-    if (NULL == nv->name) {
-        return (0 == strcmp(name, nv->name_buf));
+    if (smart) {
+        return (0 == strncasecmp(name, nv->name, len));
     }
-    return (0 == strcmp(name, nv->name));
+    return (0 == memcmp(name, nv->name, len));
+}
+
+inline static int nv_same_name(Nv nv, const char *name, bool smart) {
+    size_t len = strlen(name);
+
+    return nv_same(nv, name, len, nv_hash(name, len), smart);
 }
 
 #endif /* OX_SAX_STACK_H */
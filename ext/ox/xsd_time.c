@@ -0,0 +1,249 @@
+/* xsd_time.c
+ * Copyright (c) 2011, Peter Ohler
+ * All rights reserved.
+ */
+
+#include "xsd_time.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// XSD (ISO-8601) times are converted with integer calendar math in both
+// directions. No libc time zone or locale calls are made. A time without a
+// zone is taken to be UTC everywhere it is read.
+
+static const char digits2[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static inline char *put2(char *b, long v) {
+    memcpy(b, digits2 + v * 2, 2);
+
+    return b + 2;
+}
+
+static const char *read_num(const char *s, int cnt, long *vp) {
+    long v = 0;
+
+    for (; 0 < cnt; cnt--, s++) {
+        if (*s < '0' || '9' < *s) {
+            return NULL;
+        }
+        v = 10 * v + (long)(*s - '0');
+    }
+    *vp = v;
+
+    return s;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar.
+static int64_t days_from_civil(long y, long m, long d) {
+    long era;
+    long yoe;
+    long doy;
+    long doe;
+
+    if (m <= 2) {
+        y--;
+    }
+    era = (0 <= y ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (2 < m ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return (int64_t)era * 146097 + (int64_t)doe - 719468;
+}
+
+// The inverse of days_from_civil().
+static void civil_from_days(int64_t days, long *yp, long *mp, long *dp) {
+    int64_t era;
+    long    doe;
+    long    yoe;
+    long    doy;
+    long    mp0;
+
+    days += 719468;
+    era = (0 <= days ? days : days - 146096) / 146097;
+    doe = (long)(days - era * 146097);
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp0 = (5 * doy + 2) / 153;
+    *dp = doy - (153 * mp0 + 2) / 5 + 1;
+    *mp = mp0 + (mp0 < 10 ? 3 : -9);
+    *yp = (long)(yoe + era * 400) + (*mp <= 2 ? 1 : 0);
+}
+
+// Parses an XSD (ISO-8601) time of the form YYYY-MM-DDTHH:MM:SS.nnnnnnnnn
+// followed by an optional Z or +HH:MM zone. The year may have a sign and more
+// than 4 digits. A space is accepted in place of the T and before the zone so
+// the output of Time#to_s is also accepted.
+bool ox_xsd_time_parse(const char *str, XsdTime tp) {
+    const char *s = str;
+    const char *ys;
+    bool        neg = false;
+
+    memset(tp, 0, sizeof(struct _xsdTime));
+    if ('-' == *s || '+' == *s) {
+        neg = ('-' == *s);
+        s++;
+    }
+    for (ys = s; '0' <= *s && *s <= '9'; s++) {
+    }
+    // More than 12 digits would not fit in a time_t once converted to seconds.
+    if (s - ys < 4 || 12 < s - ys) {
+        return false;
+    }
+    read_num(ys, (int)(s - ys), &tp->year);
+    if (neg) {
+        tp->year = -tp->year;
+    }
+    if ('-' != *s++ || NULL == (s = read_num(s, 2, &tp->mon)) || '-' != *s++ ||
+        NULL == (s = read_num(s, 2, &tp->day))) {
+        return false;
+    }
+    if (tp->mon < 1 || 12 < tp->mon || tp->day < 1 || 31 < tp->day) {
+        return false;
+    }
+    if ('\0' == *s) {
+        return true;
+    }
+    if ('T' != *s && ' ' != *s) {
+        return false;
+    }
+    s++;
+    if (NULL == (s = read_num(s, 2, &tp->hour)) || ':' != *s++ || NULL == (s = read_num(s, 2, &tp->min)) ||
+        ':' != *s++ || NULL == (s = read_num(s, 2, &tp->sec))) {
+        return false;
+    }
+    if (23 < tp->hour || 59 < tp->min || 60 < tp->sec) {
+        return false;
+    }
+    if ('.' == *s) {
+        long scale = 100000000;
+
+        s++;
+        if (*s < '0' || '9' < *s) {
+            return false;
+        }
+        for (; '0' <= *s && *s <= '9'; s++) {
+            tp->nsec += scale * (long)(*s - '0');
+            scale /= 10;
+        }
+    }
+    if (' ' == *s) {
+        s++;
+    }
+    switch (*s) {
+    case '\0': return true;
+    case 'Z':
+        tp->zone = 'Z';
+        s++;
+        break;
+    case 'U':
+        if (0 != strcmp("UTC", s)) {
+            return false;
+        }
+        tp->zone = 'Z';
+        s += 3;
+        break;
+    case '+':
+    case '-': {
+        long h;
+        long m;
+        int  sign = ('-' == *s) ? -1 : 1;
+
+        if (NULL == (s = read_num(s + 1, 2, &h))) {
+            return false;
+        }
+        if (':' == *s) {
+            s++;
+        }
+        if (NULL == (s = read_num(s, 2, &m))) {
+            return false;
+        }
+        tp->zone   = '+';
+        tp->offset = sign * (h * 3600 + m * 60);
+        break;
+    }
+    default: return false;
+    }
+    return '\0' == *s;
+}
+
+int64_t ox_xsd_time_utc_sec(XsdTime tp) {
+    return days_from_civil(tp->year, tp->mon, tp->day) * 86400 + tp->hour * 3600 + tp->min * 60 + tp->sec - tp->offset;
+}
+
+/* Returns a Time for a parsed XSD time. A Time with an offset keeps that
+ * offset. One with a Z or without a zone is a UTC Time, the same as the
+ * :time column conversion in sax_as.c.
+ */
+VALUE ox_xsd_time_value(XsdTime tp) {
+    struct timespec ts;
+
+    ts.tv_sec  = (time_t)ox_xsd_time_utc_sec(tp);
+    ts.tv_nsec = tp->nsec;
+
+    // INT_MAX - 1 asks for a UTC Time.
+    return rb_time_timespec_new(&ts, ('+' == tp->zone) ? (int)tp->offset : INT_MAX - 1);
+}
+
+/* Writes sec and nsec since the epoch as 2010-07-09T10:47:45.895826+09:00
+ * with the wall clock shifted by offset seconds east of UTC. Microseconds
+ * are written. Returns the number of characters written which is at most
+ * XSD_TIME_MAX - 1. The buffer is not terminated.
+ */
+int ox_xsd_time_format(char *buf, int64_t sec, long nsec, long offset) {
+    char   *b     = buf;
+    int64_t local = sec + offset;
+    int64_t days  = (0 <= local ? local : local - 86399) / 86400;
+    long    sod   = (long)(local - days * 86400);
+    long    usec  = nsec / 1000;
+    long    y, m, d;
+    char    sign = '+';
+
+    civil_from_days(days, &y, &m, &d);
+    if (y < 0) {
+        // XSD puts the sign before a year that is still at least 4 digits.
+        b += snprintf(b, XSD_TIME_MAX - 8, "-%04ld", -y);
+    } else if (9999 < y) {
+        b += snprintf(b, XSD_TIME_MAX - 8, "%ld", y);
+    } else {
+        b = put2(b, y / 100);
+        b = put2(b, y % 100);
+    }
+    *b++ = '-';
+    b    = put2(b, m);
+    *b++ = '-';
+    b    = put2(b, d);
+    *b++ = 'T';
+    b    = put2(b, sod / 3600);
+    *b++ = ':';
+    b    = put2(b, sod / 60 % 60);
+    *b++ = ':';
+    b    = put2(b, sod % 60);
+    *b++ = '.';
+    b    = put2(b, usec / 10000);
+    b    = put2(b, usec / 100 % 100);
+    b    = put2(b, usec % 100);
+    if (0 > offset) {
+        sign   = '-';
+        offset = -offset;
+    }
+    *b++ = sign;
+    b    = put2(b, offset / 3600 % 100);
+    *b++ = ':';
+    b    = put2(b, offset / 60 % 60);
+
+    return (int)(b - buf);
+}
@@ -0,0 +1,35 @@
+/* xsd_time.h
+ * Copyright (c) 2011, Peter Ohler
+ * All rights reserved.
+ */
+
+#ifndef XSD_TIME_H
+#define XSD_TIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ruby.h"
+
+// Longest output of ox_xsd_time_format() such as
+// 2010-07-09T10:47:45.895826+09:00 plus room for a wide year.
+#define XSD_TIME_MAX 48
+
+typedef struct _xsdTime {
+    long year;
+    long mon;
+    long day;
+    long hour;
+    long min;
+    long sec;
+    long nsec;
+    long offset;  // seconds east of UTC
+    char zone;    // '\0' for none, 'Z' for UTC, or '+' for an offset
+} *XsdTime;
+
+extern bool    ox_xsd_time_parse(const char *str, XsdTime tp);
+extern int64_t ox_xsd_time_utc_sec(XsdTime tp);
+extern VALUE   ox_xsd_time_value(XsdTime tp);
+extern int     ox_xsd_time_format(char *buf, int64_t sec, long nsec, long offset);
+
+#endif /* XSD_TIME_H */
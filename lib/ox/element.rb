@@ -45,10 +45,12 @@ module Ox
     alias name= value=
 
     # Returns the Element's nodes array. These are the sub-elements of this
-    # Element.
+    # Element. Elements loaded with the :compact mode keep a lone text node as
+    # a String until this method is called.
     # *return* [Array] all child Nodes.
     def nodes
       @nodes = [] if !instance_variable_defined?(:@nodes) or @nodes.nil?
+      @nodes = [@nodes] if @nodes.is_a?(String)
       @nodes
     end
 
@@ -58,8 +60,8 @@ module Ox
     def <<(node)
       raise 'argument to << must be a String or Ox::Node.' unless node.is_a?(String) or node.is_a?(Node)
 
-      @nodes = [] if !instance_variable_defined?(:@nodes) or @nodes.nil?
-      @nodes << node
+      nodes << node
+      clear_memo
       self
     end
 
@@ -69,17 +71,20 @@ module Ox
     def prepend_child(node)
       raise 'argument to << must be a String or Ox::Node.' unless node.is_a?(String) or node.is_a?(Node)
 
-      @nodes = [] if !instance_variable_defined?(:@nodes) or @nodes.nil?
-      @nodes.unshift(node)
+      nodes.unshift(node)
+      clear_memo
       self
     end
 
-    # Returns true if this Object and other are of the same type and have the
-    # equivalent value and the equivalent elements otherwise false is returned.
+    # Returns true if this Object and other are both Elements or both
+    # Documents and have the equivalent value and the equivalent elements
+    # otherwise false is returned. An Ox::LazyElement is an Element so it is
+    # equal to the Element parsed from the same XML.
     # - +other+ [Object] Object compare _self_ to.
     # *return* [Boolean] true if both Objects are equivalent, otherwise false.
     def eql?(other)
-      return false unless super
+      return false unless other.is_a?(Element) && other.is_a?(Document) == is_a?(Document)
+      return false unless value == other.value
       return false unless attributes == other.attributes
       return false unless nodes == other.nodes
 
@@ -100,18 +105,20 @@ module Ox
     def replace_text(txt)
       raise 'the argument to replace_text() must be a String' unless txt.is_a?(String)
 
-      if !instance_variable_defined?(:@nodes) or @nodes.nil?
-        @node = []
+      if !instance_variable_defined?(:@nodes) or !@nodes.is_a?(Array)
+        @nodes = []
       else
         @nodes.clear
       end
       @nodes << txt
+      clear_memo
+      @nodes
     end
 
     # Return true if all the key-value pairs in the cond Hash match the
     # @attributes key-values.
     def attr_match(cond)
-      cond.each_pair { |k, v| return false unless v == @attributes[k.to_sym] || v == @attributes[k.to_s] }
+      cond.each_pair { |k, v| return false unless v == attributes[k.to_sym] || v == attributes[k.to_s] }
       true
     end
 
@@ -227,8 +234,8 @@ module Ox
         i -= 1
       end
       if instance_variable_defined?(:@attributes)
-        return @attributes[id] if @attributes.has_key?(id)
-        return @attributes[ids] if @attributes.has_key?(ids)
+        return attributes[id] if attributes.has_key?(id)
+        return attributes[ids] if attributes.has_key?(ids)
       end
       return nil if has_some
 
@@ -248,8 +255,8 @@ module Ox
         return true if n.value == id_str || n.value == id_sym || name_matchs?(n.value, id_str)
       end
       if instance_variable_defined?(:@attributes) && !@attributes.nil?
-        return true if @attributes.has_key?(id_str)
-        return true if @attributes.has_key?(id_sym)
+        return true if attributes.has_key?(id_str)
+        return true if attributes.has_key?(id_sym)
       end
       false
     end
@@ -264,7 +271,7 @@ module Ox
         if instance_variable_defined?(:@attributes)
           step = step[1..-1]
           sym_step = step.to_sym
-          @attributes.each do |k, v|
+          attributes.each do |k, v|
             found << v if ('?' == step or k == step or k == sym_step)
           end
         end
@@ -347,7 +354,8 @@ module Ox
         if instance_variable_defined?(:@attributes)
           step = step[1..-1]
           sym_step = step.to_sym
-          @attributes.delete_if { |k, v| '?' == step || k.to_sym == sym_step }
+          attributes.delete_if { |k, v| '?' == step || k.to_sym == sym_step }
+          clear_memo
         end
       else # element name
         if (i = step.index('[')).nil? # just name
@@ -410,6 +418,7 @@ module Ox
         end
         if (1 == path.size)
           nodes.delete_if { |n| match.include?(n) }
+          clear_memo
         elsif '*' == name
           match.each { |n| n.del_locate(path) if n.is_a?(Element) }
           match.each { |n| n.del_locate(path[1..-1]) if n.is_a?(Element) }
@@ -447,7 +456,9 @@ module Ox
 
       nodes.tap do |ns|
         # found.delete(n.object_id) stops looking for an already found object_id
+        cnt = ns.size
         ns.delete_if { |n| found.include?(n.object_id) ? found.delete(n.object_id) : false }
+        clear_memo if cnt != ns.size
         nodes.each do |n|
           n.send(:recursive_children_removal, found) if n.is_a?(Ox::Element)
         end
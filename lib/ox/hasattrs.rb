@@ -5,19 +5,35 @@ module Ox
   # To access the attributes there are several options. One is to walk the attributes. The easiest for simple regularly
   # formatted XML is to reference the attributes simply by name.
   module HasAttrs
-    # Returns all the attributes of the Instruct as a Hash.
+    # Returns all the attributes of the Instruct as a Hash. Elements loaded
+    # with the :compact mode keep their attributes as a flat Array of name and
+    # value pairs until this method is called.
     # *return* [Hash] all attributes and attribute values.
     def attributes
       @attributes = {} if !instance_variable_defined?(:@attributes) or @attributes.nil?
+      @attributes = Hash[*@attributes] if @attributes.is_a?(Array)
       @attributes
     end
 
     # Returns the value of an attribute.
     # - +attr+ [Symbol|String] attribute name or key to return the value for
     def [](attr)
-      return nil unless instance_variable_defined?(:@attributes) and @attributes.is_a?(Hash)
+      return nil unless instance_variable_defined?(:@attributes)
 
-      @attributes[attr] or (attr.is_a?(String) ? @attributes[attr.to_sym] : @attributes[attr.to_s])
+      alt = attr.is_a?(String) ? attr.to_sym : attr.to_s
+      if @attributes.is_a?(Array)
+        i = 0
+        while i < @attributes.size
+          k = @attributes[i]
+          return @attributes[i + 1] if k == attr or k == alt
+
+          i += 2
+        end
+        return nil
+      end
+      return nil unless @attributes.is_a?(Hash)
+
+      @attributes[attr] or @attributes[alt]
     end
 
     # Adds or set an attribute of the Instruct.
@@ -26,7 +42,7 @@ module Ox
     def []=(attr, value)
       raise 'argument to [] must be a Symbol or a String.' unless attr.is_a?(Symbol) or attr.is_a?(String)
 
-      @attributes = {} if !instance_variable_defined?(:@attributes) or @attributes.nil?
+      attributes
       a_str = attr.to_s
       a_sym = attr.to_sym
       if @attributes.has_key?(a_str)
@@ -35,6 +51,8 @@ module Ox
         attr = a_sym
       end
       @attributes[attr] = value.to_s
+      clear_memo
+      value
     end
 
     # Handles the 'easy' API that allows navigating a simple XML by
@@ -45,8 +63,8 @@ module Ox
     def method_missing(id, *args, &block)
       ids = id.to_s
       if instance_variable_defined?(:@attributes)
-        return @attributes[id] if @attributes.has_key?(id)
-        return @attributes[ids] if @attributes.has_key?(ids)
+        return attributes[id] if attributes.has_key?(id)
+        return attributes[ids] if attributes.has_key?(ids)
       end
       raise NoMethodError.new("#{ids} not found", name)
     end
@@ -2,7 +2,7 @@ module Ox
   # The Node is the base class for all other in the Ox module.
   class Node
     # String value associated with the Node.
-    attr_accessor :value
+    attr_reader :value
 
     # Creates a new Node with the specified String value.
     # - +value+ [String] string value for the Node
@@ -10,6 +10,13 @@ module Ox
       @value = value.to_s
     end
 
+    # Sets the String value of the Node and drops any memoized dump.
+    # - +value+ [String] new value
+    def value=(value)
+      @value = value
+      clear_memo
+    end
+
     # Returns true if this Object and other are of the same type and have the
     # equivalent value otherwise false is returned.
     # - +other+ [Object] Object to compare _self_ to.
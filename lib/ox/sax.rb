@@ -31,7 +31,19 @@ module Ox
   # value() methods are called for the same element in the XML document the the
   # text() method is ignored if the value() method is defined or public. The
   # same is true for attr() and attr_value(). When all attributes have been read
-  # the attr_done() callback will be invoked.
+  # the attr_done() callback will be invoked. If the :columns option is given
+  # to Ox.sax_parse() the columns() callback is invoked at the end of the parse
+  # with the collected columns.
+  #
+  # A text or CDATA node is normally read whole before text() or cdata() is
+  # called so a very large one, such as an embedded base64 attachment, needs
+  # a buffer and a String as large as the node. If text_chunk() is defined it
+  # is called in place of text() and value() with pieces of about the
+  # :chunk_size option and a flag that is true on the last piece of the node.
+  # cdata_chunk() does the same for CDATA. Pieces never split a character
+  # reference or a UTF-8 character and the :skip mode is applied across them.
+  # Text that is base64 encoded data can instead be decoded in C and written
+  # straight to a file with the :base64 option to Ox.sax_parse().
   #
   #    def instruct(target); end
   #    def end_instruct(target); end
@@ -41,18 +53,37 @@ module Ox
   #    def doctype(str); end
   #    def comment(str); end
   #    def cdata(str); end
+  #    def cdata_chunk(str, final); end
   #    def text(str); end
+  #    def text_chunk(str, final); end
   #    def value(value); end
   #    def start_element(name); end
   #    def end_element(name); end
   #    def error(message, line, column); end
   #    def abort(name); end
+  #    def columns(columns); end
   #
   # Initializing _line_ attribute in the initializer will cause that variable to
   # be updated before each callback with the XML line number. The same is true
   # for the _column_ attribute but it will be updated with the column in the XML
   # file that is the start of the element or node just read. @pos if defined
   # will hold the number of bytes from the start of the document.
+  #
+  # Setting those variables costs a little on every callback. A handler that
+  # only needs the location now and then, such as when reporting an error, can
+  # call location() instead which returns [pos, line, column] for the current
+  # callback. Passing location: false to Ox.sax_parse() turns off line and
+  # column tracking altogether.
+  #
+  # A long parse can be made restartable by calling checkpoint() from
+  # end_element() and saving the returned String. Passing it later as the
+  # :resume option to Ox.sax_parse() with the same document seeks past the
+  # part already parsed and continues with the same open elements.
+  #
+  # For a small extractor a Hash of callback names mapped to Procs can be
+  # passed to Ox.sax_parse() in place of a handler.
+  #
+  #  Ox.sax_parse({ start_element: ->(name) { puts name } }, xml)
   class Sax
     # Create a new instance of the Sax handler class.
     def initialize
@@ -82,8 +113,12 @@ module Ox
 
     def cdata(str); end
 
+    def cdata_chunk(str, final); end
+
     def text(str); end
 
+    def text_chunk(str, final); end
+
     def value(value); end
 
     def start_element(name); end
@@ -93,5 +128,7 @@ module Ox
     def error(message, line, column); end
 
     def abort(name); end
+
+    def columns(columns); end
   end # Sax
 end # Ox
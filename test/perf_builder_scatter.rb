@@ -0,0 +1,57 @@
+#!/usr/bin/env ruby
+
+# Compares an Ox::Builder.file that copies raw blobs into its buffer with
+# one in scatter mode that writes the Strings with writev().
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'base64'
+require 'tmpdir'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 20
+$blobs = 5_000
+$size = 8_000
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-b', '--blobs [Int]', Integer, 'blobs per document')  { |b| $blobs = b }
+opts.on('-s', '--size [Int]', Integer, 'bytes per blob')       { |s| $size = s }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+$blob = Base64.strict_encode64('x' * ($size * 3 / 4))
+$path = File.join(Dir.tmpdir, 'ox_perf_builder_scatter.xml')
+
+def build(scatter)
+  b = Ox::Builder.file($path, indent: 0, scatter: scatter)
+  b.element('blobs')
+  $blobs.times do |i|
+    b.element('blob', id: i.to_s)
+    b.raw($blob)
+    b.pop
+  end
+  b.close
+end
+
+puts "#{$blobs} blobs of #{$blob.size} bytes, #{$iter} times."
+
+perf = Perf.new
+perf.add('copy', 'file') { build(false) }
+perf.add('scatter', 'file') { build(true) }
+perf.run($iter)
+File.delete($path)
@@ -0,0 +1,52 @@
+#!/usr/bin/env ruby
+
+# Compares dumping a large generic document into a growing buffer with
+# measuring it first and writing into a String of the exact size.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 20
+$rows = 200_000
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-r', '--rows [Int]', Integer, 'items per document')   { |r| $rows = r }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+$doc = Ox::Document.new
+root = Ox::Element.new('items')
+$doc << root
+$rows.times { |i|
+  e = Ox::Element.new('item')
+  e[:id] = i.to_s
+  e << (Ox::Element.new('name') << "Item #{i}")
+  e << (Ox::Element.new('description') << 'A plain description that takes up some room & a bit more.')
+  root << e
+}
+xml = Ox.dump($doc)
+
+raise 'measured dump differs' unless xml == Ox.dump($doc, measure: true)
+
+puts "#{$rows} items in a #{xml.size} byte document, #{$iter} times."
+
+perf = Perf.new
+perf.add('grow', 'dump') { Ox.dump($doc) }
+perf.add('measure', 'dump') { Ox.dump($doc, measure: true) }
+perf.run($iter)
@@ -0,0 +1,61 @@
+#!/usr/bin/env ruby
+
+# Compares dumping a long Array of Floats and Strings and a generic document
+# with many elements on one thread and with the :parallel option.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'etc'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 20
+$rows = 100_000
+$threads = Etc.nprocessors
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-r', '--rows [Int]', Integer, 'items per array')      { |r| $rows = r }
+opts.on('-t', '--threads [Int]', Integer, 'parallel threads')  { |t| $threads = t }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+$vals = Array.new($rows) { |i| i.even? ? i * 1.0001 : "value #{i} <needs> & escaping" }
+$doc = Ox::Document.new
+root = Ox::Element.new('items')
+$doc << root
+$rows.times { |i|
+  e = Ox::Element.new('item')
+  e[:id] = i.to_s
+  e[:note] = %{"quoted" & <tagged>}
+  e << "Item #{i} with text that needs & escaping"
+  root << e
+}
+
+raise 'object dumps differ' unless Ox.dump($vals, mode: :object) == Ox.dump($vals, mode: :object, parallel: $threads)
+raise 'generic dumps differ' unless Ox.dump($doc) == Ox.dump($doc, parallel: $threads)
+
+puts "#{$rows} items dumped #{$iter} times with #{$threads} threads."
+
+perf = Perf.new
+perf.add('serial', 'object') { Ox.dump($vals, mode: :object) }
+perf.add('parallel', 'object') { Ox.dump($vals, mode: :object, parallel: $threads) }
+perf.run($iter)
+
+perf = Perf.new
+perf.add('serial', 'generic') { Ox.dump($doc) }
+perf.add('parallel', 'generic') { Ox.dump($doc, parallel: $threads) }
+perf.run($iter)
@@ -0,0 +1,92 @@
+#!/usr/bin/env ruby
+
+# Compares finding the offset of each keyed record with a Ruby SAX handler
+# against Ox.index_file which scans in C. Also times looking up and loading
+# single records with Ox.load_at.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 20
+$rows = 10_000
+$filename = 'perf_index_test.xml'
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-r', '--rows [Int]', Integer, 'records in the file')  { |r| $rows = r }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+row = %{  <record id="%08d">
+    <name>Record %d</name>
+    <price currency="USD">12.34</price>
+    <tag>red</tag>
+  </record>
+}
+File.write($filename, %{<?xml version="1.0"?>\n<records>\n} + Array.new($rows) { |i| format(row, i, i) }.join + %{</records>\n})
+
+# Tracks the start offset and id of each record from SAX locations.
+class IndexSax < Ox::Sax
+  attr_reader :index
+
+  def initialize
+    super
+    @index = {}
+    @start = nil
+    @id = nil
+  end
+
+  def start_element(name)
+    @start = location[0] - 1 if :record == name
+  end
+
+  def attr(name, value)
+    @id = value if :id == name && !@start.nil?
+  end
+
+  def end_element(name)
+    return unless :record == name
+
+    @index[@id] = @start
+    @start = nil
+  end
+end
+
+puts "#{$rows} records in a #{File.size($filename)} byte file, #{$iter} times."
+
+$index = Ox.index_file($filename, element: 'record', key: '@id')
+$keys = $index.keys.sample(100)
+
+perf = Perf.new
+perf.add('Ruby handler', 'sax_parse') {
+  h = IndexSax.new
+  File.open($filename) { |f| Ox.sax_parse(h, f) }
+  raise 'wrong count' unless $rows == h.index.size
+}
+perf.add('index_file', 'index_file') {
+  raise 'wrong count' unless $rows == Ox.index_file($filename, element: 'record', key: '@id').size
+}
+perf.run($iter)
+
+perf = Perf.new
+perf.add('load_at x100', 'load_at') {
+  $keys.each { |k| Ox.load_at($filename, *$index[k], mode: :hash) }
+}
+perf.run($iter)
+
+File.delete($filename)
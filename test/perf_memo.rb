@@ -0,0 +1,67 @@
+#!/usr/bin/env ruby
+
+# Compares re-dumping a large generic document after small changes with and
+# without the :memoize option.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 100
+$rows = 2_000
+$every = 1
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-r', '--rows [Int]', Integer, 'items per document')   { |r| $rows = r }
+opts.on('-c', '--change [Int]', Integer, 'dumps per change')     { |c| $every = c }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+row = %{  <item id="%08d">
+    <name>Item %d</name>
+    <price currency="USD">12.34</price>
+    <description>A fairly long description of the item that makes it worth keeping.</description>
+    <tag>red</tag>
+    <tag>large</tag>
+  </item>
+}
+xml = %{<?xml version="1.0"?>\n<items>\n} + Array.new($rows) { |i| format(row, i, i) }.join + %{</items>\n}
+$doc = Ox.load(xml, mode: :generic)
+$items = $doc.nodes[0].nodes
+$plain = Ox.dump($doc, indent: 2)
+
+raise 'memoized dump differs' unless $plain == Ox.dump($doc, indent: 2, memoize: true)
+
+puts "#{$rows} items in a #{$plain.size} byte document, one attribute changed every #{$every} dumps, #{$iter} times."
+
+def change
+  $items[($cnt / $every) % $rows][:id] = $cnt.to_s if 0 == $cnt % $every
+  $cnt += 1
+end
+
+$cnt = 0
+perf = Perf.new
+perf.add('dump', 'plain') {
+  change
+  Ox.dump($doc, indent: 2)
+}
+perf.add('memoize', 'memoize') {
+  change
+  Ox.dump($doc, indent: 2, memoize: true)
+}
+perf.run($iter)
@@ -30,6 +30,8 @@ do_load = false
 do_dump = false
 do_read = false
 do_write = false
+do_many = false
+$many = 100_000
 $iter = 1000
 
 opts = OptionParser.new
@@ -42,6 +44,7 @@ opts.on('-l', 'load')                                       { do_load = true }
 opts.on('-d', 'dump')                                       { do_dump = true }
 opts.on('-r', 'read')                                       { do_read = true }
 opts.on('-w', 'write')                                      { do_write = true }
+opts.on('-m', '--many [Int]', Integer, 'dump an Array of many objects of a few classes') { |m| do_many = true; $many = m unless m.nil? }
 opts.on('-a', 'load, dump, read and write')                 { do_load = true; do_dump = true; do_read = true; do_write = true }
 
 opts.on('-i', '--iterations [Int]', Integer, 'iterations')  { |it| $iter = it }
@@ -55,7 +58,7 @@ $xml = nil
 $mars = nil
 $json = nil
 
-unless do_load || do_dump || do_read || do_write
+unless do_load || do_dump || do_read || do_write || do_many
   do_load = true
   do_dump = true
   do_read = true
@@ -124,3 +127,41 @@ if do_write
   perf.add('Marshal', 'dump') { Marshal.dump($obj, File.new('sample.marshal', 'w')) } unless ox_only
   perf.run($iter)
 end
+
+# Simple classes for the many objects dump.
+class PerfItem
+  def initialize(id, name, price, at)
+    @id = id
+    @name = name
+    @price = price
+    @at = at
+  end
+end
+
+class PerfTagged
+  def initialize(id, tags)
+    @id = id
+    @tags = tags
+  end
+end
+
+PerfPoint = Struct.new(:x, :y)
+
+if do_many
+  # Object mode dumps of many objects of a few classes reuse the per class
+  # metadata so the class name and ivar names are looked up once per class.
+  items = Array.new($many) { |i|
+    if i.even?
+      PerfItem.new(i, 'item', 1.5, PerfPoint.new(i, -i))
+    else
+      PerfTagged.new(i, [:a, :b])
+    end
+  }
+  puts '-' * 80
+  puts "Dump Performance of #{$many} objects"
+  perf = Perf.new
+  perf.add('Ox', 'dump') { Ox.dump(items, indent: $indent, circular: $circular) }
+  perf.add('Oj', 'dump') { Oj.dump(items) } unless defined?(Oj).nil? || ox_only
+  perf.add('Marshal', 'dump') { Marshal.dump(items) } unless ox_only
+  perf.run(($iter / 100).clamp(1, 10))
+end
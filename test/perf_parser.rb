@@ -0,0 +1,56 @@
+#!/usr/bin/env ruby
+
+# Compares Ox.load() with a reused Ox::Parser on many small messages where
+# setting up each parse is a large part of the cost.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 200_000
+$mode = :hash
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-m', '--mode [String]', String, 'load mode')          { |m| $mode = m.to_sym }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+# About a 2KB message.
+$xml = %{<?xml version="1.0" encoding="UTF-8"?>
+<message id="m-1" type="order">
+  <header>
+    <from>client</from>
+    <to>server</to>
+    <sent>2024-02-29T12:34:56Z</sent>
+  </header>
+  <body>
+#{(1..20).map { |i| %{    <item sku="sku-#{i}" qty="#{i}"><name>Item number #{i}</name><price>#{i}.99</price></item>} }.join("\n")}
+  </body>
+</message>
+}
+$opts = { mode: $mode, symbolize_keys: false, skip: :skip_white }
+$parser = Ox::Parser.new($opts)
+
+raise 'results differ' unless Ox.load($xml, $opts).eql?($parser.load($xml))
+
+puts "#{$xml.size} byte message in #{$mode} mode, #{$iter} times."
+
+perf = Perf.new
+perf.add('Ox::Parser', 'load') { $parser.load($xml) }
+perf.add('Ox', 'load') { Ox.load($xml, $opts) }
+perf.run($iter)
@@ -33,6 +33,7 @@ $filesize = 1000 # KBytes
 $iter = 1000
 $strio = false
 $pos = false
+$procs = false
 $smart = false
 
 opts = OptionParser.new
@@ -41,6 +42,7 @@ opts.on('-x', 'ox only')                                       { $ox_only = true
 opts.on('-a', 'all callbacks')                                 { $all_cbs = true }
 opts.on('-b', 'html smart')                                    { $smart = true }
 opts.on('-p', 'update position')                               { $pos = true; $all_cbs = true }
+opts.on('-l', 'Hash of lambdas handler')                       { $procs = true }
 opts.on('-z', 'use StringIO instead of file')                  { $strio = true }
 opts.on('-f', '--file [String]', String, 'filename')           { |f| $filename = f }
 opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
@@ -171,7 +173,16 @@ perf.add('Ox::Sax', 'sax_parse') do
   input.close
 end
 perf.before('Ox::Sax') do
-  $handler = if $all_cbs
+  $handler = if $procs
+               if $all_cbs
+                 one = ->(_a) {}
+                 two = ->(_a, _b) {}
+                 h = %i[start_element end_element text value instruct doctype comment cdata].to_h { |k| [k, one] }
+                 h.merge(attr: two, attr_value: two)
+               else
+                 {}
+               end
+             elsif $all_cbs
                $pos ? OxPosAllSax.new : OxAllSax.new
              else
                OxSax.new
@@ -0,0 +1,81 @@
+#!/usr/bin/env ruby
+
+# Compares a handler that decodes base64 element text with unpack1('m') and
+# writes it to a file against the :base64 option which decodes in C and
+# writes straight to the file descriptor.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 10
+$size = 20 # MB of decoded data
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-s', '--size [Int]', Integer, 'MB of data')           { |s| $size = s }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+$path = 'sax_base64.xml'
+$out_path = 'sax_base64.out'
+File.open($path, 'w') { |f|
+  f.write('<envelope><body><attachment>')
+  rnd = Random.new(1)
+  ($size * 16).times { f.write([rnd.bytes(65_535)].pack('m')) }
+  f.write('</attachment></body></envelope>')
+}
+$data_size = $size * 16 * 65_535
+
+class AttachmentSax < Ox::Sax
+  def initialize(out)
+    super()
+    @out = out
+    @in_att = false
+  end
+
+  def start_element(name)
+    @in_att = (:attachment == name)
+  end
+
+  def end_element(_name)
+    @in_att = false
+  end
+
+  def text(str)
+    @out.write(str.unpack1('m')) if @in_att
+  end
+end
+
+puts "#{File.size($path)} byte document with #{$data_size} bytes encoded, #{$iter} times."
+
+perf = Perf.new
+perf.add('unpack', 'sax_parse') {
+  File.open($out_path, 'wb') { |out|
+    File.open($path) { |f| Ox.sax_parse(AttachmentSax.new(out), f) }
+  }
+  raise 'wrong size' unless $data_size == File.size($out_path)
+}
+perf.add('base64', 'sax_parse') {
+  File.open($out_path, 'wb') { |out|
+    File.open($path) { |f| Ox.sax_parse(Ox::Sax.new, f, base64: { 'body/attachment' => out }) }
+  }
+  raise 'wrong size' unless $data_size == File.size($out_path)
+}
+perf.run($iter)
+File.delete($path)
+File.delete($out_path)
@@ -0,0 +1,79 @@
+#!/usr/bin/env ruby
+
+# Compares reading a document with a large base64 text node whole with
+# text() against reading it in pieces with text_chunk(). The pieces need a
+# read buffer of about the chunk size where the whole node needs a buffer and
+# a String at least as large as the node.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 10
+$size = 20 # MB of base64 text
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-s', '--size [Int]', Integer, 'MB of text')           { |s| $size = s }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+$path = 'sax_chunk.xml'
+File.open($path, 'w') { |f|
+  f.write('<doc><attachment>')
+  rnd = Random.new(1)
+  ($size * 16).times { f.write([rnd.bytes(49_152)].pack('m')) }
+  f.write('</attachment></doc>')
+}
+$text_size = File.size($path) - 36
+
+class WholeSax < Ox::Sax
+  attr_reader :size
+
+  def text(str)
+    @size = str.bytesize
+  end
+end
+
+class ChunkSax < Ox::Sax
+  attr_reader :size
+
+  def initialize
+    super
+    @size = 0
+  end
+
+  def text_chunk(str, _final)
+    @size += str.bytesize
+  end
+end
+
+puts "#{File.size($path)} byte document, #{$iter} times."
+
+perf = Perf.new
+perf.add('text_chunk', 'sax_parse') {
+  h = ChunkSax.new
+  File.open($path) { |f| Ox.sax_parse(h, f) }
+  raise 'wrong size' unless $text_size == h.size
+}
+perf.add('text', 'sax_parse') {
+  h = WholeSax.new
+  File.open($path) { |f| Ox.sax_parse(h, f) }
+  raise 'wrong size' unless $text_size == h.size
+}
+perf.run($iter)
+File.delete($path)
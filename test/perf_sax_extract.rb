@@ -0,0 +1,105 @@
+#!/usr/bin/env ruby
+
+# Compares building a Hash per record with a Ruby SAX handler against
+# Ox.sax_extract which builds the same Hash in C.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'stringio'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 20
+$rows = 10_000
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-r', '--rows [Int]', Integer, 'items per document')   { |r| $rows = r }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+row = %{  <item id="%08d">
+    <name>Item %d</name>
+    <price currency="USD">12.34</price>
+    <tag>red</tag>
+    <tag>large</tag>
+  </item>
+}
+$xml = %{<?xml version="1.0"?>\n<items>\n} + Array.new($rows) { |i| format(row, i, i) }.join + %{</items>\n}
+
+# Builds the same shape as Ox.load(item, mode: :hash) from SAX events.
+class ItemSax < Ox::Sax
+  attr_reader :count
+
+  def initialize
+    super
+    @count = 0
+    @stack = nil
+  end
+
+  def start_element(name)
+    return if @stack.nil? && :item != name
+
+    @stack ||= []
+    @stack << [name, nil, nil]
+  end
+
+  def attr(name, value)
+    return if @stack.nil?
+
+    top = @stack.last
+    (top[1] ||= {})[name] = value
+  end
+
+  def text(value)
+    @stack.last[2] = value unless @stack.nil?
+  end
+
+  def end_element(_name)
+    return if @stack.nil?
+
+    name, attrs, val = @stack.pop
+    val = attrs.nil? ? val : [attrs] + (val.nil? ? [] : [val])
+    if @stack.empty?
+      @stack = nil
+      @count += 1
+    else
+      parent = @stack.last
+      parent[2] = {} unless parent[2].is_a?(Hash)
+      if parent[2].key?(name)
+        prev = parent[2][name]
+        parent[2][name] = prev.is_a?(Array) ? prev << val : [prev, val]
+      else
+        parent[2][name] = val
+      end
+    end
+  end
+end
+
+puts "#{$rows} items in a #{$xml.size} byte document, #{$iter} times."
+
+perf = Perf.new
+perf.add('Ruby handler', 'sax_parse') {
+  h = ItemSax.new
+  Ox.sax_parse(h, StringIO.new($xml))
+  raise 'wrong count' unless $rows == h.count
+}
+perf.add('sax_extract', 'sax_extract') {
+  cnt = 0
+  Ox.sax_extract(StringIO.new($xml), element: 'item') { |_| cnt += 1 }
+  raise 'wrong count' unless $rows == cnt
+}
+perf.run($iter)
@@ -0,0 +1,154 @@
+#!/usr/bin/env ruby
+
+# Runs many concurrent SAX parses over local pipes under a fiber scheduler.
+# Writers dribble each document into its pipe so readers regularly find the
+# pipe empty and have to wait through the scheduler.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 10
+$parses = 100
+$rows = 200
+$chunk = 1024
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-n', '--parses [Int]', Integer, 'concurrent parses')  { |n| $parses = n }
+opts.on('-r', '--rows [Int]', Integer, 'rows per document')    { |r| $rows = r }
+opts.on('-c', '--chunk [Int]', Integer, 'bytes per write')     { |c| $chunk = c }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+row = %{  <row id="%08d">
+    <cell id="A" type="Fixnum">1234</cell>
+    <cell id="B" type="String">A string.</cell>
+    <cell id="C" type="String">This is a longer string that stretches over a larger number of characters.</cell>
+    <cell id="D" type="Float">-12.345</cell>
+  </row>
+}
+$xml = %{<?xml version="1.0"?>\n<table>\n} + Array.new($rows) { |i| format(row, i) }.join + %{</table>\n}
+
+# A minimal IO.select based scheduler, just enough for pipes and sleep.
+class PerfScheduler
+  def initialize
+    @readable = {}
+    @writable = {}
+    @ready = []
+  end
+
+  def fiber(&block)
+    f = Fiber.new(blocking: false, &block)
+    f.resume
+    f
+  end
+
+  def io_wait(io, events, _timeout)
+    @readable[io] = Fiber.current if (events & IO::READABLE) != 0
+    @writable[io] = Fiber.current if (events & IO::WRITABLE) != 0
+    Fiber.yield
+    events
+  end
+
+  def kernel_sleep(_duration = nil)
+    @ready << Fiber.current
+    Fiber.yield
+  end
+
+  def block(_blocker, _timeout = nil)
+    Fiber.yield
+  end
+
+  def unblock(_blocker, fiber)
+    @ready << fiber
+  end
+
+  def close
+    run
+  end
+
+  def run
+    until @readable.empty? && @writable.empty? && @ready.empty?
+      ready = @ready
+      @ready = []
+      ready.each { |f| f.resume if f.alive? }
+      next if @readable.empty? && @writable.empty?
+
+      r, w = IO.select(@readable.keys, @writable.keys, nil, ready.empty? ? nil : 0)
+      r&.each { |io| @readable.delete(io)&.resume }
+      w&.each { |io| @writable.delete(io)&.resume }
+    end
+  end
+end
+
+class CountSax < Ox::Sax
+  attr_reader :rows
+
+  def initialize
+    super
+    @rows = 0
+  end
+
+  def start_element(name)
+    @rows += 1 if :row == name
+  end
+end
+
+# Hides the IO so the parser falls back to calling readpartial().
+class PartialReader
+  def initialize(io)
+    @io = io
+  end
+
+  def readpartial(size)
+    @io.readpartial(size)
+  end
+end
+
+def run_parses(wrap)
+  handlers = []
+  Thread.new {
+    Fiber.set_scheduler(PerfScheduler.new)
+    $parses.times do
+      r, w = IO.pipe
+      handler = CountSax.new
+      handlers << handler
+      Fiber.schedule do
+        Ox.sax_parse(handler, wrap ? PartialReader.new(r) : r)
+        r.close
+      end
+      Fiber.schedule do
+        pos = 0
+        while pos < $xml.size
+          w.write($xml[pos, $chunk])
+          pos += $chunk
+          sleep(0)
+        end
+        w.close
+      end
+    end
+  }.join
+  handlers.each { |h| raise "expected #{$rows} rows, parsed #{h.rows}" unless $rows == h.rows }
+end
+
+puts "#{$parses} concurrent parses of a #{$xml.size} byte document written #{$chunk} bytes at a time, #{$iter} times."
+
+perf = Perf.new
+perf.add('descriptor', 'sax_parse') { run_parses(false) }
+perf.add('readpartial', 'sax_parse') { run_parses(true) }
+perf.run($iter)
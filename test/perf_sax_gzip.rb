@@ -0,0 +1,73 @@
+#!/usr/bin/env ruby
+
+# Compares parsing a gzip file wrapped in Zlib::GzipReader with letting the
+# SAX parser inflate it with the :compressed option.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'zlib'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 20
+$rows = 20_000
+$filename = 'perf_sax_gzip.xml.gz'
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-r', '--rows [Int]', Integer, 'rows in the document') { |r| $rows = r }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+row = %{  <row id="%08d">
+    <cell id="A" type="Fixnum">1234</cell>
+    <cell id="B" type="String">A string.</cell>
+    <cell id="C" type="String">This is a longer string that stretches over a larger number of characters.</cell>
+    <cell id="D" type="Float">-12.345</cell>
+  </row>
+}
+xml = %{<?xml version="1.0"?>\n<table>\n} + Array.new($rows) { |i| format(row, i) }.join + %{</table>\n}
+Zlib::GzipWriter.open($filename) { |gz| gz.write(xml) }
+
+class CountSax < Ox::Sax
+  attr_reader :rows
+
+  def initialize
+    super
+    @rows = 0
+  end
+
+  def start_element(name)
+    @rows += 1 if :row == name
+  end
+end
+
+puts "#{$rows} rows, #{xml.size} bytes compressed to #{File.size($filename)}, #{$iter} times."
+
+perf = Perf.new
+perf.add('GzipReader', 'sax_parse') {
+  h = CountSax.new
+  Zlib::GzipReader.open($filename) { |gz| Ox.sax_parse(h, gz) }
+  raise 'wrong count' unless $rows == h.rows
+}
+perf.add('compressed', 'sax_parse') {
+  h = CountSax.new
+  File.open($filename) { |f| Ox.sax_parse(h, f, compressed: true) }
+  raise 'wrong count' unless $rows == h.rows
+}
+perf.run($iter)
+
+File.delete($filename)
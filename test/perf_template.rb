@@ -0,0 +1,75 @@
+#!/usr/bin/env ruby
+
+# Compares building the same envelope with Ox::Builder calls and with an
+# Ox::Template that only fills in the values.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 100_000
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+$values = { id: 12_345, user: 'Peter & Co', amount: '12.34', currency: 'USD', memo: 'a < b' }
+
+$template = Ox::Template.compile(%{<?xml version="1.0" encoding="UTF-8"?>
+<Envelope xmlns="http://schemas.xmlsoap.org/soap/envelope/">
+  <Header>
+    <Auth version="2" realm="payments"/>
+  </Header>
+  <Body>
+    <Payment id="{{id}}">
+      <User>{{user}}</User>
+      <Amount currency="{{currency}}">{{amount}}</Amount>
+      <Memo>{{memo}}</Memo>
+    </Payment>
+  </Body>
+</Envelope>
+})
+
+def build(v)
+  Ox::Builder.new(indent: 2) { |b|
+    b.instruct(:xml, version: '1.0', encoding: 'UTF-8')
+    b.element('Envelope', xmlns: 'http://schemas.xmlsoap.org/soap/envelope/')
+    b.element('Header')
+    b.element('Auth', version: '2', realm: 'payments')
+    b.pop
+    b.pop
+    b.element('Body')
+    b.element('Payment', id: v[:id].to_s)
+    b.element('User')
+    b.text(v[:user])
+    b.pop
+    b.element('Amount', currency: v[:currency])
+    b.text(v[:amount])
+    b.pop
+    b.element('Memo')
+    b.text(v[:memo])
+    b.pop
+  }
+end
+
+raise 'different output' unless build($values) == $template.render($values)
+
+perf = Perf.new
+perf.add('Builder', 'new') { build($values) }
+perf.add('Template', 'render') { $template.render($values) }
+perf.run($iter)
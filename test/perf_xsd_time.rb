@@ -0,0 +1,48 @@
+#!/usr/bin/env ruby
+
+# Dumps and loads a timestamp heavy Object mode document with times in the
+# XSD format and in the default decimal format.
+
+$: << '.'
+$: << '..'
+$: << '../lib'
+$: << '../ext'
+
+if __FILE__ == $0
+  while (i = ARGV.index('-I'))
+    x = ARGV.slice!(i, 2)
+    $: << x[1]
+  end
+end
+
+require 'optparse'
+require 'ox'
+require 'perf'
+
+$verbose = 0
+$iter = 100
+$size = 10_000
+
+opts = OptionParser.new
+opts.on('-v', 'increase verbosity')                            { $verbose += 1 }
+opts.on('-i', '--iterations [Int]', Integer, 'iterations')     { |it| $iter = it }
+opts.on('-s', '--size [Int]', Integer, 'times per document')   { |s| $size = s }
+opts.on('-h', '--help', 'Show this display')                   { puts opts; Process.exit!(0) }
+opts.parse(ARGV)
+
+base = Time.now
+$times = Array.new($size) { |i| (base + (i * 3607.123456)).localtime(((i % 25) - 12) * 3600) }
+$xsd_xml = Ox.dump($times, mode: :object, xsd_date: true)
+$dec_xml = Ox.dump($times, mode: :object, xsd_date: false)
+
+puts "#{$size} Times per document, #{$iter} times."
+
+perf = Perf.new
+perf.add('xsd', 'dump') { Ox.dump($times, mode: :object, xsd_date: true) }
+perf.add('decimal', 'dump') { Ox.dump($times, mode: :object, xsd_date: false) }
+perf.run($iter)
+
+perf = Perf.new
+perf.add('xsd', 'load') { Ox.load($xsd_xml, mode: :object) }
+perf.add('decimal', 'load') { Ox.load($dec_xml, mode: :object) }
+perf.run($iter)
@@ -59,6 +59,46 @@ class AllSax < StartSax
   end
 end
 
+class LocationSax < Ox::Sax
+  attr_accessor :calls
+
+  def initialize
+    super
+    @calls = []
+  end
+
+  def start_element(name)
+    @calls << [:start_element, name, *location]
+  end
+
+  def end_element(name)
+    @calls << [:end_element, name, *location]
+  end
+end
+
+# Parses a nested document from the same handler when the nest element
+# starts.
+class NestedLocationSax < LocationSax
+  def start_element(name)
+    Ox.sax_parse(self, '<inner/>') if :nest == name
+    super
+  end
+end
+
+class CheckpointSax < AllSax
+  attr_accessor :checkpoints
+
+  def initialize
+    super
+    @checkpoints = []
+  end
+
+  def end_element(name)
+    super
+    @checkpoints << [@calls.size, checkpoint]
+  end
+end
+
 class LineColSax < StartSax
   def initialize
     @pos = nil    # this initializes the @pos variable which will then be set by the parser
@@ -132,6 +172,74 @@ class TypeSax < Ox::Sax
   end
 end
 
+class ColumnSax < Ox::Sax
+  attr_reader :cols
+  attr_reader :names
+  attr_reader :errors
+
+  def initialize
+    super
+    @cols = nil
+    @names = []
+    @errors = []
+  end
+
+  def start_element(name)
+    @names << name
+  end
+
+  def error(message, line, column)
+    @errors << message
+  end
+
+  def columns(cols)
+    @cols = cols
+  end
+end
+
+class ChunkSax < Ox::Sax
+  attr_reader :calls
+  attr_reader :max
+
+  def initialize
+    super
+    @calls = []
+    @max = 0
+  end
+
+  def start_element(name)
+    @calls << [:start_element, name]
+  end
+
+  def end_element(name)
+    @calls << [:end_element, name]
+  end
+
+  def text_chunk(str, final)
+    add_chunk(:text, str, final)
+  end
+
+  def cdata_chunk(str, final)
+    add_chunk(:cdata, str, final)
+  end
+
+  private
+
+  # Joins the pieces of a node so the calls match those of text() and cdata().
+  def add_chunk(type, str, final)
+    @max = str.bytesize if @max < str.bytesize
+    if @pending.nil?
+      @pending = [type, str.dup]
+    else
+      @pending[1] << str
+    end
+    return unless final
+
+    @calls << @pending
+    @pending = nil
+  end
+end
+
 class ErrorSax < Ox::Sax
   attr_reader :errors
 
@@ -88,6 +88,170 @@ class SaxBaseTest < Test::Unit::TestCase
                  ], handler.calls)
   end
 
+  def test_sax_location
+    Ox.default_options = $ox_sax_options
+    handler = LocationSax.new
+    assert_nil(handler.location)
+    xml = File.read(File.join(File.dirname(__FILE__), 'trilevel.xml'))
+    Ox.sax_parse(handler, xml)
+    assert_equal([
+                   [:start_element, :top, 23, 2, 1],
+                   [:start_element, :child, 31, 3, 3],
+                   [:start_element, :grandchild, 43, 4, 5],
+                   [:end_element, :grandchild, 55, 4, 17],
+                   [:end_element, :child, 59, 5, 3],
+                   [:end_element, :top, 68, 6, 1]
+                 ], handler.calls)
+    assert_nil(handler.location)
+
+    handler = LocationSax.new
+    Ox.sax_parse(handler, xml, location: false)
+    assert_equal([[:start_element, :top, 23, 0, 0], [:start_element, :child, 31, 0, 0]], handler.calls[0, 2])
+  end
+
+  def test_sax_location_nested
+    Ox.default_options = $ox_sax_options
+    handler = NestedLocationSax.new
+    Ox.sax_parse(handler, %{<top>\n  <nest/>\n</top>})
+    assert_equal([
+                   [:start_element, :top, 1, 1, 1],
+                   [:start_element, :inner, 1, 1, 1],
+                   [:end_element, :inner, 8, 1, 8],
+                   [:start_element, :nest, 9, 2, 3],
+                   [:end_element, :nest, 15, 2, 9],
+                   [:end_element, :top, 17, 3, 1]
+                 ], handler.calls)
+    assert_equal([:@calls], handler.instance_variables)
+    assert_nil(handler.location)
+  end
+
+  def test_sax_checkpoint
+    Ox.default_options = $ox_sax_options
+    xml = %{<?xml version="1.0"?>\n<top>\n  <a x="1">one</a>\n  <b><c/><d>two</d></b >\n</top>\n}
+    handler = CheckpointSax.new
+    assert_nil(handler.checkpoint)
+    Ox.sax_parse(handler, xml)
+    assert_equal(5, handler.checkpoints.size)
+    handler.checkpoints.each do |cnt, state|
+      [xml, StringIO.new(xml)].each do |input|
+        resumed = CheckpointSax.new
+        Ox.sax_parse(resumed, input, resume: state)
+        assert_equal(handler.calls[cnt..], resumed.calls)
+      end
+    end
+    assert_raise(Ox::ArgError) { Ox.sax_parse(AllSax.new, xml, resume: 'bad state') }
+  end
+
+  def test_sax_hash_handler
+    Ox.default_options = $ox_sax_options
+    calls = []
+    handler = {
+      start_element: ->(name) { calls << [:start_element, name] },
+      attr: ->(name, value) { calls << [:attr, name, value] },
+      text: proc { |value| calls << [:text, value] },
+      end_element: ->(name) { calls << [:end_element, name] }
+    }
+    Ox.sax_parse(handler, %{<top x="1">hello<child/></top>})
+    assert_equal([
+                   [:start_element, :top],
+                   [:attr, :x, '1'],
+                   [:text, 'hello'],
+                   [:start_element, :child],
+                   [:end_element, :child],
+                   [:end_element, :top]
+                 ], calls)
+    assert_raise(Ox::ArgError) { Ox.sax_parse({ text: 'not callable' }, '<top/>') }
+  end
+
+  def test_sax_extract
+    Ox.default_options = $ox_sax_options
+    item1 = %{<item id="1"><name>One &amp; only</name><tag>x</tag><tag>y</tag><empty/></item>}
+    item2 = %{<item><name>Two</name><sub a="1"><v>1</v></sub><sub a="2"/></item>}
+    xml = %{<?xml version="1.0"?>\n<root>\n  #{item1}\n  <other>skip</other>\n  #{item2}\n</root>\n}
+    [:hash, :hash_no_attrs].each do |mode|
+      records = []
+      Ox.sax_extract(StringIO.new(xml), element: 'item', mode: mode) { |h| records << h }
+      assert_equal([Ox.load(item1, mode: mode), Ox.load(item2, mode: mode)], records)
+    end
+    assert_raise(Ox::ArgError) { Ox.sax_extract(xml, mode: :hash) { |_| } }
+    assert_raise(Ox::ArgError) { Ox.sax_extract(xml, element: 'item', mode: :generic) { |_| } }
+  end
+
+  def test_sax_compressed
+    require 'zlib'
+    Ox.default_options = $ox_sax_options
+    xml = %{<top><child a="1">text</child></top>}
+    expected = [
+      [:start_element, :top],
+      [:start_element, :child],
+      [:attr, :a, '1'],
+      [:text, 'text'],
+      [:end_element, :child],
+      [:end_element, :top]
+    ]
+    [Zlib.gzip(xml), Zlib.deflate(xml), StringIO.new(Zlib.gzip(xml))].each do |input|
+      handler = AllSax.new
+      Ox.sax_parse(handler, input, compressed: true)
+      assert_equal(expected, handler.calls)
+    end
+    handler = AllSax.new
+    parser = Ox::Sax::Parser.new(handler, compressed: true)
+    Zlib.gzip(xml).each_char { |c| parser << c }
+    parser.finish
+    assert_equal(expected, handler.calls)
+  end
+
+  def test_sax_chunk
+    Ox.default_options = $ox_sax_options
+    text = ('café &amp; crème &#x1F600;  ' * 40) + ('x' * 300)
+    cdata = ('<b>€]</b> ' * 40) + ']'
+    xml = %{<top><a>#{text}</a><b><![CDATA[#{cdata}]]></b><c></c></top>}
+    [:skip_none, :skip_return, :skip_white, :skip_off].each do |skip|
+      expected = AllSax.new
+      Ox.sax_parse(expected, StringIO.new(xml), skip: skip)
+      handler = ChunkSax.new
+      Ox.sax_parse(handler, StringIO.new(xml), skip: skip, chunk_size: 64)
+      assert_equal(expected.calls, handler.calls)
+      assert_operator(handler.max, :<, 128)
+    end
+    handler = ChunkSax.new
+    Ox.sax_parse(handler, StringIO.new(xml))
+    assert_operator(handler.max, :>, 1000)
+    assert_raise(Ox::ArgError) { Ox.sax_parse(handler, xml, chunk_size: 0) }
+  end
+
+  def test_sax_base64
+    require 'tempfile'
+    Ox.default_options = $ox_sax_options
+    data = (0..255).to_a.pack('C*') * 20
+    xml = %{<msg><att>#{[data].pack('m')}</att><body><att>x</att></body><raw>#{[data[0, 100]].pack('m0')}</raw></msg>}
+    r, w = IO.pipe
+    reader = Thread.new { r.read }
+    Tempfile.create('sax_base64') { |f|
+      handler = AllSax.new
+      Ox.sax_parse(handler, StringIO.new(xml), base64: { 'msg/att' => w, raw: f.fileno })
+      w.close
+      assert_equal(data, reader.value.b)
+      f.rewind
+      assert_equal(data[0, 100], f.read.b)
+      assert_equal([
+                     [:start_element, :msg],
+                     [:start_element, :att],
+                     [:end_element, :att],
+                     [:start_element, :body],
+                     [:start_element, :att],
+                     [:text, 'x'],
+                     [:end_element, :att],
+                     [:end_element, :body],
+                     [:start_element, :raw],
+                     [:end_element, :raw],
+                     [:end_element, :msg]
+                   ], handler.calls)
+    }
+    r.close
+    assert_raise(Ox::ArgError) { Ox.sax_parse(AllSax.new, xml, base64: { att: StringIO.new }) }
+  end
+
   def test_sax_io_file
     Ox.default_options = $ox_sax_options
     handler = AllSax.new
@@ -425,6 +589,16 @@ encoding = "UTF-8" ?>},
                   ])
   end
 
+  def test_sax_nested_long_names
+    Ox.default_options = $ox_sax_options
+    # Enough long names to outgrow the initial element name storage.
+    names = Array.new(100) { |i| "element_#{'n' * (i % 70)}_#{i}" }
+    xml = names.map { |n| "<#{n}>" }.join + names.reverse.map { |n| "</#{n}>" }.join
+    parse_compare(xml,
+                  names.map { |n| [:start_element, n.to_sym] } + [[:text, '']] +
+                  names.reverse.map { |n| [:end_element, n.to_sym] })
+  end
+
   def test_sax_element_no_term
     Ox.default_options = $ox_sax_options
     parse_compare(%{
@@ -1142,6 +1316,115 @@ encoding = "UTF-8" ?>},
     assert_equal(t.usec, handler.item.usec)
   end
 
+  def test_sax_value_time_no_zone
+    Ox.default_options = $ox_sax_options
+    xml = %{<r><at>2012-01-05T10:20:30.5</at></r>}
+    handler = TypeSax.new(:as_time)
+    Ox.sax_parse(handler, StringIO.new(xml))
+    assert_equal(Time.utc(2012, 1, 5, 10, 20, 30.5), handler.item)
+    assert(handler.item.utc?)
+    columns = ColumnSax.new
+    Ox.sax_parse(columns, StringIO.new(xml), columns: { at: :time })
+    assert_equal([handler.item.to_i * 1_000_000_000 + handler.item.nsec], columns.cols[:at].unpack('q*'))
+  end
+
+  def test_sax_columns
+    Ox.default_options = $ox_sax_options
+    handler = ColumnSax.new
+    xml = %{<readings>
+  <r><n>3</n><v>1.5</v><at>2012-01-05T10:20:30.5Z</at></r>
+  <r><n>-9223372036854775808</n><v>-2.25e3</v><at>2012-01-05 10:20:30 +01:00</at></r>
+  <r><n>x</n><v>0.1</v><at>1325758830.25</at></r>
+</readings>}
+    Ox.sax_parse(handler, StringIO.new(xml), columns: { n: :int, 'v' => :float, at: :time })
+    assert_equal([3, -9_223_372_036_854_775_808, 0], handler.cols[:n].unpack('q*'))
+    assert_equal([1.5, -2250.0, 0.1], handler.cols['v'].unpack('d*'))
+    base = Time.utc(2012, 1, 5, 10, 20, 30).to_i * 1_000_000_000
+    assert_equal([base + 500_000_000, base - 3_600_000_000_000, 1_325_758_830_250_000_000],
+                 handler.cols[:at].unpack('q*'))
+    assert_equal(1, handler.errors.size)
+    assert_equal(13, handler.names.size)
+    assert_raise(Ox::ParseError) { Ox.sax_parse(handler, StringIO.new(xml), columns: { n: :bad }) }
+  end
+
+  def test_sax_columns_empty_and_cdata
+    Ox.default_options = $ox_sax_options
+    handler = ColumnSax.new
+    long = '0.' + ('0' * 80) + '15'
+    xml = %{<readings>
+  <r><n>1</n><v>#{long}</v></r>
+  <r><n/><v></v></r>
+  <r><n>  </n><v><![CDATA[2.5]]></v></r>
+  <r><n><![CDATA[ 4 ]]></n><v>3.5</v></r>
+</readings>}
+    Ox.sax_parse(handler, StringIO.new(xml), columns: { n: :int, v: :float })
+    assert_equal(0, handler.errors.size)
+    min = -9_223_372_036_854_775_808
+    assert_equal([1, min, min, 4], handler.cols[:n].unpack('q*'))
+    v = handler.cols[:v].unpack('d*')
+    assert_equal(4, v.size)
+    assert_equal([1.5e-81, 2.5, 3.5], [v[0], v[2], v[3]])
+    assert(v[1].nan?)
+
+    Ox.sax_parse(handler, StringIO.new("<r><n>1#{'0' * 70}</n></r>"), columns: { n: :int })
+    assert_equal(1, handler.errors.size)
+    assert_match('1' + ('0' * 70), handler.errors[0])
+  end
+
+  def test_sax_value_float_fast
+    Ox.default_options = $ox_sax_options
+    handler = TypeSax.new(:as_f)
+    ['0.1', '-1.25e-3', '123456789.123', '1e23', '4.9e-324', '0.30000000000000004', '12345678901234567890'].each do |s|
+      Ox.sax_parse(handler, StringIO.new(%{<top>#{s}</top>}))
+      assert_equal(s.to_f, handler.item, s)
+    end
+  end
+
+  def test_sax_value_time_zone
+    Ox.default_options = $ox_sax_options
+    handler = TypeSax.new(:as_time)
+    Ox.sax_parse(handler, StringIO.new(%{<top>2012-01-05T10:20:30.123456789+05:30</top>}))
+    assert_equal(Time.utc(2012, 1, 5, 4, 50, 30).to_i, handler.item.to_i)
+    assert_equal(123_456_789, handler.item.nsec)
+    assert_equal(19_800, handler.item.utc_offset)
+    Ox.sax_parse(handler, StringIO.new(%{<top>2012-01-05T10:20:30Z</top>}))
+    assert(handler.item.utc?)
+  end
+
+  def test_sax_push_parser
+    Ox.default_options = $ox_sax_options
+    xml = %{<?xml version="1.0"?>
+<!DOCTYPE top PUBLIC "top.dtd">
+<top attr="one &amp; two">
+  <!-- a comment -->
+  <child>some text</child>
+  <![CDATA[<raw>]]>
+  <empty/>
+</top>
+}
+    expected = AllSax.new
+    Ox.sax_parse(expected, StringIO.new(xml))
+    [1, 3, 7, xml.size].each do |size|
+      handler = AllSax.new
+      parser = Ox::Sax::Parser.new(handler, skip: :skip_return)
+      xml.scan(/.{1,#{size}}/m) { |chunk| parser << chunk }
+      assert(!parser.finished?)
+      parser.finish
+      assert(parser.finished?)
+      assert_equal(expected.calls, handler.calls, "chunk size #{size}")
+    end
+    handler = AllSax.new
+    parser = Ox::Sax::Parser.new(handler)
+    parser << '<top><chi'
+    assert_equal([[:start_element, :top]], handler.calls)
+    parser << 'ld>'
+    assert_equal([[:start_element, :top], [:start_element, :child]], handler.calls)
+    parser.finish
+    assert_equal([:error, "Start End Mismatch: element 'child' not closed", 1, 12], handler.calls[2])
+    assert_equal([:end_element, :top], handler.calls[-1])
+    assert_raise(Ox::ArgError) { parser << '</top>' }
+  end
+
   def test_sax_nested_same_prefix
     Ox.default_options = $ox_sax_options
     handler = ErrorSax.new
@@ -1365,6 +1648,29 @@ this is not part of the xml document
                  ], handler.calls)
   end
 
+  def test_sax_html_overlay_case
+    Ox.default_options = $ox_sax_options
+    handler = AllSax.new
+    Ox.sax_html(handler, '<HTML><H1>title</h1><Hr/><p>Hello</P></html>', overlay: { 'HR'=>:inactive, 'H1'=>:off })
+    assert_equal([
+                   [:start_element, :HTML],
+                   [:start_element, :p],
+                   [:text, 'Hello'],
+                   [:end_element, :p],
+                   [:end_element, :HTML]
+                 ], handler.calls)
+
+    # The overlay only applies to the parse it was given to.
+    handler = AllSax.new
+    Ox.sax_html(handler, '<html><hr/></html>')
+    assert_equal([
+                   [:start_element, :html],
+                   [:start_element, :hr],
+                   [:end_element, :hr],
+                   [:end_element, :html]
+                 ], handler.calls)
+  end
+
   def test_sax_html_active
     Ox.default_options = $ox_sax_options
     handler = AllSax.new
@@ -40,6 +40,9 @@ $ox_object_options = {
   convert_special: true,
   effort: :strict,
   no_empty: false,
+  memoize: false,
+  parallel: 0,
+  measure: false,
   with_cdata: false,
   invalid_replace: '',
   strip_namespace: false,
@@ -65,6 +68,9 @@ $ox_generic_options = {
   convert_special: true,
   effort: :strict,
   no_empty: false,
+  memoize: false,
+  parallel: 0,
+  measure: false,
   with_cdata: false,
   invalid_replace: '',
   strip_namespace: false,
@@ -101,6 +107,9 @@ class Func < Test::Unit::TestCase
       convert_special: false,
       effort: :tolerant,
       no_empty: true,
+      memoize: true,
+      parallel: 4,
+      measure: true,
       with_cdata: true,
       invalid_replace: '*',
       strip_namespace: 'spaced',
@@ -168,6 +177,24 @@ class Func < Test::Unit::TestCase
     dump_and_load(t, false)
   end
 
+  def test_time_xsd
+    Ox.default_options = $ox_object_options
+    t = Time.at(1_325_808_000, 123_456, :usec).localtime('+05:30')
+    xml = Ox.dump(t, mode: :object, xsd_date: true)
+    assert_equal(%{<t>2012-01-06T05:30:00.123456+05:30</t>\n}, xml)
+    loaded = Ox.load(xml, mode: :object)
+    assert_equal(t, loaded)
+    assert_equal(19_800, loaded.utc_offset)
+    assert_equal(%{<t>1969-12-31T23:59:59.500000+00:00</t>\n},
+                 Ox.dump(Time.at(-1, 500_000, :usec).utc, mode: :object, xsd_date: true))
+    [Time.utc(12_345, 6, 7, 8, 9, 10), Time.utc(-44, 3, 15, 12), Time.utc(-12_345, 1, 2)].each do |wide|
+      xml = Ox.dump(wide, mode: :object, xsd_date: true)
+      assert_equal(wide, Ox.load(xml, mode: :object))
+    end
+    assert_equal(%{<t>-0044-03-15T12:00:00.000000+00:00</t>\n},
+                 Ox.dump(Time.utc(-44, 3, 15, 12), mode: :object, xsd_date: true))
+  end
+
   def test_date
     Ox.default_options = $ox_object_options
     dump_and_load(Date.new(2011, 1, 5), false)
@@ -854,6 +881,43 @@ class Func < Test::Unit::TestCase
     dump_and_load(Bag.new(:@a => nil, :@b => true, :@c => false, :@d => 3, :@e => 'z', :@f => 7.9, :@g => 'a&b', :@h => :xyz, :@i => t, :@j => (-1..7)), false)
   end
 
+  def test_object_shape_change
+    Ox.default_options = $ox_object_options
+    # Objects of one class with different ivars and order in the same dump.
+    bags = [Bag.new(:@a => 1, :@b => 2),
+            Bag.new(:@b => 3, :@a => 4),
+            Bag.new(:@a => 5),
+            Bag.new(:@a => 6, :@b => 7, :@c => Bag.new(:@c => 8, :@a => 9)),
+            Bag.new(:@a => 10, :@b => 11)]
+    dump_and_load(bags, false)
+    xml = Ox.dump(bags[1], indent: -1)
+    assert_equal(%{<o c="Bag"><i a="@b">3</i><i a="@a">4</i></o>}, xml)
+  end
+
+  def test_object_class_not_retained
+    Ox.default_options = $ox_object_options
+    refs = ObjectSpace::WeakMap.new
+    20.times { |i| dump_removed_class(refs, i) }
+    4.times { GC.start(full_mark: true, immediate_sweep: true) }
+    assert_operator(refs.keys.size, :<, 20)
+    frozen = Class.new(Bag).freeze
+    Object.const_set(:FrozenBag, frozen)
+    assert_equal(%{<o c="FrozenBag"><i a="@a">1</i></o>}, Ox.dump(frozen.new(:@a => 1), indent: -1))
+  ensure
+    Object.send(:remove_const, :FrozenBag) if Object.const_defined?(:FrozenBag)
+  end
+
+  def dump_removed_class(refs, i)
+    name = :"RemovedBag#{i}"
+    klass = Class.new(Bag)
+    Object.const_set(name, klass)
+    assert_equal(%{<o c="#{name}"><i a="@a">1</i></o>}, Ox.dump(klass.new(:@a => 1), indent: -1))
+    assert_equal([], klass.instance_variables)
+    Object.send(:remove_const, name)
+    refs[klass] = i
+    nil
+  end
+
   def test_complex
     Ox.default_options = $ox_object_options
     dump_and_load(Bag.new(:@o => Bag.new(:@a => [2]), :@a => [1, { b: 3, a: [5], c: Bag.new(:@x => 7) }]), false)
@@ -887,6 +951,154 @@ class Func < Test::Unit::TestCase
 '))
   end
 
+  def test_dump_memoize
+    Ox.default_options = $ox_generic_options
+    doc = Ox::Document.new
+    root = Ox::Element.new('root')
+    doc << root
+    10.times { |i|
+      e = Ox::Element.new('item')
+      e[:id] = i.to_s
+      e << Ox::Element.new('name').tap { |n| n << "name #{i}" * 20 }
+      root << e
+    }
+    shared = Ox::Element.new('shared')
+    shared << 'shared text' * 30
+    root.nodes[0] << shared
+    root.nodes[1] << shared
+    check = lambda {
+      [2, 0, -1].each { |indent|
+        expected = Ox.dump(doc, indent: indent)
+        assert_equal(expected, Ox.dump(doc, indent: indent, memoize: true))
+        assert_equal(expected, Ox.dump(doc, indent: indent, memoize: true))
+      }
+    }
+    check.call
+    root.nodes[2][:id] = 'changed'
+    check.call
+    root.nodes[3].nodes[0] << Ox::Element.new('extra')
+    check.call
+    root.nodes[4].nodes[0].replace_text('replaced')
+    check.call
+    root.nodes[5].prepend_child(Ox::Comment.new('first'))
+    check.call
+    root.nodes[6].name = 'renamed'
+    check.call
+    root.remove_children(root.nodes[7])
+    check.call
+    root.nodes[8].locate('name/^String').first << ' in place'
+    root.nodes[8].nodes[0].clear_memo
+    check.call
+    shared[:via] = 'both'
+    check.call
+    assert_equal([:@value, :@attributes, :@nodes], root.instance_variables)
+  end
+
+  def test_dump_memoize_subtree
+    Ox.default_options = $ox_generic_options
+    root = Ox::Element.new('root')
+    a = Ox::Element.new('a')
+    a << 'a' * 200
+    b = Ox::Element.new('b')
+    b << 'b' * 200
+    root << a << b
+    Ox.dump(root, indent: -1, memoize: true)
+    # A direct change is not seen so a is only rendered again after clear_memo.
+    a.nodes[0] << 'X'
+    b[:id] = 'new'
+    xml = Ox.dump(root, indent: -1, memoize: true)
+    assert_equal(%|<root><a>#{'a' * 200}</a><b id="new">#{'b' * 200}</b></root>|, xml)
+    a.clear_memo
+    xml = Ox.dump(root, indent: -1, memoize: true)
+    assert_equal(%|<root><a>#{'a' * 200}X</a><b id="new">#{'b' * 200}</b></root>|, xml)
+  end
+
+  def test_dump_memoize_detached
+    Ox.default_options = $ox_generic_options
+    refs = ObjectSpace::WeakMap.new
+    kid = memo_detached_kid(refs)
+    4.times { GC.start(full_mark: true, immediate_sweep: true) }
+    assert_operator(refs.keys.size, :<, 10)
+    kid << 'more'
+    assert_equal(%|<kid>#{'k' * 200}more</kid>|, Ox.dump(kid, indent: -1, memoize: true))
+  end
+
+  def memo_detached_kid(refs)
+    kid = nil
+    10.times { |i|
+      root = Ox::Element.new('root')
+      mid = Ox::Element.new('mid')
+      root << mid
+      kid = Ox::Element.new('kid')
+      kid << 'k' * 200
+      mid << kid
+      xml = Ox.dump(root, memoize: true)
+      # Only the kid, as the smallest kept element, and the root keep XML.
+      assert_equal(2, ObjectSpace.each_object(String).count { |str| str.frozen? && str.include?('k' * 200) })
+      assert_equal(xml, Ox.dump(Marshal.load(Marshal.dump(root)), memoize: true))
+      mid.remove_children(kid)
+      refs[root] = i
+    }
+    kid
+  end
+
+  def test_dump_parallel
+    Ox.default_options = $ox_object_options
+    vals = Array.new(5000) { |i| [i, -i * 7, i * 1.5, "s<#{i}>&\"'", :"sym#{i}", nil, true, false][i % 8] }
+    [2, 0, -1].each { |indent|
+      assert_equal(Ox.dump(vals, indent: indent), Ox.dump(vals, indent: indent, parallel: 4))
+      assert_equal(Ox.dump(vals, indent: indent, no_empty: true),
+                   Ox.dump(vals, indent: indent, no_empty: true, parallel: 4))
+    }
+    assert_equal(vals, Ox.load(Ox.dump(vals, parallel: 4), mode: :object))
+    mixed = vals + [Bag.new(:@x => 1)]
+    assert_equal(Ox.dump(mixed), Ox.dump(mixed, parallel: 4))
+    assert_raise(Ox::SyntaxError) { Ox.dump(vals + ["bad\x01"], parallel: 4) }
+
+    Ox.default_options = $ox_generic_options
+    doc = Ox::Document.new
+    root = Ox::Element.new('root')
+    doc << root
+    5000.times { |i|
+      e = Ox::Element.new('item')
+      e[:id] = i
+      e[:q] = %{a"b<c>&'d}
+      case i % 4
+      when 0 then e << "text #{i} & more"
+      when 1 then e << (Ox::Element.new('sub') << 'x' << Ox::Element.new('deep'))
+      when 2 then e << Ox::Comment.new('note') << Ox::CData.new('<raw>')
+      end
+      root << e
+      root << 'between' if 0 == i % 100
+    }
+    root << 'last'
+    [2, 0, -1].each { |indent|
+      assert_equal(Ox.dump(doc, indent: indent), Ox.dump(doc, indent: indent, parallel: 4))
+      assert_equal(Ox.dump(doc, indent: indent, no_empty: true),
+                   Ox.dump(doc, indent: indent, no_empty: true, parallel: 4))
+    }
+  end
+
+  def test_dump_measure
+    Ox.default_options = $ox_generic_options
+    doc = Ox::Document.new(version: '1.0')
+    root = Ox::Element.new('root')
+    doc << root
+    root[:q] = %{a"b'c<d>&e\x01}
+    root << Ox::Instruct.new('pi').tap { |i| i.content = 'data' }
+    root << (Ox::Element.new('text') << %{t"'<>&\x02})
+    root << Ox::Comment.new('note') << Ox::CData.new('<cd>') << Ox::Raw.new('<raw/>') << Ox::Element.new('empty')
+    [2, 0, -1].each { |indent|
+      [{}, { no_empty: true }, { margin: '##' }, { with_xml: true, with_instruct: true }, { invalid_replace: '??' },
+       { invalid_replace: nil }].each { |opts|
+        opts = opts.merge(indent: indent, effort: :tolerant)
+        assert_equal(Ox.dump(doc, opts), Ox.dump(doc, opts.merge(measure: true)))
+        assert_equal(Ox.dump(root, opts), Ox.dump(root, opts.merge(measure: true)))
+      }
+    }
+    assert_raise(Ox::SyntaxError) { Ox.dump(doc, measure: true, effort: :strict) }
+  end
+
   # Create an Object and an Array with the same Objects in them. Dump and load
   # and then change the ones in the loaded Object to verify that the ones in
   # the array change in the same way. They are the same objects so they should
@@ -1080,6 +1292,83 @@ class Func < Test::Unit::TestCase
     end
   end
 
+  def test_compact
+    Ox.default_options = $ox_generic_options
+    xml = %{<?xml?>
+<Family real="false">
+  <Pete age="57" type="male">
+    <Kid gender="female" age="32">Nicole &amp; Co</Kid>
+    <Kid gender="female" age="31"/>
+  </Pete>
+</Family>
+}
+    doc = Ox.load(xml, mode: :compact)
+    pete = doc.root.nodes[0]
+    kid = pete.nodes[0]
+    assert_equal('Nicole & Co', kid.instance_variable_get(:@nodes))
+    assert_equal(['Nicole & Co'], doc.locate('Family/Pete/Kid/^Text'))
+    [-1, 0, 2].each { |indent|
+      assert_equal(Ox.dump(Ox.load(xml, mode: :generic), indent: indent), Ox.dump(doc, indent: indent))
+      assert_equal(Ox.dump(Ox.load(xml, mode: :generic), indent: indent), Ox.dump(doc, indent: indent, measure: true))
+    }
+    assert_equal([:age, '57', :type, 'male'], pete.instance_variable_get(:@attributes))
+    assert_equal('57', pete[:age])
+    assert_equal('male', pete['type'])
+    assert_nil(pete[:none])
+    assert_equal(['31', '32'], doc.locate('Family/Pete/Kid/@age').sort)
+    assert_equal(1, doc.locate('Family/Pete/Kid[@age=31]').size)
+    assert_equal(Ox.dump(Ox.load(xml, mode: :generic), with_xml: true), Ox.dump(doc, with_xml: true))
+    assert_equal({ age: '57', type: 'male' }, pete.attributes)
+    assert_equal('Nicole & Co', kid.text)
+    kid << Ox::Element.new('Pet')
+    assert_equal(['Nicole & Co', Ox::Element.new('Pet')], kid.nodes)
+    kid.remove_children(kid.nodes[1])
+    assert_equal(Ox.load(xml, mode: :generic), doc)
+  end
+
+  def test_compact_parallel
+    Ox.default_options = $ox_generic_options
+    xml = %{<items>#{(0...3000).map { |i| %{<i n="#{i}">item &lt;#{i}&gt;</i>} }.join}</items>}
+    doc = Ox.load(xml, mode: :compact)
+    assert_equal(Ox.dump(Ox.load(xml, mode: :generic)), Ox.dump(doc, parallel: 4))
+  end
+
+  def test_parse_lazy
+    Ox.default_options = $ox_generic_options
+    xml = %{<?xml version="1.0"?>
+<Family real="false">
+  <!--family-->
+  <Pete age="57" type="male">
+    <Kid gender="female" age="32">Nicole</Kid>
+    <Kid gender="female" age="31"><![CDATA[Pamela]]></Kid>
+  </Pete>
+</Family>
+}
+    root = Ox.parse_lazy(xml)
+    assert_equal(Ox::LazyElement, root.class)
+    assert_equal('Family', root.name)
+    assert_equal('false', root[:real])
+    assert_nil(root.instance_variable_get(:@nodes))
+    pete = root.nodes[1]
+    assert_equal(Ox::Comment, root.nodes[0].class)
+    assert_equal('57', pete.attributes[:age])
+    assert_nil(pete.instance_variable_get(:@nodes))
+    assert_equal('Nicole', root.Pete.Kid.text)
+    assert_equal(['31', '32'], root.locate('Pete/Kid/@age').sort)
+    assert_equal(Ox.parse(xml).root, Ox.parse_lazy(xml))
+    assert_equal(Ox.parse_lazy(xml), Ox.parse(xml).root)
+    assert_not_equal(Ox.parse(xml), Ox.parse_lazy(xml))
+    lazy = Ox.parse_lazy(xml)
+    assert_equal(Ox.dump(Ox.parse(xml)), Ox.dump(lazy))
+    assert_equal(Ox.dump(Ox.parse(xml), indent: -1), Ox.dump(lazy, indent: -1))
+    assert_nil(lazy.instance_variable_get(:@nodes))
+    kid = Ox.parse_lazy(xml).locate('Pete/Kid')[1]
+    kid << 'more'
+    assert_equal(Ox::CData, kid.nodes[0].class)
+    assert_equal('more', kid.nodes[1])
+    assert_nil(Ox.parse_lazy('<!--none-->'))
+  end
+
   def test_IO
     Ox.default_options = $ox_object_options
     f = File.open(__FILE__, 'r')
@@ -1618,6 +1907,82 @@ comment -->
 |, xml)
   end
 
+  def test_load_file_compressed
+    require 'zlib'
+    filename = File.join(File.dirname(__FILE__), 'create_file_test.xml.gz')
+    xml = %{<top><child a="1">one</child><child>two</child></top>}
+    File.binwrite(filename, Zlib.gzip(xml))
+    assert_equal(Ox.load(xml, mode: :hash), Ox.load_file(filename, mode: :hash, compressed: true))
+    File.binwrite(filename, Zlib.deflate(xml))
+    assert_equal(Ox.load(xml, mode: :hash), Ox.load_file(filename, mode: :hash, compressed: true))
+  ensure
+    File.delete(filename) if File.exist?(filename)
+  end
+
+  def test_index_file
+    filename = File.join(File.dirname(__FILE__), 'create_file_test.xml')
+    index_name = File.join(File.dirname(__FILE__), 'create_file_test.oxi')
+    xml = %{<?xml version="1.0"?>
+<top>
+  <!-- <rec id="0"> -->
+  <rec id="1"><name>one</name></rec>
+  <rec id='2'/>
+  <rec id="3"><![CDATA[</rec>]]></rec >
+  <rec><name>four</name></rec>
+</top>
+}
+    File.write(filename, xml)
+    index = Ox.index_file(filename, element: 'rec', key: '@id', index: index_name)
+    assert_equal(%w[1 2 3], index.keys)
+    assert_equal('<rec id="1"><name>one</name></rec>', xml.byteslice(*index['1']))
+    assert_equal(%|<rec id='2'/>|, xml.byteslice(*index['2']))
+    assert_equal('<rec id="3"><![CDATA[</rec>]]></rec >', xml.byteslice(*index['3']))
+    assert_equal(index, Ox.load_index(index_name))
+    assert_equal({ rec: [{ id: '1' }, { name: 'one' }] }, Ox.load_at(filename, *index['1'], mode: :hash))
+
+    index = Ox.index_file(filename, element: :rec, key: 'name')
+    assert_equal(%w[one four], index.keys)
+    assert_equal('<rec><name>four</name></rec>', xml.byteslice(*index['four']))
+  ensure
+    File.delete(filename) if File.exist?(filename)
+    File.delete(index_name) if File.exist?(index_name)
+  end
+
+  def test_index_file_key_text
+    filename = File.join(File.dirname(__FILE__), 'create_file_test.xml')
+    index_name = File.join(File.dirname(__FILE__), 'create_file_test.oxi')
+    xml = %{<top>
+  <rec id="a&amp;b"><name>x &lt; y</name></rec>
+  <rec id="&#233;&#x4e2d;"><name><![CDATA[ p&amp;q ]]]></name></rec>
+  <rec id="&bogus;"><name>&#65;<![CDATA[<b>]]>&copy;</name></rec>
+</top>
+}
+    File.write(filename, xml)
+    index = Ox.index_file(filename, element: 'rec', key: '@id', index: index_name)
+    assert_equal(['a&b', "\u00e9\u4e2d", '&bogus;'], index.keys)
+    assert_equal(index, Ox.load_index(index_name))
+    index = Ox.index_file(filename, element: 'rec', key: 'name')
+    assert_equal(['x < y', 'p&amp;q ]', "A<b>\u00a9"], index.keys)
+    assert_equal('<rec id="a&amp;b"><name>x &lt; y</name></rec>', xml.byteslice(*index['x < y']))
+  ensure
+    File.delete(filename) if File.exist?(filename)
+    File.delete(index_name) if File.exist?(index_name)
+  end
+
+  def test_index_file_closes_on_error
+    skip 'needs /proc' unless File.directory?('/proc/self/fd')
+    filename = File.join(File.dirname(__FILE__), 'create_file_test.xml')
+    File.write(filename, '<top><rec id="1"/></top>')
+    GC.start
+    fds = Dir.children('/proc/self/fd').size
+    10.times do
+      assert_raise(IOError) { Ox.index_file(filename, element: 'rec', key: '@id', index: '/no/such/dir/x.oxi') }
+    end
+    assert_operator(Dir.children('/proc/self/fd').size, :<=, fds)
+  ensure
+    File.delete(filename) if File.exist?(filename)
+  end
+
   def test_builder_file
     filename = File.join(File.dirname(__FILE__), 'create_file_test.xml')
     b = Ox::Builder.file(filename, indent: 2)
@@ -1643,6 +2008,51 @@ comment -->
 |, xml)
   end
 
+  def test_builder_file_scatter
+    filename = File.join(File.dirname(__FILE__), 'create_file_test.xml')
+    big = 'x' * 20_000
+    mid = "line\n" * 1_000
+    build = proc { |b|
+      b.element('blobs')
+      100.times do |i|
+        b.element('blob', id: i.to_s)
+        b.text(i.even? ? big : mid)
+        b.pop
+      end
+      b.element('data')
+      b.cdata(mid)
+      b.raw(big)
+      b.text('a < b' * 1_000)
+      b.pop
+      b.pop
+    }
+    expect = Ox::Builder.new(indent: 1) { |b| build.call(b) }
+
+    b = Ox::Builder.file(filename, indent: 1, scatter: true)
+    build.call(b)
+    # Changing a String after it was added must not change the output.
+    big << 'y'
+    mid.replace('z')
+    b.close
+    assert_equal(expect, File.read(filename))
+  end
+
+  def test_builder_file_scatter_text
+    require 'objspace'
+    filename = File.join(File.dirname(__FILE__), 'create_file_test.xml')
+    text = 'x' * 100_000
+    cdata = 'x' * 100_000
+    b = Ox::Builder.file(filename, scatter: true)
+    b.element('data')
+    # A queued String shares its bytes with the frozen copy the builder holds
+    # so it no longer reports them as its own.
+    b.cdata(cdata)
+    b.text(text)
+    assert_equal(ObjectSpace.memsize_of(cdata), ObjectSpace.memsize_of(text))
+    b.close
+    assert_equal(Ox::Builder.new { |x| x.element('data') { x.cdata(cdata); x.text(text) } }, File.read(filename))
+  end
+
   def test_builder_io
     omit 'needs fork' unless Process.respond_to?(:fork)
 
@@ -1765,6 +2175,145 @@ comment -->
     assert_equal(%|<?xml version="1.0" encoding="UTF-8"?><one a="ack" b="back">hello</one>|, xml)
   end
 
+  def test_builder_reset
+    b = Ox::Builder.new(indent: -1)
+    b.element('one')
+    b.element('two')
+    b.reset
+    b.element('three')
+    b.close
+    assert_equal('<three/>', b.to_s)
+    big = 'x' * 40_000
+    b.reset
+    assert_equal(0, b.pos)
+    b.element('big')
+    b.text(big)
+    b.close
+    assert_equal("<big>#{big}</big>", b.to_s!)
+    assert_equal('', b.to_s)
+  end
+
+  def test_builder_reset_after_bad_element
+    b = Ox::Builder.new(indent: -1)
+    b.element('a')
+    assert_raise(Ox::ArgError) { b.element(7) }
+    b.reset
+    b.element('b')
+    b.close
+    assert_equal('<b/>', b.to_s)
+    b.reset
+    b.element('c' * 200)
+    assert_raise(Ox::ArgError) { b.element(nil) }
+    b.text('x')
+    b.close
+    assert_equal("<#{'c' * 200}>x</#{'c' * 200}>", b.to_s!)
+    assert_raise(Ox::ArgError) { Ox::Builder.pooled { |pb| pb.element('a'); pb.element(7) } }
+    assert_equal('<ok/>', Ox::Builder.pooled(indent: -1) { |pb| pb.element('ok') })
+  end
+
+  def test_builder_pooled
+    xml = Ox::Builder.pooled(indent: 0) { |b| b.element('a', x: '1') { b.text('one') } }
+    assert_equal(%|<a x="1">one</a>
+|, xml)
+    inner = nil
+    xml = Ox::Builder.pooled(indent: -1) do |b|
+      b.element('outer')
+      inner = Ox::Builder.pooled(indent: -1) { |b2| b2.element('inner') }
+    end
+    assert_equal('<outer/>', xml)
+    assert_equal('<inner/>', inner)
+    assert_raise(RuntimeError) { Ox::Builder.pooled { |b| b.element('oops'); raise 'fail' } }
+    assert_equal('<ok/>', Ox::Builder.pooled(indent: -1) { |b| b.element('ok') })
+  end
+
+  def test_builder_emit_hash
+    b = Ox::Builder.new(indent: 0)
+    b.element('top')
+    b.emit_hash({ a: '1', b: nil, c: { d: 2 }, e: %w[x y] })
+    b.close
+    assert_equal(%|<top><a>1</a><b/><c><d>2</d></c><e>x</e><e>y</e></top>
+|, b.to_s)
+  end
+
+  def test_dump_hash
+    Ox.default_options = $ox_generic_options
+    xml = %{<top>
+  <a>one</a>
+  <b>
+    <c>two</c>
+  </b>
+  <d/>
+  <e>3</e>
+  <e>4</e>
+</top>
+}
+    h = Ox.load(xml, mode: :hash)
+    assert_equal(xml, Ox.dump_hash(h, indent: 2))
+    assert_equal(%|<list><i>1</i><i>2</i></list>|, Ox.dump_hash({ i: [1, 2] }, root: :list, indent: -1))
+    xml = %{<top><a x="1" y="2">text</a><b z="3"><c/></b></top>}
+    h = Ox.load(xml, mode: :hash, symbolize_keys: true)
+    assert_equal(xml, Ox.dump_hash(h, attrs: true, indent: -1))
+    assert_equal('<a>&lt;&amp;&gt;</a>', Ox.dump_hash({ a: '<&>' }, indent: -1))
+    assert_raise(Ox::ArgError) { Ox.dump_hash({ 7 => 'x' }) }
+    assert_equal('<ok/>', Ox.dump_hash({ ok: nil }, indent: -1))
+  end
+
+  def test_dump_hash_bad_key_reuse
+    long = 'n' * 100
+    bad = { a: { long.to_sym => { b: { 7 => 'x' } } } }
+    100.times do
+      assert_raise(Ox::ArgError) { Ox.dump_hash(bad) }
+      assert_raise(Ox::ArgError) { Ox.dump_hash({ a: [{ 3 => '1' }, 'x'] }, attrs: true) }
+      assert_raise(Ox::ArgError) { Ox.dump_hash({ a: nil }, root: 1.5) }
+    end
+    assert_equal(%|<a><#{long}><b>x</b></#{long}></a>|, Ox.dump_hash({ a: { long => { b: 'x' } } }, indent: -1))
+    assert_equal('<ok/>', Ox::Builder.pooled(indent: -1) { |b| b.element('ok') })
+  end
+
+  def test_template
+    t = Ox::Template.compile(%{<env id="{{id}}" note='{{note}}'>
+  <name>{{ name }}</name>
+  <data><![CDATA[{{data}}]]></data>
+  <id>{{id}}</id>
+</env>
+})
+    assert_equal([:id, :note, :name, :data], t.slots)
+    assert_equal(%{<env id="7" note='it&apos;s &quot;x&quot;'>
+  <name>a&lt;b &amp; c</name>
+  <data><![CDATA[<x/>]]></data>
+  <id>7</id>
+</env>
+}, t.render(id: 7, note: %{it's "x"}, 'name' => 'a<b & c', data: '<x/>'))
+    assert_equal(%{<env id="1" note=''>
+  <name>n</name>
+  <data><![CDATA[]]></data>
+  <id>1</id>
+</env>
+}, t.render([1, nil, 'n', nil]))
+    assert_raise(Ox::ArgError) { t.render(id: 1) }
+    cdata = Ox::Template.compile('<d><![CDATA[{{d}}]]></d>')
+    xml = cdata.render(d: 'a]]>b]]]>c]]>')
+    assert_equal('<d><![CDATA[a]]]]><![CDATA[>b]]]]]><![CDATA[>c]]]]><![CDATA[>]]></d>', xml)
+    assert_equal('a]]>b]]]>c]]>', Ox.parse(xml).nodes.map(&:value).join)
+    b = Ox::Builder.new(indent: -1)
+    b.template(cdata, d: "x]]>\ny]]>z")
+    assert_equal([2, 25, 53], [b.line, b.column, b.pos])
+    assert_raise(Ox::ArgError) { Ox::Template.compile('<a {{x}}/>') }
+    assert_raise(Ox::ArgError) { Ox::Template.compile('<a>{{x</a>') }
+
+    b = Ox::Builder.new(indent: 2)
+    b.element('top')
+    b.template(Ox::Template.compile('<x v="{{v}}">{{t}}</x>'), v: '"', t: 3)
+    b.element('after')
+    b.pop
+    b.pop
+    assert_equal(%{<top>
+  <x v="&quot;">3</x>
+  <after/>
+</top>
+}, b.to_s)
+  end
+
   def test_builder_text_with_invalid_characters_stripping
     b = Ox::Builder.new
     b.element('one')
@@ -2019,6 +2568,42 @@ comment -->
     enc = Ox.load(xml, mode: :limited).locate('name').first.text.encoding
     assert_equal('UTF-8', enc.to_s)
   end
+
+  def test_parser
+    Ox.default_options = $ox_generic_options
+    xml = %{<top a="1"><b>x</b><b>y</b><c><d>z</d></c></top>}
+    deep = ('<a>' * 40) + 'x' + ('</a>' * 40)
+    parser = Ox::Parser.new(mode: :hash, symbolize_keys: false)
+    3.times {
+      assert_equal(Ox.load(xml, mode: :hash, symbolize_keys: false), parser.load(xml))
+      assert_equal(Ox.load(deep, mode: :hash, symbolize_keys: false), parser.load(deep))
+    }
+    assert_equal(Ox.dump(Ox.parse(xml)), Ox.dump(parser.parse(xml)))
+    assert_raise(Ox::ParseError) { parser.load('<top><b>x</top') }
+    assert_equal({ 'top' => nil }, parser.load('<top/>'))
+
+    roots = []
+    Ox::Parser.new(mode: :generic).load('<one/><two/>') { |e| roots << e.value }
+    assert_equal(%w[one two], roots)
+    assert_raise(Ox::ArgError) { parser.load('<one/><two/>') { parser.load('<three/>') } }
+
+    obj = { 'a' => [1, 2.5, :b, nil, 'c'] }
+    parser = Ox::Parser.new(mode: :object)
+    2.times { assert_equal(obj, parser.load(Ox.dump(obj))) }
+    assert_raise(NameError) { parser.load('<o c="NoSuchKlass"/>') }
+    assert_equal(false, GC.enable)
+  end
+
+  def test_parser_encoding
+    Ox.default_options = $ox_generic_options
+    parser = Ox::Parser.new
+    xml = '<?xml version="1.0" encoding="UTF-8" ?><text>H&#233;ra&#239;dios</text>'.dup
+    xml.force_encoding(Encoding::ASCII_8BIT)
+    text = parser.load(xml).root.text
+    assert_equal('Héraïdios', text)
+    assert_equal(Encoding::UTF_8, text.encoding)
+    assert_equal(Encoding::ASCII_8BIT, parser.load('<text>x</text>'.b).text.encoding)
+  end
 end
 
 class Bag